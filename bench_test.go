@@ -0,0 +1,181 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * The ASF licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+package v8go
+
+import (
+    "strconv"
+    "testing"
+)
+
+// 运行: go test -run '^$' -bench . -benchmem -count 10 | tee new.txt
+// 与修改前的结果比较: benchstat old.txt new.txt
+
+const (
+    benchScript = "testdata/bench/main.js"
+    benchModule = "testdata/bench/module.mjs"
+)
+
+var benchSizes = []struct {
+    name   string
+    fields int
+}{
+    {"small", 4},
+    {"medium", 64},
+    {"large", 1024},
+}
+
+// 构造确定的消息负载, 与 main.js 中 makePayload 的结构一致
+func benchPayload(fields int) map[interface{}] interface{} {
+    items := make([]interface{}, 0, fields/8+1)
+    msg := map[interface{}] interface{}{"op": "state", "fields": fields}
+    for i := 0; i < fields; i++ {
+        msg["key"+strconv.Itoa(i)] = "value-" + strconv.Itoa(i)
+        if i%8 == 0 {
+            items = append(items, map[interface{}] interface{}{"id": i, "score": float64(i) * 1.5, "alive": i&1 == 0})
+        }
+    }
+    msg["items"] = items
+    return msg
+}
+
+func benchVM(b *testing.B) VM {
+    vm := CreateV8VM()
+    if !vm.Load(benchScript) {
+        b.Fatal("load " + benchScript + " failed")
+    }
+    return vm
+}
+
+func BenchmarkNewDisposeVM(b *testing.B) {
+    b.ReportAllocs()
+    for i := 0; i < b.N; i++ {
+        vm := CreateV8VM()
+        vm.Dispose()
+    }
+}
+
+func BenchmarkLoad(b *testing.B) {
+    b.Run("script", func(b *testing.B) {
+        b.ReportAllocs()
+        for i := 0; i < b.N; i++ {
+            b.StopTimer()
+            vm := CreateV8VM()
+            b.StartTimer()
+            if !vm.Load(benchScript) {
+                b.Fatal("load failed")
+            }
+            b.StopTimer()
+            vm.Dispose()
+            b.StartTimer()
+        }
+    })
+    b.Run("module", func(b *testing.B) {
+        b.ReportAllocs()
+        for i := 0; i < b.N; i++ {
+            b.StopTimer()
+            vm := CreateV8VM()
+            b.StartTimer()
+            if !vm.LoadModule(benchModule) {
+                b.Fatal("load module failed")
+            }
+            b.StopTimer()
+            vm.Dispose()
+            b.StartTimer()
+        }
+    })
+}
+
+func BenchmarkDispatchEnter(b *testing.B) {
+    vm := benchVM(b)
+    defer vm.Dispose()
+
+    b.ReportAllocs()
+    b.ResetTimer()
+    for i := 0; i < b.N; i++ {
+        if vm.DispatchEnter(uint64(i), "127.0.0.1:7000") != 0 {
+            b.Fatal("enter failed")
+        }
+    }
+}
+
+func BenchmarkDispatchLeave(b *testing.B) {
+    vm := benchVM(b)
+    defer vm.Dispose()
+
+    b.ReportAllocs()
+    b.ResetTimer()
+    for i := 0; i < b.N; i++ {
+        if vm.DispatchLeave(uint64(i), "127.0.0.1:7000") != 0 {
+            b.Fatal("leave failed")
+        }
+    }
+}
+
+func BenchmarkDispatchMessage(b *testing.B) {
+    for _, size := range benchSizes {
+        msg := benchPayload(size.fields)
+        b.Run(size.name, func(b *testing.B) {
+            vm := benchVM(b)
+            defer vm.Dispose()
+
+            b.SetBytes(int64(len(EncodeMessage(msg))))
+            b.ReportAllocs()
+            b.ResetTimer()
+            for i := 0; i < b.N; i++ {
+                if vm.DispatchMessage(1, msg) != 0 {
+                    b.Fatal("message failed")
+                }
+            }
+        })
+    }
+}
+
+// 脚本调用 net.sendCurrentPlayer 发送预先构造的负载, 衡量 GoSend 把 JS 值转换为 Go 值的开销
+func BenchmarkSend(b *testing.B) {
+    for _, size := range benchSizes {
+        msg := map[interface{}] interface{}{"op": "send", "size": size.name}
+        b.Run(size.name, func(b *testing.B) {
+            vm := benchVM(b)
+            defer vm.Dispose()
+
+            b.SetBytes(int64(len(EncodeMessage(benchPayload(size.fields)))))
+            b.ReportAllocs()
+            b.ResetTimer()
+            for i := 0; i < b.N; i++ {
+                if vm.DispatchMessage(1, msg) != 0 {
+                    b.Fatal("send failed")
+                }
+            }
+        })
+    }
+}
+
+func BenchmarkConsoleLog(b *testing.B) {
+    vm := benchVM(b)
+    defer vm.Dispose()
+
+    msg := map[interface{}] interface{}{"op": "log", "seq": 0}
+    b.ReportAllocs()
+    b.ResetTimer()
+    for i := 0; i < b.N; i++ {
+        msg["seq"] = i
+        if vm.DispatchMessage(1, msg) != 0 {
+            b.Fatal("log failed")
+        }
+    }
+}
@@ -0,0 +1,242 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * The ASF licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+package v8go
+
+/*
+#include <stdlib.h>
+#include "v8bridge.h"
+*/
+import "C"
+
+import (
+    "bytes"
+    "encoding/binary"
+    "errors"
+    "hash/fnv"
+    "io/ioutil"
+    "os"
+    "path/filepath"
+    "sort"
+    "strings"
+    "unsafe"
+)
+
+// 与 v8bundle.h 保持一致
+const (
+    bundleMagic      = "V8GB"
+    bundleVersion    = 1
+    bundleFlagModule = 1
+    bundleHeaderSize = 24
+    bundleEntrySize  = 48
+)
+
+type BundleStats struct {
+    Modules           uint64
+    Hits              uint64
+    CodeCacheAccepted uint64
+    CodeCacheRejected uint64
+}
+
+// 挂载脚本包, 之后 Load 和模块加载优先从包中取源码. root 为包内相对路径对应的目录, 为空时为工作目录.
+// 重复调用会原子替换之前的包.
+func MountBundle(path, root string) error {
+    cPath := C.CString(path)
+    defer C.free(unsafe.Pointer(cPath))
+    cRoot := C.CString(root)
+    defer C.free(unsafe.Pointer(cRoot))
+
+    if C.V8MountBundle(cPath, cRoot) != 0 {
+        return errors.New(C.GoString(C.V8LastBundleError()))
+    }
+    return nil
+}
+
+func UnmountBundle() {
+    C.V8UnmountBundle()
+}
+
+func GetBundleStats() BundleStats {
+    var cs C.V8BundleStats
+    C.V8GetBundleStats(&cs)
+    return BundleStats{
+        Modules:           uint64(cs.modules),
+        Hits:              uint64(cs.hits),
+        CodeCacheAccepted: uint64(cs.codeCacheAccepted),
+        CodeCacheRejected: uint64(cs.codeCacheRejected),
+    }
+}
+
+type bundleModule struct {
+    path   string
+    source []byte
+    module bool
+    cache  []byte
+}
+
+// 脚本包生成器
+type BundleBuilder struct {
+    // 为每个模块生成 code cache, 需要与运行时相同的 V8 版本和参数, 否则加载时会被拒绝并退回普通编译
+    CodeCache bool
+    // AddDir 用于判断文件是否按 ES 模块编译, 默认只有 .mjs 为模块
+    IsModule func(path string) bool
+
+    modules map[string]*bundleModule
+}
+
+func NewBundleBuilder() *BundleBuilder {
+    return &BundleBuilder{
+        IsModule: func(path string) bool {
+            return strings.HasSuffix(path, ".mjs")
+        },
+        modules: make(map[string]*bundleModule),
+    }
+}
+
+// path 为包内相对路径, 以 / 分隔
+func (b *BundleBuilder) Add(path string, source []byte, module bool) {
+    path = strings.TrimPrefix(filepath.ToSlash(path), "./")
+    b.modules[path] = &bundleModule{path: path, source: source, module: module}
+}
+
+// 添加 root 下所有 .js/.mjs 文件, 包内路径相对 root
+func (b *BundleBuilder) AddDir(root string) error {
+    return filepath.Walk(root, func(path string, info os.FileInfo, err error) error {
+        if err != nil {
+            return err
+        }
+        if info.IsDir() || !(strings.HasSuffix(path, ".js") || strings.HasSuffix(path, ".mjs")) {
+            return nil
+        }
+
+        rel, err := filepath.Rel(root, path)
+        if err != nil {
+            return err
+        }
+        source, err := ioutil.ReadFile(path)
+        if err != nil {
+            return err
+        }
+        b.Add(rel, source, b.IsModule(rel))
+        return nil
+    })
+}
+
+func (b *BundleBuilder) createCodeCaches() {
+    Init()
+    vm := CreateV8VM().(*V8VM)
+    defer vm.Dispose()
+
+    for _, m := range b.modules {
+        if len(m.source) == 0 {
+            continue
+        }
+        cName := C.CString(m.path)
+        cSource := C.CBytes(m.source)
+
+        var l C.size_t
+        buf := C.V8CreateCodeCache(vm.vmCPtr, cName, (*C.char)(cSource), C.size_t(len(m.source)), C.bool(m.module), &l)
+        if buf != nil {
+            m.cache = C.GoBytes(unsafe.Pointer(buf), C.int(l))
+            C.free(unsafe.Pointer(buf))
+        }
+
+        C.free(cSource)
+        C.free(unsafe.Pointer(cName))
+    }
+}
+
+func align8(n int) int {
+    return (n + 7) &^ 7
+}
+
+// 写入脚本包. 先写临时文件再改名, 保证替换是原子的
+func (b *BundleBuilder) WriteFile(path string) error {
+    if b.CodeCache {
+        b.createCodeCaches()
+    }
+
+    modules := make([]*bundleModule, 0, len(b.modules))
+    for _, m := range b.modules {
+        modules = append(modules, m)
+    }
+    sort.Slice(modules, func(i, j int) bool {
+        return modules[i].path < modules[j].path
+    })
+
+    pathsOffset := bundleHeaderSize + len(modules)*bundleEntrySize
+    offset := pathsOffset
+    for _, m := range modules {
+        offset += len(m.path)
+    }
+
+    entries := make([]byte, len(modules)*bundleEntrySize)
+    var data bytes.Buffer
+    pathOffset := pathsOffset
+    for i, m := range modules {
+        offset = align8(offset)
+        sourceOffset := offset
+        offset += len(m.source)
+        offset = align8(offset)
+        cacheOffset := offset
+        offset += len(m.cache)
+
+        h := fnv.New64a()
+        h.Write(m.source)
+
+        var flags uint32
+        if m.module {
+            flags |= bundleFlagModule
+        }
+
+        e := entries[i*bundleEntrySize:]
+        binary.LittleEndian.PutUint64(e[0:], h.Sum64())
+        binary.LittleEndian.PutUint64(e[8:], uint64(sourceOffset))
+        binary.LittleEndian.PutUint64(e[16:], uint64(cacheOffset))
+        binary.LittleEndian.PutUint32(e[24:], uint32(pathOffset))
+        binary.LittleEndian.PutUint32(e[28:], uint32(len(m.path)))
+        binary.LittleEndian.PutUint32(e[32:], uint32(len(m.source)))
+        binary.LittleEndian.PutUint32(e[36:], uint32(len(m.cache)))
+        binary.LittleEndian.PutUint32(e[40:], flags)
+        pathOffset += len(m.path)
+    }
+
+    header := make([]byte, bundleHeaderSize)
+    copy(header, bundleMagic)
+    binary.LittleEndian.PutUint32(header[4:], bundleVersion)
+    binary.LittleEndian.PutUint32(header[8:], uint32(len(modules)))
+    binary.LittleEndian.PutUint64(header[16:], uint64(offset))
+
+    data.Grow(offset)
+    data.Write(header)
+    data.Write(entries)
+    for _, m := range modules {
+        data.WriteString(m.path)
+    }
+    for _, m := range modules {
+        data.Write(make([]byte, align8(data.Len())-data.Len()))
+        data.Write(m.source)
+        data.Write(make([]byte, align8(data.Len())-data.Len()))
+        data.Write(m.cache)
+    }
+
+    tmp := path + ".tmp"
+    if err := ioutil.WriteFile(tmp, data.Bytes(), 0644); err != nil {
+        return err
+    }
+    return os.Rename(tmp, path)
+}
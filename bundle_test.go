@@ -0,0 +1,92 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * The ASF licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+package v8go
+
+import (
+    "encoding/binary"
+    "io/ioutil"
+    "path/filepath"
+    "strings"
+    "testing"
+)
+
+func TestBundleReaderRejectsDamagedFiles(t *testing.T) {
+    dir := t.TempDir()
+    path := filepath.Join(dir, "scripts.bundle")
+
+    b := NewBundleBuilder()
+    b.Add("main.js", []byte("var x = 1;\n"), false)
+    b.Add("lib/util.mjs", []byte("export const y = 2;\n"), true)
+    if err := b.WriteFile(path); err != nil {
+        t.Fatal(err)
+    }
+    good, err := ioutil.ReadFile(path)
+    if err != nil {
+        t.Fatal(err)
+    }
+    sourceOffset := binary.LittleEndian.Uint64(good[bundleHeaderSize+8:])
+
+    cases := []struct {
+        name   string
+        mutate func([]byte) []byte
+        err    string
+    }{
+        {"intact", func(b []byte) []byte { return b }, ""},
+        {"empty", func(b []byte) []byte { return b[:0] }, "truncated"},
+        {"partial header", func(b []byte) []byte { return b[:bundleHeaderSize-1] }, "truncated"},
+        {"header only", func(b []byte) []byte { return b[:bundleHeaderSize] }, "bad header"},
+        {"partial entries", func(b []byte) []byte { return b[:bundleHeaderSize+bundleEntrySize] }, "bad header"},
+        {"missing last byte", func(b []byte) []byte { return b[:len(b)-1] }, "bad header"},
+        {"bad magic", func(b []byte) []byte { b[0] = 'X'; return b }, "bad header"},
+        {"bad version", func(b []byte) []byte { b[4]++; return b }, "bad header"},
+        {"count too large", func(b []byte) []byte { binary.LittleEndian.PutUint32(b[8:], 1<<20); return b }, "bad header"},
+        {
+            "path out of range",
+            func(b []byte) []byte { binary.LittleEndian.PutUint32(b[bundleHeaderSize+24:], uint32(len(b))); return b },
+            "corrupted at entry 0",
+        },
+        {
+            "source out of range",
+            func(b []byte) []byte { binary.LittleEndian.PutUint32(b[bundleHeaderSize+32:], uint32(len(b))); return b },
+            "corrupted at entry 0",
+        },
+        {"source modified", func(b []byte) []byte { b[sourceOffset] ^= 0xff; return b }, "corrupted at entry 0"},
+    }
+
+    defer UnmountBundle()
+    for _, c := range cases {
+        t.Run(c.name, func(t *testing.T) {
+            data := c.mutate(append([]byte(nil), good...))
+            damaged := filepath.Join(dir, strings.Replace(c.name, " ", "-", -1)+".bundle")
+            if err := ioutil.WriteFile(damaged, data, 0644); err != nil {
+                t.Fatal(err)
+            }
+
+            err := MountBundle(damaged, dir)
+            if c.err == "" {
+                if err != nil {
+                    t.Fatalf("unexpected error: %v", err)
+                }
+                return
+            }
+            if err == nil || !strings.Contains(err.Error(), c.err) {
+                t.Fatalf("got error %v, want %q", err, c.err)
+            }
+        })
+    }
+}
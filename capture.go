@@ -0,0 +1,404 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * The ASF licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+package v8go
+
+/*
+#include "v8bridge.h"
+*/
+import "C"
+
+import (
+    "bufio"
+    "encoding/binary"
+    "errors"
+    "io"
+    "os"
+    "sort"
+    "sync"
+    "sync/atomic"
+    "time"
+)
+
+// 流量抓包格式, 小端:
+//   文件头: "V8TC" + u32 版本
+//   记录:   u8 类型, 3 字节保留, u32 虚拟机编号, u64 会话, i64 开始时间(相对抓包开始, ns),
+//           u64 耗时(ns), i32 返回值, u32 负载长度, 负载
+// enter/leave 的负载为地址, 消息与发送的负载为 EncodeMessage 格式.
+const (
+    captureMagic      = "V8TC"
+    captureVersion    = 2
+    captureRecordSize = 40
+)
+
+type CaptureKind uint8
+
+const (
+    CaptureEnter CaptureKind = iota + 1
+    CaptureLeave
+    // DispatchMessage 派发的消息
+    CaptureMessage
+    // DispatchMessageBuffer/DispatchLazyMessage 派发的消息
+    CaptureMessageBuffer
+    // net.sendCurrentPlayer
+    CaptureSend
+    // net.sendToOtherPlayer
+    CaptureSendTo
+)
+
+type CaptureRecord struct {
+    Kind     CaptureKind
+    VM       uint32
+    Session  uint64
+    Time     time.Duration
+    Duration time.Duration
+    Result   int
+    Payload  []byte
+}
+
+type captureWriter struct {
+    mu     sync.Mutex
+    f      *os.File
+    w      *bufio.Writer
+    start  time.Time
+    vmIds  map[*V8VM]uint32
+    header [captureRecordSize]byte
+    err    error
+}
+
+var activeCapture atomic.Value
+// 保证开始/停止抓包的检查与设置是原子的
+var captureMu sync.Mutex
+
+func currentCapture() *captureWriter {
+    c, _ := activeCapture.Load().(*captureWriter)
+    return c
+}
+
+// 开始把所有虚拟机的派发与发送记录到文件, 已在抓包时返回错误
+func StartCapture(path string) error {
+    captureMu.Lock()
+    defer captureMu.Unlock()
+    if currentCapture() != nil {
+        return errors.New("capture already started")
+    }
+    f, err := os.Create(path)
+    if err != nil {
+        return err
+    }
+    c := &captureWriter{f: f, w: bufio.NewWriterSize(f, 256*1024), start: time.Now(), vmIds: make(map[*V8VM]uint32)}
+    var head [8]byte
+    copy(head[:], captureMagic)
+    binary.LittleEndian.PutUint32(head[4:], captureVersion)
+    c.w.Write(head[:])
+    activeCapture.Store(c)
+    return nil
+}
+
+// 停止抓包并关闭文件, 返回抓包期间的第一个写入错误
+func StopCapture() error {
+    captureMu.Lock()
+    c := currentCapture()
+    if c == nil {
+        captureMu.Unlock()
+        return nil
+    }
+    activeCapture.Store((*captureWriter)(nil))
+    captureMu.Unlock()
+
+    c.mu.Lock()
+    defer c.mu.Unlock()
+    if err := c.w.Flush(); err != nil && c.err == nil {
+        c.err = err
+    }
+    if err := c.f.Close(); err != nil && c.err == nil {
+        c.err = err
+    }
+    c.vmIds = nil
+    return c.err
+}
+
+// 派发开始时间, 未抓包时为零值
+func captureStart() time.Time {
+    if currentCapture() == nil {
+        return time.Time{}
+    }
+    return time.Now()
+}
+
+func (c *captureWriter) write(kind CaptureKind, vm *V8VM, sessionId uint64, start time.Time, result int, payload []byte) {
+    var duration time.Duration
+    if !start.IsZero() {
+        duration = time.Since(start)
+    } else {
+        start = time.Now()
+    }
+
+    c.mu.Lock()
+    defer c.mu.Unlock()
+    if c.vmIds == nil || c.err != nil {
+        return
+    }
+    id, ok := c.vmIds[vm]
+    if !ok {
+        id = uint32(len(c.vmIds) + 1)
+        c.vmIds[vm] = id
+    }
+
+    h := c.header[:]
+    h[0] = byte(kind)
+    h[1], h[2], h[3] = 0, 0, 0
+    binary.LittleEndian.PutUint32(h[4:], id)
+    binary.LittleEndian.PutUint64(h[8:], sessionId)
+    binary.LittleEndian.PutUint64(h[16:], uint64(start.Sub(c.start)))
+    binary.LittleEndian.PutUint64(h[24:], uint64(duration))
+    binary.LittleEndian.PutUint32(h[32:], uint32(int32(result)))
+    binary.LittleEndian.PutUint32(h[36:], uint32(len(payload)))
+    if _, err := c.w.Write(h); err != nil {
+        c.err = err
+        return
+    }
+    if _, err := c.w.Write(payload); err != nil {
+        c.err = err
+    }
+}
+
+func captureEvent(kind CaptureKind, vm *V8VM, sessionId uint64, addr string, start time.Time, result int) {
+    if c := currentCapture(); c != nil {
+        c.write(kind, vm, sessionId, start, result, []byte(addr))
+    }
+}
+
+func captureMessage(vm *V8VM, sessionId uint64, msg map[interface{}] interface{}, start time.Time, result int) {
+    c := currentCapture()
+    if c == nil {
+        return
+    }
+    e := messageEncoderPool.Get().(*messageEncoder)
+    e.buf = e.buf[:0]
+    e.encodeMap(msg)
+    c.write(CaptureMessage, vm, sessionId, start, result, e.buf)
+    messageEncoderPool.Put(e)
+}
+
+func captureMessageBuffer(vm *V8VM, sessionId uint64, buf []byte, start time.Time, result int) {
+    if c := currentCapture(); c != nil {
+        c.write(CaptureMessageBuffer, vm, sessionId, start, result, buf)
+    }
+}
+
+// 记录脚本发出的消息, data 为转换后的 Go 值
+func captureSend(vmPtr C.VMPtr, to bool, data interface{}) {
+    c := currentCapture()
+    if c == nil {
+        return
+    }
+    vm := lookupVM(vmPtr)
+    if vm == nil {
+        return
+    }
+    kind := CaptureSend
+    if to {
+        kind = CaptureSendTo
+    }
+    e := messageEncoderPool.Get().(*messageEncoder)
+    e.buf = e.buf[:0]
+    // 发送 nil 或不支持的值时仍记录一次发送, 负载为 null
+    if !e.encode(data) {
+        e.buf = append(e.buf[:0], msgNull)
+    }
+    c.write(kind, vm, vm.sessionId, time.Time{}, 0, e.buf)
+    messageEncoderPool.Put(e)
+}
+
+// 读取抓包文件中的全部记录
+func LoadCapture(path string) ([]CaptureRecord, error) {
+    f, err := os.Open(path)
+    if err != nil {
+        return nil, err
+    }
+    defer f.Close()
+
+    r := bufio.NewReaderSize(f, 256*1024)
+    var head [8]byte
+    if _, err := io.ReadFull(r, head[:]); err != nil {
+        return nil, err
+    }
+    if string(head[:4]) != captureMagic || binary.LittleEndian.Uint32(head[4:]) != captureVersion {
+        return nil, errors.New("not a v8go capture file")
+    }
+
+    var records []CaptureRecord
+    var h [captureRecordSize]byte
+    for {
+        if _, err := io.ReadFull(r, h[:]); err != nil {
+            if err == io.EOF {
+                return records, nil
+            }
+            return records, err
+        }
+        rec := CaptureRecord{
+            Kind:     CaptureKind(h[0]),
+            VM:       binary.LittleEndian.Uint32(h[4:]),
+            Session:  binary.LittleEndian.Uint64(h[8:]),
+            Time:     time.Duration(binary.LittleEndian.Uint64(h[16:])),
+            Duration: time.Duration(binary.LittleEndian.Uint64(h[24:])),
+            Result:   int(int32(binary.LittleEndian.Uint32(h[32:]))),
+            Payload:  make([]byte, binary.LittleEndian.Uint32(h[36:])),
+        }
+        if _, err := io.ReadFull(r, rec.Payload); err != nil {
+            return records, err
+        }
+        records = append(records, rec)
+    }
+}
+
+type ReplayOptions struct {
+    // 按抓包中的时间间隔重放, 否则尽可能快
+    RealTime bool
+    // 为抓包中的每个虚拟机创建一个新虚拟机, 通常为 CreateV8VM 后 Load 入口脚本
+    NewVM func() VM
+}
+
+// 某类事件在抓包与重放中的耗时对比
+type ReplayTiming struct {
+    Count          int
+    // 返回值与抓包时不同的次数
+    Mismatched     int
+    Recorded       LatencySummary
+    Replayed       LatencySummary
+}
+
+type ReplayReport struct {
+    Events   int
+    Wall     time.Duration
+    // 抓包中记录的发送次数, 重放时的发送照常交给 OnSendMessage/OnSendMessageTo
+    Sends    int
+    Timings  map[CaptureKind]*ReplayTiming
+}
+
+// 按开始时间顺序把抓包中的派发事件重放到新的虚拟机中, 报告与抓包时的耗时差异
+func Replay(records []CaptureRecord, opts ReplayOptions) (ReplayReport, error) {
+    report := ReplayReport{Timings: make(map[CaptureKind]*ReplayTiming)}
+    events := make([]*CaptureRecord, 0, len(records))
+    for i := range records {
+        switch records[i].Kind {
+        case CaptureEnter, CaptureLeave, CaptureMessage, CaptureMessageBuffer:
+            events = append(events, &records[i])
+        case CaptureSend, CaptureSendTo:
+            report.Sends++
+        }
+    }
+    sort.SliceStable(events, func(i, j int) bool { return events[i].Time < events[j].Time })
+
+    vms := make(map[uint32]VM)
+    defer func() {
+        for _, vm := range vms {
+            vm.Dispose()
+        }
+    }()
+
+    recorded := make(map[CaptureKind][]time.Duration)
+    replayed := make(map[CaptureKind][]time.Duration)
+    start := time.Now()
+    for _, ev := range events {
+        vm := vms[ev.VM]
+        if vm == nil {
+            if vm = opts.NewVM(); vm == nil {
+                return report, errors.New("failed to create replay vm")
+            }
+            vms[ev.VM] = vm
+        }
+        vm.SetAssociatedSessionId(ev.Session)
+
+        if opts.RealTime {
+            if wait := ev.Time - time.Since(start); wait > 0 {
+                time.Sleep(wait)
+            }
+        }
+
+        var r int
+        begin := time.Now()
+        switch ev.Kind {
+        case CaptureEnter: r = vm.DispatchEnter(ev.Session, string(ev.Payload))
+        case CaptureLeave: r = vm.DispatchLeave(ev.Session, string(ev.Payload))
+        case CaptureMessageBuffer: r = vm.DispatchMessageBuffer(ev.Session, ev.Payload)
+        case CaptureMessage:
+            msg, err := DecodeMessage(ev.Payload)
+            if err != nil {
+                return report, err
+            }
+            begin = time.Now()
+            r = vm.DispatchMessage(ev.Session, msg)
+        }
+        d := time.Since(begin)
+
+        t := report.Timings[ev.Kind]
+        if t == nil {
+            t = &ReplayTiming{}
+            report.Timings[ev.Kind] = t
+        }
+        t.Count++
+        if r != ev.Result {
+            t.Mismatched++
+        }
+        recorded[ev.Kind] = append(recorded[ev.Kind], ev.Duration)
+        replayed[ev.Kind] = append(replayed[ev.Kind], d)
+        report.Events++
+    }
+    report.Wall = time.Since(start)
+
+    for kind, t := range report.Timings {
+        t.Recorded = summarizeDurations(recorded[kind])
+        t.Replayed = summarizeDurations(replayed[kind])
+    }
+    return report, nil
+}
+
+func summarizeDurations(list []time.Duration) LatencySummary {
+    if len(list) == 0 {
+        return LatencySummary{}
+    }
+    sort.Slice(list, func(i, j int) bool { return list[i] < list[j] })
+    var sum time.Duration
+    for _, d := range list {
+        sum += d
+    }
+    pct := func(p float64) time.Duration {
+        return list[int(p*float64(len(list)-1))]
+    }
+    return LatencySummary{
+        Mean: sum / time.Duration(len(list)),
+        P50:  pct(0.5),
+        P90:  pct(0.9),
+        P99:  pct(0.99),
+        P999: pct(0.999),
+        Max:  list[len(list)-1],
+    }
+}
+
+func (k CaptureKind) String() string {
+    switch k {
+    case CaptureEnter: return "enter"
+    case CaptureLeave: return "leave"
+    case CaptureMessage: return "message"
+    case CaptureMessageBuffer: return "messageBuffer"
+    case CaptureSend: return "send"
+    case CaptureSendTo: return "sendTo"
+    }
+    return "unknown"
+}
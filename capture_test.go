@@ -0,0 +1,161 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * The ASF licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+package v8go
+
+import (
+    "bytes"
+    "io/ioutil"
+    "os"
+    "path/filepath"
+    "sync"
+    "testing"
+    "time"
+)
+
+func TestCaptureFileFormat(t *testing.T) {
+    path := filepath.Join(t.TempDir(), "traffic.cap")
+    msg := map[interface{}] interface{}{"op": "move", "pos": []interface{}{1, nil, 3}}
+    buf := EncodeMessage(map[interface{}] interface{}{"op": "buffer"})
+
+    if err := StartCapture(path); err != nil {
+        t.Fatal(err)
+    }
+    if err := StartCapture(path); err == nil {
+        t.Fatal("second StartCapture succeeded")
+    }
+    captureEvent(CaptureEnter, nil, 7, "10.0.0.1:4000", time.Time{}, 0)
+    captureMessage(nil, 7, msg, time.Now(), 2)
+    captureMessageBuffer(nil, 7, buf, time.Time{}, -1)
+    captureEvent(CaptureLeave, nil, 7, "10.0.0.1:4000", time.Time{}, 0)
+    if err := StopCapture(); err != nil {
+        t.Fatal(err)
+    }
+    // 停止后的记录被忽略
+    captureEvent(CaptureEnter, nil, 8, "ignored", time.Time{}, 0)
+
+    want := []CaptureRecord{
+        {Kind: CaptureEnter, VM: 1, Session: 7, Result: 0, Payload: []byte("10.0.0.1:4000")},
+        {Kind: CaptureMessage, VM: 1, Session: 7, Result: 2, Payload: EncodeMessage(msg)},
+        {Kind: CaptureMessageBuffer, VM: 1, Session: 7, Result: -1, Payload: buf},
+        {Kind: CaptureLeave, VM: 1, Session: 7, Result: 0, Payload: []byte("10.0.0.1:4000")},
+    }
+    records, err := LoadCapture(path)
+    if err != nil {
+        t.Fatal(err)
+    }
+    if len(records) != len(want) {
+        t.Fatalf("got %d records, want %d", len(records), len(want))
+    }
+    var last time.Duration
+    for i, r := range records {
+        w := want[i]
+        if r.Kind != w.Kind || r.VM != w.VM || r.Session != w.Session || r.Result != w.Result || !bytes.Equal(r.Payload, w.Payload) {
+            t.Fatalf("record %d: got %+v, want %+v", i, r, w)
+        }
+        if r.Time < last {
+            t.Fatalf("record %d: time went backwards", i)
+        }
+        last = r.Time
+    }
+
+    data, err := ioutil.ReadFile(path)
+    if err != nil {
+        t.Fatal(err)
+    }
+    firstEnd := 8 + captureRecordSize + len("10.0.0.1:4000")
+    cases := []struct {
+        name    string
+        data    []byte
+        records int
+        err     bool
+    }{
+        {"header only", data[:8], 0, false},
+        {"partial header", data[:6], 0, true},
+        {"bad magic", append([]byte("XXXX"), data[4:]...), 0, true},
+        {"bad version", append(append([]byte(nil), data[:4]...), append([]byte{9, 0, 0, 0}, data[8:]...)...), 0, true},
+        {"partial record", data[:8+captureRecordSize-1], 0, true},
+        {"partial payload", data[:firstEnd-1], 0, true},
+        {"first record", data[:firstEnd], 1, false},
+        {"missing last byte", data[:len(data)-1], len(want) - 1, true},
+    }
+
+    for _, c := range cases {
+        t.Run(c.name, func(t *testing.T) {
+            damaged := filepath.Join(filepath.Dir(path), "damaged.cap")
+            if err := ioutil.WriteFile(damaged, c.data, 0644); err != nil {
+                t.Fatal(err)
+            }
+            defer os.Remove(damaged)
+
+            records, err := LoadCapture(damaged)
+            if (err != nil) != c.err {
+                t.Fatalf("got error %v, want error %v", err, c.err)
+            }
+            if len(records) != c.records {
+                t.Fatalf("got %d records, want %d", len(records), c.records)
+            }
+        })
+    }
+}
+
+func TestCaptureStartOnce(t *testing.T) {
+    dir := t.TempDir()
+    var wg sync.WaitGroup
+    var mu sync.Mutex
+    started := 0
+    for i := 0; i < 8; i++ {
+        wg.Add(1)
+        go func(i int) {
+            defer wg.Done()
+            if StartCapture(filepath.Join(dir, "race.cap")) == nil {
+                mu.Lock()
+                started++
+                mu.Unlock()
+            }
+        }(i)
+    }
+    wg.Wait()
+    if err := StopCapture(); err != nil {
+        t.Fatal(err)
+    }
+    if started != 1 {
+        t.Fatalf("%d concurrent StartCapture calls succeeded, want 1", started)
+    }
+}
+
+// 超过 2^32ns 的耗时不能截断
+func TestCaptureLongDuration(t *testing.T) {
+    path := filepath.Join(t.TempDir(), "long.cap")
+    if err := StartCapture(path); err != nil {
+        t.Fatal(err)
+    }
+    // 抓包开始时间前移, 使派发开始时间仍在抓包之后
+    currentCapture().start = currentCapture().start.Add(-time.Minute)
+    captureMessage(nil, 7, map[interface{}] interface{}{"op": "slow"}, time.Now().Add(-5*time.Second), 0)
+    if err := StopCapture(); err != nil {
+        t.Fatal(err)
+    }
+
+    records, err := LoadCapture(path)
+    if err != nil {
+        t.Fatal(err)
+    }
+    if len(records) != 1 || records[0].Duration < 5*time.Second {
+        t.Fatalf("got %+v, want one record lasting at least 5s", records)
+    }
+}
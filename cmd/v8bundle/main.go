@@ -0,0 +1,65 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * The ASF licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// v8bundle 把脚本目录打包成单个可 mmap 的脚本包, 供 v8go.MountBundle 挂载.
+//
+//     v8bundle -o scripts.v8b [-cache] [-modules] dir...
+package main
+
+import (
+    "flag"
+    "fmt"
+    "os"
+    "strings"
+
+    "github.com/packing/v8go"
+)
+
+func main() {
+    out := flag.String("o", "", "output bundle file")
+    cache := flag.Bool("cache", false, "embed V8 code cache for every module")
+    modules := flag.Bool("modules", false, "compile .js files as ES modules (.mjs always is)")
+    flag.Parse()
+
+    if *out == "" || flag.NArg() == 0 {
+        fmt.Fprintln(os.Stderr, "usage: v8bundle -o out.v8b [-cache] [-modules] dir...")
+        os.Exit(2)
+    }
+
+    b := v8go.NewBundleBuilder()
+    b.CodeCache = *cache
+    if *modules {
+        b.IsModule = func(path string) bool {
+            return strings.HasSuffix(path, ".js") || strings.HasSuffix(path, ".mjs")
+        }
+    }
+
+    for _, dir := range flag.Args() {
+        if err := b.AddDir(dir); err != nil {
+            fmt.Fprintln(os.Stderr, err)
+            os.Exit(1)
+        }
+    }
+
+    if err := b.WriteFile(*out); err != nil {
+        fmt.Fprintln(os.Stderr, err)
+        os.Exit(1)
+    }
+    if *cache {
+        v8go.Dispose()
+    }
+}
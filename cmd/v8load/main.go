@@ -0,0 +1,272 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * The ASF licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// v8load 启动多个虚拟机运行示例游戏脚本, 按给定速率与并发驱动 enter/message/leave 流量,
+// 报告吞吐、延迟分位数、单虚拟机 RSS 以及 GC 停顿.
+//
+//     v8load [-script testdata/load/game.js] [-vms 64] [-sessions 1024] [-concurrency 8] [-rate 0] [-duration 30s] [-capture file] [-trace file] [-workers 0]
+package main
+
+import (
+    "flag"
+    "fmt"
+    "math/rand"
+    "os"
+    "runtime"
+    "sort"
+    "strconv"
+    "strings"
+    "sync"
+    "sync/atomic"
+    "time"
+
+    "github.com/packing/v8go"
+    "github.com/packing/v8go/internal/procstat"
+)
+
+var (
+    script      = flag.String("script", "testdata/load/game.js", "game script loaded into every VM")
+    vmCount     = flag.Int("vms", 64, "number of VMs")
+    sessions    = flag.Int("sessions", 1024, "concurrent sessions, spread over the VMs")
+    perSession  = flag.Int("messages", 50, "messages per session between enter and leave")
+    concurrency = flag.Int("concurrency", runtime.NumCPU(), "number of driver goroutines")
+    rate        = flag.Int("rate", 0, "target events per second over all drivers, 0 for unlimited")
+    duration    = flag.Duration("duration", 30*time.Second, "test duration")
+    seed        = flag.Int64("seed", 1, "random seed for generated messages")
+    capture     = flag.String("capture", "", "record the generated traffic to this file for v8replay")
+    trace       = flag.String("trace", "", "write a Chrome trace of the run to this file")
+    workers     = flag.Int("workers", 0, "V8 background worker threads, 0 for the default")
+)
+
+type session struct {
+    id   uint64
+    vm   v8go.VM
+    step int
+}
+
+type driver struct {
+    latencies [3][]time.Duration
+    errors    uint64
+}
+
+const (
+    kindEnter = iota
+    kindMessage
+    kindLeave
+)
+
+var kindNames = [3]string{"enter", "message", "leave"}
+
+func main() {
+    flag.Parse()
+    if *vmCount <= 0 || *sessions <= 0 || *concurrency <= 0 {
+        fmt.Fprintln(os.Stderr, "vms, sessions and concurrency must be positive")
+        os.Exit(2)
+    }
+
+    v8go.SetPlatformWorkers(*workers)
+    v8go.Init()
+    v8go.OnOutput = func(string) {}
+    var sends uint64
+    v8go.OnSendMessage = func(string, uint64, interface{}) int {
+        atomic.AddUint64(&sends, 1)
+        return 0
+    }
+    v8go.OnSendMessageTo = func(interface{}) int {
+        atomic.AddUint64(&sends, 1)
+        return 0
+    }
+
+    runtime.GC()
+    rssBefore := procstat.RSS()
+    vms := make([]v8go.VM, *vmCount)
+    for i := range vms {
+        vms[i] = v8go.CreateV8VM()
+        if !vms[i].Load(*script) {
+            os.Exit(1)
+        }
+    }
+    rssLoaded := procstat.RSS()
+
+    // 会话按驱动协程分组, 同一会话只由一个协程驱动; 不同协程可能同时访问同一个虚拟机
+    groups := make([][]*session, *concurrency)
+    for i := 0; i < *sessions; i++ {
+        s := &session{id: uint64(i + 1), vm: vms[i%len(vms)]}
+        groups[i%len(groups)] = append(groups[i%len(groups)], s)
+    }
+
+    var goStats runtime.MemStats
+    runtime.ReadMemStats(&goStats)
+    goGCBefore, goPauseBefore := goStats.NumGC, goStats.PauseTotalNs
+    v8GCBefore := v8go.GetGCStats()
+
+    if *capture != "" {
+        if err := v8go.StartCapture(*capture); err != nil {
+            fmt.Fprintln(os.Stderr, err)
+            os.Exit(1)
+        }
+    }
+    if *trace != "" {
+        if err := v8go.StartTracing(*trace, nil, 0); err != nil {
+            fmt.Fprintln(os.Stderr, err)
+            os.Exit(1)
+        }
+    }
+
+    drivers := make([]*driver, *concurrency)
+    var wg sync.WaitGroup
+    start := time.Now()
+    deadline := start.Add(*duration)
+    for w := range drivers {
+        drivers[w] = &driver{}
+        if len(groups[w]) == 0 {
+            continue
+        }
+        wg.Add(1)
+        go func(d *driver, list []*session, r *rand.Rand) {
+            defer wg.Done()
+            d.run(list, r, start, deadline)
+        }(drivers[w], groups[w], rand.New(rand.NewSource(*seed+int64(w))))
+    }
+    wg.Wait()
+    elapsed := time.Since(start)
+    if err := v8go.StopCapture(); err != nil {
+        fmt.Fprintln(os.Stderr, "capture:", err)
+    }
+    if *trace != "" {
+        if ts, err := v8go.StopTracing(); err != nil {
+            fmt.Fprintln(os.Stderr, "trace:", err)
+        } else if ts.Dropped != 0 {
+            fmt.Fprintf(os.Stderr, "trace: %d of %d events overwritten\n", ts.Dropped, ts.Events)
+        }
+    }
+    rssEnd := procstat.RSS()
+
+    runtime.ReadMemStats(&goStats)
+    v8GC := v8go.GetGCStats()
+
+    var all [3][]time.Duration
+    var errors uint64
+    for _, d := range drivers {
+        for k := range all {
+            all[k] = append(all[k], d.latencies[k]...)
+        }
+        errors += d.errors
+    }
+    total := len(all[kindEnter]) + len(all[kindMessage]) + len(all[kindLeave])
+
+    fmt.Printf("vms %d, sessions %d, concurrency %d, GOMAXPROCS %d, duration %v\n",
+        *vmCount, *sessions, *concurrency, runtime.GOMAXPROCS(0), elapsed.Round(time.Millisecond))
+    fmt.Printf("events %d (%.0f/s), errors %d, outbound sends %d\n",
+        total, float64(total)/elapsed.Seconds(), errors, atomic.LoadUint64(&sends))
+    fmt.Printf("%-8s %10s %10s %10s %10s %10s\n", "event", "count", "p50", "p99", "p999", "max")
+    var merged []time.Duration
+    for k := range all {
+        merged = append(merged, all[k]...)
+        printLatency(kindNames[k], all[k])
+    }
+    printLatency("all", merged)
+    fmt.Printf("rss/vm %s after load, %s at end\n",
+        procstat.FormatBytes(perVM(rssLoaded, rssBefore)), procstat.FormatBytes(perVM(rssEnd, rssBefore)))
+    fmt.Printf("v8 gc %d, pause total %v, p99 %v, max %v\n", v8GC.Count-v8GCBefore.Count,
+        v8GC.Total-v8GCBefore.Total, v8GC.Pause.P99, v8GC.Pause.Max)
+    fmt.Printf("go gc %d, pause total %v\n", goStats.NumGC-goGCBefore,
+        time.Duration(goStats.PauseTotalNs-goPauseBefore))
+    ps := v8go.GetPlatformStats()
+    fmt.Printf("v8 background workers %d, tasks executed %d/%d/%d (blocking/visible/best-effort)\n", ps.Workers,
+        ps.Executed[v8go.TaskUserBlocking], ps.Executed[v8go.TaskUserVisible], ps.Executed[v8go.TaskBestEffort])
+
+    for _, vm := range vms {
+        vm.Dispose()
+    }
+}
+
+// 轮流驱动分到的会话. 限速时延迟从计划发送时间算起, 避免协调遗漏掩盖排队时间
+func (d *driver) run(list []*session, r *rand.Rand, start, deadline time.Time) {
+    var interval time.Duration
+    if *rate > 0 {
+        interval = time.Duration(int64(time.Second) * int64(*concurrency) / int64(*rate))
+    }
+
+    next := start
+    for i := 0; ; i++ {
+        now := time.Now()
+        if now.After(deadline) {
+            return
+        }
+        begin := now
+        if interval > 0 {
+            if next.After(now) {
+                time.Sleep(next.Sub(now))
+            }
+            begin = next
+            next = next.Add(interval)
+        }
+
+        s := list[i%len(list)]
+        var kind, rc int
+        switch {
+        case s.step == 0:
+            kind = kindEnter
+            rc = s.vm.DispatchEnter(s.id, "127.0.0.1:"+strconv.FormatUint(s.id%65536, 10))
+        case s.step <= *perSession:
+            kind = kindMessage
+            rc = s.vm.DispatchMessage(s.id, makeMessage(r))
+        default:
+            kind = kindLeave
+            rc = s.vm.DispatchLeave(s.id, "")
+        }
+        d.latencies[kind] = append(d.latencies[kind], time.Since(begin))
+        if rc != 0 {
+            d.errors++
+        }
+
+        s.step++
+        if kind == kindLeave {
+            s.step = 0
+        }
+    }
+}
+
+func makeMessage(r *rand.Rand) map[interface{}] interface{} {
+    switch n := r.Intn(100); {
+    case n < 80:
+        return map[interface{}] interface{}{"op": "move", "x": r.Intn(200), "y": r.Intn(200)}
+    case n < 95:
+        return map[interface{}] interface{}{"op": "action", "power": 1 + r.Intn(10)}
+    default:
+        return map[interface{}] interface{}{"op": "chat", "text": strings.Repeat("hi ", 1+r.Intn(8))}
+    }
+}
+
+func printLatency(name string, list []time.Duration) {
+    if len(list) == 0 {
+        return
+    }
+    sort.Slice(list, func(i, j int) bool { return list[i] < list[j] })
+    pct := func(p float64) time.Duration {
+        return list[int(p*float64(len(list)-1))]
+    }
+    fmt.Printf("%-8s %10d %10v %10v %10v %10v\n", name, len(list), pct(0.5), pct(0.99), pct(0.999), list[len(list)-1])
+}
+
+func perVM(after, before uint64) uint64 {
+    if after <= before {
+        return 0
+    }
+    return (after - before) / uint64(*vmCount)
+}
@@ -0,0 +1,192 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * The ASF licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// v8profile 在同一负载下比较各执行配置的单虚拟机内存与派发吞吐.
+// 执行配置是进程级的, 每个配置在单独的子进程中运行.
+//
+//     v8profile -script main.js [-corpus events.jsonl] [-vms 200] [-messages 100000] [-profiles default,lite,jitless,tuned]
+package main
+
+import (
+    "bytes"
+    "encoding/json"
+    "flag"
+    "fmt"
+    "os"
+    "os/exec"
+    "runtime"
+    "strconv"
+    "strings"
+    "time"
+
+    "github.com/packing/v8go"
+    "github.com/packing/v8go/internal/procstat"
+)
+
+type result struct {
+    Profile   string  `json:"profile"`
+    VMs       int     `json:"vms"`
+    HeapPerVM uint64  `json:"heapPerVM"`
+    RSSPerVM  uint64  `json:"rssPerVM"`
+    Messages  int     `json:"messages"`
+    Seconds   float64 `json:"seconds"`
+    Errors    int     `json:"errors"`
+}
+
+var (
+    script   = flag.String("script", "", "entry script loaded into every VM")
+    corpus   = flag.String("corpus", "", "warm-up corpus (JSON lines) replayed as the workload")
+    vms      = flag.Int("vms", 200, "number of VMs to create")
+    messages = flag.Int("messages", 100000, "number of dispatched events")
+    profiles = flag.String("profiles", "default,lite,jitless,tuned", "comma separated execution profiles")
+    v8flags  = flag.String("flags", "", "extra V8 flags for every profile")
+    child    = flag.String("child", "", "internal: run a single profile")
+)
+
+func main() {
+    flag.Parse()
+    if *script == "" {
+        fmt.Fprintln(os.Stderr, "usage: v8profile -script main.js [-corpus events.jsonl] [-vms n] [-messages n] [-profiles list]")
+        os.Exit(2)
+    }
+
+    if *child != "" {
+        runChild(*child)
+        return
+    }
+
+    fmt.Printf("%-8s %6s %12s %12s %10s %12s %8s\n", "profile", "vms", "heap/vm", "rss/vm", "events", "events/s", "errors")
+    for _, name := range strings.Split(*profiles, ",") {
+        name = strings.TrimSpace(name)
+        if _, ok := v8go.ParseExecutionProfile(name); !ok {
+            fmt.Fprintln(os.Stderr, "unknown profile", name)
+            os.Exit(2)
+        }
+
+        args := append([]string{"-child", name}, os.Args[1:]...)
+        var out bytes.Buffer
+        cmd := exec.Command(os.Args[0], args...)
+        cmd.Stdout = &out
+        cmd.Stderr = os.Stderr
+        if err := cmd.Run(); err != nil {
+            fmt.Fprintf(os.Stderr, "profile %s: %v\n", name, err)
+            continue
+        }
+
+        lines := strings.Split(strings.TrimSpace(out.String()), "\n")
+        var r result
+        if err := json.Unmarshal([]byte(lines[len(lines)-1]), &r); err != nil {
+            fmt.Fprintf(os.Stderr, "profile %s: %v\n", name, err)
+            continue
+        }
+        fmt.Printf("%-8s %6d %12s %12s %10d %12.0f %8d\n", r.Profile, r.VMs, procstat.FormatBytes(r.HeapPerVM),
+            procstat.FormatBytes(r.RSSPerVM), r.Messages, float64(r.Messages)/r.Seconds, r.Errors)
+    }
+}
+
+func runChild(name string) {
+    profile, _ := v8go.ParseExecutionProfile(name)
+    v8go.InitWithProfile(profile, *v8flags)
+
+    var events []v8go.WarmupEvent
+    var payloads []map[interface{}] interface{}
+    if *corpus != "" {
+        c, err := v8go.LoadWarmupCorpus(*corpus)
+        if err != nil {
+            fmt.Fprintln(os.Stderr, err)
+            os.Exit(1)
+        }
+        // 消息在计时前解码, 计时段只包含派发本身
+        events = c.Events()
+        payloads = make([]map[interface{}] interface{}, len(events))
+        for i := range events {
+            if events[i].Kind == v8go.WarmupMessage {
+                payloads[i] = events[i].DispatchMessage()
+            }
+        }
+    }
+
+    runtime.GC()
+    rssBefore := procstat.RSS()
+    list := make([]v8go.VM, 0, *vms)
+    var heap uint64
+    for i := 0; i < *vms; i++ {
+        vm := v8go.CreateV8VM()
+        if !vm.Load(*script) {
+            os.Exit(1)
+        }
+        vm.SetSendMuted(true)
+        list = append(list, vm)
+    }
+
+    r := result{Profile: name, VMs: len(list)}
+    start := time.Now()
+    if events != nil {
+        // 语料按虚拟机轮流重放, 直到派发次数达到 -messages
+        for r.Messages < *messages {
+            before := r.Messages
+            for _, vm := range list {
+                for i, ev := range events {
+                    rc := 0
+                    switch ev.Kind {
+                    case v8go.WarmupEnter: rc = vm.DispatchEnter(ev.Session, ev.Addr)
+                    case v8go.WarmupLeave: rc = vm.DispatchLeave(ev.Session, ev.Addr)
+                    case v8go.WarmupMessage: rc = vm.DispatchMessage(ev.Session, payloads[i])
+                    default:
+                        continue
+                    }
+                    r.Messages++
+                    if rc == 2 || rc == -1 {
+                        r.Errors++
+                    }
+                    if r.Messages >= *messages {
+                        break
+                    }
+                }
+                if r.Messages >= *messages {
+                    break
+                }
+            }
+            if r.Messages == before {
+                break
+            }
+        }
+    } else {
+        for i := 0; i < *messages; i++ {
+            msg := map[interface{}] interface{}{"seq": i, "text": "benchmark message " + strconv.Itoa(i)}
+            if rc := list[i%len(list)].DispatchMessage(uint64(i%len(list)), msg); rc == 2 || rc == -1 {
+                r.Errors++
+            }
+            r.Messages++
+        }
+    }
+    r.Seconds = time.Since(start).Seconds()
+
+    for _, vm := range list {
+        heap += vm.HeapSize()
+    }
+    rssAfter := procstat.RSS()
+    if len(list) > 0 {
+        r.HeapPerVM = heap / uint64(len(list))
+        if rssAfter > rssBefore {
+            r.RSSPerVM = (rssAfter - rssBefore) / uint64(len(list))
+        }
+    }
+
+    data, _ := json.Marshal(r)
+    fmt.Println(string(data))
+}
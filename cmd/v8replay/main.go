@@ -0,0 +1,125 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * The ASF licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// v8replay 把 StartCapture (或 v8load -capture) 录制的流量按原顺序重放到新的虚拟机中,
+// 对比每类事件录制时与重放时的耗时, 用于发现脚本或引擎升级带来的性能回退.
+//
+//     v8replay -capture traffic.v8tc -script game.js [-realtime] [-repeat 1]
+package main
+
+import (
+    "flag"
+    "fmt"
+    "os"
+    "sort"
+    "sync/atomic"
+    "time"
+
+    "github.com/packing/v8go"
+)
+
+var (
+    capture  = flag.String("capture", "", "capture file recorded by StartCapture")
+    script   = flag.String("script", "", "entry script loaded into every replay VM")
+    realTime = flag.Bool("realtime", false, "keep the recorded spacing between events instead of replaying at full speed")
+    repeat   = flag.Int("repeat", 1, "number of replays, each into fresh VMs")
+)
+
+func main() {
+    flag.Parse()
+    if *capture == "" || *script == "" {
+        flag.Usage()
+        os.Exit(2)
+    }
+
+    records, err := v8go.LoadCapture(*capture)
+    if err != nil {
+        fmt.Fprintln(os.Stderr, err)
+        os.Exit(1)
+    }
+
+    v8go.Init()
+    v8go.OnOutput = func(string) {}
+    var sends uint64
+    v8go.OnSendMessage = func(string, uint64, interface{}) int {
+        atomic.AddUint64(&sends, 1)
+        return 0
+    }
+    v8go.OnSendMessageTo = func(interface{}) int {
+        atomic.AddUint64(&sends, 1)
+        return 0
+    }
+
+    opts := v8go.ReplayOptions{
+        RealTime: *realTime,
+        NewVM: func() v8go.VM {
+            vm := v8go.CreateV8VM()
+            if !vm.Load(*script) {
+                vm.Dispose()
+                return nil
+            }
+            return vm
+        },
+    }
+
+    fmt.Printf("capture %s: %d records\n", *capture, len(records))
+    for i := 0; i < *repeat; i++ {
+        atomic.StoreUint64(&sends, 0)
+        report, err := v8go.Replay(records, opts)
+        if err != nil {
+            fmt.Fprintln(os.Stderr, err)
+            os.Exit(1)
+        }
+        printReport(i+1, report, atomic.LoadUint64(&sends))
+    }
+}
+
+func printReport(round int, r v8go.ReplayReport, sends uint64) {
+    fmt.Printf("\nreplay #%d: %d events in %v, sends recorded %d replayed %d\n", round, r.Events, r.Wall.Round(time.Millisecond), r.Sends, sends)
+    fmt.Printf("%-14s %8s %8s  %-10s %10s %10s %10s %10s\n", "kind", "count", "mismatch", "", "mean", "p50", "p99", "max")
+
+    kinds := make([]v8go.CaptureKind, 0, len(r.Timings))
+    for k := range r.Timings {
+        kinds = append(kinds, k)
+    }
+    sort.Slice(kinds, func(i, j int) bool { return kinds[i] < kinds[j] })
+
+    for _, k := range kinds {
+        t := r.Timings[k]
+        row := func(name string, label string, s v8go.LatencySummary) {
+            if name != "" {
+                fmt.Printf("%-14s %8d %8d  ", name, t.Count, t.Mismatched)
+            } else {
+                fmt.Printf("%-14s %8s %8s  ", "", "", "")
+            }
+            fmt.Printf("%-10s %10v %10v %10v %10v\n", label, s.Mean, s.P50, s.P99, s.Max)
+        }
+        row(k.String(), "recorded", t.Recorded)
+        row("", "replayed", t.Replayed)
+        if t.Recorded.P50 > 0 {
+            fmt.Printf("%-14s %8s %8s  %-10s %9.2fx %9.2fx %9.2fx\n", "", "", "", "ratio",
+                ratio(t.Replayed.Mean, t.Recorded.Mean), ratio(t.Replayed.P50, t.Recorded.P50), ratio(t.Replayed.P99, t.Recorded.P99))
+        }
+    }
+}
+
+func ratio(a, b time.Duration) float64 {
+    if b == 0 {
+        return 0
+    }
+    return float64(a) / float64(b)
+}
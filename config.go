@@ -0,0 +1,69 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * The ASF licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+package v8go
+
+/*
+#include <stdlib.h>
+#include "v8bridge.h"
+*/
+import "C"
+
+import (
+    "errors"
+    "runtime"
+    "unsafe"
+)
+
+// 加载 JSON 配置表(经由 MountFS/脚本包/磁盘), 进程内只保存一份.
+// 脚本中通过 getConfig(name) 访问, 属性在读取时才生成, 不占用各虚拟机的堆. 同名表会被替换,
+// 已经取得旧表的虚拟机继续看到旧表
+func LoadConfigTable(name, path string) error {
+    cName := C.CString(name)
+    defer C.free(unsafe.Pointer(cName))
+    cPath := C.CString(path)
+    defer C.free(unsafe.Pointer(cPath))
+
+    // 错误信息按线程保存, 读取前不能切换线程
+    runtime.LockOSThread()
+    defer runtime.UnlockOSThread()
+    if C.V8LoadConfigTable(cName, cPath) != 0 {
+        return errors.New(C.GoString(C.V8LastConfigError()))
+    }
+    return nil
+}
+
+// 从内存中的 JSON 加载配置表
+func LoadConfigTableData(name string, data []byte) error {
+    cName := C.CString(name)
+    defer C.free(unsafe.Pointer(cName))
+    cData := C.CBytes(data)
+    defer C.free(cData)
+
+    runtime.LockOSThread()
+    defer runtime.UnlockOSThread()
+    if C.V8LoadConfigTableData(cName, (*C.char)(cData), C.size_t(len(data))) != 0 {
+        return errors.New(C.GoString(C.V8LastConfigError()))
+    }
+    return nil
+}
+
+func RemoveConfigTable(name string) bool {
+    cName := C.CString(name)
+    defer C.free(unsafe.Pointer(cName))
+    return C.V8RemoveConfigTable(cName) == 0
+}
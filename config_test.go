@@ -0,0 +1,117 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * The ASF licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+package v8go
+
+import (
+    "strings"
+    "testing"
+)
+
+func TestConfigTableParse(t *testing.T) {
+    cases := []struct {
+        name string
+        data string
+        err  string
+    }{
+        {"object", `{"a": 1, "b": [true, false, null], "c": {"d": "e"}}`, ""},
+        {"whitespace", " \n\t{ } \r\n", ""},
+        {"numbers", `{"n": [0, -1, 1.5, 2e10, -3.25E-2]}`, ""},
+        {"escapes", `{"s": "\"\\\/\b\f\n\r\t\u00e9\ud83d\ude00"}`, ""},
+        {"duplicate keys", `{"a": 1, "a": 2}`, ""},
+        {"empty input", "", "unexpected end of input"},
+        {"trailing characters", `{} {}`, "trailing characters"},
+        {"trailing comma", `{"a": 1,}`, "expected string key"},
+        {"missing colon", `{"a" 1}`, "expected ':'"},
+        {"missing comma", `[1 2]`, "expected ',' or ']'"},
+        {"unterminated object", `{"a": 1`, "expected ',' or '}'"},
+        {"unterminated string", `{"a": "b`, "unterminated string"},
+        {"control character", "{\"a\": \"b\nc\"}", "control character in string"},
+        {"bad escape", `{"a": "\x"}`, "invalid escape"},
+        {"bad unicode escape", `{"a": "\u12g4"}`, "invalid unicode escape"},
+        {"bad literal", `{"a": tru}`, "invalid literal"},
+        {"bad number", `{"a": -}`, "invalid number"},
+        {"hex number", `{"a": 0x10}`, "invalid number"},
+        {"leading plus", `{"a": +1}`, "invalid number"},
+        {"leading zero", `{"a": 01}`, "invalid number"},
+        {"bare fraction", `{"a": 1.}`, "invalid number"},
+        {"bare exponent", `{"a": 1e}`, "invalid number"},
+        {"infinity", `{"a": inf}`, "invalid number"},
+        {"negative infinity", `{"a": -Infinity}`, "invalid number"},
+        {"nan", `{"a": nan}`, "invalid literal"},
+        {"long number", `{"a": 1` + strings.Repeat("0", 100) + `.5e-3}`, ""},
+        {"nesting too deep", strings.Repeat("[", 300) + strings.Repeat("]", 300), "nesting too deep"},
+    }
+
+    for _, c := range cases {
+        t.Run(c.name, func(t *testing.T) {
+            err := LoadConfigTableData("test", []byte(c.data))
+            if c.err == "" {
+                if err != nil {
+                    t.Fatalf("unexpected error: %v", err)
+                }
+                return
+            }
+            if err == nil || !strings.Contains(err.Error(), c.err) {
+                t.Fatalf("got error %v, want %q", err, c.err)
+            }
+        })
+    }
+    RemoveConfigTable("test")
+}
+
+func TestConfigTableStringify(t *testing.T) {
+    cases := []struct {
+        name string
+        data string
+        want string
+    }{
+        {"object", `{"b": [1, [2, 3]], "a": {"c": "x"}}`, `{"a":{"c":"x"},"b":[1,[2,3]]}`},
+        {"array root", `[[], [true, null], "s"]`, `[[],[true,null],"s"]`},
+        {"array of objects", `{"l": [{"k": 1}, {"k": 2}]}`, `{"l":[{"k":1},{"k":2}]}`},
+        {"long number", `{"n": 1` + strings.Repeat("0", 80) + `}`, `{"n":1e+80}`},
+    }
+
+    vm := CreateV8VM()
+    defer vm.Dispose()
+    if !vm.Load("testdata/config/main.js") {
+        t.Fatal("load testdata/config/main.js failed")
+    }
+
+    var got string
+    OnSendMessage = func(_ string, _ uint64, data interface{}) int {
+        got, _ = data.(string)
+        return 0
+    }
+    defer func() { OnSendMessage = func(string, uint64, interface{}) int { return 0 } }()
+
+    for _, c := range cases {
+        t.Run(c.name, func(t *testing.T) {
+            if err := LoadConfigTableData("stringify", []byte(c.data)); err != nil {
+                t.Fatalf("load: %v", err)
+            }
+            got = ""
+            if rc := vm.DispatchMessage(1, map[interface{}] interface{}{"name": "stringify"}); rc != 0 {
+                t.Fatalf("message returned %d", rc)
+            }
+            if got != c.want {
+                t.Fatalf("got %s, want %s", got, c.want)
+            }
+        })
+    }
+    RemoveConfigTable("stringify")
+}
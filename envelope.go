@@ -0,0 +1,179 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * The ASF licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+package v8go
+
+/*
+#include "v8bridge.h"
+*/
+import "C"
+
+import (
+    "sync"
+    "sync/atomic"
+    "time"
+    "unsafe"
+)
+
+type BroadcastStats struct {
+    Broadcasts     uint64
+    // 所有广播的目标总数, Targets/Broadcasts 为平均扇出
+    Targets        uint64
+    MaxFanout      uint64
+    Bytes          uint64
+    SerializeTotal time.Duration
+    SerializeMax   time.Duration
+}
+
+// 虚拟机间传递的结构化克隆消息, 内容对 Go 不透明
+type Envelope struct {
+    ptr C.V8EnvelopePtr
+}
+
+// 增加一个引用, 返回的信封需单独 Release
+func (e *Envelope) Retain() *Envelope {
+    return &Envelope{ptr: C.V8RetainEnvelope(e.ptr)}
+}
+
+func (e *Envelope) Release() {
+    if e.ptr != nil {
+        C.V8ReleaseEnvelope(e.ptr)
+        e.ptr = nil
+    }
+}
+
+// 序列化后的字节数
+func (e *Envelope) Len() int {
+    if e.ptr == nil {
+        return 0
+    }
+    return int(C.V8EnvelopeLength(e.ptr))
+}
+
+// 等待投递的 postMessage/broadcast, 由 deliverEnvelopes 按发送顺序逐个交给应用回调
+type envelopeDelivery struct {
+    from    *V8VM
+    target  uint64
+    targets []uint64
+    env     *Envelope
+}
+
+var envelopeMu sync.Mutex
+var envelopeQueue []envelopeDelivery
+var envelopeRunning bool
+
+// 脚本在持有发送方虚拟机锁时调用 postMessage/broadcast, 若在此同步调用应用回调并派发到目标虚拟机,
+// A->B 与 B->A 同时发生时会互相等待对方的锁. 因此只保留信封入队, 由投递协程在锁外回调.
+func queueEnvelope(d envelopeDelivery) {
+    envelopeMu.Lock()
+    envelopeQueue = append(envelopeQueue, d)
+    start := !envelopeRunning
+    envelopeRunning = true
+    envelopeMu.Unlock()
+
+    if start {
+        go deliverEnvelopes()
+    }
+}
+
+func deliverEnvelopes() {
+    for {
+        envelopeMu.Lock()
+        queue := envelopeQueue
+        envelopeQueue = nil
+        if len(queue) == 0 {
+            envelopeRunning = false
+            envelopeMu.Unlock()
+            return
+        }
+        envelopeMu.Unlock()
+
+        for _, d := range queue {
+            if d.targets != nil {
+                if OnBroadcast != nil {
+                    OnBroadcast(d.from, d.targets, d.env)
+                }
+            } else if OnPostMessage != nil {
+                OnPostMessage(d.from, d.target, d.env)
+            }
+            d.env.Release()
+        }
+    }
+}
+
+//export GoPostMessage
+func GoPostMessage(vmPtr C.VMPtr, target C.uint64_t, env C.V8EnvelopePtr) C.int {
+    vm := lookupVM(vmPtr)
+    if OnPostMessage == nil || vm == nil {
+        return C.int(-1)
+    }
+    queueEnvelope(envelopeDelivery{from: vm, target: uint64(target), env: &Envelope{ptr: C.V8RetainEnvelope(env)}})
+    return C.int(0)
+}
+
+//export GoBroadcast
+func GoBroadcast(vmPtr C.VMPtr, targets *C.uint64_t, count C.size_t, env C.V8EnvelopePtr) C.int {
+    vm := lookupVM(vmPtr)
+    if OnBroadcast == nil || vm == nil {
+        return C.int(-1)
+    }
+    ids := make([]uint64, int(count))
+    copy(ids, (*[1 << 28]uint64)(unsafe.Pointer(targets))[:int(count):int(count)])
+    queueEnvelope(envelopeDelivery{from: vm, targets: ids, env: &Envelope{ptr: C.V8RetainEnvelope(env)}})
+    return C.int(0)
+}
+
+func getBroadcastStats(vmPtr C.VMPtr) BroadcastStats {
+    var cs C.V8BroadcastStats
+    C.V8GetBroadcastStats(vmPtr, &cs)
+    return BroadcastStats{
+        Broadcasts:     uint64(cs.broadcasts),
+        Targets:        uint64(cs.targets),
+        MaxFanout:      uint64(cs.maxFanout),
+        Bytes:          uint64(cs.bytes),
+        SerializeTotal: time.Duration(cs.serializeNs),
+        SerializeMax:   time.Duration(cs.serializeMaxNs),
+    }
+}
+
+// 所有虚拟机的广播汇总统计
+func GetBroadcastStats() BroadcastStats {
+    return getBroadcastStats(nil)
+}
+
+func (vm *V8VM) BroadcastStats() BroadcastStats {
+    if vm.disposed {
+        return BroadcastStats{}
+    }
+    return getBroadcastStats(vm.vmCPtr)
+}
+
+// 在本虚拟机还原信封并调用 message(sessionId, value), 不释放 env.
+// 带 transfer 的信封只能派发一次.
+func (vm *V8VM) DispatchEnvelope(sessionId uint64, env *Envelope) int {
+    if vm.disposed || env.ptr == nil {
+        return -1
+    }
+
+    atomic.AddInt64(&vm.called, 1)
+
+    r := C.V8DispatchEnvelope(vm.vmCPtr, C.uint64_t(sessionId), env.ptr)
+    if r == 2 {
+        vm.reportException()
+    }
+    return int(r)
+}
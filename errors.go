@@ -0,0 +1,127 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * The ASF licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+package v8go
+
+/*
+#include "v8bridge.h"
+*/
+import "C"
+
+import (
+    "fmt"
+    "sort"
+    "strings"
+)
+
+// 结构化的脚本异常
+type ScriptError struct {
+    File    string
+    Line    int
+    Column  int
+    Message string
+    Frames  []string
+    // 同一位置累计发生的次数
+    Count uint64
+}
+
+func (e *ScriptError) Error() string {
+    if e.File == "" {
+        return e.Message
+    }
+    s := fmt.Sprintf("%s:%d:%d %s", e.File, e.Line, e.Column, e.Message)
+    if len(e.Frames) > 0 {
+        s += "\n    at " + strings.Join(e.Frames, "\n    at ")
+    }
+    return s
+}
+
+type ErrorLocation struct {
+    File  string
+    Line  int
+    Count uint64
+}
+
+// 最近一次异常, 没有异常时返回 nil
+func (vm *V8VM) LastError() *ScriptError {
+    if vm.disposed {
+        return nil
+    }
+
+    var info C.V8ErrorInfo
+    if C.V8GetLastError(vm.vmCPtr, &info) < 0 {
+        return nil
+    }
+
+    e := &ScriptError{
+        File:    C.GoString(info.file),
+        Line:    int(info.line),
+        Column:  int(info.column),
+        Message: C.GoString(info.message),
+        Count:   uint64(info.count),
+    }
+    for i := 0; i < int(info.frameCount); i++ {
+        e.Frames = append(e.Frames, C.GoString(C.V8GetLastErrorFrame(vm.vmCPtr, C.int(i))))
+    }
+    return e
+}
+
+// 按位置统计的异常次数, 按次数降序
+func (vm *V8VM) ErrorLocations() []ErrorLocation {
+    if vm.disposed {
+        return nil
+    }
+
+    cLocations := C.V8GetErrorLocations(vm.vmCPtr)
+    defer C.V8ReleaseErrorLocations(cLocations)
+
+    length := int(C.V8GetErrorLocationsLength(cLocations))
+    locations := make([]ErrorLocation, length)
+    for i := 0; i < length; i++ {
+        item := C.V8GetErrorLocationsItem(cLocations, C.int(i))
+        locations[i] = ErrorLocation{
+            File:  C.GoString(item.file),
+            Line:  int(item.line),
+            Count: uint64(item.count),
+        }
+    }
+
+    sort.Slice(locations, func(i, j int) bool {
+        return locations[i].Count > locations[j].Count
+    })
+    return locations
+}
+
+// 调用返回 2 之后报告异常. 设置了 OnScriptError 时交给它处理(可按需调用 LastError),
+// 否则同一位置只在第 1, 2, 4, 8... 次时格式化输出, 避免高频异常反复付出格式化代价.
+func (vm *V8VM) reportException() {
+    if OnScriptError != nil {
+        OnScriptError(vm)
+        return
+    }
+
+    n := uint64(C.V8LastExceptionCount(vm.vmCPtr))
+    if n&(n-1) != 0 {
+        return
+    }
+
+    s := C.GoString(C.V8LastException(vm.vmCPtr))
+    if n > 1 {
+        s += fmt.Sprintf("(repeated %d times at this location)\n", n)
+    }
+    fmt.Println(s)
+}
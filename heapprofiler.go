@@ -0,0 +1,91 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * The ASF licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+package v8go
+
+/*
+#include <stdlib.h>
+#include "v8bridge.h"
+*/
+import "C"
+
+import (
+    "sort"
+    "unsafe"
+)
+
+// 按分配位置汇总的存活采样对象
+type HeapSample struct {
+    Name  string
+    Size  uint64
+    Count uint64
+}
+
+// 生成完整堆快照, 以流方式写入 path(.heapsnapshot), 生成期间虚拟机不可用
+func (vm *V8VM) WriteHeapSnapshot(path string) bool {
+    if vm.disposed {
+        return false
+    }
+
+    cPath := C.CString(path)
+    defer C.free(unsafe.Pointer(cPath))
+    return C.V8WriteHeapSnapshot(vm.vmCPtr, cPath) == 0
+}
+
+// 开始堆分配采样, interval 为平均采样间隔字节数(0 为 512KB), stackDepth 为 0 时取 16
+func (vm *V8VM) StartHeapSampling(interval uint64, stackDepth int) bool {
+    if vm.disposed {
+        return false
+    }
+    return C.V8StartHeapSampling(vm.vmCPtr, C.uint64_t(interval), C.int(stackDepth)) == 0
+}
+
+func (vm *V8VM) StopHeapSampling() {
+    if vm.disposed {
+        return
+    }
+    C.V8StopHeapSampling(vm.vmCPtr)
+}
+
+// 获取当前存活采样对象按分配位置的汇总, 按字节数降序. 未开启采样时返回 nil
+func (vm *V8VM) HeapSamplingSummary() []HeapSample {
+    if vm.disposed {
+        return nil
+    }
+
+    cSummary := C.V8GetHeapSamplingSummary(vm.vmCPtr)
+    if cSummary == nil {
+        return nil
+    }
+    defer C.V8ReleaseHeapSummary(cSummary)
+
+    length := int(C.V8GetHeapSummaryLength(cSummary))
+    samples := make([]HeapSample, length)
+    for i := 0; i < length; i++ {
+        item := C.V8GetHeapSummaryItem(cSummary, C.int(i))
+        samples[i] = HeapSample{
+            Name:  C.GoString(item.name),
+            Size:  uint64(item.size),
+            Count: uint64(item.count),
+        }
+    }
+
+    sort.Slice(samples, func(i, j int) bool {
+        return samples[i].Size > samples[j].Size
+    })
+    return samples
+}
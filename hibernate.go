@@ -0,0 +1,301 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * The ASF licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+package v8go
+
+/*
+#include <stdlib.h>
+#include "v8bridge.h"
+*/
+import "C"
+
+import (
+    "errors"
+    "io/ioutil"
+    "os"
+    "path/filepath"
+    "strconv"
+    "sync"
+    "time"
+    "unsafe"
+)
+
+type HibernationStats struct {
+    // 当前处于休眠的会话数
+    Sleeping       int
+    Hibernations   uint64
+    Resumes        uint64
+    // 导出并保存会话状态的耗时, 不含归还虚拟机
+    HibernateTotal time.Duration
+    HibernateMax   time.Duration
+    // 休眠后归还虚拟机(重置并重新加载脚本)的累计耗时
+    RecycleTotal   time.Duration
+    ResumeTotal    time.Duration
+    ResumeMax      time.Duration
+    // 当前休眠状态占用的字节数
+    StateBytes     uint64
+    // 当前休眠会话释放的堆内存: 休眠前的堆大小减去虚拟机重置并重新加载后的堆大小,
+    // 状态保存在内存中时再减去状态大小
+    MemorySaved    uint64
+}
+
+// 调用脚本的 hibernate(sessionId) 并序列化其返回值, 脚本未定义 hibernate 时返回 -1
+func (vm *V8VM) Hibernate(sessionId uint64) ([]byte, int) {
+    if vm.disposed {
+        return nil, -1
+    }
+
+    var data *C.uint8_t
+    var size C.size_t
+    r := C.V8Hibernate(vm.vmCPtr, C.uint64_t(sessionId), &data, &size)
+    if r == 2 {
+        vm.reportException()
+    }
+    if r != 0 {
+        return nil, int(r)
+    }
+    state := C.GoBytes(unsafe.Pointer(data), C.int(size))
+    C.free(unsafe.Pointer(data))
+    return state, 0
+}
+
+// 还原 Hibernate 得到的状态并调用脚本的 resume(sessionId, state)
+func (vm *V8VM) Resume(sessionId uint64, state []byte) int {
+    if vm.disposed {
+        return -1
+    }
+
+    var data *C.uint8_t
+    if len(state) > 0 {
+        data = (*C.uint8_t)(unsafe.Pointer(&state[0]))
+    }
+    r := C.V8Resume(vm.vmCPtr, C.uint64_t(sessionId), data, C.size_t(len(state)))
+    if r == 2 {
+        vm.reportException()
+    }
+    return int(r)
+}
+
+// 虚拟机堆占用的内存(字节)
+func (vm *V8VM) HeapSize() uint64 {
+    if vm.disposed {
+        return 0
+    }
+    return uint64(C.V8HeapSize(vm.vmCPtr))
+}
+
+type sleepingSession struct {
+    addr     string
+    sourceId uint64
+    state    []byte
+    size     int
+    saved    uint64
+}
+
+// 会话休眠管理. 空闲会话的状态由脚本的 hibernate() 导出并序列化, 虚拟机归还到池中;
+// 之后对该会话的派发会从池中取出虚拟机并调用 resume() 透明恢复.
+// 同一会话的调用需由调用方串行, 不同会话可以并发.
+type Hibernator struct {
+    pool *VMPool
+    dir  string
+
+    mu       sync.Mutex
+    live     map[uint64]VM
+    sleeping map[uint64]*sleepingSession
+    stats    HibernationStats
+}
+
+// dir 为空时状态保存在内存中, 否则每个会话写入 dir 下的一个文件
+func NewHibernator(pool *VMPool, dir string) *Hibernator {
+    return &Hibernator{
+        pool:     pool,
+        dir:      dir,
+        live:     make(map[uint64]VM),
+        sleeping: make(map[uint64]*sleepingSession),
+    }
+}
+
+func (h *Hibernator) statePath(sessionId uint64) string {
+    return filepath.Join(h.dir, strconv.FormatUint(sessionId, 10)+".state")
+}
+
+// 取得会话的虚拟机: 活跃会话直接返回, 休眠会话从池中取虚拟机恢复, 未知会话从池中分配新虚拟机
+func (h *Hibernator) Acquire(sessionId uint64) (VM, error) {
+    h.mu.Lock()
+    vm := h.live[sessionId]
+    s := h.sleeping[sessionId]
+    h.mu.Unlock()
+    if vm != nil {
+        return vm, nil
+    }
+
+    start := time.Now()
+    vm = h.pool.Get()
+    if vm == nil {
+        return nil, errors.New("vm pool failed to load script")
+    }
+    vm.SetAssociatedSessionId(sessionId)
+    if s == nil {
+        h.mu.Lock()
+        h.live[sessionId] = vm
+        h.mu.Unlock()
+        return vm, nil
+    }
+
+    state := s.state
+    if h.dir != "" {
+        var err error
+        if state, err = ioutil.ReadFile(h.statePath(sessionId)); err != nil {
+            h.pool.Put(vm)
+            return nil, err
+        }
+    }
+    vm.SetAssociatedSourceAddr(s.addr)
+    vm.SetAssociatedSourceId(s.sourceId)
+    if r := vm.Resume(sessionId, state); r != 0 {
+        h.pool.Put(vm)
+        return nil, errors.New("resume session " + strconv.FormatUint(sessionId, 10) + " failed")
+    }
+    if h.dir != "" {
+        os.Remove(h.statePath(sessionId))
+    }
+
+    d := time.Since(start)
+    h.mu.Lock()
+    delete(h.sleeping, sessionId)
+    h.live[sessionId] = vm
+    h.stats.Resumes++
+    h.stats.ResumeTotal += d
+    if d > h.stats.ResumeMax {
+        h.stats.ResumeMax = d
+    }
+    h.stats.StateBytes -= uint64(s.size)
+    h.stats.MemorySaved -= s.saved
+    h.mu.Unlock()
+    return vm, nil
+}
+
+// 休眠会话并把虚拟机归还到池中. 脚本未定义 hibernate() 或导出失败时会话保持活跃
+func (h *Hibernator) Hibernate(sessionId uint64) error {
+    h.mu.Lock()
+    vm := h.live[sessionId]
+    h.mu.Unlock()
+    if vm == nil {
+        return errors.New("session " + strconv.FormatUint(sessionId, 10) + " is not active")
+    }
+
+    start := time.Now()
+    heap := vm.HeapSize()
+    state, r := vm.Hibernate(sessionId)
+    if r == -1 {
+        return errors.New("script does not define hibernate()")
+    }
+    if r != 0 {
+        return errors.New("hibernate session " + strconv.FormatUint(sessionId, 10) + " failed")
+    }
+
+    s := &sleepingSession{
+        addr:     vm.GetAssociatedSourceAddr(),
+        sourceId: vm.GetAssociatedSourceId(),
+        size:     len(state),
+    }
+    if h.dir != "" {
+        path := h.statePath(sessionId)
+        if err := ioutil.WriteFile(path+".tmp", state, 0644); err != nil {
+            return err
+        }
+        if err := os.Rename(path+".tmp", path); err != nil {
+            return err
+        }
+    } else {
+        s.state = state
+    }
+
+    d := time.Since(start)
+
+    h.mu.Lock()
+    delete(h.live, sessionId)
+    h.sleeping[sessionId] = s
+    h.mu.Unlock()
+
+    recycleStart := time.Now()
+    after := h.pool.put(vm)
+    recycle := time.Since(recycleStart)
+
+    var saved uint64
+    if after < heap {
+        saved = heap - after
+    }
+    if h.dir == "" {
+        if uint64(s.size) < saved {
+            saved -= uint64(s.size)
+        } else {
+            saved = 0
+        }
+    }
+
+    h.mu.Lock()
+    s.saved = saved
+    h.stats.Hibernations++
+    h.stats.HibernateTotal += d
+    if d > h.stats.HibernateMax {
+        h.stats.HibernateMax = d
+    }
+    h.stats.RecycleTotal += recycle
+    h.stats.StateBytes += uint64(s.size)
+    h.stats.MemorySaved += saved
+    h.mu.Unlock()
+    return nil
+}
+
+// 会话结束: 活跃虚拟机归还到池中, 休眠状态直接丢弃
+func (h *Hibernator) Release(sessionId uint64) {
+    h.mu.Lock()
+    vm := h.live[sessionId]
+    s := h.sleeping[sessionId]
+    delete(h.live, sessionId)
+    delete(h.sleeping, sessionId)
+    if s != nil {
+        h.stats.StateBytes -= uint64(s.size)
+        h.stats.MemorySaved -= s.saved
+    }
+    h.mu.Unlock()
+
+    if vm != nil {
+        h.pool.Put(vm)
+    }
+    if s != nil && h.dir != "" {
+        os.Remove(h.statePath(sessionId))
+    }
+}
+
+// 派发消息, 会话处于休眠时先恢复
+func (h *Hibernator) DispatchMessage(sessionId uint64, msg map[interface{}] interface{}) int {
+    vm, err := h.Acquire(sessionId)
+    if err != nil {
+        return -1
+    }
+    return vm.DispatchMessage(sessionId, msg)
+}
+
+func (h *Hibernator) Stats() HibernationStats {
+    h.mu.Lock()
+    defer h.mu.Unlock()
+    stats := h.stats
+    stats.Sleeping = len(h.sleeping)
+    return stats
+}
@@ -0,0 +1,458 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * The ASF licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+package v8go
+
+/*
+#include <stdlib.h>
+#include "v8bridge.h"
+*/
+import "C"
+
+import (
+    "bufio"
+    "crypto/sha1"
+    "encoding/base64"
+    "encoding/binary"
+    "encoding/json"
+    "errors"
+    "fmt"
+    "io"
+    "net"
+    "net/http"
+    "os"
+    "strconv"
+    "strings"
+    "sync"
+    "unsafe"
+)
+
+const wsAcceptGUID = "258EAFA5-E914-47DA-95CA-C5AB0DC11B9E"
+
+const (
+    wsOpContinuation = 0x0
+    wsOpText         = 0x1
+    wsOpClose        = 0x8
+    wsOpPing         = 0x9
+    wsOpPong         = 0xa
+)
+
+type inspectorConn struct {
+    vm   *V8VM
+    conn net.Conn
+    rw   *bufio.ReadWriter
+    wmu  sync.Mutex
+    // 保护 detached, 断开后不再访问虚拟机, 虚拟机可能随后被销毁
+    mu       sync.Mutex
+    detached bool
+}
+
+type inspectorServer struct {
+    listener  net.Listener
+    host      string
+    checkHost bool
+    mu        sync.Mutex
+    conns     map[*V8VM]*inspectorConn
+}
+
+var inspector *inspectorServer
+var inspectorMu sync.Mutex
+
+// 启动 DevTools 调试服务, addr 为 "127.0.0.1:9229" 形式的回环地址或 "unix:/path/to.sock";
+// 调试协议可以执行任意代码, 因此拒绝监听非回环地址.
+// 每个虚拟机是一个调试目标, 目标 id 为关联的会话 id(未设置时为虚拟机指针), 可通过 /json/list 查询.
+func StartInspector(addr string) error {
+    inspectorMu.Lock()
+    defer inspectorMu.Unlock()
+
+    if inspector != nil {
+        return errors.New("inspector already started")
+    }
+
+    var l net.Listener
+    var err error
+    host := addr
+    if strings.HasPrefix(addr, "unix:") {
+        path := strings.TrimPrefix(addr, "unix:")
+        os.Remove(path)
+        l, err = net.Listen("unix", path)
+        host = "localhost"
+    } else {
+        if err := checkInspectorAddr(addr); err != nil {
+            return err
+        }
+        l, err = net.Listen("tcp", addr)
+        if err == nil {
+            host = l.Addr().String()
+        }
+    }
+    if err != nil {
+        return err
+    }
+
+    s := &inspectorServer{listener: l, host: host, checkHost: !strings.HasPrefix(addr, "unix:"), conns: make(map[*V8VM]*inspectorConn)}
+    inspector = s
+    go http.Serve(l, s)
+    return nil
+}
+
+// 停止调试服务并断开所有客户端
+func StopInspector() {
+    inspectorMu.Lock()
+    s := inspector
+    inspector = nil
+    inspectorMu.Unlock()
+
+    if s == nil {
+        return
+    }
+    s.listener.Close()
+
+    s.mu.Lock()
+    conns := make([]*inspectorConn, 0, len(s.conns))
+    for _, c := range s.conns {
+        conns = append(conns, c)
+    }
+    s.mu.Unlock()
+
+    for _, c := range conns {
+        c.close()
+    }
+}
+
+// 虚拟机销毁前断开其调试会话
+func detachInspector(vm *V8VM) {
+    inspectorMu.Lock()
+    s := inspector
+    inspectorMu.Unlock()
+
+    if s == nil {
+        return
+    }
+
+    s.mu.Lock()
+    c := s.conns[vm]
+    s.mu.Unlock()
+
+    if c != nil {
+        c.close()
+    }
+}
+
+//export GoInspectorSend
+func GoInspectorSend(vmPtr C.VMPtr, msg *C.char, length C.int) {
+    vm := lookupVM(vmPtr)
+    if vm == nil {
+        return
+    }
+
+    inspectorMu.Lock()
+    s := inspector
+    inspectorMu.Unlock()
+    if s == nil {
+        return
+    }
+
+    s.mu.Lock()
+    c := s.conns[vm]
+    s.mu.Unlock()
+    if c == nil {
+        return
+    }
+
+    c.writeFrame(wsOpText, C.GoBytes(unsafe.Pointer(msg), length))
+}
+
+func inspectorTargetId(vm *V8VM, ptr uintptr) string {
+    if vm.sessionId != 0 {
+        return strconv.FormatUint(vm.sessionId, 10)
+    }
+    return fmt.Sprintf("%x", ptr)
+}
+
+func (s *inspectorServer) findTarget(id string) *V8VM {
+    var found *V8VM
+    vmRegistry.Range(func(k, v interface{}) bool {
+        vm := v.(*V8VM)
+        if inspectorTargetId(vm, k.(uintptr)) == id {
+            found = vm
+            return false
+        }
+        return true
+    })
+    return found
+}
+
+// 监听地址必须是 localhost 或回环 IP, 空主机名(所有网卡)也被拒绝
+func checkInspectorAddr(addr string) error {
+    host, _, err := net.SplitHostPort(addr)
+    if err != nil {
+        return err
+    }
+    if strings.EqualFold(host, "localhost") {
+        return nil
+    }
+    if ip := net.ParseIP(host); ip != nil && ip.IsLoopback() {
+        return nil
+    }
+    return errors.New("inspector must listen on a loopback address, got " + addr)
+}
+
+// 与 Node 相同的 DNS 重绑定防护: Host 只能是 localhost 或 IP 字面量,
+// 恶意网页解析到 127.0.0.1 的域名会带着自己的主机名访问
+func inspectorHostAllowed(hostHeader string) bool {
+    host := hostHeader
+    if h, _, err := net.SplitHostPort(hostHeader); err == nil {
+        host = h
+    }
+    host = strings.TrimSuffix(strings.TrimPrefix(host, "["), "]")
+    lower := strings.ToLower(host)
+    if lower == "localhost" || lower == "localhost6" || strings.HasSuffix(lower, ".localhost") {
+        return true
+    }
+    return net.ParseIP(host) != nil
+}
+
+func (s *inspectorServer) ServeHTTP(w http.ResponseWriter, r *http.Request) {
+    if s.checkHost && !inspectorHostAllowed(r.Host) {
+        http.Error(w, "Host header is not an IP address or localhost", http.StatusForbidden)
+        return
+    }
+
+    switch r.URL.Path {
+    case "/json", "/json/list":
+        var targets []map[string]string
+        vmRegistry.Range(func(k, v interface{}) bool {
+            vm := v.(*V8VM)
+            id := inspectorTargetId(vm, k.(uintptr))
+            ws := s.host + "/" + id
+            targets = append(targets, map[string]string{
+                "description":          "v8go instance",
+                "devtoolsFrontendUrl":  "devtools://devtools/bundled/js_app.html?experiments=true&v8only=true&ws=" + ws,
+                "id":                   id,
+                "title":                fmt.Sprintf("v8go[%s] %s", id, vm.GetAssociatedSourceAddr()),
+                "type":                 "node",
+                "url":                  "file://",
+                "webSocketDebuggerUrl": "ws://" + ws,
+            })
+            return true
+        })
+        writeInspectorJSON(w, targets)
+    case "/json/version":
+        writeInspectorJSON(w, map[string]string{
+            "Browser":          "v8go/" + Version(),
+            "Protocol-Version": "1.3",
+        })
+    default:
+        vm := s.findTarget(strings.TrimPrefix(r.URL.Path, "/"))
+        if vm == nil || !strings.EqualFold(r.Header.Get("Upgrade"), "websocket") {
+            http.NotFound(w, r)
+            return
+        }
+        s.attach(w, r, vm)
+    }
+}
+
+func writeInspectorJSON(w http.ResponseWriter, v interface{}) {
+    b, _ := json.Marshal(v)
+    w.Header().Set("Content-Type", "application/json; charset=UTF-8")
+    w.Write(b)
+}
+
+func (s *inspectorServer) attach(w http.ResponseWriter, r *http.Request, vm *V8VM) {
+    key := r.Header.Get("Sec-WebSocket-Key")
+    hj, ok := w.(http.Hijacker)
+    if key == "" || !ok {
+        http.Error(w, "bad websocket handshake", http.StatusBadRequest)
+        return
+    }
+
+    s.mu.Lock()
+    vm.lifeMu.RLock()
+    if s.conns[vm] != nil || vm.disposed || C.V8InspectorConnect(vm.vmCPtr) != 0 {
+        vm.lifeMu.RUnlock()
+        s.mu.Unlock()
+        http.Error(w, "target is busy", http.StatusConflict)
+        return
+    }
+    conn, rw, err := hj.Hijack()
+    if err != nil {
+        C.V8InspectorClose(vm.vmCPtr)
+        vm.lifeMu.RUnlock()
+        s.mu.Unlock()
+        vm.scheduleRunTimers()
+        return
+    }
+    vm.lifeMu.RUnlock()
+    c := &inspectorConn{vm: vm, conn: conn, rw: rw}
+    s.conns[vm] = c
+    s.mu.Unlock()
+
+    h := sha1.Sum([]byte(key + wsAcceptGUID))
+    rw.WriteString("HTTP/1.1 101 Switching Protocols\r\nUpgrade: websocket\r\nConnection: Upgrade\r\nSec-WebSocket-Accept: " +
+        base64.StdEncoding.EncodeToString(h[:]) + "\r\n\r\n")
+    rw.Flush()
+
+    go func() {
+        c.serve()
+        c.detach()
+
+        s.mu.Lock()
+        if s.conns[vm] == c {
+            delete(s.conns, vm)
+        }
+        s.mu.Unlock()
+        conn.Close()
+    }()
+}
+
+func (c *inspectorConn) serve() {
+    var message []byte
+    for {
+        fin, op, payload, err := c.readFrame()
+        if err != nil {
+            return
+        }
+
+        switch op {
+        case wsOpText, wsOpContinuation:
+            message = append(message, payload...)
+            if !fin {
+                continue
+            }
+            if !c.post(message) {
+                return
+            }
+            message = message[:0]
+        case wsOpPing:
+            c.writeFrame(wsOpPong, payload)
+        case wsOpClose:
+            c.writeFrame(wsOpClose, nil)
+            return
+        }
+    }
+}
+
+// 投递消息只入队, 由持有 Locker 的线程处理: 断点暂停的消息循环或脚本执行中的中断回调,
+// 虚拟机空闲时安排一次 RunTimers. 读协程不能自己获取 Locker, 否则暂停期间会一直阻塞
+func (c *inspectorConn) post(message []byte) bool {
+    c.mu.Lock()
+    defer c.mu.Unlock()
+    if c.detached {
+        return false
+    }
+
+    cMsg := C.CBytes(message)
+    C.V8InspectorPost(c.vm.vmCPtr, (*C.char)(cMsg), C.size_t(len(message)))
+    C.free(cMsg)
+    c.vm.scheduleRunTimers()
+    return true
+}
+
+// 通知虚拟机客户端已断开, 不会阻塞; 会话在虚拟机线程上销毁
+func (c *inspectorConn) detach() {
+    c.mu.Lock()
+    defer c.mu.Unlock()
+    if c.detached {
+        return
+    }
+    c.detached = true
+    C.V8InspectorClose(c.vm.vmCPtr)
+    c.vm.scheduleRunTimers()
+}
+
+// 断开客户端, 不等待读协程退出
+func (c *inspectorConn) close() {
+    c.detach()
+    c.conn.Close()
+}
+
+func (c *inspectorConn) readFrame() (bool, byte, []byte, error) {
+    var h [2]byte
+    if _, err := io.ReadFull(c.rw, h[:]); err != nil {
+        return false, 0, nil, err
+    }
+
+    fin := h[0]&0x80 != 0
+    op := h[0] & 0x0f
+    length := uint64(h[1] & 0x7f)
+
+    switch length {
+    case 126:
+        var b [2]byte
+        if _, err := io.ReadFull(c.rw, b[:]); err != nil {
+            return false, 0, nil, err
+        }
+        length = uint64(binary.BigEndian.Uint16(b[:]))
+    case 127:
+        var b [8]byte
+        if _, err := io.ReadFull(c.rw, b[:]); err != nil {
+            return false, 0, nil, err
+        }
+        length = binary.BigEndian.Uint64(b[:])
+    }
+    if length > 64<<20 {
+        return false, 0, nil, errors.New("websocket frame too large")
+    }
+
+    var mask [4]byte
+    masked := h[1]&0x80 != 0
+    if masked {
+        if _, err := io.ReadFull(c.rw, mask[:]); err != nil {
+            return false, 0, nil, err
+        }
+    }
+
+    payload := make([]byte, length)
+    if _, err := io.ReadFull(c.rw, payload); err != nil {
+        return false, 0, nil, err
+    }
+    if masked {
+        for i := range payload {
+            payload[i] ^= mask[i&3]
+        }
+    }
+    return fin, op, payload, nil
+}
+
+func (c *inspectorConn) writeFrame(op byte, payload []byte) error {
+    var h [10]byte
+    h[0] = 0x80 | op
+    n := 2
+    switch l := len(payload); {
+    case l < 126:
+        h[1] = byte(l)
+    case l <= 0xffff:
+        h[1] = 126
+        binary.BigEndian.PutUint16(h[2:], uint16(l))
+        n = 4
+    default:
+        h[1] = 127
+        binary.BigEndian.PutUint64(h[2:], uint64(l))
+        n = 10
+    }
+
+    c.wmu.Lock()
+    defer c.wmu.Unlock()
+    if _, err := c.rw.Write(h[:n]); err != nil {
+        return err
+    }
+    if _, err := c.rw.Write(payload); err != nil {
+        return err
+    }
+    return c.rw.Flush()
+}
@@ -1,6 +1,9 @@
 package v8go
 
-import "sync"
+import (
+    "sync"
+    "time"
+)
 
 type VM interface {
     Dispose()
@@ -8,6 +11,7 @@ type VM interface {
     Reset()
     PrintMemStat()
     Load(path string) bool
+    LoadModule(path string) bool
     SetValue(name string, val interface{})
     SetAssociatedSourceAddr(addr string)
     SetAssociatedSourceId(id uint64)
@@ -18,10 +22,61 @@ type VM interface {
     DispatchEnter(sessionId uint64, addr string) int
     DispatchLeave(sessionId uint64, addr string) int
     DispatchMessage(sessionId uint64, msg map[interface{}] interface{}) int
+    DispatchLazyMessage(sessionId uint64, msg map[interface{}] interface{}) int
+    DispatchMessageBuffer(sessionId uint64, buf []byte) int
+    DispatchEnvelope(sessionId uint64, env *Envelope) int
+    RunTimers() int
+    TimerStats() TimerStats
+    HandlerStats(handler Handler) HandlerStats
+    GCStats() GCStats
+    OutputStats() OutputStats
+    BroadcastStats() BroadcastStats
+    SetSendCoalescing(enabled bool)
+    OutboundStats() OutboundStats
+    Hibernate(sessionId uint64) ([]byte, int)
+    Resume(sessionId uint64, state []byte) int
+    HeapSize() uint64
+    SetSendMuted(muted bool)
+    TraceTierUp(enabled bool)
+    TierUpStats() TierUpStats
+    OptimizedFunctions() []string
+    LastError() *ScriptError
+    ErrorLocations() []ErrorLocation
+    StartCpuProfiling(interval time.Duration) bool
+    StopCpuProfiling() []byte
+    StopCpuProfilingToFile(path string) bool
+    WriteHeapSnapshot(path string) bool
+    StartHeapSampling(interval uint64, stackDepth int) bool
+    StopHeapSampling()
+    HeapSamplingSummary() []HeapSample
 }
 
 var initV8Once sync.Once
 
 var OnSendMessage func(string, uint64, interface{}) int = nil
 var OnSendMessageTo func(interface{}) int = nil
-var OnOutput func(string) = nil
\ No newline at end of file
+// 合并发送模式下每次派发结束时回调一次, 按发送顺序给出本次派发的所有消息.
+// 未设置时逐条交给 OnSendMessage/OnSendMessageTo
+var OnSendBatch func(addr string, sessionId uint64, batch []Outbound) = nil
+// 脚本调用 net.postMessage(target, value[, transferList]) 后回调, 由应用把信封路由到目标虚拟机
+// 并调用其 DispatchEnvelope. 回调在投递协程中按发送顺序执行, 不持有发送方的虚拟机锁, 返回值被忽略;
+// env 只在回调期间有效, 需要继续异步投递时先 env.Retain()
+var OnPostMessage func(from VM, target uint64, env *Envelope) int = nil
+// 脚本调用 net.broadcast(targets, value) 后回调, value 只序列化一次, 所有目标共享同一个信封.
+// 与 OnPostMessage 在同一个投递协程中执行, env 只在回调期间有效
+var OnBroadcast func(from VM, targets []uint64, env *Envelope) int = nil
+var OnOutput func(string) = nil
+
+// 虚拟机有到期定时器或动态 import 的模块已读取完毕时由后台线程调用,
+// 应尽快把 vm.RunTimers() 投递到该虚拟机的执行协程, 不可阻塞.
+// 未设置时为每个虚拟机启动一个协程执行.
+var OnTimersReady func(VM) = nil
+// 开启异步输出后按批回调, 每个元素为一行日志. 未设置时逐行交给 OnOutput
+var OnOutputBatch func([]string) = nil
+
+// 设置后 V8 的后台任务不再由内部线程执行, 而是逐个交给应用自己的调度器, 由其在任意协程中调用 task.Run().
+// 回调可能来自任意线程(包括正在执行脚本的线程), 不可阻塞; 必须在 Init 之前设置
+var OnPlatformTask func(task *PlatformTask) = nil
+
+// 脚本调用出现异常时回调, 可调用 vm.LastError() 获取结构化异常; 未设置时按位置限频打印
+var OnScriptError func(VM) = nil
@@ -0,0 +1,56 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * The ASF licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// 命令行工具共用的进程资源统计
+package procstat
+
+import (
+    "fmt"
+    "io/ioutil"
+    "os"
+    "runtime"
+    "strconv"
+    "strings"
+    "syscall"
+)
+
+// 进程常驻内存, 优先读 /proc, 其他平台退化为峰值 RSS
+func RSS() uint64 {
+    if data, err := ioutil.ReadFile("/proc/self/statm"); err == nil {
+        fields := strings.Fields(string(data))
+        if len(fields) > 1 {
+            pages, _ := strconv.ParseUint(fields[1], 10, 64)
+            return pages * uint64(os.Getpagesize())
+        }
+    }
+    var ru syscall.Rusage
+    if syscall.Getrusage(syscall.RUSAGE_SELF, &ru) != nil {
+        return 0
+    }
+    if runtime.GOOS == "darwin" {
+        return uint64(ru.Maxrss)
+    }
+    return uint64(ru.Maxrss) * 1024
+}
+
+func FormatBytes(n uint64) string {
+    switch {
+    case n >= 1<<20: return fmt.Sprintf("%.1fMB", float64(n)/(1<<20))
+    case n >= 1<<10: return fmt.Sprintf("%.1fKB", float64(n)/(1<<10))
+    }
+    return fmt.Sprintf("%dB", n)
+}
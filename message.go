@@ -0,0 +1,310 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * The ASF licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+package v8go
+
+/*
+#include "v8bridge.h"
+*/
+import "C"
+
+import (
+    "encoding/binary"
+    "errors"
+    "math"
+    "sort"
+    "strconv"
+    "sync"
+    "sync/atomic"
+    "unsafe"
+)
+
+// 消息编码, 小端, 偏移均相对缓冲区起点, 根节点位于偏移 0:
+//   0 null, 1 false, 2 true
+//   3 number: f64
+//   4 string: u32 长度 + 字节
+//   5 array:  u32 个数 + u32 元素偏移[个数], 偏移 0 表示空位
+//   6 object: u32 个数 + {u32 键偏移, u32 键长度, u32 值偏移}[个数], 按键字节序排序
+const (
+    msgNull   = 0
+    msgFalse  = 1
+    msgTrue   = 2
+    msgNumber = 3
+    msgString = 4
+    msgArray  = 5
+    msgObject = 6
+)
+
+type messageEncoder struct {
+    buf []byte
+}
+
+var messageEncoderPool = sync.Pool{
+    New: func() interface{} { return &messageEncoder{buf: make([]byte, 0, 1024)} },
+}
+
+type messageMember struct {
+    key   string
+    value interface{}
+}
+
+// 把 DispatchMessage 可接受的消息编码为 DispatchMessageBuffer 使用的格式.
+// 键与值的类型转换规则与 DispatchMessage 一致: 值为 nil 或不支持的类型时对象省略该键,
+// 数组保留原长度并在该位置留下空位.
+func EncodeMessage(msg map[interface{}] interface{}) []byte {
+    e := &messageEncoder{}
+    e.encodeMap(msg)
+    return e.buf
+}
+
+func (e *messageEncoder) reserve(n int) int {
+    off := len(e.buf)
+    e.buf = append(e.buf, make([]byte, n)...)
+    return off
+}
+
+func (e *messageEncoder) putU32(off int, v int) {
+    binary.LittleEndian.PutUint32(e.buf[off:], uint32(v))
+}
+
+func (e *messageEncoder) encodeNumber(v float64) {
+    off := e.reserve(9)
+    e.buf[off] = msgNumber
+    binary.LittleEndian.PutUint64(e.buf[off+1:], math.Float64bits(v))
+}
+
+// 编码一个值, 类型不支持时返回 false 且不写入任何内容
+func (e *messageEncoder) encode(v interface{}) bool {
+    switch val := v.(type) {
+    case bool:
+        if val {
+            e.buf = append(e.buf, msgTrue)
+        } else {
+            e.buf = append(e.buf, msgFalse)
+        }
+    case string:
+        off := e.reserve(5)
+        e.buf[off] = msgString
+        e.putU32(off+1, len(val))
+        e.buf = append(e.buf, val...)
+    case int: e.encodeNumber(float64(val))
+    case int8: e.encodeNumber(float64(val))
+    case int16: e.encodeNumber(float64(val))
+    case int32: e.encodeNumber(float64(val))
+    case int64: e.encodeNumber(float64(val))
+    case uint: e.encodeNumber(float64(val))
+    case uint8: e.encodeNumber(float64(val))
+    case uint16: e.encodeNumber(float64(val))
+    case uint32: e.encodeNumber(float64(val))
+    case uint64: e.encodeNumber(float64(val))
+    case float32: e.encodeNumber(float64(val))
+    case float64: e.encodeNumber(val)
+    case map[interface{}] interface{}: e.encodeMap(val)
+    case []interface{}: e.encodeArray(val)
+    default:
+        return false
+    }
+    return true
+}
+
+func (e *messageEncoder) encodeArray(arr []interface{}) {
+    off := e.reserve(5 + 4*len(arr))
+    e.buf[off] = msgArray
+    e.putU32(off+1, len(arr))
+    for i, v := range arr {
+        at := len(e.buf)
+        if e.encode(v) {
+            e.putU32(off+5+4*i, at)
+        }
+    }
+}
+
+// 按 DispatchMessage 的规则把消息键转为字符串, 不支持的类型返回 false
+func messageKey(k interface{}) (string, bool) {
+    switch key := k.(type) {
+    case string: return key, true
+    case int: return strconv.FormatInt(int64(key), 10), true
+    case int8: return strconv.FormatInt(int64(key), 10), true
+    case int16: return strconv.FormatInt(int64(key), 10), true
+    case int32: return strconv.FormatInt(int64(key), 10), true
+    case int64: return strconv.FormatInt(key, 10), true
+    case uint: return strconv.FormatUint(uint64(key), 10), true
+    case uint8: return strconv.FormatUint(uint64(key), 10), true
+    case uint16: return strconv.FormatUint(uint64(key), 10), true
+    case uint32: return strconv.FormatUint(uint64(key), 10), true
+    case uint64: return strconv.FormatUint(key, 10), true
+    }
+    return "", false
+}
+
+func (e *messageEncoder) encodeMap(m map[interface{}] interface{}) {
+    members := make([]messageMember, 0, len(m))
+    for k, v := range m {
+        sk, ok := messageKey(k)
+        if !ok {
+            continue
+        }
+        members = append(members, messageMember{sk, v})
+    }
+    // 不同类型的键可能格式化成同一个字符串, 排序后只保留一个
+    sort.Slice(members, func(i, j int) bool { return members[i].key < members[j].key })
+
+    off := e.reserve(5 + 12*len(members))
+    e.buf[off] = msgObject
+    n := 0
+    for i, mb := range members {
+        if i+1 < len(members) && members[i+1].key == mb.key {
+            continue
+        }
+        keyAt := len(e.buf)
+        e.buf = append(e.buf, mb.key...)
+        valueAt := len(e.buf)
+        if !e.encode(mb.value) {
+            e.buf = e.buf[:keyAt]
+            continue
+        }
+        entry := off + 5 + 12*n
+        e.putU32(entry, keyAt)
+        e.putU32(entry+4, len(mb.key))
+        e.putU32(entry+8, valueAt)
+        n++
+    }
+    e.putU32(off+1, n)
+}
+
+// 派发已编码的消息. 脚本收到的是按需解码的只读对象, 字段在访问时才从 buf 中读取;
+// buf 只在本次调用期间被引用, 需要保留消息的脚本应在处理时调用 msg.materialize().
+func (vm *V8VM) DispatchMessageBuffer(sessionId uint64, buf []byte) int {
+    if vm.disposed {
+        return -1
+    }
+
+    atomic.AddInt64(&vm.called, 1)
+
+    var data *C.char
+    if len(buf) > 0 {
+        data = (*C.char)(unsafe.Pointer(&buf[0]))
+    }
+    start := captureStart()
+    r := C.V8DispatchMessageBuffer(vm.vmCPtr, C.uint64_t(sessionId), data, C.size_t(len(buf)))
+    if r == 2 {
+        vm.reportException()
+    }
+    captureMessageBuffer(vm, sessionId, buf, start, int(r))
+    return int(r)
+}
+
+// 与 DispatchMessage 相同, 但消息先编码为缓冲区再按需解码, 适合脚本只读取少数字段的大消息
+func (vm *V8VM) DispatchLazyMessage(sessionId uint64, msg map[interface{}] interface{}) int {
+    e := messageEncoderPool.Get().(*messageEncoder)
+    e.buf = e.buf[:0]
+    e.encodeMap(msg)
+    r := vm.DispatchMessageBuffer(sessionId, e.buf)
+    if cap(e.buf) <= 64*1024 {
+        messageEncoderPool.Put(e)
+    }
+    return r
+}
+
+// 把 EncodeMessage 的结果还原为 DispatchMessage 可接受的消息, 数字统一为 float64
+func DecodeMessage(buf []byte) (map[interface{}] interface{}, error) {
+    v, err := decodeMessageValue(buf, 0, 0)
+    if err != nil {
+        return nil, err
+    }
+    m, ok := v.(map[interface{}] interface{})
+    if !ok {
+        return nil, errors.New("message root is not an object")
+    }
+    return m, nil
+}
+
+var errMessageTruncated = errors.New("message buffer truncated")
+
+func decodeMessageU32(buf []byte, off int) (int, error) {
+    if off < 0 || off+4 > len(buf) {
+        return 0, errMessageTruncated
+    }
+    return int(binary.LittleEndian.Uint32(buf[off:])), nil
+}
+
+func decodeMessageValue(buf []byte, off int, depth int) (interface{}, error) {
+    if off >= len(buf) || depth > 256 {
+        return nil, errMessageTruncated
+    }
+    switch buf[off] {
+    case msgNull: return nil, nil
+    case msgFalse: return false, nil
+    case msgTrue: return true, nil
+    case msgNumber:
+        if off+9 > len(buf) {
+            return nil, errMessageTruncated
+        }
+        return math.Float64frombits(binary.LittleEndian.Uint64(buf[off+1:])), nil
+    case msgString:
+        n, err := decodeMessageU32(buf, off+1)
+        if err != nil || off+5+n > len(buf) {
+            return nil, errMessageTruncated
+        }
+        return string(buf[off+5 : off+5+n]), nil
+    case msgArray:
+        n, err := decodeMessageU32(buf, off+1)
+        if err != nil {
+            return nil, err
+        }
+        arr := make([]interface{}, 0, n)
+        for i := 0; i < n; i++ {
+            at, err := decodeMessageU32(buf, off+5+4*i)
+            if err != nil {
+                return nil, err
+            }
+            if at == 0 {
+                // 空位
+                arr = append(arr, nil)
+                continue
+            }
+            v, err := decodeMessageValue(buf, at, depth+1)
+            if err != nil {
+                return nil, err
+            }
+            arr = append(arr, v)
+        }
+        return arr, nil
+    case msgObject:
+        n, err := decodeMessageU32(buf, off+1)
+        if err != nil {
+            return nil, err
+        }
+        m := make(map[interface{}] interface{}, n)
+        for i := 0; i < n; i++ {
+            entry := off + 5 + 12*i
+            keyAt, err1 := decodeMessageU32(buf, entry)
+            keyLen, err2 := decodeMessageU32(buf, entry+4)
+            valueAt, err3 := decodeMessageU32(buf, entry+8)
+            if err1 != nil || err2 != nil || err3 != nil || keyAt+keyLen > len(buf) {
+                return nil, errMessageTruncated
+            }
+            v, err := decodeMessageValue(buf, valueAt, depth+1)
+            if err != nil {
+                return nil, err
+            }
+            m[string(buf[keyAt:keyAt+keyLen])] = v
+        }
+        return m, nil
+    }
+    return nil, errors.New("unknown message value tag")
+}
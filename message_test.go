@@ -0,0 +1,95 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * The ASF licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+package v8go
+
+import (
+    "reflect"
+    "testing"
+)
+
+func TestMessageRoundTrip(t *testing.T) {
+    cases := []struct {
+        name string
+        msg  map[interface{}] interface{}
+        want map[interface{}] interface{}
+    }{
+        {"empty", map[interface{}] interface{}{}, map[interface{}] interface{}{}},
+        {
+            "scalars",
+            map[interface{}] interface{}{"s": "text", "t": true, "f": false, "i": 42, "u": uint8(7), "x": 1.5},
+            map[interface{}] interface{}{"s": "text", "t": true, "f": false, "i": float64(42), "u": float64(7), "x": 1.5},
+        },
+        {
+            "numeric keys",
+            map[interface{}] interface{}{1: "one", int64(-2): "minus two", uint32(3): "three"},
+            map[interface{}] interface{}{"1": "one", "-2": "minus two", "3": "three"},
+        },
+        {
+            "nested",
+            map[interface{}] interface{}{"a": map[interface{}] interface{}{"b": []interface{}{"c", map[interface{}] interface{}{"d": 1}}}},
+            map[interface{}] interface{}{"a": map[interface{}] interface{}{"b": []interface{}{"c", map[interface{}] interface{}{"d": float64(1)}}}},
+        },
+        // 与 DispatchMessage 一致: nil 与不支持的值省略该键
+        {
+            "nil and unsupported values",
+            map[interface{}] interface{}{"keep": 1, "nil": nil, "chan": make(chan int), "fn": func() {}},
+            map[interface{}] interface{}{"keep": float64(1)},
+        },
+        {
+            "unsupported keys",
+            map[interface{}] interface{}{"keep": 1, 1.5: "float key", struct{}{}: "struct key"},
+            map[interface{}] interface{}{"keep": float64(1)},
+        },
+        // 数组保留长度, nil 与不支持的元素成为空位
+        {
+            "array holes",
+            map[interface{}] interface{}{"a": []interface{}{1, nil, "x", struct{}{}, true, nil}},
+            map[interface{}] interface{}{"a": []interface{}{float64(1), nil, "x", nil, true, nil}},
+        },
+        {
+            "empty containers",
+            map[interface{}] interface{}{"a": []interface{}{}, "m": map[interface{}] interface{}{}},
+            map[interface{}] interface{}{"a": []interface{}{}, "m": map[interface{}] interface{}{}},
+        },
+    }
+
+    for _, c := range cases {
+        t.Run(c.name, func(t *testing.T) {
+            got, err := DecodeMessage(EncodeMessage(c.msg))
+            if err != nil {
+                t.Fatalf("DecodeMessage: %v", err)
+            }
+            if !reflect.DeepEqual(got, c.want) {
+                t.Fatalf("got %#v, want %#v", got, c.want)
+            }
+        })
+    }
+}
+
+func TestMessageDecodeTruncated(t *testing.T) {
+    buf := EncodeMessage(map[interface{}] interface{}{
+        "name": "player",
+        "pos":  []interface{}{1, nil, 3},
+        "meta": map[interface{}] interface{}{"level": 9},
+    })
+    for n := 0; n < len(buf); n++ {
+        if _, err := DecodeMessage(buf[:n]); err == nil {
+            t.Fatalf("DecodeMessage accepted %d of %d bytes", n, len(buf))
+        }
+    }
+}
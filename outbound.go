@@ -0,0 +1,131 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * The ASF licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+package v8go
+
+/*
+#include "v8bridge.h"
+*/
+import "C"
+
+// 合并发送模式下缓冲的一条消息, To 为 true 表示来自 net.sendToOtherPlayer
+type Outbound struct {
+    To   bool
+    Data interface{}
+}
+
+type OutboundStats struct {
+    // 派发期间进入缓冲的消息数
+    Queued  uint64
+    // 因合并键相同被后一条覆盖的消息数
+    Merged  uint64
+    // 刷出到 Go 的批次数
+    Batches uint64
+}
+
+// 合并缓冲中的一条消息, 被同键消息覆盖后标记为 dropped
+type queuedSend struct {
+    msg     Outbound
+    dropped bool
+}
+
+// 派发期间的一次发送, 在发送时就转换为 Go 值, 避免脚本随后修改对象影响缓冲中的内容.
+// 返回 1 表示覆盖了同键的前一条消息
+//export GoQueueSend
+func GoQueueSend(vmPtr C.VMPtr, jsValue C.VMValuePtr, to C._Bool, key *C.char, keyLen C.int) C.int {
+    vm := lookupVM(vmPtr)
+    if vm == nil {
+        return C.int(0)
+    }
+
+    data := transferJsValue2GoValue(vmPtr, jsValue)
+    merged := 0
+    if key != nil {
+        k := C.GoStringN(key, keyLen)
+        if i, ok := vm.outboundKeys[k]; ok {
+            vm.outbound[i].dropped = true
+            vm.outbound[i].msg.Data = nil
+            merged = 1
+        }
+        if vm.outboundKeys == nil {
+            vm.outboundKeys = make(map[string]int)
+        }
+        vm.outboundKeys[k] = len(vm.outbound)
+    }
+    vm.outbound = append(vm.outbound, queuedSend{msg: Outbound{To: bool(to), Data: data}, dropped: data == nil})
+    return C.int(merged)
+}
+
+//export GoFlushSends
+func GoFlushSends(vmPtr C.VMPtr) {
+    vm := lookupVM(vmPtr)
+    if vm == nil {
+        return
+    }
+    pending := vm.outbound
+    vm.outbound = nil
+    vm.outboundKeys = nil
+
+    batch := make([]Outbound, 0, len(pending))
+    for _, item := range pending {
+        if !item.dropped {
+            captureSend(vmPtr, item.msg.To, item.msg.Data)
+            batch = append(batch, item.msg)
+        }
+    }
+    if len(batch) == 0 {
+        return
+    }
+
+    sAddr := C.GoString(C.V8GetVMAssociatedSourceAddr(vmPtr))
+    sId := uint64(C.V8GetVMAssociatedSourceId(vmPtr))
+    if OnSendBatch != nil {
+        OnSendBatch(sAddr, sId, batch)
+        return
+    }
+    for _, m := range batch {
+        if m.To {
+            if OnSendMessageTo != nil {
+                OnSendMessageTo(m.Data)
+            }
+        } else if OnSendMessage != nil {
+            OnSendMessage(sAddr, sId, m.Data)
+        }
+    }
+}
+
+// 开启后派发期间的 net.sendCurrentPlayer/sendToOtherPlayer 只进入缓冲, 派发结束时一次性交给 Go;
+// 发送时传入第二个参数作为合并键, 同一次派发中相同键只保留最后一条
+func (vm *V8VM) SetSendCoalescing(enabled bool) {
+    if vm.disposed {
+        return
+    }
+    C.V8SetSendCoalescing(vm.vmCPtr, C._Bool(enabled))
+}
+
+func (vm *V8VM) OutboundStats() OutboundStats {
+    if vm.disposed {
+        return OutboundStats{}
+    }
+    var cs C.V8OutboundStats
+    C.V8GetOutboundStats(vm.vmCPtr, &cs)
+    return OutboundStats{
+        Queued:  uint64(cs.queued),
+        Merged:  uint64(cs.merged),
+        Batches: uint64(cs.batches),
+    }
+}
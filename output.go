@@ -0,0 +1,107 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * The ASF licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+package v8go
+
+/*
+#include "v8bridge.h"
+*/
+import "C"
+
+import (
+    "encoding/binary"
+    "fmt"
+    "time"
+    "unsafe"
+)
+
+type AsyncOutputOptions struct {
+    // 每个虚拟机缓冲的日志条数, 缓冲满时丢弃并计数
+    Capacity int
+    // 每个虚拟机每秒最多输出条数, 0 表示不限
+    MaxPerSecond int
+    // 刷新间隔, 0 表示 50ms
+    FlushInterval time.Duration
+}
+
+type OutputStats struct {
+    Written     uint64
+    Dropped     uint64
+    RateLimited uint64
+}
+
+//export GoOutputBatch
+func GoOutputBatch(data *C.char, length C.int) {
+    lines := decodeOutputBatch(C.GoBytes(unsafe.Pointer(data), length))
+    if OnOutputBatch != nil {
+        OnOutputBatch(lines)
+        return
+    }
+
+    for _, s := range lines {
+        if OnOutput != nil {
+            OnOutput(s)
+        } else {
+            fmt.Println(s)
+        }
+    }
+}
+
+// 将 console 输出切换为异步批量模式, 只能调用一次
+func EnableAsyncOutput(opts AsyncOutputOptions) {
+    C.V8EnableAsyncOutput(C.size_t(opts.Capacity), C.uint32_t(opts.MaxPerSecond), C.uint32_t(opts.FlushInterval/time.Millisecond))
+}
+
+// 同步刷出所有缓冲中的日志
+func FlushOutput() {
+    C.V8FlushOutput()
+}
+
+func getOutputStats(vmPtr C.VMPtr) OutputStats {
+    var cs C.V8OutputStats
+    C.V8GetOutputStats(vmPtr, &cs)
+    return OutputStats{
+        Written:     uint64(cs.written),
+        Dropped:     uint64(cs.dropped),
+        RateLimited: uint64(cs.rateLimited),
+    }
+}
+
+func GetOutputStats() OutputStats {
+    return getOutputStats(nil)
+}
+
+func (vm *V8VM) OutputStats() OutputStats {
+    if vm.disposed {
+        return OutputStats{}
+    }
+    return getOutputStats(vm.vmCPtr)
+}
+
+// 批次由若干条 4 字节小端长度加文本的记录组成, 单条日志可以包含换行
+func decodeOutputBatch(buf []byte) []string {
+    var lines []string
+    for len(buf) >= 4 {
+        n := binary.LittleEndian.Uint32(buf)
+        if uint64(n) > uint64(len(buf)-4) {
+            break
+        }
+        lines = append(lines, string(buf[4:4+n]))
+        buf = buf[4+n:]
+    }
+    return lines
+}
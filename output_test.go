@@ -0,0 +1,45 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * The ASF licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+package v8go
+
+import (
+    "reflect"
+    "testing"
+)
+
+func TestDecodeOutputBatch(t *testing.T) {
+    cases := []struct {
+        name string
+        buf  []byte
+        want []string
+    }{
+        {"empty", nil, nil},
+        {"single", []byte("\x03\x00\x00\x00abc"), []string{"abc"}},
+        {"multi line record", []byte("\x03\x00\x00\x00a\nb\x00\x00\x00\x00"), []string{"a\nb", ""}},
+        {"truncated length", []byte("\x01\x00\x00\x00x\x02\x00"), []string{"x"}},
+        {"truncated text", []byte("\x01\x00\x00\x00x\x05\x00\x00\x00ab"), []string{"x"}},
+    }
+
+    for _, c := range cases {
+        t.Run(c.name, func(t *testing.T) {
+            if got := decodeOutputBatch(c.buf); !reflect.DeepEqual(got, c.want) {
+                t.Fatalf("got %q, want %q", got, c.want)
+            }
+        })
+    }
+}
@@ -0,0 +1,91 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * The ASF licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+package v8go
+
+/*
+#include "v8bridge.h"
+*/
+import "C"
+
+// 与 v8::TaskPriority 一致
+type TaskPriority int
+
+const (
+    // 可被推迟的任务, 如空闲时的编译缓存
+    TaskBestEffort TaskPriority = iota
+    // 后台编译、并发标记等
+    TaskUserVisible
+    // 会阻塞执行线程的任务, 如主 GC 的并行阶段
+    TaskUserBlocking
+)
+
+// 交给 OnPlatformTask 的 V8 后台任务, 必须且只能调用一次 Run
+type PlatformTask struct {
+    ptr      C.V8PlatformTaskPtr
+    Priority TaskPriority
+}
+
+func (t *PlatformTask) Run() {
+    if t.ptr == nil {
+        return
+    }
+    ptr := t.ptr
+    t.ptr = nil
+    C.V8RunPlatformTask(ptr, C.int(t.Priority))
+}
+
+type PlatformStats struct {
+    // 后台工作线程数, 使用 OnPlatformTask 时为报告给 V8 的并发度
+    Workers  int
+    // 已提交尚未开始执行的任务, 按 TaskPriority 下标
+    Pending  [3]uint64
+    Executed [3]uint64
+    // 尚未到期的延迟任务
+    Delayed  uint64
+}
+
+var platformWorkers int
+
+// 设置 V8 后台任务(并发 GC、并行编译等)使用的线程数, 0 为 CPU 数减一(最多 16).
+// 必须在 Init 之前调用
+func SetPlatformWorkers(n int) {
+    if n < 0 {
+        n = 0
+    }
+    platformWorkers = n
+}
+
+func configurePlatform() {
+    C.V8SetPlatformOptions(C.int(platformWorkers), C.bool(OnPlatformTask != nil))
+}
+
+//export GoPlatformTask
+func GoPlatformTask(task C.V8PlatformTaskPtr, priority C.int) {
+    OnPlatformTask(&PlatformTask{ptr: task, Priority: TaskPriority(priority)})
+}
+
+func GetPlatformStats() PlatformStats {
+    var cs C.V8PlatformStats
+    C.V8GetPlatformStats(&cs)
+    stats := PlatformStats{Workers: int(cs.workers), Delayed: uint64(cs.delayed)}
+    for i := range stats.Pending {
+        stats.Pending[i] = uint64(cs.pending[i])
+        stats.Executed[i] = uint64(cs.executed[i])
+    }
+    return stats
+}
@@ -0,0 +1,130 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * The ASF licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+package v8go
+
+import (
+    "sync"
+)
+
+// 已加载同一入口脚本的虚拟机池. 归还的虚拟机会被 Reset 并重新加载脚本, 保证会话之间不共享脚本状态.
+type VMPool struct {
+    script string
+    max    int
+
+    mu   sync.Mutex
+    idle []VM
+
+    // 新虚拟机加载脚本后调用, 返回 false 时丢弃该虚拟机
+    Prepare func(VM) bool
+}
+
+// max 为空闲虚拟机上限, 超出时归还的虚拟机直接释放
+func NewVMPool(script string, max int) *VMPool {
+    return &VMPool{script: script, max: max}
+}
+
+func (p *VMPool) create() VM {
+    vm := CreateV8VM()
+    if !vm.Load(p.script) || (p.Prepare != nil && !p.Prepare(vm)) {
+        vm.Dispose()
+        return nil
+    }
+    return vm
+}
+
+// 取出一个已加载脚本的虚拟机, 池为空时新建; 脚本加载失败返回 nil
+func (p *VMPool) Get() VM {
+    p.mu.Lock()
+    if n := len(p.idle); n > 0 {
+        vm := p.idle[n-1]
+        p.idle = p.idle[:n-1]
+        p.mu.Unlock()
+        return vm
+    }
+    p.mu.Unlock()
+    return p.create()
+}
+
+// 归还虚拟机. 重置和重新加载在调用方协程上完成
+func (p *VMPool) Put(vm VM) {
+    p.put(vm)
+}
+
+// 返回虚拟机重置并重新加载后的堆大小, 虚拟机被释放时为 0
+func (p *VMPool) put(vm VM) uint64 {
+    p.mu.Lock()
+    full := len(p.idle) >= p.max
+    p.mu.Unlock()
+    if full {
+        vm.Dispose()
+        return 0
+    }
+
+    vm.Reset()
+    if !vm.Load(p.script) || (p.Prepare != nil && !p.Prepare(vm)) {
+        vm.Dispose()
+        return 0
+    }
+    // 放回空闲列表之前测量, 之后虚拟机可能已被其他会话取走
+    heap := vm.HeapSize()
+
+    p.mu.Lock()
+    if len(p.idle) < p.max {
+        p.idle = append(p.idle, vm)
+        vm = nil
+    }
+    p.mu.Unlock()
+    if vm != nil {
+        vm.Dispose()
+        return 0
+    }
+    return heap
+}
+
+// 预先创建虚拟机直到空闲数达到 n
+func (p *VMPool) Fill(n int) {
+    if n > p.max {
+        n = p.max
+    }
+    for p.Len() < n {
+        vm := p.create()
+        if vm == nil {
+            return
+        }
+        p.mu.Lock()
+        p.idle = append(p.idle, vm)
+        p.mu.Unlock()
+    }
+}
+
+func (p *VMPool) Len() int {
+    p.mu.Lock()
+    defer p.mu.Unlock()
+    return len(p.idle)
+}
+
+// 释放所有空闲虚拟机
+func (p *VMPool) Close() {
+    p.mu.Lock()
+    idle := p.idle
+    p.idle = nil
+    p.mu.Unlock()
+    for _, vm := range idle {
+        vm.Dispose()
+    }
+}
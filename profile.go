@@ -0,0 +1,78 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * The ASF licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+package v8go
+
+/*
+#include <stdlib.h>
+#include "v8bridge.h"
+*/
+import "C"
+
+import (
+    "unsafe"
+)
+
+// 进程级执行配置, 在 Init 时生效, 之后不可更改
+type ExecutionProfile int
+
+const (
+    // 完整 JIT, 峰值性能最高
+    ProfileDefault ExecutionProfile = C.v8ProfileDefault
+    // --lite-mode: 只用解释器, 不分配反馈向量
+    ProfileLite    ExecutionProfile = C.v8ProfileLite
+    // --jitless: 不生成可执行内存, 内存最省, WebAssembly 不可用
+    ProfileJitless ExecutionProfile = C.v8ProfileJitless
+    // 推迟 tier-up 并偏向代码体积
+    ProfileTuned   ExecutionProfile = C.v8ProfileTuned
+)
+
+func (p ExecutionProfile) String() string {
+    switch p {
+    case ProfileDefault: return "default"
+    case ProfileLite: return "lite"
+    case ProfileJitless: return "jitless"
+    case ProfileTuned: return "tuned"
+    }
+    return "unknown"
+}
+
+// 按名称解析执行配置, 名称与 String() 一致
+func ParseExecutionProfile(name string) (ExecutionProfile, bool) {
+    for _, p := range []ExecutionProfile{ProfileDefault, ProfileLite, ProfileJitless, ProfileTuned} {
+        if p.String() == name {
+            return p, true
+        }
+    }
+    return ProfileDefault, false
+}
+
+// 以指定执行配置初始化 V8, extraFlags 追加在配置自带的 V8 参数之后.
+// 与 Init 一样只有第一次调用生效
+func InitWithProfile(profile ExecutionProfile, extraFlags string) {
+    cFlags := C.CString(extraFlags)
+    defer C.free(unsafe.Pointer(cFlags))
+    initV8Once.Do(func() {
+        C.V8SetExecutionProfile(C.int(profile), cFlags)
+        configurePlatform()
+        C.V8Init()
+    })
+}
+
+func CurrentExecutionProfile() ExecutionProfile {
+    return ExecutionProfile(C.V8GetExecutionProfile())
+}
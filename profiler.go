@@ -0,0 +1,92 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * The ASF licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+package v8go
+
+/*
+#include <stdlib.h>
+#include "v8bridge.h"
+*/
+import "C"
+
+import (
+    "fmt"
+    "path/filepath"
+    "time"
+    "unsafe"
+)
+
+// 开始 CPU 采样, interval 为 0 时使用默认的 1ms.
+// V8 的采样线程使用 SIGPROF, 不要与 Go 的 pprof CPU 采样同时使用.
+func (vm *V8VM) StartCpuProfiling(interval time.Duration) bool {
+    if vm.disposed {
+        return false
+    }
+    return C.V8StartCpuProfiling(vm.vmCPtr, C.int(interval/time.Microsecond)) == 0
+}
+
+// 结束 CPU 采样, 返回 Chrome DevTools .cpuprofile 格式的内容
+func (vm *V8VM) StopCpuProfiling() []byte {
+    if vm.disposed {
+        return nil
+    }
+
+    var l C.size_t
+    buf := C.V8StopCpuProfiling(vm.vmCPtr, &l)
+    if buf == nil {
+        return nil
+    }
+    defer C.free(unsafe.Pointer(buf))
+    return C.GoBytes(unsafe.Pointer(buf), C.int(l))
+}
+
+// 结束 CPU 采样并写入 path
+func (vm *V8VM) StopCpuProfilingToFile(path string) bool {
+    if vm.disposed {
+        return false
+    }
+
+    cPath := C.CString(path)
+    defer C.free(unsafe.Pointer(cPath))
+    return C.V8StopCpuProfilingToFile(vm.vmCPtr, cPath) == 0
+}
+
+// 对所有虚拟机开始 CPU 采样, 返回成功开始的数量
+func StartCpuProfilingAll(interval time.Duration) int {
+    n := 0
+    vmRegistry.Range(func(_, v interface{}) bool {
+        if v.(*V8VM).StartCpuProfiling(interval) {
+            n++
+        }
+        return true
+    })
+    return n
+}
+
+// 结束所有虚拟机的 CPU 采样, 每个虚拟机写入 dir 下的 vm-<源地址id>-<指针>.cpuprofile, 返回写入的文件列表
+func StopCpuProfilingAll(dir string) []string {
+    var files []string
+    vmRegistry.Range(func(k, v interface{}) bool {
+        vm := v.(*V8VM)
+        path := filepath.Join(dir, fmt.Sprintf("vm-%d-%x.cpuprofile", vm.GetAssociatedSourceId(), k.(uintptr)))
+        if vm.StopCpuProfilingToFile(path) {
+            files = append(files, path)
+        }
+        return true
+    })
+    return files
+}
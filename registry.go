@@ -0,0 +1,47 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * The ASF licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+package v8go
+
+/*
+#include "v8bridge.h"
+*/
+import "C"
+
+import (
+    "sync"
+    "unsafe"
+)
+
+// 由 C 侧虚拟机指针找回 Go 侧对象, 供 native 线程发起的回调使用
+var vmRegistry sync.Map
+
+func registerVM(vm *V8VM) {
+    vmRegistry.Store(uintptr(unsafe.Pointer(vm.vmCPtr)), vm)
+}
+
+func unregisterVM(vm *V8VM) {
+    vmRegistry.Delete(uintptr(unsafe.Pointer(vm.vmCPtr)))
+}
+
+func lookupVM(vmPtr C.VMPtr) *V8VM {
+    v, ok := vmRegistry.Load(uintptr(unsafe.Pointer(vmPtr)))
+    if !ok {
+        return nil
+    }
+    return v.(*V8VM)
+}
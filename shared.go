@@ -0,0 +1,89 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * The ASF licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+package v8go
+
+/*
+#include <stdlib.h>
+#include "v8bridge.h"
+*/
+import "C"
+
+import (
+    "errors"
+    "unsafe"
+)
+
+// 命名共享区域, References 包括注册表自身和每个打开它的 SharedArrayBuffer
+type SharedRegion struct {
+    Name       string
+    Size       int
+    References int
+}
+
+// 创建命名共享区域(内容初始化为 0), 脚本中通过 openSharedRegion(name) 以 SharedArrayBuffer 打开,
+// 同一进程内的所有虚拟机共享同一块内存. 已存在且大小相同时直接返回
+func CreateSharedRegion(name string, size int) error {
+    cName := C.CString(name)
+    defer C.free(unsafe.Pointer(cName))
+
+    switch C.V8CreateSharedRegion(cName, C.size_t(size)) {
+    case 0:
+        return nil
+    case 1:
+        return errors.New("shared region " + name + " already exists with a different size")
+    default:
+        return errors.New("shared region " + name + " allocation failed")
+    }
+}
+
+// 限制脚本通过 openSharedRegion(name, byteLength) 创建的区域: 名字必须以 prefix 开头, 大小不超过 maxSize.
+// 默认前缀为 "script.", 上限 1MB; Go 侧创建的区域不受限制
+func SetSharedRegionScriptPolicy(prefix string, maxSize int) {
+    cPrefix := C.CString(prefix)
+    defer C.free(unsafe.Pointer(cPrefix))
+    C.V8SetSharedRegionScriptPolicy(cPrefix, C.size_t(maxSize))
+}
+
+// 之后新建的虚拟机是否允许 Atomics.wait, 默认允许. 关闭后脚本等待共享区域会抛出异常而不是阻塞执行线程
+func SetAtomicsWaitAllowed(allowed bool) {
+    C.V8SetAllowAtomicsWait(C._Bool(allowed))
+}
+
+// 从注册表移除, 已经打开的虚拟机不受影响, 全部释放后回收内存
+func ReleaseSharedRegion(name string) bool {
+    cName := C.CString(name)
+    defer C.free(unsafe.Pointer(cName))
+    return C.V8ReleaseSharedRegion(cName) == 0
+}
+
+func SharedRegions() []SharedRegion {
+    cRegions := C.V8GetSharedRegions()
+    defer C.V8ReleaseSharedRegions(cRegions)
+
+    length := int(C.V8GetSharedRegionsLength(cRegions))
+    regions := make([]SharedRegion, length)
+    for i := 0; i < length; i++ {
+        item := C.V8GetSharedRegionsItem(cRegions, C.int(i))
+        regions[i] = SharedRegion{
+            Name:       C.GoString(item.name),
+            Size:       int(item.size),
+            References: int(item.references),
+        }
+    }
+    return regions
+}
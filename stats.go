@@ -0,0 +1,115 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * The ASF licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+package v8go
+
+/*
+#include "v8bridge.h"
+*/
+import "C"
+
+import "time"
+
+type Handler int
+
+// 与 v8stats.h 中的 V8HandlerKind 顺序一致
+const (
+    HandlerMain Handler = iota
+    HandlerEnter
+    HandlerLeave
+    HandlerMessage
+)
+
+type LatencySummary struct {
+    Mean time.Duration
+    P50  time.Duration
+    P90  time.Duration
+    P99  time.Duration
+    P999 time.Duration
+    Max  time.Duration
+}
+
+// 处理函数(main/enter/leave/message)的调用次数、失败次数及墙钟/线程 CPU 耗时分位数
+type HandlerStats struct {
+    Calls  uint64
+    Errors uint64
+    Wall   LatencySummary
+    CPU    LatencySummary
+}
+
+func toLatencySummary(ls C.V8LatencySummary) LatencySummary {
+    return LatencySummary{
+        Mean: time.Duration(ls.meanNs),
+        P50:  time.Duration(ls.p50Ns),
+        P90:  time.Duration(ls.p90Ns),
+        P99:  time.Duration(ls.p99Ns),
+        P999: time.Duration(ls.p999Ns),
+        Max:  time.Duration(ls.maxNs),
+    }
+}
+
+func getHandlerStats(vmPtr C.VMPtr, handler Handler) HandlerStats {
+    var cs C.V8HandlerStats
+    C.V8GetHandlerStats(vmPtr, C.int(handler), &cs)
+    return HandlerStats{
+        Calls:  uint64(cs.calls),
+        Errors: uint64(cs.errors),
+        Wall:   toLatencySummary(cs.wall),
+        CPU:    toLatencySummary(cs.cpu),
+    }
+}
+
+// 全进程汇总, 包含已销毁的虚拟机
+func GetHandlerStats(handler Handler) HandlerStats {
+    return getHandlerStats(nil, handler)
+}
+
+func (vm *V8VM) HandlerStats(handler Handler) HandlerStats {
+    if vm.disposed {
+        return HandlerStats{}
+    }
+    return getHandlerStats(vm.vmCPtr, handler)
+}
+
+// V8 GC 的次数与停顿时间分位数
+type GCStats struct {
+    Count uint64
+    Total time.Duration
+    Pause LatencySummary
+}
+
+func getGCStats(vmPtr C.VMPtr) GCStats {
+    var cs C.V8GCStats
+    C.V8GetGCStats(vmPtr, &cs)
+    return GCStats{
+        Count: uint64(cs.count),
+        Total: time.Duration(cs.totalNs),
+        Pause: toLatencySummary(cs.pause),
+    }
+}
+
+// 全进程汇总, 包含已销毁的虚拟机
+func GetGCStats() GCStats {
+    return getGCStats(nil)
+}
+
+func (vm *V8VM) GCStats() GCStats {
+    if vm.disposed {
+        return GCStats{}
+    }
+    return getGCStats(vm.vmCPtr)
+}
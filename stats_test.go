@@ -0,0 +1,78 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * The ASF licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+package v8go
+
+import (
+    "testing"
+    "time"
+)
+
+const statsTestScript = "testdata/stats/main.js"
+
+func TestHandlerStats(t *testing.T) {
+    cases := []struct {
+        name    string
+        handler Handler
+        op      string
+        ms      int
+        calls   int
+        errors  uint64
+    }{
+        {"enter", HandlerEnter, "", 0, 4, 0},
+        {"message", HandlerMessage, "noop", 0, 5, 0},
+        {"message errors", HandlerMessage, "throw", 0, 3, 3},
+        // 直方图每个 2 的幂区间 8 个子桶, 分位数误差约 12%
+        {"message latency", HandlerMessage, "busy", 10, 20, 0},
+    }
+
+    for _, c := range cases {
+        t.Run(c.name, func(t *testing.T) {
+            vm := CreateV8VM()
+            defer vm.Dispose()
+            if !vm.Load(statsTestScript) {
+                t.Fatal("load " + statsTestScript + " failed")
+            }
+
+            for i := 0; i < c.calls; i++ {
+                if c.handler == HandlerEnter {
+                    vm.DispatchEnter(uint64(i), "127.0.0.1:7000")
+                } else {
+                    vm.DispatchMessage(uint64(i), map[interface{}] interface{}{"op": c.op, "ms": c.ms})
+                }
+            }
+
+            stats := vm.HandlerStats(c.handler)
+            if stats.Calls != uint64(c.calls) || stats.Errors != c.errors {
+                t.Fatalf("calls %d errors %d, want %d and %d", stats.Calls, stats.Errors, c.calls, c.errors)
+            }
+            wall := stats.Wall
+            if !(wall.P50 <= wall.P90 && wall.P90 <= wall.P99 && wall.P99 <= wall.P999 && wall.P999 <= wall.Max) {
+                t.Fatalf("percentiles out of order: %+v", wall)
+            }
+            if c.ms > 0 {
+                d := time.Duration(c.ms) * time.Millisecond
+                if wall.P50 < d*3/4 || wall.P50 > d*2 {
+                    t.Fatalf("p50 %v, want about %v", wall.P50, d)
+                }
+                if wall.Mean < d*3/4 {
+                    t.Fatalf("mean %v, want at least %v", wall.Mean, d*3/4)
+                }
+            }
+        })
+    }
+}
@@ -0,0 +1,7 @@
+export function makeTable(n) {
+    const table = [];
+    for (let i = 0; i < n; i++) {
+        table.push({ id: i, name: 'row-' + i });
+    }
+    return table;
+}
@@ -0,0 +1,42 @@
+// 基准测试入口脚本: 实现 enter/leave/message 三个处理函数
+var sessions = {};
+var received = 0;
+
+// net.sendCurrentPlayer 的负载按大小预先构造, 基准只衡量 JS -> Go 的提取
+function makePayload(fields) {
+    var o = { op: 'state', fields: fields, items: [] };
+    for (var i = 0; i < fields; i++) {
+        o['key' + i] = 'value-' + i;
+        if (i % 8 === 0)
+            o.items.push({ id: i, score: i * 1.5, alive: (i & 1) === 0 });
+    }
+    return o;
+}
+
+var payloads = {
+    small: makePayload(4),
+    medium: makePayload(64),
+    large: makePayload(1024),
+};
+
+function enter(sessionId, addr) {
+    sessions[sessionId] = addr;
+    return 0;
+}
+
+function leave(sessionId, addr) {
+    delete sessions[sessionId];
+    return 0;
+}
+
+function message(sessionId, msg) {
+    received++;
+    switch (msg.op) {
+        case 'send':
+            return net.sendCurrentPlayer(payloads[msg.size]);
+        case 'log':
+            console.log('session', sessionId, 'seq', msg.seq);
+            return 0;
+    }
+    return 0;
+}
@@ -0,0 +1,8 @@
+// 基准测试模块入口, 静态导入一个依赖
+import { makeTable } from './lib.mjs';
+
+globalThis.table = makeTable(256);
+
+globalThis.message = function (sessionId, msg) {
+    return table.length;
+};
@@ -0,0 +1,4 @@
+// 配置表测试脚本: 把 msg.name 对应的配置表序列化后通过 net.sendCurrentPlayer 报告
+function message(sessionId, msg) {
+    return net.sendCurrentPlayer(JSON.stringify(getConfig(msg.name)));
+}
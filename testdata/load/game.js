@@ -0,0 +1,72 @@
+// 负载测试用的示例游戏脚本: 玩家按房间分组, 移动时计算视野内的玩家并回包
+var ROOM_SIZE = 16;
+var VIEW_RANGE = 50;
+
+var players = {};
+var rooms = {};
+
+function roomOf(sessionId) {
+    return Number(sessionId % BigInt(1024)) / ROOM_SIZE | 0;
+}
+
+function enter(sessionId, addr) {
+    var room = roomOf(sessionId);
+    var player = { id: sessionId.toString(), room: room, x: 0, y: 0, hp: 100, score: 0 };
+    players[player.id] = player;
+    (rooms[room] = rooms[room] || {})[player.id] = player;
+    return 0;
+}
+
+function leave(sessionId, addr) {
+    var player = players[sessionId.toString()];
+    if (player) {
+        delete rooms[player.room][player.id];
+        delete players[player.id];
+    }
+    return 0;
+}
+
+function nearby(player) {
+    var list = [];
+    var members = rooms[player.room];
+    for (var id in members) {
+        var other = members[id];
+        if (other === player)
+            continue;
+        var dx = other.x - player.x, dy = other.y - player.y;
+        if (dx * dx + dy * dy <= VIEW_RANGE * VIEW_RANGE)
+            list.push({ id: other.id, x: other.x, y: other.y, hp: other.hp });
+    }
+    return list;
+}
+
+function message(sessionId, msg) {
+    var player = players[sessionId.toString()];
+    if (!player)
+        return 1;
+
+    switch (msg.op) {
+        case 'move':
+            player.x = msg.x;
+            player.y = msg.y;
+            net.sendCurrentPlayer({ op: 'view', x: player.x, y: player.y, players: nearby(player) });
+            break;
+        case 'action':
+            player.score += msg.power;
+            var targets = nearby(player);
+            for (var i = 0; i < targets.length; i++) {
+                var target = players[targets[i].id];
+                target.hp = Math.max(0, target.hp - msg.power);
+            }
+            net.sendCurrentPlayer({ op: 'result', score: player.score, hits: targets.length });
+            break;
+        case 'chat':
+            var members = rooms[player.room];
+            for (var id in members) {
+                if (id !== player.id)
+                    net.sendToOtherPlayer({ to: id, from: player.id, text: msg.text });
+            }
+            break;
+    }
+    return 0;
+}
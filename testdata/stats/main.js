@@ -0,0 +1,21 @@
+// 处理函数统计测试脚本: message 按 op 空转指定毫秒数或抛出异常
+function busy(ms) {
+    var end = Date.now() + ms;
+    while (Date.now() < end) {
+    }
+}
+
+function enter(sessionId, addr) {
+    return 0;
+}
+
+function message(sessionId, msg) {
+    switch (msg.op) {
+        case 'busy':
+            busy(msg.ms);
+            return 0;
+        case 'throw':
+            throw new Error('handler failed');
+    }
+    return 0;
+}
@@ -0,0 +1,26 @@
+// 定时器测试脚本: 按 message 中的延迟注册定时器, 到期顺序通过 net.sendCurrentPlayer 报告
+var handles = [];
+var fired = [];
+
+function message(sessionId, msg) {
+    switch (msg.op) {
+        case 'schedule':
+            msg.delays.forEach(function (delay, id) {
+                handles[id] = setTimeout(function () { fired.push(id); }, delay);
+            });
+            return 0;
+        case 'interval':
+            handles[0] = setInterval(function () {
+                fired.push(0);
+                if (fired.length >= msg.times)
+                    clearInterval(handles[0]);
+            }, msg.delay);
+            return 0;
+        case 'clear':
+            msg.ids.forEach(function (id) { clearTimeout(handles[id]); });
+            return 0;
+        case 'report':
+            return net.sendCurrentPlayer(fired.join(','));
+    }
+    return 0;
+}
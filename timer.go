@@ -0,0 +1,110 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * The ASF licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+package v8go
+
+/*
+#include "v8bridge.h"
+*/
+import "C"
+
+import (
+    "sync/atomic"
+    "time"
+)
+
+type TimerStats struct {
+    Active     uint64
+    Scheduled  uint64
+    Fired      uint64
+    Cancelled  uint64
+    DriftTotal time.Duration
+    DriftMax   time.Duration
+}
+
+//export GoTimersReady
+func GoTimersReady(vmPtr C.VMPtr) {
+    vm := lookupVM(vmPtr)
+    if vm == nil {
+        return
+    }
+
+    if OnTimersReady != nil {
+        OnTimersReady(vm)
+        return
+    }
+
+    // 不能在时间轮线程上执行脚本, 否则一个繁忙的虚拟机会阻塞所有虚拟机的定时器
+    vm.scheduleRunTimers()
+}
+
+// 每个虚拟机最多排队一个执行协程, 执行前清除标记, 期间新到期的定时器会再排一次
+func (vm *V8VM) scheduleRunTimers() {
+    if atomic.CompareAndSwapInt32(&vm.timersQueued, 0, 1) {
+        go func() {
+            atomic.StoreInt32(&vm.timersQueued, 0)
+            // 查找虚拟机与执行之间可能发生 Dispose/Reset, 持读锁后再确认一次
+            vm.lifeMu.RLock()
+            defer vm.lifeMu.RUnlock()
+            if !vm.disposed {
+                vm.RunTimers()
+            }
+        }()
+    }
+}
+
+// 设置时间轮精度, 必须在任何脚本调用 setTimeout/setInterval 之前设置
+func SetTimerResolution(d time.Duration) {
+    C.V8SetTimerResolution(C.uint32_t(d / time.Millisecond))
+}
+
+// 所有虚拟机的定时器汇总统计
+func GetTimerStats() TimerStats {
+    return getTimerStats(nil)
+}
+
+func getTimerStats(vmPtr C.VMPtr) TimerStats {
+    var cs C.V8TimerStats
+    C.V8GetTimerStats(vmPtr, &cs)
+    return TimerStats{
+        Active:     uint64(cs.active),
+        Scheduled:  uint64(cs.scheduled),
+        Fired:      uint64(cs.fired),
+        Cancelled:  uint64(cs.cancelled),
+        DriftTotal: time.Duration(cs.driftTotalMs) * time.Millisecond,
+        DriftMax:   time.Duration(cs.driftMaxMs) * time.Millisecond,
+    }
+}
+
+func (vm *V8VM) RunTimers() int {
+    if vm.disposed {
+        return -1
+    }
+
+    r := C.V8RunTimers(vm.vmCPtr)
+    if r == 2 {
+        vm.reportException()
+    }
+    return int(r)
+}
+
+func (vm *V8VM) TimerStats() TimerStats {
+    if vm.disposed {
+        return TimerStats{}
+    }
+    return getTimerStats(vm.vmCPtr)
+}
@@ -0,0 +1,124 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * The ASF licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+package v8go
+
+import (
+    "strings"
+    "testing"
+    "time"
+)
+
+const timerTestScript = "testdata/timer/main.js"
+
+// 读取脚本记录的到期顺序
+func timerFired(t *testing.T, vm VM) string {
+    var fired string
+    OnSendMessage = func(_ string, _ uint64, data interface{}) int {
+        fired, _ = data.(string)
+        return 0
+    }
+    defer func() { OnSendMessage = func(string, uint64, interface{}) int { return 0 } }()
+
+    if rc := vm.DispatchMessage(1, map[interface{}] interface{}{"op": "report"}); rc != 0 {
+        t.Fatalf("report returned %d", rc)
+    }
+    return fired
+}
+
+func TestTimers(t *testing.T) {
+    cases := []struct {
+        name   string
+        delays []interface{}
+        clear  []interface{}
+        want   string
+        long   bool
+    }{
+        {"root slots", []interface{}{50, 10, 0, 30}, nil, "2,1,3,0", false},
+        {"same delay keeps order", []interface{}{20, 20, 20}, nil, "0,1,2", false},
+        // 1ms 精度下超过 256 个 tick 的定时器先放在第 0 层, 到期前级联回根轮
+        {"cascade level 0", []interface{}{300, 10, 600, 257}, nil, "1,3,0,2", false},
+        {"cancelled", []interface{}{10, 20, 30}, []interface{}{1}, "0,2", false},
+        // 超过 2^14 个 tick 的定时器从第 1 层级联
+        {"cascade level 1", []interface{}{16500, 100}, nil, "1,0", true},
+    }
+
+    // 由测试协程执行定时器, 到期顺序不受调度影响
+    OnTimersReady = func(VM) {}
+    defer func() { OnTimersReady = nil }()
+
+    for _, c := range cases {
+        t.Run(c.name, func(t *testing.T) {
+            if c.long && testing.Short() {
+                t.Skip("long timer in short mode")
+            }
+            vm := CreateV8VM()
+            defer vm.Dispose()
+            if !vm.Load(timerTestScript) {
+                t.Fatal("load " + timerTestScript + " failed")
+            }
+
+            vm.DispatchMessage(1, map[interface{}] interface{}{"op": "schedule", "delays": c.delays})
+            if c.clear != nil {
+                vm.DispatchMessage(1, map[interface{}] interface{}{"op": "clear", "ids": c.clear})
+            }
+
+            want := len(c.delays) - len(c.clear)
+            deadline := time.Now().Add(20 * time.Second)
+            fired := ""
+            for time.Now().Before(deadline) {
+                vm.RunTimers()
+                if fired = timerFired(t, vm); fired != "" && len(strings.Split(fired, ",")) >= want {
+                    break
+                }
+                time.Sleep(time.Millisecond)
+            }
+            if fired != c.want {
+                t.Fatalf("fired %q, want %q", fired, c.want)
+            }
+
+            stats := vm.TimerStats()
+            if stats.Active != 0 || stats.Fired != uint64(want) || stats.Cancelled != uint64(len(c.clear)) {
+                t.Fatalf("unexpected stats %+v", stats)
+            }
+        })
+    }
+}
+
+func TestTimerInterval(t *testing.T) {
+    OnTimersReady = func(VM) {}
+    defer func() { OnTimersReady = nil }()
+
+    vm := CreateV8VM()
+    defer vm.Dispose()
+    if !vm.Load(timerTestScript) {
+        t.Fatal("load " + timerTestScript + " failed")
+    }
+
+    vm.DispatchMessage(1, map[interface{}] interface{}{"op": "interval", "delay": 5, "times": 3})
+    deadline := time.Now().Add(5 * time.Second)
+    for time.Now().Before(deadline) && vm.TimerStats().Active != 0 {
+        vm.RunTimers()
+        time.Sleep(time.Millisecond)
+    }
+    if fired := timerFired(t, vm); fired != "0,0,0" {
+        t.Fatalf("fired %q, want %q", fired, "0,0,0")
+    }
+    if stats := vm.TimerStats(); stats.Fired != 3 || stats.Active != 0 {
+        t.Fatalf("unexpected stats %+v", stats)
+    }
+}
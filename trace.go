@@ -0,0 +1,119 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * The ASF licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+package v8go
+
+/*
+#include <stdlib.h>
+#include "v8bridge.h"
+*/
+import "C"
+
+import (
+    "errors"
+    "strings"
+    "sync/atomic"
+    "unsafe"
+)
+
+// 桥接层的追踪类别, V8 自身的类别如 "v8.compile", "v8.execute", "devtools.timeline",
+// "disabled-by-default-v8.gc" 可一并开启
+const (
+    // V8Load/V8LoadModule
+    TraceCategoryLoad     = "v8go.load"
+    // enter/leave/message 等派发与定时器
+    TraceCategoryDispatch = "v8go.dispatch"
+    // Go 与 JS 之间的数据转换, 包括发送批次
+    TraceCategoryMarshal  = "v8go.marshal"
+)
+
+// StartTracing 未指定类别时使用的默认集合
+var DefaultTraceCategories = []string{
+    TraceCategoryLoad,
+    TraceCategoryDispatch,
+    TraceCategoryMarshal,
+    "v8.compile",
+    "v8.execute",
+    "devtools.timeline",
+    "disabled-by-default-v8.gc",
+}
+
+type TraceStats struct {
+    // 记录期间产生的事件数
+    Events  uint64
+    // 因环形缓冲区已满而被覆盖的事件数
+    Dropped uint64
+}
+
+var tracing int32
+
+// 开始记录 Chrome trace 事件, 必须在 Init 之后调用. 事件保存在容量为 maxEvents 的环形缓冲区中(0 为 65536),
+// StopTracing 时写入 path, 可直接用 chrome://tracing 或 Perfetto 打开, 每个虚拟机一条异步时间线.
+func StartTracing(path string, categories []string, maxEvents int) error {
+    if len(categories) == 0 {
+        categories = DefaultTraceCategories
+    }
+    if maxEvents < 0 {
+        maxEvents = 0
+    }
+
+    cPath := C.CString(path)
+    cCategories := C.CString(strings.Join(categories, ","))
+    defer func() {
+        C.free(unsafe.Pointer(cPath))
+        C.free(unsafe.Pointer(cCategories))
+    }()
+
+    switch C.V8StartTracing(cPath, cCategories, C.size_t(maxEvents)) {
+    case -1:
+        return errors.New("v8 is not initialized")
+    case 1:
+        return errors.New("tracing already started")
+    case 2:
+        return errors.New("failed to create trace file " + path)
+    }
+    atomic.StoreInt32(&tracing, 1)
+    return nil
+}
+
+// 停止记录并写出 trace 文件
+func StopTracing() (TraceStats, error) {
+    atomic.StoreInt32(&tracing, 0)
+
+    var cs C.V8TraceStats
+    r := C.V8StopTracing(&cs)
+    stats := TraceStats{Events: uint64(cs.events), Dropped: uint64(cs.dropped)}
+    switch r {
+    case 1:
+        return stats, errors.New("tracing not started")
+    case 2:
+        return stats, errors.New("failed to write trace file")
+    }
+    return stats, nil
+}
+
+func traceBegin(vm *V8VM, span C.int, sessionId uint64) bool {
+    if atomic.LoadInt32(&tracing) == 0 {
+        return false
+    }
+    C.V8TraceBegin(vm.vmCPtr, span, C.uint64_t(sessionId))
+    return true
+}
+
+func traceEnd(vm *V8VM, span C.int) {
+    C.V8TraceEnd(vm.vmCPtr, span)
+}
@@ -30,6 +30,8 @@ import (
     "fmt"
     "runtime"
     "strconv"
+    "sync"
+    "sync/atomic"
     "unsafe"
 )
 
@@ -60,7 +62,7 @@ func GoOutput(c *C.char) {
 
 //export GoSend
 func GoSend(vm C.VMPtr, jsValue C.VMValuePtr) C.int {
-    if OnSendMessage == nil {
+    if OnSendMessage == nil && currentCapture() == nil {
         return C.int(0)
     }
 
@@ -69,7 +71,10 @@ func GoSend(vm C.VMPtr, jsValue C.VMValuePtr) C.int {
 
     data := transferJsValue2GoValue(vm, jsValue)
     if data != nil {
-        OnSendMessage(sAddr, sId, data)
+        captureSend(vm, false, data)
+        if OnSendMessage != nil {
+            OnSendMessage(sAddr, sId, data)
+        }
     }
 
     return C.int(0)
@@ -77,13 +82,16 @@ func GoSend(vm C.VMPtr, jsValue C.VMValuePtr) C.int {
 
 //export GoSendTo
 func GoSendTo(vm C.VMPtr, jsValue C.VMValuePtr) C.int {
-    if OnSendMessageTo == nil {
+    if OnSendMessageTo == nil && currentCapture() == nil {
         return C.int(0)
     }
 
     data := transferJsValue2GoValue(vm, jsValue)
     if data != nil {
-        OnSendMessageTo(data)
+        captureSend(vm, true, data)
+        if OnSendMessageTo != nil {
+            OnSendMessageTo(data)
+        }
     }
 
     return C.int(0)
@@ -93,6 +101,13 @@ type V8VM struct {
     vmCPtr C.VMPtr
     disposed bool
     called int64
+    sessionId uint64
+    timersQueued int32
+    // 后台协程执行定时器时持读锁, Dispose/Reset 持写锁, 防止释放中的虚拟机被使用
+    lifeMu sync.RWMutex
+    // 合并发送模式下派发期间缓冲的消息, 只在持有虚拟机锁的线程上访问
+    outbound []queuedSend
+    outboundKeys map[string]int
 }
 
 func Version() string {
@@ -105,6 +120,7 @@ func Dispose() {
 
 func Init() {
     initV8Once.Do(func() {
+        configurePlatform()
         C.V8Init()
     })
 }
@@ -114,6 +130,7 @@ func CreateV8VM() VM {
 
     vm.vmCPtr = C.V8NewVM()
     vm.disposed = false
+    registerVM(vm)
 
     runtime.SetFinalizer(vm, func(vmWillDispose *VM) {
     //    vmWillDispose.Dispose()
@@ -125,18 +142,31 @@ func CreateV8VM() VM {
 }
 
 func (vm *V8VM) Dispose() {
+    detachInspector(vm)
+    unregisterVM(vm)
+    vm.lifeMu.Lock()
     C.V8DisposeVM(vm.vmCPtr)
+    vm.outbound = nil
+    vm.outboundKeys = nil
     vm.disposed = true
+    vm.lifeMu.Unlock()
 }
 
 func (vm *V8VM) Called() int64 {
-    return vm.called
+    return atomic.LoadInt64(&vm.called)
 }
 
 func (vm *V8VM) Reset() {
+    detachInspector(vm)
+    unregisterVM(vm)
+    vm.lifeMu.Lock()
     C.V8DisposeVM(vm.vmCPtr)
-    vm.called = 0
+    vm.outbound = nil
+    vm.outboundKeys = nil
+    atomic.StoreInt64(&vm.called, 0)
     vm.vmCPtr = C.V8NewVM()
+    vm.lifeMu.Unlock()
+    registerVM(vm)
 }
 
 func (vm *V8VM) PrintMemStat() {
@@ -158,7 +188,7 @@ func (vm *V8VM) Load(path string) bool {
 
     r := C.V8Load(vm.vmCPtr, cPath, nil)
     if r == 2 {
-        fmt.Println(C.GoString(C.V8LastException(vm.vmCPtr)))
+        vm.reportException()
     }
     if r == -1 {
         fmt.Printf("\nScript entryfile %s is not exists!\n\n", path)
@@ -166,6 +196,26 @@ func (vm *V8VM) Load(path string) bool {
     return r == 0
 }
 
+// 以 ES 模块方式加载入口文件, 静态 import 的依赖会一并加载
+func (vm *V8VM) LoadModule(path string) bool {
+    if vm.disposed {
+        return false
+    }
+    cPath := C.CString(path)
+    defer func() {
+        C.free(unsafe.Pointer(cPath))
+    }()
+
+    r := C.V8LoadModule(vm.vmCPtr, cPath, nil, nil)
+    if r == 2 || r == 3 {
+        vm.reportException()
+    }
+    if r == -1 {
+        fmt.Printf("\nModule entryfile %s is not exists!\n\n", path)
+    }
+    return r == 0
+}
+
 func (vm *V8VM) SetAssociatedSourceAddr(addr string) {
     cAddr := C.CString(addr)
     defer func() {
@@ -187,11 +237,11 @@ func (vm *V8VM) GetAssociatedSourceId() uint64 {
 }
 
 func (vm *V8VM) SetAssociatedSessionId(id uint64) {
-
+    vm.sessionId = id
 }
 
 func (vm *V8VM) GetAssociatedSessionId() uint64 {
-    return 0
+    return vm.sessionId
 }
 
 func (vm *V8VM) DispatchEnter(sessionId uint64, addr string) int {
@@ -199,17 +249,19 @@ func (vm *V8VM) DispatchEnter(sessionId uint64, addr string) int {
         return -1
     }
 
-    vm.called += 1
+    atomic.AddInt64(&vm.called, 1)
 
     cAddr := C.CString(addr)
     defer func() {
         C.free(unsafe.Pointer(cAddr))
     }()
 
+    start := captureStart()
     r := C.V8DispatchEnterEvent(vm.vmCPtr, C.uint64_t(sessionId), cAddr)
     if r == 2 {
-        fmt.Println(C.GoString(C.V8LastException(vm.vmCPtr)))
+        vm.reportException()
     }
+    captureEvent(CaptureEnter, vm, sessionId, addr, start, int(r))
 
     return int(r)
 }
@@ -219,17 +271,19 @@ func (vm *V8VM) DispatchLeave(sessionId uint64, addr string) int {
         return -1
     }
 
-    vm.called += 1
+    atomic.AddInt64(&vm.called, 1)
 
     cAddr := C.CString(addr)
     defer func() {
         C.free(unsafe.Pointer(cAddr))
     }()
 
+    start := captureStart()
     r := C.V8DispatchLeaveEvent(vm.vmCPtr, C.uint64_t(sessionId), cAddr)
     if r == 2 {
-        fmt.Println(C.GoString(C.V8LastException(vm.vmCPtr)))
+        vm.reportException()
     }
+    captureEvent(CaptureLeave, vm, sessionId, addr, start, int(r))
     return int(r)
 }
 
@@ -349,19 +403,25 @@ func (vm *V8VM) DispatchMessage(sessionId uint64, msg map[interface{}] interface
         return -1
     }
 
-    vm.called += 1
+    atomic.AddInt64(&vm.called, 1)
 
     m := C.V8CreateVMObject(vm.vmCPtr)
     defer func() {
         C.V8DisposeVMValue(m)
     }()
 
+    start := captureStart()
+    traced := traceBegin(vm, C.v8TraceMarshalMessage, sessionId)
     transferGoMap2JsObject(vm, m, msg)
+    if traced {
+        traceEnd(vm, C.v8TraceMarshalMessage)
+    }
 
     r := C.V8DispatchMessageEvent(vm.vmCPtr, C.uint64_t(sessionId), m)
     if r == 2 {
-        fmt.Println(C.GoString(C.V8LastException(vm.vmCPtr)))
+        vm.reportException()
     }
+    captureMessage(vm, sessionId, msg, start, int(r))
 
     return int(r)
 }
@@ -16,13 +16,32 @@
  */
 
 #include "v8bridge.h"
+#include "v8timer.h"
+#include "v8stats.h"
+#include "v8log.h"
+#include "v8loader.h"
+#include "v8bundle.h"
+#include "v8vfs.h"
+#include "v8shared.h"
+#include "v8configtable.h"
+#include "v8trace.h"
+#include "v8platform.h"
 #include "libplatform/libplatform.h"
 #include "v8.h"
+#include "v8-profiler.h"
+#include "v8-inspector.h"
 
 #include <sstream>
+#include <algorithm>
 #include <cassert>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
 #include <map>
-#include <libgen.h>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
 #include <unistd.h>
 #include <string.h>
 
@@ -32,65 +51,104 @@ extern "C" {
 
 using namespace v8;
 
-size_t SplitString(const std::string src, const std::string sp, std::vector<std::string> &strings) {
-    std::istringstream f(src);
-    std::string s;
-    while (getline(f, s, sp.c_str()[0])) {
-        strings.push_back(s);
+/*
+ * 以 referrer 所在目录为基准拼接 specifier, 结果写入 out.
+ * 逐段扫描原始字符, 就地处理 "." / ".." / 空段, 不做分割和中间拷贝.
+ */
+void NormalizeModulePath(const char *specifier, size_t specifierLen,
+                         const char *referrer, size_t referrerLen, std::string &out) {
+    out.clear();
+    out.reserve(referrerLen + specifierLen + 1);
+
+    if (specifierLen == 0 || specifier[0] != '/') {
+        size_t dirLen = referrerLen;
+        while (dirLen > 0 && referrer[dirLen - 1] != '/')
+            dirLen--;
+        if (dirLen == 0) {
+            out.push_back('.');
+        } else {
+            out.append(referrer, dirLen - 1);
+        }
     }
-    return strings.size();
-}
-
-std::string JoinStrings(const std::vector<std::string> &strings, const std::string sp) {
-    auto it = strings.begin();
-    std::string r = "";
-    while (it != strings.end()) {
-        r += *it;
-        it++;
 
-        if (it != strings.end())
-            r += sp;
+    const char *p = specifier;
+    const char *end = specifier + specifierLen;
+    while (p < end) {
+        const char *q = (const char *)memchr(p, '/', end - p);
+        if (q == nullptr)
+            q = end;
+        size_t len = q - p;
+
+        if (len == 0 || (len == 1 && p[0] == '.')) {
+            // 跳过
+        } else if (len == 2 && p[0] == '.' && p[1] == '.') {
+            size_t pos = out.rfind('/');
+            out.resize(pos == std::string::npos ? 0 : pos);
+        } else {
+            out.push_back('/');
+            out.append(p, len);
+        }
+        p = q + 1;
     }
-    return r;
-}
 
-std::string ResolveDirPath(const std::string absPath) {
-    char sz[4096];
-    memcpy(sz, absPath.c_str(), absPath.length() + 1);
-    std::string baseDirPath = dirname(sz);
-    return baseDirPath;
+    if (out.empty())
+        out.push_back('/');
 }
 
-std::string JoinAbsPath(const std::string &relativeFilePath, const std::string &referenceFileAbsPath) {
-    if (relativeFilePath[0] == '/') {
-        return relativeFilePath;
+/*
+ * 进程级模块路径解析缓存, 键为 (referrer 所在目录, specifier).
+ * 同一目录下的模块共享缓存项, 大型依赖图实例化时每条 import 边只需一次查表.
+ */
+class ModuleResolutionCache {
+public:
+    static ModuleResolutionCache &Default() {
+        static ModuleResolutionCache cache;
+        return cache;
     }
 
-    char sz[4096];
-    memcpy(sz, referenceFileAbsPath.c_str(), referenceFileAbsPath.length() + 1);
-    std::string baseDirPath = dirname(sz);
+    void Resolve(const std::string &specifier, const std::string &referrer, std::string &out) {
+        if (!specifier.empty() && specifier[0] == '/') {
+            NormalizeModulePath(specifier.data(), specifier.length(), referrer.data(), referrer.length(), out);
+            return;
+        }
 
-    std::vector<std::string> basePathStmts;
-    SplitString(baseDirPath, "/", basePathStmts);
+        size_t dirLen = referrer.rfind('/');
+        if (dirLen == std::string::npos)
+            dirLen = 0;
+
+        static thread_local std::string key;
+        key.assign(referrer, 0, dirLen);
+        key.push_back('\0');
+        key.append(specifier);
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            auto it = entries.find(key);
+            if (it != entries.end()) {
+                out = it->second;
+                return;
+            }
+        }
 
-    std::vector<std::string> filePathStmts;
-    SplitString(relativeFilePath, "/", filePathStmts);
+        NormalizeModulePath(specifier.data(), specifier.length(), referrer.data(), referrer.length(), out);
 
-    while (!filePathStmts.empty()) {
-        if (filePathStmts[0] == "..") {
-            filePathStmts.erase(filePathStmts.begin());
-            if(!basePathStmts.empty())
-                basePathStmts.pop_back();
-            continue;
-        } else if (filePathStmts[0] == ".") {
-            filePathStmts.erase(filePathStmts.begin());
-            continue;
-        } else {
-            break;
-        }
+        std::lock_guard<std::mutex> lock(mutex);
+        if (entries.size() >= kMaxEntries)
+            entries.clear();
+        entries.emplace(key, out);
     }
 
-    return JoinStrings(basePathStmts, "/") + "/" + JoinStrings(filePathStmts, "/");
+private:
+    static const size_t kMaxEntries = 65536;
+
+    std::mutex mutex;
+    std::unordered_map<std::string, std::string> entries;
+};
+
+std::string JoinAbsPath(const std::string &relativeFilePath, const std::string &referenceFileAbsPath) {
+    std::string out;
+    ModuleResolutionCache::Default().Resolve(relativeFilePath, referenceFileAbsPath, out);
+    return out;
 }
 
 std::string ReadFile(const char *fileName, size_t &s) {
@@ -116,21 +174,136 @@ std::string ReadFile(const char *fileName, size_t &s) {
     return content;
 }
 
+bool WriteFile(const char *fileName, const char *data, size_t len) {
+    FILE *f = fopen(fileName, "w");
+    if (f == nullptr) {
+        return false;
+    }
+
+    bool ok = fwrite(data, 1, len, f) == len;
+    ok = fclose(f) == 0 && ok;
+    return ok;
+}
+
+/*
+ * 追加一个 JSON 字符串(含引号).
+ */
+void AppendJSONString(std::string &out, const char *s) {
+    out += '"';
+    for (; s != nullptr && *s != '\0'; s++) {
+        unsigned char c = (unsigned char)*s;
+        switch (c) {
+        case '"': out += "\\\""; break;
+        case '\\': out += "\\\\"; break;
+        case '\n': out += "\\n"; break;
+        case '\r': out += "\\r"; break;
+        case '\t': out += "\\t"; break;
+        default:
+            if (c < 0x20) {
+                char esc[8];
+                snprintf(esc, sizeof(esc), "\\u%04x", c);
+                out += esc;
+            } else {
+                out += (char)c;
+            }
+        }
+    }
+    out += '"';
+}
 
 /*
  * 逻辑虚拟机, 与一个指定的上下文绑定, 该上下文被显示调用结束虚拟机方法释放之前，将会一直存在。
  */
 
+/*
+ * setTimeout/setInterval 注册的回调, 到期调度由 TimerService 负责.
+ */
+typedef struct _VMTimer {
+    Global<Function> callback;
+    std::vector<Global<Value>> args;
+    bool repeat;
+} VMTimer;
+
+/*
+ * 等待后台加载的动态 import, 同一路径的多次 import() 共享一个加载请求.
+ */
+typedef struct _VMImport {
+    std::string path;
+    std::vector<Global<Promise::Resolver>> resolvers;
+} VMImport;
+
+class V8GoInspector;
+
+/*
+ * 按 (脚本, 行) 统计的异常次数.
+ */
+typedef struct _VMErrorLocation {
+    std::string file;
+    int line;
+    uint64_t count;
+} VMErrorLocation;
+
+/*
+ * 最近一次脚本异常的结构化记录, 首次读取时才生成.
+ */
+typedef struct _VMErrorRecord {
+    bool built;
+    std::string file;
+    int line;
+    int column;
+    std::string message;
+    std::vector<std::string> frames;
+} VMErrorRecord;
+
+struct ConfigAnchor;
+
 typedef struct _VM {
     Isolate *isolate;
     Persistent<Context> context;
     std::string last_exception;
-    std::map<std::string, Eternal<Module>> modules;
-    ArrayBuffer::Allocator *allocator;
+    std::string lastExceptionText;
+    Global<Value> lastExceptionValue;
+    Global<Message> lastExceptionMessage;
+    bool lastExceptionPending;
+    uint64_t lastExceptionCount;
+    VMErrorRecord lastError;
+    std::map<uint64_t, VMErrorLocation> errorLocations;
+    std::unordered_map<std::string, Eternal<Module>> modules;
+    std::unordered_multimap<int, std::string> modulePaths;
     std::map<std::string, bool> resolvings;
-    std::string lastReferrerPath;
     std::string associatedSourceAddr;
     uint64_t associatedSourceId;
+    std::map<uint32_t, VMTimer> timers;
+    std::map<uint32_t, VMImport> imports;
+    std::unordered_map<std::string, uint32_t> importIds;
+    CpuProfiler *cpuProfiler;
+    bool cpuProfiling;
+    V8GoInspector *inspector;
+    std::mutex inspectorMutex;
+    std::atomic<bool> inspectorPending;
+    HandlerStats stats;
+    LatencyHistogram gcPauses;
+    uint64_t gcStart;
+    LogRing *logRing;
+    Global<ObjectTemplate> configTemplate;
+    Global<FunctionTemplate> configArrayTemplate;
+    std::unordered_map<const ConfigTable *, ConfigAnchor *> configAnchors;
+    const char *messageData;
+    size_t messageLength;
+    uint32_t messageGeneration;
+    Global<FunctionTemplate> messageTemplate;
+    Global<Object> messageArrayPrototype;
+    V8BroadcastStats broadcastStats;
+    bool coalesceSends;
+    int dispatchDepth;
+    bool outboundPending;
+    V8OutboundStats outboundStats;
+    bool sendMuted;
+    std::vector<uint32_t> keptTimers;
+    std::vector<uint32_t> keptImports;
+    bool tracingTierUp;
+    uint64_t optimizedCount;
+    std::vector<std::string> optimizedFunctions;
 } VM;
 
 
@@ -143,10 +316,27 @@ typedef struct _V8StringArrays {
     std::vector<std::string> strs;
 } V8StringArrays;
 
+typedef struct _V8ErrorLocations {
+    std::vector<std::string> files;
+    std::vector<V8ErrorLocation> items;
+} V8ErrorLocations;
+
+typedef struct _V8HeapSummary {
+    std::vector<std::string> names;
+    std::vector<V8HeapSummaryItem> items;
+} V8HeapSummary;
+
 typedef struct _VMValue {
     Persistent<Value> value;
     unsigned int kind;
 } VMValue;
+/*
+ * 转换V8的Utf8Value到一个C风格字符串指针
+ */
+const char *V8ToCString(const String::Utf8Value &value) {
+    return *value ? *value : "<string conversion failed>";
+}
+
 /*
  * 默认输出回调，直接输出到stdout, 但它未能支持格式化字符.
  */
@@ -188,11 +378,91 @@ int stdOutputCallback(const char *tag, FunctionCallbackInfoPtr argsPtr) {
     return 0;
 }
 
+/*
+ * 异步输出回调, 执行线程只复制参数文本写入虚拟机的环形缓冲区,
+ * 时间戳格式化与交给 Go 由 LogService 的刷新线程批量完成.
+ */
+int asyncOutputCallback(const char *tag, FunctionCallbackInfoPtr argsPtr) {
+    auto args = static_cast<const FunctionCallbackInfo<Value> *>(argsPtr);
+    auto vmPtr = static_cast<VMPtr>(args->GetIsolate()->GetData(0));
+    if (vmPtr == nullptr) {
+        return stdOutputCallback(tag, argsPtr);
+    }
+
+    if (vmPtr->logRing == nullptr) {
+        vmPtr->logRing = LogService::Default().Attach();
+    }
+
+    time_t now = time(nullptr);
+    if (!vmPtr->logRing->Admit(now)) {
+        return 0;
+    }
+
+    int startIndex = strcmp(tag, "A") != 0 ? 0 : 1;
+    std::string o;
+    for (int i = startIndex; i < args->Length(); i++) {
+        if (i != startIndex) {
+            o += " ";
+        }
+        String::Utf8Value str(args->GetIsolate(), (*args)[i]);
+        o += V8ToCString(str);
+    }
+
+    vmPtr->logRing->Push(tag[0], now, std::move(o));
+    return 0;
+}
+
+void V8OutputBatch(const char *data, size_t len) {
+#ifdef GOOUTPUT
+    GoOutputBatch((char *)data, (int)len);
+#else
+    size_t pos = 0;
+    while (pos + 4 <= len) {
+        const uint8_t *p = (const uint8_t *)data + pos;
+        size_t n = p[0] | (p[1] << 8) | (p[2] << 16) | ((size_t)p[3] << 24);
+        if (n > len - pos - 4)
+            break;
+        fwrite(data + pos + 4, 1, n, stdout);
+        fputc('\n', stdout);
+        pos += 4 + n;
+    }
+    fflush(stdout);
+#endif
+}
+
 /*
  * 初始化输出回调为默认
  */
 OutputCallback outputCallback = stdOutputCallback;
 
+/*
+ * 切换到异步批量输出. capacity 为每个虚拟机缓冲的日志条数, maxPerSecond 为每个虚拟机每秒最多条数(0 不限).
+ */
+void V8EnableAsyncOutput(size_t capacity, uint32_t maxPerSecond, uint32_t flushIntervalMs) {
+    LogService::Default().Configure(capacity, maxPerSecond, flushIntervalMs, V8OutputBatch);
+    outputCallback = asyncOutputCallback;
+}
+
+void V8FlushOutput() {
+    LogService::Default().Flush();
+}
+
+/*
+ * 获取日志计数, vmPtr 为空时返回全进程汇总.
+ */
+void V8GetOutputStats(VMPtr vmPtr, V8OutputStats *stats) {
+    LogCounters counters;
+    memset(&counters, 0, sizeof(counters));
+    if (vmPtr == nullptr) {
+        LogService::Default().Counters(nullptr, &counters);
+    } else if (vmPtr->logRing != nullptr) {
+        LogService::Default().Counters(vmPtr->logRing, &counters);
+    }
+    stats->written = counters.written;
+    stats->dropped = counters.dropped;
+    stats->rateLimited = counters.rateLimited;
+}
+
 size_t V8GetStringArraysLength(V8StringArraysPtr v8StringArraysPtr) {
     return v8StringArraysPtr->strs.size();
 }
@@ -236,35 +506,26 @@ void consoleWarn(const FunctionCallbackInfo<Value> &args) {
     outputCallback("W", &args);
 }
 
-/*
- * 转换V8的Utf8Value到一个C风格字符串指针
- */
-const char *V8ToCString(const String::Utf8Value &value) {
-    return *value ? *value : "<string conversion failed>";
-}
-
 /*
  * 构造V8引擎异常捕获的格式化字符串
  */
-std::string V8ExceptionString(VMPtr vmPtr, TryCatch *try_catch) {
+std::string V8FormatException(VMPtr vmPtr, Local<Value> exceptionValue, Local<Message> message) {
     std::string out;
     size_t scratchSize = 20;
     char scratch[scratchSize];
 
     HandleScope handle_scope(vmPtr->isolate);
     Local<Context> context = Local<Context>::New(vmPtr->isolate, vmPtr->context);
-    String::Utf8Value exception(vmPtr->isolate, try_catch->Exception());
+    String::Utf8Value exception(vmPtr->isolate, exceptionValue);
     const char *exception_string = V8ToCString(exception);
 
-    Handle<Message> message = try_catch->Message();
-
     if (message.IsEmpty()) {
         out.append(exception_string);
         out.append("\n");
     } else {
         String::Utf8Value filename(vmPtr->isolate, message->GetScriptOrigin().ResourceName());
         const char *filename_string = V8ToCString(filename);
-        int linenum = message->GetLineNumber(context).ToChecked();
+        int linenum = message->GetLineNumber(context).FromMaybe(0);
 
         snprintf(scratch, scratchSize, "%i", linenum);
         out.append(filename_string);
@@ -272,25 +533,31 @@ std::string V8ExceptionString(VMPtr vmPtr, TryCatch *try_catch) {
         out.append(scratch);
         out.append("\n");
 
-        String::Utf8Value sourceline(vmPtr->isolate, message->GetSourceLine(context).ToLocalChecked());
-        const char *sourceline_string = V8ToCString(sourceline);
+        Local<String> sourceLine;
+        if (message->GetSourceLine(context).ToLocal(&sourceLine)) {
+            String::Utf8Value sourceline(vmPtr->isolate, sourceLine);
+            const char *sourceline_string = V8ToCString(sourceline);
 
-        out.append(sourceline_string);
-        out.append("\n");
+            out.append(sourceline_string);
+            out.append("\n");
+        }
 
-        int start = message->GetStartColumn(context).FromJust();
+        int start = message->GetStartColumn(context).FromMaybe(0);
         for (int i = 0; i < start; i++) {
             out.append(" ");
         }
-        int end = message->GetEndColumn(context).FromJust();
+        int end = message->GetEndColumn(context).FromMaybe(start);
         for (int i = start; i < end; i++) {
             out.append("^");
         }
         out.append("\n");
-        String::Utf8Value stack_trace(vmPtr->isolate, try_catch->StackTrace(context).ToLocalChecked());
-        if (stack_trace.length() > 0) {
-            const char *stack_trace_string = V8ToCString(stack_trace);
-            out.append(stack_trace_string);
+
+        Local<Value> stack;
+        if (exceptionValue->IsObject() &&
+            exceptionValue.As<Object>()->Get(context, String::NewFromUtf8(vmPtr->isolate, "stack").ToLocalChecked()).ToLocal(&stack) &&
+            stack->IsString()) {
+            String::Utf8Value stack_trace(vmPtr->isolate, stack);
+            out.append(V8ToCString(stack_trace));
             out.append("\n");
         } else {
             out.append(exception_string);
@@ -300,6 +567,120 @@ std::string V8ExceptionString(VMPtr vmPtr, TryCatch *try_catch) {
     return out;
 }
 
+/*
+ * 捕获异常时只保留异常值与 Message 句柄, 并按 (脚本, 行) 计数,
+ * 格式化推迟到 V8LastException / V8GetLastError 被调用时.
+ */
+void V8CaptureException(VMPtr vmPtr, TryCatch *try_catch) {
+    Isolate *isolate = vmPtr->isolate;
+    HandleScope handle_scope(isolate);
+    Local<Context> context = Local<Context>::New(isolate, vmPtr->context);
+
+    vmPtr->last_exception.clear();
+    vmPtr->lastExceptionText.clear();
+    vmPtr->lastError.built = false;
+    vmPtr->lastExceptionPending = true;
+    vmPtr->lastExceptionCount = 1;
+
+    vmPtr->lastExceptionValue.Reset(isolate, try_catch->Exception());
+    Local<Message> message = try_catch->Message();
+    if (message.IsEmpty()) {
+        vmPtr->lastExceptionMessage.Reset();
+        return;
+    }
+    vmPtr->lastExceptionMessage.Reset(isolate, message);
+
+    int line = message->GetLineNumber(context).FromMaybe(0);
+    uint64_t key = ((uint64_t)(uint32_t)message->GetScriptOrigin().ScriptID()->Value() << 32) | (uint32_t)line;
+    auto it = vmPtr->errorLocations.find(key);
+    if (it == vmPtr->errorLocations.end()) {
+        if (vmPtr->errorLocations.size() >= 4096) {
+            return;
+        }
+        String::Utf8Value filename(isolate, message->GetScriptOrigin().ResourceName());
+        VMErrorLocation location;
+        location.file = V8ToCString(filename);
+        location.line = line;
+        location.count = 0;
+        it = vmPtr->errorLocations.insert(std::make_pair(key, location)).first;
+    }
+    it->second.count++;
+    vmPtr->lastExceptionCount = it->second.count;
+}
+
+/*
+ * 由保留的句柄生成结构化异常记录.
+ */
+void V8BuildLastError(VMPtr vmPtr) {
+    VMErrorRecord &record = vmPtr->lastError;
+    if (record.built) {
+        return;
+    }
+
+    Isolate *isolate = vmPtr->isolate;
+    Locker locker(isolate);
+    Isolate::Scope isolate_scope(isolate);
+    HandleScope handle_scope(isolate);
+    Local<Context> context = Local<Context>::New(isolate, vmPtr->context);
+    Context::Scope context_scope(context);
+
+    record.built = true;
+    record.file.clear();
+    record.line = 0;
+    record.column = 0;
+    record.frames.clear();
+
+    Local<Value> exception = vmPtr->lastExceptionValue.Get(isolate);
+    Local<Message> message = vmPtr->lastExceptionMessage.Get(isolate);
+
+    if (message.IsEmpty()) {
+        String::Utf8Value text(isolate, exception);
+        record.message = V8ToCString(text);
+        return;
+    }
+
+    String::Utf8Value text(isolate, message->Get());
+    record.message = V8ToCString(text);
+    String::Utf8Value filename(isolate, message->GetScriptOrigin().ResourceName());
+    record.file = V8ToCString(filename);
+    record.line = message->GetLineNumber(context).FromMaybe(0);
+    record.column = message->GetStartColumn(context).FromMaybe(0);
+
+    Local<StackTrace> trace = message->GetStackTrace();
+    if (!trace.IsEmpty()) {
+        for (int i = 0; i < trace->GetFrameCount(); i++) {
+            Local<StackFrame> frame = trace->GetFrame(isolate, i);
+            String::Utf8Value fn(isolate, frame->GetFunctionName());
+            String::Utf8Value script(isolate, frame->GetScriptName());
+            char scratch[32];
+            snprintf(scratch, sizeof(scratch), ":%d:%d)", frame->GetLineNumber(), frame->GetColumn());
+
+            std::string f = *fn != nullptr && fn.length() > 0 ? *fn : "<anonymous>";
+            f += " (";
+            f += *script != nullptr ? *script : "";
+            f += scratch;
+            record.frames.push_back(f);
+        }
+        return;
+    }
+
+    // 没有详细调用栈时从 error.stack 中取 "    at ..." 行
+    Local<Value> stack;
+    if (exception->IsObject() &&
+        exception.As<Object>()->Get(context, String::NewFromUtf8(isolate, "stack").ToLocalChecked()).ToLocal(&stack) &&
+        stack->IsString()) {
+        String::Utf8Value stackStr(isolate, stack);
+        std::istringstream lines(V8ToCString(stackStr));
+        std::string l;
+        while (getline(lines, l)) {
+            size_t pos = l.find("at ");
+            if (pos != std::string::npos && l.find_first_not_of(' ') == pos) {
+                record.frames.push_back(l.substr(pos + 3));
+            }
+        }
+    }
+}
+
 const char * V8Version() {
     return V8::GetVersion();
 }
@@ -308,751 +689,3580 @@ void v8goVersion(const FunctionCallbackInfo<Value> &args) {
     args.GetReturnValue().Set(String::NewFromUtf8(args.GetIsolate(), V8Version()).ToLocalChecked());
 }
 
-void v8goSend(const FunctionCallbackInfo<Value> &args) {
-    int sentLen = -1;
-    if (args.Length() == 0) {
-        args.GetReturnValue().Set(sentLen);
-        return;
-    }
-    auto vmPtr = static_cast<VMPtr>(args.GetIsolate()->GetData(0));
-    if (vmPtr == nullptr) {
-        args.GetReturnValue().Set(sentLen);
+/*
+ * 一次性把缓冲的消息交给 Go. 消息在发送时已转换为 Go 值并缓冲在 Go 侧, 这里只通知刷出.
+ */
+void V8FlushOutbound(VMPtr vmPtr) {
+    if (!vmPtr->outboundPending)
         return;
-    }
 
-    if (args.Length() == 1) {
-        auto vmValue = new VMValue;
-        vmValue->value.Reset(args.GetIsolate(), args[0]);
-        vmValue->kind = v8KindObject;
-        if (args[0]->IsArray())
-            vmValue->kind |= v8KindArray;
+    vmPtr->outboundPending = false;
+    vmPtr->outboundStats.batches++;
 #ifdef GOOUTPUT
-        sentLen = GoSend(vmPtr, vmValue);
+    TraceSpan span(kTraceMarshal, "SendBatch", vmPtr);
+    GoFlushSends(vmPtr);
 #endif
-        V8DisposeVMValue(vmValue);
+}
+
+/*
+ * 派发期间的作用域, 最外层退出时刷出合并的消息.
+ */
+class OutboundScope {
+public:
+    explicit OutboundScope(VMPtr vmPtr) : vmPtr(vmPtr) {
+        vmPtr->dispatchDepth++;
     }
 
-    args.GetReturnValue().Set(sentLen);
-}
+    ~OutboundScope() {
+        if (--vmPtr->dispatchDepth == 0)
+            V8FlushOutbound(vmPtr);
+    }
 
-void v8goSendTo(const FunctionCallbackInfo<Value> &args) {
+private:
+    VMPtr vmPtr;
+};
+
+/*
+ * net.sendCurrentPlayer/sendToOtherPlayer 公共实现. 合并模式下派发期间只入缓冲,
+ * 第二个参数为合并键, 同一次派发中相同键的消息只发送最后一条.
+ * 入缓冲时立即转换为 Go 值, 之后脚本修改同一对象不影响已发送的内容.
+ */
+void v8goSendMessage(const FunctionCallbackInfo<Value> &args, bool to) {
     int sentLen = -1;
-    if (args.Length() == 0) {
+    if (args.Length() == 0 || args.Length() > 2) {
         args.GetReturnValue().Set(sentLen);
         return;
     }
-    auto vmPtr = static_cast<VMPtr>(args.GetIsolate()->GetData(0));
+    auto isolate = args.GetIsolate();
+    auto vmPtr = static_cast<VMPtr>(isolate->GetData(0));
     if (vmPtr == nullptr) {
         args.GetReturnValue().Set(sentLen);
         return;
     }
+    if (vmPtr->sendMuted) {
+        args.GetReturnValue().Set(0);
+        return;
+    }
 
-    if (args.Length() == 1) {
-        auto vmValue = new VMValue;
-        vmValue->value.Reset(args.GetIsolate(), args[0]);
-        vmValue->kind = v8KindObject;
-        if (args[0]->IsArray())
-            vmValue->kind |= v8KindArray;
+    auto vmValue = new VMValue;
+    vmValue->value.Reset(isolate, args[0]);
+    vmValue->kind = v8KindObject;
+    if (args[0]->IsArray())
+        vmValue->kind |= v8KindArray;
+
+    if (vmPtr->coalesceSends && vmPtr->dispatchDepth > 0) {
+        vmPtr->outboundStats.queued++;
+        vmPtr->outboundPending = true;
+        std::string mergeKey;
+        bool keyed = args.Length() == 2 && !args[1]->IsUndefined();
+        if (keyed) {
+            String::Utf8Value key(isolate, args[1]);
+            mergeKey.assign(to ? "t" : "c");
+            mergeKey.append(*key ? *key : "", key.length());
+        }
 #ifdef GOOUTPUT
-        sentLen = GoSendTo(vmPtr, vmValue);
+        {
+            TraceSpan span(kTraceMarshal, to ? "QueueSendTo" : "QueueSend", vmPtr);
+            if (GoQueueSend(vmPtr, vmValue, to, keyed ? (char *)mergeKey.data() : nullptr, (int)mergeKey.length()) != 0)
+                vmPtr->outboundStats.merged++;
+        }
 #endif
         V8DisposeVMValue(vmValue);
+        args.GetReturnValue().Set(0);
+        return;
+    }
+
+#ifdef GOOUTPUT
+    {
+        TraceSpan span(kTraceMarshal, to ? "SendTo" : "Send", vmPtr);
+        sentLen = to ? GoSendTo(vmPtr, vmValue) : GoSend(vmPtr, vmValue);
     }
+#endif
+    V8DisposeVMValue(vmValue);
 
     args.GetReturnValue().Set(sentLen);
 }
 
-int V8DispatchEnterEvent(VMPtr vmPtr, uint64_t sessionId, const char *addr) {
-    Locker locker(vmPtr->isolate);
-    HandleScope handle_scope(vmPtr->isolate);
-    TryCatch try_catch(vmPtr->isolate);
-    Local<Context> context = Local<Context>::New(vmPtr->isolate, vmPtr->context);
-    Context::Scope context_scope(context);
-    auto global = context->Global();
+void v8goSend(const FunctionCallbackInfo<Value> &args) {
+    v8goSendMessage(args, false);
+}
 
-    MaybeLocal<Value> maybeEnterVal = global->Get(context, String::NewFromUtf8(vmPtr->isolate, "enter").ToLocalChecked());
-    if (maybeEnterVal.IsEmpty()) {
-        std::string out = "'enter' not found\n";
-        vmPtr->last_exception = out;
-        return 2;
-    }
-    Local<Value> enterVal = maybeEnterVal.ToLocalChecked();
-    if(!enterVal->IsFunction()) {
-        std::string out = "'enter' found, but it's not a function\n";
-        vmPtr->last_exception = out;
-        return 2;
-    }
+void v8goSendTo(const FunctionCallbackInfo<Value> &args) {
+    v8goSendMessage(args, true);
+}
 
-    Local<Function> enter = Local<Function>::Cast(enterVal);
-    if (!enter->IsCallable()) {
-        std::string out = "'enter' found, but it's not a callable\n";
-        vmPtr->last_exception = out;
-        return 2;
+/*
+ * 开启或关闭合并发送, 关闭时不影响已缓冲的消息.
+ */
+void V8SetSendCoalescing(VMPtr vmPtr, bool enabled) {
+    vmPtr->coalesceSends = enabled;
+}
+
+void V8GetOutboundStats(VMPtr vmPtr, V8OutboundStats *stats) {
+    *stats = vmPtr->outboundStats;
+}
+
+/*
+ * 虚拟机间的结构化克隆消息. 发送端用 ValueSerializer 序列化一次, 接收端用 ValueDeserializer 还原,
+ * Go 只负责按 target 路由信封. transfer 列表中的 ArrayBuffer 在发送端被 detach,
+ * 其内存直接交给接收端而不复制; SharedArrayBuffer 在两端共享同一块内存.
+ * 信封只读并带引用计数; 含 transfer 的信封只能被还原一次.
+ */
+struct _V8Envelope {
+    uint8_t *data;
+    size_t length;
+    std::vector<std::shared_ptr<BackingStore>> transfers;
+    std::vector<std::shared_ptr<BackingStore>> shared;
+    std::atomic<int> refs;
+    std::atomic<bool> consumed;
+
+    _V8Envelope() : data(nullptr), length(0), refs(1), consumed(false) {}
+    ~_V8Envelope() { free(data); }
+};
+
+class EnvelopeSerializerDelegate : public ValueSerializer::Delegate {
+public:
+    EnvelopeSerializerDelegate(Isolate *isolate, V8EnvelopePtr envelope) : isolate(isolate), envelope(envelope) {}
+
+    void ThrowDataCloneError(Local<String> message) override {
+        isolate->ThrowException(Exception::Error(message));
     }
 
-    Local<Value> args[2];
-    args[0] = BigInt::NewFromUnsigned(vmPtr->isolate, sessionId);
-    args[1] = String::NewFromUtf8(vmPtr->isolate, addr).ToLocalChecked();
-    MaybeLocal<Value> result = enter->CallAsFunction(context, Undefined(vmPtr->isolate), 2, args);
-    if(result.IsEmpty()) {
-        assert(try_catch.HasCaught());
-        vmPtr->last_exception = V8ExceptionString(vmPtr, &try_catch);
-        return 2;
+    Maybe<uint32_t> GetSharedArrayBufferId(Isolate *isolate, Local<SharedArrayBuffer> buffer) override {
+        auto store = buffer->GetBackingStore();
+        for (size_t i = 0; i < envelope->shared.size(); i++) {
+            if (envelope->shared[i].get() == store.get())
+                return Just<uint32_t>(i);
+        }
+        envelope->shared.push_back(store);
+        return Just<uint32_t>(envelope->shared.size() - 1);
     }
-    return result.ToLocalChecked()->Uint32Value(context).FromMaybe(-1);
-}
 
+private:
+    Isolate *isolate;
+    V8EnvelopePtr envelope;
+};
 
-int V8DispatchLeaveEvent(VMPtr vmPtr, uint64_t sessionId, const char *addr) {
-    Locker locker(vmPtr->isolate);
-    HandleScope handle_scope(vmPtr->isolate);
-    TryCatch try_catch(vmPtr->isolate);
-    Local<Context> context = Local<Context>::New(vmPtr->isolate, vmPtr->context);
-    Context::Scope context_scope(context);
-    auto global = context->Global();
+class EnvelopeDeserializerDelegate : public ValueDeserializer::Delegate {
+public:
+    explicit EnvelopeDeserializerDelegate(V8EnvelopePtr envelope) : envelope(envelope) {}
 
-    MaybeLocal<Value> maybeEnterVal = global->Get(context, String::NewFromUtf8(vmPtr->isolate, "leave").ToLocalChecked());
-    if (maybeEnterVal.IsEmpty()) {
-        std::string out = "'leave' not found\n";
-        vmPtr->last_exception = out;
-        return 2;
-    }
-    Local<Value> enterVal = maybeEnterVal.ToLocalChecked();
-    if(!enterVal->IsFunction()) {
-        std::string out = "'leave' found, but it's not a function\n";
-        vmPtr->last_exception = out;
-        return 2;
+    MaybeLocal<SharedArrayBuffer> GetSharedArrayBufferFromId(Isolate *isolate, uint32_t id) override {
+        if (id >= envelope->shared.size()) {
+            isolate->ThrowException(Exception::Error(String::NewFromUtf8(isolate, "Invalid SharedArrayBuffer id").ToLocalChecked()));
+            return MaybeLocal<SharedArrayBuffer>();
+        }
+        return SharedArrayBuffer::New(isolate, envelope->shared[id]);
     }
 
-    Local<Function> enter = Local<Function>::Cast(enterVal);
-    if (!enter->IsCallable()) {
-        std::string out = "'leave' found, but it's not a callable\n";
-        vmPtr->last_exception = out;
-        return 2;
-    }
+private:
+    V8EnvelopePtr envelope;
+};
 
-    Local<Value> args[2];
-    args[0] = BigInt::NewFromUnsigned(vmPtr->isolate, sessionId);
-    args[1] = String::NewFromUtf8(vmPtr->isolate, addr).ToLocalChecked();
-    MaybeLocal<Value> result = enter->CallAsFunction(context, Undefined(vmPtr->isolate), 2, args);
-    if(result.IsEmpty()) {
-        assert(try_catch.HasCaught());
-        vmPtr->last_exception = V8ExceptionString(vmPtr, &try_catch);
-        return 2;
+/*
+ * 序列化 value, 失败时已在 isolate 上抛出异常并返回 nullptr.
+ * transferList 可为 undefined 或 ArrayBuffer 数组.
+ */
+V8EnvelopePtr V8SerializeEnvelope(Isolate *isolate, Local<Context> context, Local<Value> value, Local<Value> transferList) {
+    std::vector<Local<ArrayBuffer>> transfers;
+    if (!transferList.IsEmpty() && !transferList->IsUndefined()) {
+        if (!transferList->IsArray()) {
+            isolate->ThrowException(Exception::TypeError(String::NewFromUtf8(isolate, "Transfer list must be an array").ToLocalChecked()));
+            return nullptr;
+        }
+        Local<Array> list = transferList.As<Array>();
+        for (uint32_t i = 0; i < list->Length(); i++) {
+            Local<Value> item;
+            if (!list->Get(context, i).ToLocal(&item))
+                return nullptr;
+            if (!item->IsArrayBuffer() || !item.As<ArrayBuffer>()->IsDetachable()) {
+                isolate->ThrowException(Exception::TypeError(String::NewFromUtf8(isolate, "Transfer list may only contain detachable ArrayBuffers").ToLocalChecked()));
+                return nullptr;
+            }
+            for (auto &t : transfers) {
+                if (t == item) {
+                    isolate->ThrowException(Exception::TypeError(String::NewFromUtf8(isolate, "ArrayBuffer appears more than once in transfer list").ToLocalChecked()));
+                    return nullptr;
+                }
+            }
+            transfers.push_back(item.As<ArrayBuffer>());
+        }
     }
-    return result.ToLocalChecked()->Uint32Value(context).FromMaybe(-1);
+
+    std::unique_ptr<_V8Envelope> envelope(new _V8Envelope);
+    EnvelopeSerializerDelegate delegate(isolate, envelope.get());
+    ValueSerializer serializer(isolate, &delegate);
+    serializer.WriteHeader();
+    for (size_t i = 0; i < transfers.size(); i++) {
+        serializer.TransferArrayBuffer(i, transfers[i]);
+    }
+    if (!serializer.WriteValue(context, value).FromMaybe(false))
+        return nullptr;
+
+    for (auto &t : transfers) {
+        envelope->transfers.push_back(t->GetBackingStore());
+        t->Detach();
+    }
+    auto buffer = serializer.Release();
+    envelope->data = buffer.first;
+    envelope->length = buffer.second;
+    return envelope.release();
 }
 
+V8EnvelopePtr V8RetainEnvelope(V8EnvelopePtr envelope) {
+    envelope->refs.fetch_add(1, std::memory_order_relaxed);
+    return envelope;
+}
 
-int V8DispatchMessageEvent(VMPtr vmPtr, uint64_t sessionId, VMValuePtr vmValuePtr) {
-    Locker locker(vmPtr->isolate);
-    HandleScope handle_scope(vmPtr->isolate);
-    TryCatch try_catch(vmPtr->isolate);
-    Local<Context> context = Local<Context>::New(vmPtr->isolate, vmPtr->context);
-    Context::Scope context_scope(context);
-    auto global = context->Global();
+void V8ReleaseEnvelope(V8EnvelopePtr envelope) {
+    if (envelope != nullptr && envelope->refs.fetch_sub(1, std::memory_order_acq_rel) == 1)
+        delete envelope;
+}
 
-    MaybeLocal<Value> maybeEnterVal = global->Get(context, String::NewFromUtf8(vmPtr->isolate, "message").ToLocalChecked());
-    if (maybeEnterVal.IsEmpty()) {
-        std::string out = "'message' not found\n";
-        vmPtr->last_exception = out;
-        return 2;
+size_t V8EnvelopeLength(V8EnvelopePtr envelope) {
+    return envelope->length;
+}
+
+/*
+ * net.postMessage(target, value[, transferList]), target 为数字或 BigInt, 由 Go 决定投递到哪个虚拟机.
+ * 信封在 Go 侧入队后异步投递, 返回 0 表示已入队, -1 表示没有投递回调.
+ */
+void v8goPostMessage(const FunctionCallbackInfo<Value> &args) {
+    auto isolate = args.GetIsolate();
+    auto vmPtr = static_cast<VMPtr>(isolate->GetData(0));
+    if (vmPtr == nullptr || args.Length() < 2) {
+        args.GetReturnValue().Set(-1);
+        return;
     }
-    Local<Value> enterVal = maybeEnterVal.ToLocalChecked();
-    if(!enterVal->IsFunction()) {
-        std::string out = "'message' found, but it's not a function\n";
-        vmPtr->last_exception = out;
-        return 2;
+    if (vmPtr->sendMuted) {
+        args.GetReturnValue().Set(0);
+        return;
     }
 
-    Local<Function> enter = Local<Function>::Cast(enterVal);
-    if (!enter->IsCallable()) {
-        std::string out = "'message' found, but it's not a callable\n";
-        vmPtr->last_exception = out;
-        return 2;
+    auto context = isolate->GetCurrentContext();
+    uint64_t target;
+    if (args[0]->IsBigInt()) {
+        target = args[0].As<BigInt>()->Uint64Value();
+    } else if (args[0]->IsNumber()) {
+        target = (uint64_t)args[0]->IntegerValue(context).FromMaybe(0);
+    } else {
+        isolate->ThrowException(Exception::TypeError(String::NewFromUtf8(isolate, "Target must be a number or BigInt").ToLocalChecked()));
+        return;
     }
 
-    Local<Value> args[2];
-    args[0] = BigInt::NewFromUnsigned(vmPtr->isolate, sessionId);
-    args[1] = vmValuePtr->value.Get(vmPtr->isolate);
-    MaybeLocal<Value> result = enter->CallAsFunction(context, Undefined(vmPtr->isolate), 2, args);
-    if(result.IsEmpty()) {
-        assert(try_catch.HasCaught());
-        vmPtr->last_exception = V8ExceptionString(vmPtr, &try_catch);
-        return 2;
+    V8EnvelopePtr envelope = V8SerializeEnvelope(isolate, context, args[1], args.Length() > 2 ? args[2] : Local<Value>());
+    if (envelope == nullptr)
+        return;
+
+    int sent = -1;
+#ifdef GOOUTPUT
+    sent = GoPostMessage(vmPtr, target, envelope);
+#endif
+    V8ReleaseEnvelope(envelope);
+    args.GetReturnValue().Set(sent);
+}
+
+/*
+ * 广播计数, 虚拟机与全进程汇总都在 broadcastMutex 下更新.
+ */
+std::mutex broadcastMutex;
+V8BroadcastStats broadcastTotals;
+
+void V8RecordBroadcast(V8BroadcastStats *stats, size_t targets, size_t bytes, uint64_t ns) {
+    stats->broadcasts++;
+    stats->targets += targets;
+    stats->bytes += bytes;
+    stats->serializeNs += ns;
+    if (targets > stats->maxFanout)
+        stats->maxFanout = targets;
+    if (ns > stats->serializeMaxNs)
+        stats->serializeMaxNs = ns;
+}
+
+/*
+ * 获取广播计数, vmPtr 为空时返回全进程汇总.
+ */
+void V8GetBroadcastStats(VMPtr vmPtr, V8BroadcastStats *stats) {
+    std::lock_guard<std::mutex> lock(broadcastMutex);
+    *stats = vmPtr == nullptr ? broadcastTotals : vmPtr->broadcastStats;
+}
+
+/*
+ * net.broadcast(targets, value): value 只序列化一次, 目标列表与共享信封一起交给 Go 做扇出.
+ */
+void v8goBroadcast(const FunctionCallbackInfo<Value> &args) {
+    auto isolate = args.GetIsolate();
+    auto vmPtr = static_cast<VMPtr>(isolate->GetData(0));
+    if (vmPtr == nullptr || args.Length() < 2) {
+        args.GetReturnValue().Set(-1);
+        return;
     }
-    return result.ToLocalChecked()->Uint32Value(context).FromMaybe(-1);
+    if (vmPtr->sendMuted) {
+        args.GetReturnValue().Set(0);
+        return;
+    }
+    if (!args[0]->IsArray()) {
+        isolate->ThrowException(Exception::TypeError(String::NewFromUtf8(isolate, "Targets must be an array").ToLocalChecked()));
+        return;
+    }
+
+    auto context = isolate->GetCurrentContext();
+    Local<Array> list = args[0].As<Array>();
+    std::vector<uint64_t> targets;
+    targets.reserve(list->Length());
+    for (uint32_t i = 0; i < list->Length(); i++) {
+        Local<Value> item;
+        if (!list->Get(context, i).ToLocal(&item))
+            return;
+        if (item->IsBigInt()) {
+            targets.push_back(item.As<BigInt>()->Uint64Value());
+        } else if (item->IsNumber()) {
+            targets.push_back((uint64_t)item->IntegerValue(context).FromMaybe(0));
+        } else {
+            isolate->ThrowException(Exception::TypeError(String::NewFromUtf8(isolate, "Target must be a number or BigInt").ToLocalChecked()));
+            return;
+        }
+    }
+    if (targets.empty()) {
+        args.GetReturnValue().Set(0);
+        return;
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    V8EnvelopePtr envelope = V8SerializeEnvelope(isolate, context, args[1], Local<Value>());
+    if (envelope == nullptr)
+        return;
+    uint64_t ns = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+
+    {
+        std::lock_guard<std::mutex> lock(broadcastMutex);
+        V8RecordBroadcast(&vmPtr->broadcastStats, targets.size(), envelope->length, ns);
+        V8RecordBroadcast(&broadcastTotals, targets.size(), envelope->length, ns);
+    }
+
+    int sent = -1;
+#ifdef GOOUTPUT
+    sent = GoBroadcast(vmPtr, targets.data(), targets.size(), envelope);
+#endif
+    V8ReleaseEnvelope(envelope);
+    args.GetReturnValue().Set(sent);
 }
 
-VMValuePtr V8CreateVMObject(VMPtr vmPtr) {
-    Locker locker(vmPtr->isolate);
-    HandleScope handle_scope(vmPtr->isolate);
-    TryCatch try_catch(vmPtr->isolate);
-    Local<Context> context = Local<Context>::New(vmPtr->isolate, vmPtr->context);
-    Context::Scope context_scope(context);
+/*
+ * setTimeout/setInterval 公共实现, 返回定时器 id.
+ */
+void v8goSetTimer(const FunctionCallbackInfo<Value> &args, bool repeat) {
+    auto isolate = args.GetIsolate();
+    auto vmPtr = static_cast<VMPtr>(isolate->GetData(0));
+    if (vmPtr == nullptr) {
+        args.GetReturnValue().Set(-1);
+        return;
+    }
 
-    Local<Object> o = ObjectTemplate::New(vmPtr->isolate)->NewInstance(context).ToLocalChecked();
-    VMValuePtr vmValuePtr = new VMValue;
-    vmValuePtr->value.Reset(vmPtr->isolate, o);
-    vmValuePtr->kind = v8KindObject;
-    return vmValuePtr;
+    if (args.Length() == 0 || !args[0]->IsFunction()) {
+        isolate->ThrowException(Exception::TypeError(
+                String::NewFromUtf8(isolate, "The \"callback\" argument must be of type function").ToLocalChecked()));
+        return;
+    }
+
+    double delay = 0;
+    if (args.Length() > 1) {
+        delay = args[1]->NumberValue(isolate->GetCurrentContext()).FromMaybe(0);
+        if (!(delay > 0))
+            delay = 0;
+    }
+
+    uint32_t id = TimerService::Default().Schedule(vmPtr, (uint64_t)delay, repeat);
+
+    VMTimer &timer = vmPtr->timers[id];
+    timer.callback.Reset(isolate, Local<Function>::Cast(args[0]));
+    timer.repeat = repeat;
+    for (int i = 2; i < args.Length(); i++) {
+        timer.args.emplace_back(isolate, args[i]);
+    }
+
+    args.GetReturnValue().Set(id);
 }
 
-VMValuePtr V8CreateVMArray(VMPtr vmPtr, int length) {
-    Locker locker(vmPtr->isolate);
-    HandleScope handle_scope(vmPtr->isolate);
-    TryCatch try_catch(vmPtr->isolate);
-    Local<Context> context = Local<Context>::New(vmPtr->isolate, vmPtr->context);
-    Context::Scope context_scope(context);
+void v8goSetTimeout(const FunctionCallbackInfo<Value> &args) {
+    v8goSetTimer(args, false);
+}
 
-    Local<Array> o = Array::New(vmPtr->isolate, length);
-    auto vmValuePtr = new VMValue;
-    vmValuePtr->value.Reset(vmPtr->isolate, o);
-    vmValuePtr->kind = v8KindArray;
-    return vmValuePtr;
+void v8goSetInterval(const FunctionCallbackInfo<Value> &args) {
+    v8goSetTimer(args, true);
 }
 
-void V8DisposeVMValue(VMValuePtr vmValuePtr) {
-    vmValuePtr->value.Reset();
-    delete vmValuePtr;
+/*
+ * clearTimeout/clearInterval 共用.
+ */
+void v8goClearTimer(const FunctionCallbackInfo<Value> &args) {
+    auto isolate = args.GetIsolate();
+    auto vmPtr = static_cast<VMPtr>(isolate->GetData(0));
+    if (vmPtr == nullptr || args.Length() == 0 || !args[0]->IsNumber()) {
+        return;
+    }
+
+    uint32_t id = args[0]->Uint32Value(isolate->GetCurrentContext()).FromMaybe(0);
+    TimerService::Default().Cancel(vmPtr, id);
+    vmPtr->timers.erase(id);
 }
 
-unsigned int V8GetVMValueKind(VMValuePtr vmValuePtr) {
-    return vmValuePtr->kind;
+/*
+ * openSharedRegion(name[, byteLength]) 以 SharedArrayBuffer 打开命名共享区域.
+ * 区域不存在时, 指定了 byteLength 则创建, 否则返回 undefined.
+ * 脚本创建的区域受 V8SetSharedRegionScriptPolicy 的名字空间和大小限制.
+ */
+void v8goOpenSharedRegion(const FunctionCallbackInfo<Value> &args) {
+    auto isolate = args.GetIsolate();
+    if (args.Length() == 0 || !args[0]->IsString()) {
+        isolate->ThrowException(Exception::TypeError(
+                String::NewFromUtf8(isolate, "The \"name\" argument must be of type string").ToLocalChecked()));
+        return;
+    }
+
+    String::Utf8Value str(isolate, args[0]);
+    std::string name(*str, str.length());
+
+    std::shared_ptr<BackingStore> store;
+    if (args.Length() > 1 && args[1]->IsNumber()) {
+        double size = args[1]->NumberValue(isolate->GetCurrentContext()).FromMaybe(-1);
+        if (!(size >= 0) || size > (double)SIZE_MAX) {
+            isolate->ThrowException(Exception::RangeError(
+                    String::NewFromUtf8(isolate, "Invalid shared region length").ToLocalChecked()));
+            return;
+        }
+        if (!SharedRegionRegistry::Default().ScriptMayCreate(name, (size_t)size)) {
+            isolate->ThrowException(Exception::RangeError(
+                    String::NewFromUtf8(isolate, "Shared region name or length is not allowed for scripts").ToLocalChecked()));
+            return;
+        }
+        int r = SharedRegionRegistry::Default().Create(name, (size_t)size, &store);
+        if (r != 0) {
+            const char *msg = r == 1 ? "Shared region already exists with a different length" : "Shared region allocation failed";
+            isolate->ThrowException(Exception::RangeError(String::NewFromUtf8(isolate, msg).ToLocalChecked()));
+            return;
+        }
+    } else {
+        store = SharedRegionRegistry::Default().Find(name);
+        if (store == nullptr) {
+            return;
+        }
+    }
+
+    args.GetReturnValue().Set(SharedArrayBuffer::New(isolate, store));
 }
 
-void V8ObjectSetString(VMPtr vmPtr, VMValuePtr o, const char *name, const char *val) {
-    Locker locker(vmPtr->isolate);
-    HandleScope handle_scope(vmPtr->isolate);
-    TryCatch try_catch(vmPtr->isolate);
-    Local<Context> context = Local<Context>::New(vmPtr->isolate, vmPtr->context);
-    Context::Scope context_scope(context);
+MaybeLocal<Object> V8ArrayPrototype(Local<Context> context) {
+    Isolate *isolate = context->GetIsolate();
+    Local<Value> arrayCtor;
+    Local<Value> arrayProto;
+    if (!context->Global()->Get(context, String::NewFromUtf8(isolate, "Array").ToLocalChecked()).ToLocal(&arrayCtor) ||
+        !arrayCtor->IsObject() ||
+        !arrayCtor.As<Object>()->Get(context, String::NewFromUtf8(isolate, "prototype").ToLocalChecked()).ToLocal(&arrayProto) ||
+        !arrayProto->IsObject()) {
+        return MaybeLocal<Object>();
+    }
+    return arrayProto.As<Object>();
+}
 
-    Local<Object> oo = Local<Value>::New(vmPtr->isolate, o->value)->ToObject(context).ToLocalChecked();
-    auto success = oo->Set(context, String::NewFromUtf8(vmPtr->isolate, name).ToLocalChecked(), String::NewFromUtf8(vmPtr->isolate, val).ToLocalChecked());
+/*
+ * 配置表在脚本中的包装对象: 内部字段 0 为 ConfigTable*, 1 为节点下标, 2 为该表版本的锚对象.
+ * 包装对象本身不含数据, 属性在访问时由拦截器按需生成.
+ */
+Local<Value> ConfigValue(VMPtr vmPtr, const ConfigTable *table, uint32_t index, Local<Value> anchor);
+
+/*
+ * 每个虚拟机对每个表版本持有一个弱引用的锚对象, 所有包装对象都引用它;
+ * 表被替换且不再有包装对象存活时, 锚对象被回收并释放该版本.
+ */
+struct ConfigAnchor {
+    VMPtr vmPtr;
+    std::shared_ptr<ConfigTable> table;
+    Global<Object> handle;
+};
+
+void ConfigAnchorCollected(const WeakCallbackInfo<ConfigAnchor> &info) {
+    ConfigAnchor *anchor = info.GetParameter();
+    anchor->vmPtr->configAnchors.erase(anchor->table.get());
+    anchor->handle.Reset();
+    delete anchor;
 }
 
-void V8ObjectSetStringForIndex(VMPtr vmPtr, VMValuePtr o, int index, const char *val) {
-    Locker locker(vmPtr->isolate);
-    HandleScope handle_scope(vmPtr->isolate);
-    TryCatch try_catch(vmPtr->isolate);
-    Local<Context> context = Local<Context>::New(vmPtr->isolate, vmPtr->context);
-    Context::Scope context_scope(context);
+Local<Object> ConfigAnchorFor(VMPtr vmPtr, const std::shared_ptr<ConfigTable> &table) {
+    Isolate *isolate = vmPtr->isolate;
+    auto it = vmPtr->configAnchors.find(table.get());
+    if (it != vmPtr->configAnchors.end())
+        return it->second->handle.Get(isolate);
+
+    Local<Object> obj = Object::New(isolate);
+    auto anchor = new ConfigAnchor;
+    anchor->vmPtr = vmPtr;
+    anchor->table = table;
+    anchor->handle.Reset(isolate, obj);
+    anchor->handle.SetWeak(anchor, ConfigAnchorCollected, WeakCallbackType::kParameter);
+    vmPtr->configAnchors[table.get()] = anchor;
+    return obj;
+}
 
-    Local<Object> oo = Local<Value>::New(vmPtr->isolate, o->value)->ToObject(context).ToLocalChecked();
-    auto success = oo->Set(context, (uint32_t)index, String::NewFromUtf8(vmPtr->isolate, val).ToLocalChecked());
+bool ConfigUnwrap(Local<Object> holder, const ConfigTable **table, const ConfigTable::Node **node) {
+    if (holder->InternalFieldCount() != 3)
+        return false;
+    *table = static_cast<const ConfigTable *>(holder->GetAlignedPointerFromInternalField(0));
+    *node = &(*table)->At(holder->GetInternalField(1).As<Uint32>()->Value());
+    return true;
 }
 
-void V8ObjectSetInteger(VMPtr vmPtr, VMValuePtr o, const char *name, int64_t val) {
-    Locker locker(vmPtr->isolate);
-    HandleScope handle_scope(vmPtr->isolate);
-    TryCatch try_catch(vmPtr->isolate);
-    Local<Context> context = Local<Context>::New(vmPtr->isolate, vmPtr->context);
-    Context::Scope context_scope(context);
+void ConfigThrowReadOnly(Isolate *isolate) {
+    isolate->ThrowException(Exception::TypeError(
+            String::NewFromUtf8(isolate, "Config tables are read-only").ToLocalChecked()));
+}
 
-    Local<Object> oo = Local<Value>::New(vmPtr->isolate, o->value)->ToObject(context).ToLocalChecked();
-    auto success = oo->Set(context, String::NewFromUtf8(vmPtr->isolate, name).ToLocalChecked(), Number::New(vmPtr->isolate, val));
+void ConfigNamedGetter(Local<Name> property, const PropertyCallbackInfo<Value> &info) {
+    const ConfigTable *table;
+    const ConfigTable::Node *node;
+    if (!ConfigUnwrap(info.Holder(), &table, &node))
+        return;
+
+    auto isolate = info.GetIsolate();
+    String::Utf8Value key(isolate, property);
+    if (node->type == ConfigTable::kArray) {
+        if (key.length() == 6 && memcmp(*key, "length", 6) == 0)
+            info.GetReturnValue().Set(node->count);
+        return;
+    }
+
+    int64_t value = table->Find(*node, *key, key.length());
+    if (value >= 0)
+        info.GetReturnValue().Set(ConfigValue(static_cast<VMPtr>(isolate->GetData(0)), table, (uint32_t)value,
+                                              info.Holder()->GetInternalField(2)));
 }
 
-void V8ObjectSetIntegerForIndex(VMPtr vmPtr, VMValuePtr o, int index, int64_t val) {
-    Locker locker(vmPtr->isolate);
-    HandleScope handle_scope(vmPtr->isolate);
-    TryCatch try_catch(vmPtr->isolate);
-    Local<Context> context = Local<Context>::New(vmPtr->isolate, vmPtr->context);
-    Context::Scope context_scope(context);
+void ConfigNamedQuery(Local<Name> property, const PropertyCallbackInfo<Integer> &info) {
+    const ConfigTable *table;
+    const ConfigTable::Node *node;
+    if (!ConfigUnwrap(info.Holder(), &table, &node))
+        return;
 
-    Local<Object> oo = Local<Value>::New(vmPtr->isolate, o->value)->ToObject(context).ToLocalChecked();
-    auto success = oo->Set(context, (uint32_t)index, Number::New(vmPtr->isolate, val));
+    String::Utf8Value key(info.GetIsolate(), property);
+    if (node->type == ConfigTable::kArray) {
+        if (key.length() == 6 && memcmp(*key, "length", 6) == 0)
+            info.GetReturnValue().Set(ReadOnly | DontEnum | DontDelete);
+        return;
+    }
+    if (table->Find(*node, *key, key.length()) >= 0)
+        info.GetReturnValue().Set(ReadOnly | DontDelete);
 }
 
-void V8ObjectSetValue(VMPtr vmPtr, VMValuePtr o, const char *name, VMValuePtr val) {
-    Locker locker(vmPtr->isolate);
-    HandleScope handle_scope(vmPtr->isolate);
-    TryCatch try_catch(vmPtr->isolate);
-    Local<Context> context = Local<Context>::New(vmPtr->isolate, vmPtr->context);
-    Context::Scope context_scope(context);
+void ConfigNamedSetter(Local<Name> property, Local<Value> value, const PropertyCallbackInfo<Value> &info) {
+    ConfigThrowReadOnly(info.GetIsolate());
+}
 
-    Local<Object> oo = Local<Value>::New(vmPtr->isolate, o->value)->ToObject(context).ToLocalChecked();
-    Local<Value> vv = Local<Value>::New(vmPtr->isolate, val->value);
-    auto success = oo->Set(context, String::NewFromUtf8(vmPtr->isolate, name).ToLocalChecked(), vv);
+void ConfigNamedDeleter(Local<Name> property, const PropertyCallbackInfo<Boolean> &info) {
+    info.GetReturnValue().Set(false);
 }
 
-void V8ObjectSetValueForIndex(VMPtr vmPtr, VMValuePtr o, int index, VMValuePtr val) {
-    Locker locker(vmPtr->isolate);
-    HandleScope handle_scope(vmPtr->isolate);
-    TryCatch try_catch(vmPtr->isolate);
-    Local<Context> context = Local<Context>::New(vmPtr->isolate, vmPtr->context);
-    Context::Scope context_scope(context);
+void ConfigNamedEnumerator(const PropertyCallbackInfo<Array> &info) {
+    const ConfigTable *table;
+    const ConfigTable::Node *node;
+    if (!ConfigUnwrap(info.Holder(), &table, &node) || node->type != ConfigTable::kObject)
+        return;
 
-    Local<Object> oo = Local<Value>::New(vmPtr->isolate, o->value)->ToObject(context).ToLocalChecked();
-    Local<Value> vv = val->value.Get(vmPtr->isolate);
-    auto success = oo->Set(context, (uint32_t)index, vv);
+    auto isolate = info.GetIsolate();
+    auto context = isolate->GetCurrentContext();
+    Local<Array> keys = Array::New(isolate, node->count);
+    const ConfigTable::Member *members = table->Members(*node);
+    for (uint32_t i = 0; i < node->count; i++) {
+        Local<String> key = String::NewFromUtf8(isolate, table->Chars(members[i].key), NewStringType::kNormal,
+                                                members[i].keyLength).ToLocalChecked();
+        keys->Set(context, i, key).FromMaybe(false);
+    }
+    info.GetReturnValue().Set(keys);
 }
 
-void V8ObjectSetFloat(VMPtr vmPtr, VMValuePtr o, const char *name, double val) {
-    Locker locker(vmPtr->isolate);
-    HandleScope handle_scope(vmPtr->isolate);
-    TryCatch try_catch(vmPtr->isolate);
-    Local<Context> context = Local<Context>::New(vmPtr->isolate, vmPtr->context);
-    Context::Scope context_scope(context);
+void ConfigIndexedGetter(uint32_t index, const PropertyCallbackInfo<Value> &info) {
+    const ConfigTable *table;
+    const ConfigTable::Node *node;
+    if (!ConfigUnwrap(info.Holder(), &table, &node))
+        return;
 
-    Local<Object> oo = Local<Value>::New(vmPtr->isolate, o->value)->ToObject(context).ToLocalChecked();
-    auto success = oo->Set(context, String::NewFromUtf8(vmPtr->isolate, name).ToLocalChecked(), Number::New(vmPtr->isolate, val));
+    auto vmPtr = static_cast<VMPtr>(info.GetIsolate()->GetData(0));
+    if (node->type == ConfigTable::kArray) {
+        if (index < node->count)
+            info.GetReturnValue().Set(ConfigValue(vmPtr, table, table->Item(*node, index), info.Holder()->GetInternalField(2)));
+        return;
+    }
+
+    std::string key = std::to_string(index);
+    int64_t value = table->Find(*node, key.data(), key.length());
+    if (value >= 0)
+        info.GetReturnValue().Set(ConfigValue(vmPtr, table, (uint32_t)value, info.Holder()->GetInternalField(2)));
 }
 
-void V8ObjectSetFloatForIndex(VMPtr vmPtr, VMValuePtr o, int index, double val) {
-    Locker locker(vmPtr->isolate);
-    HandleScope handle_scope(vmPtr->isolate);
-    TryCatch try_catch(vmPtr->isolate);
-    Local<Context> context = Local<Context>::New(vmPtr->isolate, vmPtr->context);
-    Context::Scope context_scope(context);
+void ConfigIndexedQuery(uint32_t index, const PropertyCallbackInfo<Integer> &info) {
+    const ConfigTable *table;
+    const ConfigTable::Node *node;
+    if (!ConfigUnwrap(info.Holder(), &table, &node))
+        return;
 
-    Local<Object> oo = Local<Value>::New(vmPtr->isolate, o->value)->ToObject(context).ToLocalChecked();
-    auto success = oo->Set(context, (uint32_t)index, Number::New(vmPtr->isolate, val));
+    if (node->type == ConfigTable::kArray) {
+        if (index < node->count)
+            info.GetReturnValue().Set(ReadOnly | DontDelete);
+        return;
+    }
+    std::string key = std::to_string(index);
+    if (table->Find(*node, key.data(), key.length()) >= 0)
+        info.GetReturnValue().Set(ReadOnly | DontDelete);
 }
 
-void V8ObjectSetBoolean(VMPtr vmPtr, VMValuePtr o, const char *name, bool val) {
-    Locker locker(vmPtr->isolate);
-    HandleScope handle_scope(vmPtr->isolate);
-    TryCatch try_catch(vmPtr->isolate);
-    Local<Context> context = Local<Context>::New(vmPtr->isolate, vmPtr->context);
-    Context::Scope context_scope(context);
+void ConfigIndexedSetter(uint32_t index, Local<Value> value, const PropertyCallbackInfo<Value> &info) {
+    ConfigThrowReadOnly(info.GetIsolate());
+}
+
+void ConfigIndexedDeleter(uint32_t index, const PropertyCallbackInfo<Boolean> &info) {
+    info.GetReturnValue().Set(false);
+}
+
+void ConfigIndexedEnumerator(const PropertyCallbackInfo<Array> &info) {
+    const ConfigTable *table;
+    const ConfigTable::Node *node;
+    if (!ConfigUnwrap(info.Holder(), &table, &node) || node->type != ConfigTable::kArray)
+        return;
+
+    auto isolate = info.GetIsolate();
+    auto context = isolate->GetCurrentContext();
+    Local<Array> indices = Array::New(isolate, node->count);
+    for (uint32_t i = 0; i < node->count; i++) {
+        indices->Set(context, i, Integer::NewFromUnsigned(isolate, i)).FromMaybe(false);
+    }
+    info.GetReturnValue().Set(indices);
+}
+
+void ConfigSetupTemplate(Local<ObjectTemplate> tpl) {
+    tpl->SetInternalFieldCount(3);
+    tpl->SetHandler(NamedPropertyHandlerConfiguration(
+            ConfigNamedGetter, ConfigNamedSetter, ConfigNamedQuery, ConfigNamedDeleter, ConfigNamedEnumerator,
+            Local<Value>(), PropertyHandlerFlags::kOnlyInterceptStrings));
+    tpl->SetHandler(IndexedPropertyHandlerConfiguration(
+            ConfigIndexedGetter, ConfigIndexedSetter, ConfigIndexedQuery, ConfigIndexedDeleter, ConfigIndexedEnumerator));
+}
+
+/*
+ * 数组包装对象的 toJSON, 返回真正的数组, 使 JSON.stringify 的结果与原始数据一致.
+ * 元素仍是包装对象, 嵌套的数组由 JSON.stringify 继续调用各自的 toJSON.
+ */
+void ConfigArrayToJSON(const FunctionCallbackInfo<Value> &args) {
+    auto isolate = args.GetIsolate();
+    auto vmPtr = static_cast<VMPtr>(isolate->GetData(0));
+    const ConfigTable *table;
+    const ConfigTable::Node *node;
+    if (vmPtr == nullptr || vmPtr->configArrayTemplate.IsEmpty() ||
+        !vmPtr->configArrayTemplate.Get(isolate)->HasInstance(args.This()) ||
+        !ConfigUnwrap(args.This(), &table, &node)) {
+        return;
+    }
+
+    auto context = isolate->GetCurrentContext();
+    Local<Value> anchor = args.This()->GetInternalField(2);
+    Local<Array> out = Array::New(isolate, node->count);
+    for (uint32_t i = 0; i < node->count; i++) {
+        out->Set(context, i, ConfigValue(vmPtr, table, table->Item(*node, i), anchor)).FromMaybe(false);
+    }
+    args.GetReturnValue().Set(out);
+}
+
+Local<Value> ConfigValue(VMPtr vmPtr, const ConfigTable *table, uint32_t index, Local<Value> anchor) {
+    Isolate *isolate = vmPtr->isolate;
+    const ConfigTable::Node &node = table->At(index);
+    switch (node.type) {
+        case ConfigTable::kNull:
+            return Null(isolate);
+        case ConfigTable::kFalse:
+            return False(isolate);
+        case ConfigTable::kTrue:
+            return True(isolate);
+        case ConfigTable::kNumber:
+            return Number::New(isolate, node.number);
+        case ConfigTable::kString:
+            return String::NewFromUtf8(isolate, table->Chars(node.first), NewStringType::kNormal, node.count).ToLocalChecked();
+        default:
+            break;
+    }
+
+    Local<Context> context = isolate->GetCurrentContext();
+    if (vmPtr->configTemplate.IsEmpty()) {
+        Local<ObjectTemplate> tpl = ObjectTemplate::New(isolate);
+        ConfigSetupTemplate(tpl);
+        vmPtr->configTemplate.Reset(isolate, tpl);
+
+        // 数组包装对象使用单独的模板, 其原型继承 Array.prototype, 只在这里设置一次,
+        // 可以直接使用 map/forEach/for...of
+        Local<FunctionTemplate> arrayTpl = FunctionTemplate::New(isolate);
+        ConfigSetupTemplate(arrayTpl->InstanceTemplate());
+        arrayTpl->PrototypeTemplate()->Set(isolate, "toJSON", FunctionTemplate::New(isolate, ConfigArrayToJSON));
+        vmPtr->configArrayTemplate.Reset(isolate, arrayTpl);
+
+        Local<Function> ctor;
+        Local<Value> proto;
+        Local<Object> arrayProto;
+        if (arrayTpl->GetFunction(context).ToLocal(&ctor) &&
+            ctor->Get(context, String::NewFromUtf8(isolate, "prototype").ToLocalChecked()).ToLocal(&proto) &&
+            proto->IsObject() && V8ArrayPrototype(context).ToLocal(&arrayProto)) {
+            proto.As<Object>()->SetPrototype(context, arrayProto).FromMaybe(false);
+        }
+    }
+
+    Local<Object> obj;
+    Local<ObjectTemplate> tpl = node.type == ConfigTable::kArray
+            ? vmPtr->configArrayTemplate.Get(isolate)->InstanceTemplate()
+            : vmPtr->configTemplate.Get(isolate);
+    if (!tpl->NewInstance(context).ToLocal(&obj)) {
+        return Undefined(isolate);
+    }
+    obj->SetAlignedPointerInInternalField(0, (void *)table);
+    obj->SetInternalField(1, Integer::NewFromUnsigned(isolate, index));
+    obj->SetInternalField(2, anchor);
+    return obj;
+}
+
+/*
+ * getConfig(name) 返回只读配置表的根对象, 表不存在时返回 undefined.
+ */
+void v8goGetConfig(const FunctionCallbackInfo<Value> &args) {
+    auto isolate = args.GetIsolate();
+    auto vmPtr = static_cast<VMPtr>(isolate->GetData(0));
+    if (vmPtr == nullptr || args.Length() == 0 || !args[0]->IsString()) {
+        return;
+    }
+
+    String::Utf8Value name(isolate, args[0]);
+    std::shared_ptr<ConfigTable> table = ConfigRegistry::Default().Get(std::string(*name, name.length()));
+    if (table == nullptr) {
+        return;
+    }
+
+    args.GetReturnValue().Set(ConfigValue(vmPtr, table.get(), table->Root(), ConfigAnchorFor(vmPtr, table)));
+}
+
+/*
+ * 创建命名共享区域. 返回 0 成功, 1 已存在但大小不同, -1 分配失败.
+ */
+int V8CreateSharedRegion(const char *name, size_t size) {
+    return SharedRegionRegistry::Default().Create(name, size, nullptr);
+}
+
+/*
+ * 设置脚本创建共享区域的名字前缀和大小上限.
+ */
+void V8SetSharedRegionScriptPolicy(const char *prefix, size_t maxSize) {
+    SharedRegionRegistry::Default().SetScriptPolicy(prefix, maxSize);
+}
+
+/*
+ * 之后新建的虚拟机是否允许 Atomics.wait. 默认允许; 关闭后 Atomics.wait 抛出异常,
+ * 避免脚本等待共享区域时阻塞执行线程.
+ */
+std::atomic<bool> allowAtomicsWait(true);
+
+void V8SetAllowAtomicsWait(bool allow) {
+    allowAtomicsWait = allow;
+}
+
+/*
+ * 从注册表移除, 已打开的虚拟机仍可继续使用, 全部释放后回收内存.
+ */
+int V8ReleaseSharedRegion(const char *name) {
+    return SharedRegionRegistry::Default().Release(name) ? 0 : -1;
+}
+
+typedef struct _V8SharedRegions {
+    std::vector<SharedRegionRegistry::Info> infos;
+    std::vector<V8SharedRegionInfo> items;
+} V8SharedRegions;
+
+V8SharedRegionsPtr V8GetSharedRegions() {
+    auto regions = new V8SharedRegions;
+    SharedRegionRegistry::Default().List(regions->infos);
+    regions->items.resize(regions->infos.size());
+    for (size_t i = 0; i < regions->infos.size(); i++) {
+        regions->items[i].name = regions->infos[i].name.c_str();
+        regions->items[i].size = regions->infos[i].size;
+        regions->items[i].references = regions->infos[i].references;
+    }
+    return regions;
+}
+
+size_t V8GetSharedRegionsLength(V8SharedRegionsPtr regions) {
+    return regions->items.size();
+}
+
+const V8SharedRegionInfo *V8GetSharedRegionsItem(V8SharedRegionsPtr regions, int index) {
+    if (index < 0 || index >= regions->items.size())
+        return nullptr;
+    return &regions->items[index];
+}
+
+void V8ReleaseSharedRegions(V8SharedRegionsPtr regions) {
+    delete regions;
+}
+
+MaybeLocal<Promise> V8ImportModuleDynamically(Local<Context> context, Local<ScriptOrModule> referrer, Local<String> specifier);
+void V8CompleteImports(VMPtr vmPtr, Local<Context> context, std::vector<ModuleLoader::Result> &loaded);
+
+/*
+ * 执行虚拟机已到期的定时器回调, 一次取走整批; 同时完成后台已读取完毕的动态 import.
+ * 必须在虚拟机的执行线程上调用.
+ */
+void V8InspectorService(VMPtr vmPtr);
+
+int V8RunTimers(VMPtr vmPtr) {
+    std::vector<uint32_t> ready;
+    std::vector<ModuleLoader::Result> loaded;
+    TimerService::Default().TakeReady(vmPtr, ready);
+    ModuleLoader::Default().TakeReady(vmPtr, loaded);
+    bool inspectorWork = vmPtr->inspectorPending.exchange(false);
+    if (ready.empty() && loaded.empty() && !inspectorWork) {
+        return 0;
+    }
+
+    Locker locker(vmPtr->isolate);
+    TraceSpan span(kTraceDispatch, "RunTimers", vmPtr);
+    Isolate::Scope isolate_scope(vmPtr->isolate);
+    if (inspectorWork) {
+        V8InspectorService(vmPtr);
+    }
+    HandleScope handle_scope(vmPtr->isolate);
+    Local<Context> context = Local<Context>::New(vmPtr->isolate, vmPtr->context);
+    Context::Scope context_scope(context);
+    OutboundScope outbound(vmPtr);
+
+    if (!loaded.empty()) {
+        V8CompleteImports(vmPtr, context, loaded);
+    }
+
+    int r = 0;
+    std::vector<Local<Value>> argv;
+
+    for (auto id : ready) {
+        auto it = vmPtr->timers.find(id);
+        if (it == vmPtr->timers.end()) {
+            continue;
+        }
+
+        HandleScope callback_scope(vmPtr->isolate);
+        Local<Function> callback = it->second.callback.Get(vmPtr->isolate);
+        argv.clear();
+        for (auto &arg : it->second.args) {
+            argv.push_back(arg.Get(vmPtr->isolate));
+        }
+        if (!it->second.repeat) {
+            vmPtr->timers.erase(it);
+        }
+
+        TryCatch try_catch(vmPtr->isolate);
+        MaybeLocal<Value> result = callback->Call(context, Undefined(vmPtr->isolate), (int)argv.size(), argv.data());
+        if (result.IsEmpty()) {
+            assert(try_catch.HasCaught());
+            V8CaptureException(vmPtr, &try_catch);
+            r = 2;
+        }
+    }
+
+    return r;
+}
+
+/*
+ * 时间轮线程通知虚拟机有到期定时器.
+ */
+void V8TimersReady(void *owner) {
+#ifdef GOOUTPUT
+    GoTimersReady(static_cast<VMPtr>(owner));
+#else
+    V8RunTimers(static_cast<VMPtr>(owner));
+#endif
+}
+
+/*
+ * 设置时间轮精度(毫秒), 只在第一个定时器创建之前生效.
+ */
+void V8SetTimerResolution(uint32_t ms) {
+    TimerService::Default().SetTickMillis(ms);
+}
+
+/*
+ * 获取定时器统计, vmPtr 为空时返回全部虚拟机的汇总.
+ */
+void V8GetTimerStats(VMPtr vmPtr, V8TimerStats *stats) {
+    TimerCounters counters;
+    TimerService::Default().Counters(vmPtr, &counters);
+    stats->active = counters.active;
+    stats->scheduled = counters.scheduled;
+    stats->fired = counters.fired;
+    stats->cancelled = counters.cancelled;
+    stats->driftTotalMs = counters.driftTotal;
+    stats->driftMaxMs = counters.driftMax;
+}
+
+int V8DispatchEnterEvent(VMPtr vmPtr, uint64_t sessionId, const char *addr) {
+    Locker locker(vmPtr->isolate);
+    TraceSpan span(kTraceDispatch, "DispatchEnter", vmPtr, sessionId);
+    HandlerTimer timer(&vmPtr->stats, kHandlerEnter);
+    HandleScope handle_scope(vmPtr->isolate);
+    TryCatch try_catch(vmPtr->isolate);
+    Local<Context> context = Local<Context>::New(vmPtr->isolate, vmPtr->context);
+    Context::Scope context_scope(context);
+    OutboundScope outbound(vmPtr);
+    auto global = context->Global();
+
+    MaybeLocal<Value> maybeEnterVal = global->Get(context, String::NewFromUtf8(vmPtr->isolate, "enter").ToLocalChecked());
+    if (maybeEnterVal.IsEmpty()) {
+        std::string out = "'enter' not found\n";
+        vmPtr->last_exception = out;
+        timer.Fail();
+        return 2;
+    }
+    Local<Value> enterVal = maybeEnterVal.ToLocalChecked();
+    if(!enterVal->IsFunction()) {
+        std::string out = "'enter' found, but it's not a function\n";
+        vmPtr->last_exception = out;
+        timer.Fail();
+        return 2;
+    }
+
+    Local<Function> enter = Local<Function>::Cast(enterVal);
+    if (!enter->IsCallable()) {
+        std::string out = "'enter' found, but it's not a callable\n";
+        vmPtr->last_exception = out;
+        timer.Fail();
+        return 2;
+    }
+
+    Local<Value> args[2];
+    args[0] = BigInt::NewFromUnsigned(vmPtr->isolate, sessionId);
+    args[1] = String::NewFromUtf8(vmPtr->isolate, addr).ToLocalChecked();
+    MaybeLocal<Value> result = enter->CallAsFunction(context, Undefined(vmPtr->isolate), 2, args);
+    if(result.IsEmpty()) {
+        assert(try_catch.HasCaught());
+        V8CaptureException(vmPtr, &try_catch);
+        timer.Fail();
+        return 2;
+    }
+    return result.ToLocalChecked()->Uint32Value(context).FromMaybe(-1);
+}
+
+
+int V8DispatchLeaveEvent(VMPtr vmPtr, uint64_t sessionId, const char *addr) {
+    Locker locker(vmPtr->isolate);
+    TraceSpan span(kTraceDispatch, "DispatchLeave", vmPtr, sessionId);
+    HandlerTimer timer(&vmPtr->stats, kHandlerLeave);
+    HandleScope handle_scope(vmPtr->isolate);
+    TryCatch try_catch(vmPtr->isolate);
+    Local<Context> context = Local<Context>::New(vmPtr->isolate, vmPtr->context);
+    Context::Scope context_scope(context);
+    OutboundScope outbound(vmPtr);
+    auto global = context->Global();
+
+    MaybeLocal<Value> maybeEnterVal = global->Get(context, String::NewFromUtf8(vmPtr->isolate, "leave").ToLocalChecked());
+    if (maybeEnterVal.IsEmpty()) {
+        std::string out = "'leave' not found\n";
+        vmPtr->last_exception = out;
+        timer.Fail();
+        return 2;
+    }
+    Local<Value> enterVal = maybeEnterVal.ToLocalChecked();
+    if(!enterVal->IsFunction()) {
+        std::string out = "'leave' found, but it's not a function\n";
+        vmPtr->last_exception = out;
+        timer.Fail();
+        return 2;
+    }
+
+    Local<Function> enter = Local<Function>::Cast(enterVal);
+    if (!enter->IsCallable()) {
+        std::string out = "'leave' found, but it's not a callable\n";
+        vmPtr->last_exception = out;
+        timer.Fail();
+        return 2;
+    }
+
+    Local<Value> args[2];
+    args[0] = BigInt::NewFromUnsigned(vmPtr->isolate, sessionId);
+    args[1] = String::NewFromUtf8(vmPtr->isolate, addr).ToLocalChecked();
+    MaybeLocal<Value> result = enter->CallAsFunction(context, Undefined(vmPtr->isolate), 2, args);
+    if(result.IsEmpty()) {
+        assert(try_catch.HasCaught());
+        V8CaptureException(vmPtr, &try_catch);
+        timer.Fail();
+        return 2;
+    }
+    return result.ToLocalChecked()->Uint32Value(context).FromMaybe(-1);
+}
+
+
+/*
+ * 按需解码的入站消息. Go 把消息编码成一块缓冲区(格式见 message.go), 派发期间脚本拿到的是
+ * 只含 (偏移, 代数) 两个内部字段的包装对象, 字段在访问时才从缓冲区解码.
+ * 缓冲区属于 Go, 只在派发期间有效; 派发结束后代数递增, 之后的访问会抛出异常,
+ * 需要保留消息时在派发期间调用 materialize() 转为普通对象.
+ */
+enum {
+    kMessageNull = 0,
+    kMessageFalse = 1,
+    kMessageTrue = 2,
+    kMessageNumber = 3,
+    kMessageString = 4,
+    kMessageArray = 5,
+    kMessageObject = 6,
+};
+
+class MessageReader {
+public:
+    MessageReader(const char *data, size_t len) : data(data), len(len) {}
+
+    bool U8(uint32_t offset, uint8_t *out) const {
+        if (offset >= len)
+            return false;
+        *out = (uint8_t)data[offset];
+        return true;
+    }
+
+    bool U32(uint32_t offset, uint32_t *out) const {
+        if (offset > len || len - offset < 4)
+            return false;
+        memcpy(out, data + offset, 4);
+        return true;
+    }
+
+    bool F64(uint32_t offset, double *out) const {
+        if (offset > len || len - offset < 8)
+            return false;
+        memcpy(out, data + offset, 8);
+        return true;
+    }
+
+    const char *Bytes(uint32_t offset, uint32_t n) const {
+        if (offset > len || len - offset < n)
+            return nullptr;
+        return data + offset;
+    }
+
+    /*
+     * 对象成员表按键排序, 二分查找. 找到返回 true 并写入值偏移.
+     */
+    bool Find(uint32_t object, const char *key, size_t keyLen, uint32_t *value) const {
+        uint32_t count;
+        if (!U32(object + 1, &count))
+            return false;
+        uint32_t lo = 0, hi = count;
+        while (lo < hi) {
+            uint32_t mid = lo + (hi - lo) / 2;
+            uint32_t entry = object + 5 + mid * 12;
+            uint32_t keyOffset, keyLength;
+            if (!U32(entry, &keyOffset) || !U32(entry + 4, &keyLength))
+                return false;
+            const char *k = Bytes(keyOffset, keyLength);
+            if (k == nullptr)
+                return false;
+            int c = memcmp(k, key, std::min<size_t>(keyLength, keyLen));
+            if (c == 0)
+                c = keyLength < keyLen ? -1 : (keyLength > keyLen ? 1 : 0);
+            if (c == 0)
+                return U32(entry + 8, value);
+            if (c < 0)
+                lo = mid + 1;
+            else
+                hi = mid;
+        }
+        return false;
+    }
+
+private:
+    const char *data;
+    size_t len;
+};
+
+Local<Value> MessageValue(VMPtr vmPtr, Local<Context> context, uint32_t offset);
+
+/*
+ * 取出包装对象对应的偏移; 消息已失效时抛出异常并返回 false.
+ */
+bool MessageUnwrap(VMPtr vmPtr, Local<Object> holder, uint32_t *offset, uint8_t *tag) {
+    Isolate *isolate = vmPtr->isolate;
+    if (holder->InternalFieldCount() != 2)
+        return false;
+
+    uint32_t generation = holder->GetInternalField(1).As<Uint32>()->Value();
+    if (vmPtr->messageData == nullptr || generation != vmPtr->messageGeneration) {
+        isolate->ThrowException(Exception::TypeError(String::NewFromUtf8(isolate,
+                "Inbound message is no longer available, call materialize() while handling it").ToLocalChecked()));
+        return false;
+    }
+
+    *offset = holder->GetInternalField(0).As<Uint32>()->Value();
+    MessageReader reader(vmPtr->messageData, vmPtr->messageLength);
+    return reader.U8(*offset, tag);
+}
+
+void MessageNamedGetter(Local<Name> property, const PropertyCallbackInfo<Value> &info) {
+    auto isolate = info.GetIsolate();
+    auto vmPtr = static_cast<VMPtr>(isolate->GetData(0));
+    uint32_t offset;
+    uint8_t tag;
+    if (!MessageUnwrap(vmPtr, info.Holder(), &offset, &tag))
+        return;
+
+    MessageReader reader(vmPtr->messageData, vmPtr->messageLength);
+    String::Utf8Value key(isolate, property);
+    if (tag == kMessageArray) {
+        uint32_t count;
+        if (key.length() == 6 && memcmp(*key, "length", 6) == 0 && reader.U32(offset + 1, &count))
+            info.GetReturnValue().Set(count);
+        return;
+    }
+
+    uint32_t value;
+    if (tag == kMessageObject && reader.Find(offset, *key, key.length(), &value))
+        info.GetReturnValue().Set(MessageValue(vmPtr, isolate->GetCurrentContext(), value));
+}
+
+void MessageNamedQuery(Local<Name> property, const PropertyCallbackInfo<Integer> &info) {
+    auto isolate = info.GetIsolate();
+    auto vmPtr = static_cast<VMPtr>(isolate->GetData(0));
+    uint32_t offset;
+    uint8_t tag;
+    if (!MessageUnwrap(vmPtr, info.Holder(), &offset, &tag))
+        return;
+
+    MessageReader reader(vmPtr->messageData, vmPtr->messageLength);
+    String::Utf8Value key(isolate, property);
+    uint32_t value;
+    if (tag == kMessageArray) {
+        if (key.length() == 6 && memcmp(*key, "length", 6) == 0)
+            info.GetReturnValue().Set(ReadOnly | DontEnum | DontDelete);
+    } else if (tag == kMessageObject && reader.Find(offset, *key, key.length(), &value)) {
+        info.GetReturnValue().Set(ReadOnly | DontDelete);
+    }
+}
+
+void MessageSetter(Local<Name> property, Local<Value> value, const PropertyCallbackInfo<Value> &info) {
+    auto isolate = info.GetIsolate();
+    isolate->ThrowException(Exception::TypeError(String::NewFromUtf8(isolate,
+            "Inbound message is read-only, call materialize() to get a mutable copy").ToLocalChecked()));
+}
+
+void MessageIndexedSetter(uint32_t index, Local<Value> value, const PropertyCallbackInfo<Value> &info) {
+    MessageSetter(Local<Name>(), value, info);
+}
+
+void MessageNamedEnumerator(const PropertyCallbackInfo<Array> &info) {
+    auto isolate = info.GetIsolate();
+    auto vmPtr = static_cast<VMPtr>(isolate->GetData(0));
+    uint32_t offset;
+    uint8_t tag;
+    if (!MessageUnwrap(vmPtr, info.Holder(), &offset, &tag) || tag != kMessageObject)
+        return;
+
+    MessageReader reader(vmPtr->messageData, vmPtr->messageLength);
+    uint32_t count;
+    if (!reader.U32(offset + 1, &count))
+        return;
+
+    auto context = isolate->GetCurrentContext();
+    Local<Array> keys = Array::New(isolate);
+    for (uint32_t i = 0; i < count; i++) {
+        uint32_t keyOffset, keyLength;
+        const char *k;
+        if (!reader.U32(offset + 5 + i * 12, &keyOffset) || !reader.U32(offset + 9 + i * 12, &keyLength) ||
+            (k = reader.Bytes(keyOffset, keyLength)) == nullptr)
+            break;
+        keys->Set(context, i, String::NewFromUtf8(isolate, k, NewStringType::kNormal, keyLength).ToLocalChecked()).FromMaybe(false);
+    }
+    info.GetReturnValue().Set(keys);
+}
+
+void MessageIndexedGetter(uint32_t index, const PropertyCallbackInfo<Value> &info) {
+    auto isolate = info.GetIsolate();
+    auto vmPtr = static_cast<VMPtr>(isolate->GetData(0));
+    uint32_t offset;
+    uint8_t tag;
+    if (!MessageUnwrap(vmPtr, info.Holder(), &offset, &tag))
+        return;
+
+    MessageReader reader(vmPtr->messageData, vmPtr->messageLength);
+    uint32_t count, value;
+    if (tag == kMessageArray) {
+        // 元素偏移为 0 表示空位(根节点不可能是数组元素), 与 DispatchMessage 留下的空位一致
+        if (reader.U32(offset + 1, &count) && index < count && reader.U32(offset + 5 + index * 4, &value) && value != 0)
+            info.GetReturnValue().Set(MessageValue(vmPtr, isolate->GetCurrentContext(), value));
+        return;
+    }
+
+    std::string key = std::to_string(index);
+    if (tag == kMessageObject && reader.Find(offset, key.data(), key.length(), &value))
+        info.GetReturnValue().Set(MessageValue(vmPtr, isolate->GetCurrentContext(), value));
+}
+
+void MessageIndexedQuery(uint32_t index, const PropertyCallbackInfo<Integer> &info) {
+    auto isolate = info.GetIsolate();
+    auto vmPtr = static_cast<VMPtr>(isolate->GetData(0));
+    uint32_t offset;
+    uint8_t tag;
+    if (!MessageUnwrap(vmPtr, info.Holder(), &offset, &tag))
+        return;
+
+    MessageReader reader(vmPtr->messageData, vmPtr->messageLength);
+    uint32_t count, value;
+    std::string key;
+    if (tag == kMessageArray) {
+        if (reader.U32(offset + 1, &count) && index < count && reader.U32(offset + 5 + index * 4, &value) && value != 0)
+            info.GetReturnValue().Set(ReadOnly | DontDelete);
+    } else if (tag == kMessageObject && reader.Find(offset, (key = std::to_string(index)).data(), key.length(), &value)) {
+        info.GetReturnValue().Set(ReadOnly | DontDelete);
+    }
+}
+
+void MessageIndexedEnumerator(const PropertyCallbackInfo<Array> &info) {
+    auto isolate = info.GetIsolate();
+    auto vmPtr = static_cast<VMPtr>(isolate->GetData(0));
+    uint32_t offset;
+    uint8_t tag;
+    uint32_t count;
+    MessageReader reader(vmPtr->messageData, vmPtr->messageLength);
+    if (!MessageUnwrap(vmPtr, info.Holder(), &offset, &tag) || tag != kMessageArray || !reader.U32(offset + 1, &count))
+        return;
+
+    auto context = isolate->GetCurrentContext();
+    Local<Array> indices = Array::New(isolate);
+    uint32_t n = 0;
+    for (uint32_t i = 0; i < count; i++) {
+        uint32_t value;
+        if (!reader.U32(offset + 5 + i * 4, &value))
+            break;
+        if (value != 0)
+            indices->Set(context, n++, Integer::NewFromUnsigned(isolate, i)).FromMaybe(false);
+    }
+    info.GetReturnValue().Set(indices);
+}
+
+/*
+ * 把 offset 处的值完整解码为普通对象/数组.
+ */
+Local<Value> MessageMaterialize(VMPtr vmPtr, Local<Context> context, uint32_t offset, int depth) {
+    Isolate *isolate = vmPtr->isolate;
+    MessageReader reader(vmPtr->messageData, vmPtr->messageLength);
+    uint8_t tag;
+    uint32_t count;
+    if (depth > 256 || !reader.U8(offset, &tag))
+        return Undefined(isolate);
+
+    if (tag == kMessageArray) {
+        if (!reader.U32(offset + 1, &count))
+            return Undefined(isolate);
+        Local<Array> array = Array::New(isolate, count);
+        for (uint32_t i = 0; i < count; i++) {
+            uint32_t value;
+            if (!reader.U32(offset + 5 + i * 4, &value))
+                break;
+            if (value != 0)
+                array->Set(context, i, MessageMaterialize(vmPtr, context, value, depth + 1)).FromMaybe(false);
+        }
+        return array;
+    }
+
+    if (tag == kMessageObject) {
+        if (!reader.U32(offset + 1, &count))
+            return Undefined(isolate);
+        Local<Object> object = Object::New(isolate);
+        for (uint32_t i = 0; i < count; i++) {
+            uint32_t entry = offset + 5 + i * 12;
+            uint32_t keyOffset, keyLength, value;
+            const char *k;
+            if (!reader.U32(entry, &keyOffset) || !reader.U32(entry + 4, &keyLength) || !reader.U32(entry + 8, &value) ||
+                (k = reader.Bytes(keyOffset, keyLength)) == nullptr)
+                break;
+            Local<String> key = String::NewFromUtf8(isolate, k, NewStringType::kNormal, keyLength).ToLocalChecked();
+            object->Set(context, key, MessageMaterialize(vmPtr, context, value, depth + 1)).FromMaybe(false);
+        }
+        return object;
+    }
+
+    return MessageValue(vmPtr, context, offset);
+}
+
+void v8goMessageMaterialize(const FunctionCallbackInfo<Value> &args) {
+    auto isolate = args.GetIsolate();
+    auto vmPtr = static_cast<VMPtr>(isolate->GetData(0));
+    uint32_t offset;
+    uint8_t tag;
+    // 只接受消息包装对象, 其他带两个内部字段的对象(如被 call/apply 借用时)直接忽略
+    if (vmPtr->messageTemplate.IsEmpty() || !vmPtr->messageTemplate.Get(isolate)->HasInstance(args.This()) ||
+        !MessageUnwrap(vmPtr, args.This(), &offset, &tag))
+        return;
+    args.GetReturnValue().Set(MessageMaterialize(vmPtr, isolate->GetCurrentContext(), offset, 0));
+}
+
+Local<Value> MessageValue(VMPtr vmPtr, Local<Context> context, uint32_t offset) {
+    Isolate *isolate = vmPtr->isolate;
+    MessageReader reader(vmPtr->messageData, vmPtr->messageLength);
+    uint8_t tag;
+    if (!reader.U8(offset, &tag))
+        return Undefined(isolate);
+
+    switch (tag) {
+        case kMessageNull:
+            return Null(isolate);
+        case kMessageFalse:
+            return False(isolate);
+        case kMessageTrue:
+            return True(isolate);
+        case kMessageNumber: {
+            double v;
+            if (!reader.F64(offset + 1, &v))
+                return Undefined(isolate);
+            return Number::New(isolate, v);
+        }
+        case kMessageString: {
+            uint32_t n;
+            const char *bytes;
+            if (!reader.U32(offset + 1, &n) || (bytes = reader.Bytes(offset + 5, n)) == nullptr)
+                return Undefined(isolate);
+            return String::NewFromUtf8(isolate, bytes, NewStringType::kNormal, n).ToLocalChecked();
+        }
+        case kMessageArray:
+        case kMessageObject:
+            break;
+        default:
+            return Undefined(isolate);
+    }
+
+    if (vmPtr->messageTemplate.IsEmpty()) {
+        Local<FunctionTemplate> tpl = FunctionTemplate::New(isolate);
+        Local<ObjectTemplate> instance = tpl->InstanceTemplate();
+        instance->SetInternalFieldCount(2);
+        instance->SetHandler(NamedPropertyHandlerConfiguration(
+                MessageNamedGetter, MessageSetter, MessageNamedQuery, nullptr, MessageNamedEnumerator,
+                Local<Value>(), PropertyHandlerFlags::kOnlyInterceptStrings));
+        instance->SetHandler(IndexedPropertyHandlerConfiguration(
+                MessageIndexedGetter, MessageIndexedSetter, MessageIndexedQuery, nullptr, MessageIndexedEnumerator));
+        Local<FunctionTemplate> materialize = FunctionTemplate::New(isolate, v8goMessageMaterialize);
+        tpl->PrototypeTemplate()->Set(isolate, "materialize", materialize);
+        vmPtr->messageTemplate.Reset(isolate, tpl);
+
+        // 数组包装对象的原型: 继承 Array.prototype, 同样带 materialize
+        Local<Object> arrayProto;
+        if (V8ArrayPrototype(context).ToLocal(&arrayProto)) {
+            Local<Object> proto = Object::New(isolate);
+            proto->SetPrototype(context, arrayProto).FromMaybe(false);
+            proto->Set(context, String::NewFromUtf8(isolate, "materialize").ToLocalChecked(),
+                       materialize->GetFunction(context).ToLocalChecked()).FromMaybe(false);
+            vmPtr->messageArrayPrototype.Reset(isolate, proto);
+        }
+    }
+
+    Local<Object> obj;
+    if (!vmPtr->messageTemplate.Get(isolate)->InstanceTemplate()->NewInstance(context).ToLocal(&obj)) {
+        return Undefined(isolate);
+    }
+    obj->SetInternalField(0, Integer::NewFromUnsigned(isolate, offset));
+    obj->SetInternalField(1, Integer::NewFromUnsigned(isolate, vmPtr->messageGeneration));
+    if (tag == kMessageArray && !vmPtr->messageArrayPrototype.IsEmpty()) {
+        obj->SetPrototype(context, vmPtr->messageArrayPrototype.Get(isolate)).FromMaybe(false);
+    }
+    return obj;
+}
+
+/*
+ * 取全局处理函数, 不存在时写入 last_exception 并返回 false.
+ */
+bool V8GetHandler(VMPtr vmPtr, Local<Context> context, const char *name, Local<Function> *handler) {
+    Local<Value> handlerVal;
+    if (!context->Global()->Get(context, String::NewFromUtf8(vmPtr->isolate, name).ToLocalChecked()).ToLocal(&handlerVal) ||
+        !handlerVal->IsFunction()) {
+        vmPtr->last_exception = std::string("'") + name + "' not found or it's not a function\n";
+        return false;
+    }
+    *handler = handlerVal.As<Function>();
+    return true;
+}
+
+/*
+ * 派发按 message.go 编码的消息. data 只在本次调用期间有效.
+ */
+int V8DispatchMessageBuffer(VMPtr vmPtr, uint64_t sessionId, const char *data, size_t len) {
+    Locker locker(vmPtr->isolate);
+    TraceSpan span(kTraceDispatch, "DispatchMessageBuffer", vmPtr, sessionId);
+    HandlerTimer timer(&vmPtr->stats, kHandlerMessage);
+    Isolate::Scope isolate_scope(vmPtr->isolate);
+    HandleScope handle_scope(vmPtr->isolate);
+    TryCatch try_catch(vmPtr->isolate);
+    Local<Context> context = Local<Context>::New(vmPtr->isolate, vmPtr->context);
+    Context::Scope context_scope(context);
+    OutboundScope outbound(vmPtr);
+
+    Local<Function> handler;
+    if (!V8GetHandler(vmPtr, context, "message", &handler)) {
+        timer.Fail();
+        return 2;
+    }
+
+    vmPtr->messageData = data;
+    vmPtr->messageLength = len;
+    vmPtr->messageGeneration++;
+
+    Local<Value> args[2];
+    args[0] = BigInt::NewFromUnsigned(vmPtr->isolate, sessionId);
+    args[1] = MessageValue(vmPtr, context, 0);
+    MaybeLocal<Value> result = handler->CallAsFunction(context, Undefined(vmPtr->isolate), 2, args);
+
+    vmPtr->messageData = nullptr;
+    vmPtr->messageLength = 0;
+    vmPtr->messageGeneration++;
+
+    if (result.IsEmpty()) {
+        assert(try_catch.HasCaught());
+        V8CaptureException(vmPtr, &try_catch);
+        timer.Fail();
+        return 2;
+    }
+    return result.ToLocalChecked()->Uint32Value(context).FromMaybe(-1);
+}
+
+/*
+ * 在当前虚拟机还原信封并交给 'message' 处理函数. 信封由调用方持有, 本函数不释放.
+ */
+int V8DispatchEnvelope(VMPtr vmPtr, uint64_t sessionId, V8EnvelopePtr envelope) {
+    Locker locker(vmPtr->isolate);
+    TraceSpan span(kTraceDispatch, "DispatchEnvelope", vmPtr, sessionId);
+    HandlerTimer timer(&vmPtr->stats, kHandlerMessage);
+    Isolate::Scope isolate_scope(vmPtr->isolate);
+    HandleScope handle_scope(vmPtr->isolate);
+    TryCatch try_catch(vmPtr->isolate);
+    Local<Context> context = Local<Context>::New(vmPtr->isolate, vmPtr->context);
+    Context::Scope context_scope(context);
+    OutboundScope outbound(vmPtr);
+
+    Local<Function> handler;
+    if (!V8GetHandler(vmPtr, context, "message", &handler)) {
+        timer.Fail();
+        return 2;
+    }
+    if (!envelope->transfers.empty() && envelope->consumed.exchange(true)) {
+        vmPtr->last_exception = "envelope with transferred ArrayBuffers has already been delivered\n";
+        timer.Fail();
+        return 2;
+    }
+
+    EnvelopeDeserializerDelegate delegate(envelope);
+    ValueDeserializer deserializer(vmPtr->isolate, envelope->data, envelope->length, &delegate);
+    Local<Value> value;
+    if (deserializer.ReadHeader(context).FromMaybe(false)) {
+        for (size_t i = 0; i < envelope->transfers.size(); i++) {
+            deserializer.TransferArrayBuffer(i, ArrayBuffer::New(vmPtr->isolate, envelope->transfers[i]));
+        }
+        value = deserializer.ReadValue(context).FromMaybe(Local<Value>());
+    }
+
+    MaybeLocal<Value> result;
+    if (!value.IsEmpty()) {
+        Local<Value> args[2];
+        args[0] = BigInt::NewFromUnsigned(vmPtr->isolate, sessionId);
+        args[1] = value;
+        result = handler->CallAsFunction(context, Undefined(vmPtr->isolate), 2, args);
+    }
+    if (result.IsEmpty()) {
+        assert(try_catch.HasCaught());
+        V8CaptureException(vmPtr, &try_catch);
+        timer.Fail();
+        return 2;
+    }
+    return result.ToLocalChecked()->Uint32Value(context).FromMaybe(-1);
+}
+
+/*
+ * 休眠: 调用脚本的 hibernate(sessionId) 取得会话状态并用 ValueSerializer 序列化.
+ * 成功时 *data 为 malloc 分配的缓冲区, 由调用方 free. 脚本未定义 hibernate 时返回 -1;
+ * 状态中不能包含 SharedArrayBuffer.
+ */
+int V8Hibernate(VMPtr vmPtr, uint64_t sessionId, uint8_t **data, size_t *len) {
+    *data = nullptr;
+    *len = 0;
+
+    Locker locker(vmPtr->isolate);
+    TraceSpan span(kTraceDispatch, "Hibernate", vmPtr, sessionId);
+    Isolate::Scope isolate_scope(vmPtr->isolate);
+    HandleScope handle_scope(vmPtr->isolate);
+    TryCatch try_catch(vmPtr->isolate);
+    Local<Context> context = Local<Context>::New(vmPtr->isolate, vmPtr->context);
+    Context::Scope context_scope(context);
+    OutboundScope outbound(vmPtr);
+
+    Local<Function> handler;
+    if (!V8GetHandler(vmPtr, context, "hibernate", &handler))
+        return -1;
+
+    Local<Value> args[1];
+    args[0] = BigInt::NewFromUnsigned(vmPtr->isolate, sessionId);
+    Local<Value> state;
+    V8EnvelopePtr envelope = nullptr;
+    if (handler->CallAsFunction(context, Undefined(vmPtr->isolate), 1, args).ToLocal(&state)) {
+        envelope = V8SerializeEnvelope(vmPtr->isolate, context, state, Local<Value>());
+    }
+    if (envelope != nullptr && !envelope->shared.empty()) {
+        V8ReleaseEnvelope(envelope);
+        envelope = nullptr;
+        vmPtr->isolate->ThrowException(Exception::TypeError(String::NewFromUtf8(vmPtr->isolate,
+                "SharedArrayBuffer cannot be part of hibernated state").ToLocalChecked()));
+    }
+    if (envelope == nullptr) {
+        assert(try_catch.HasCaught());
+        V8CaptureException(vmPtr, &try_catch);
+        return 2;
+    }
+
+    *data = envelope->data;
+    *len = envelope->length;
+    envelope->data = nullptr;
+    V8ReleaseEnvelope(envelope);
+    return 0;
+}
+
+/*
+ * 恢复: 还原 V8Hibernate 得到的状态并调用脚本的 resume(sessionId, state).
+ */
+int V8Resume(VMPtr vmPtr, uint64_t sessionId, const uint8_t *data, size_t len) {
+    Locker locker(vmPtr->isolate);
+    TraceSpan span(kTraceDispatch, "Resume", vmPtr, sessionId);
+    Isolate::Scope isolate_scope(vmPtr->isolate);
+    HandleScope handle_scope(vmPtr->isolate);
+    TryCatch try_catch(vmPtr->isolate);
+    Local<Context> context = Local<Context>::New(vmPtr->isolate, vmPtr->context);
+    Context::Scope context_scope(context);
+    OutboundScope outbound(vmPtr);
+
+    Local<Function> handler;
+    if (!V8GetHandler(vmPtr, context, "resume", &handler))
+        return -1;
+
+    ValueDeserializer deserializer(vmPtr->isolate, data, len);
+    Local<Value> state;
+    MaybeLocal<Value> result;
+    if (deserializer.ReadHeader(context).FromMaybe(false) && deserializer.ReadValue(context).ToLocal(&state)) {
+        Local<Value> args[2];
+        args[0] = BigInt::NewFromUnsigned(vmPtr->isolate, sessionId);
+        args[1] = state;
+        result = handler->CallAsFunction(context, Undefined(vmPtr->isolate), 2, args);
+    }
+    if (result.IsEmpty()) {
+        assert(try_catch.HasCaught());
+        V8CaptureException(vmPtr, &try_catch);
+        return 2;
+    }
+    return 0;
+}
+
+/*
+ * 虚拟机堆占用的内存(字节), 用于估算休眠节省的内存.
+ */
+size_t V8HeapSize(VMPtr vmPtr) {
+    Locker locker(vmPtr->isolate);
+    HeapStatistics hs;
+    vmPtr->isolate->GetHeapStatistics(&hs);
+    return hs.total_physical_size() + hs.external_memory();
+}
+
+/*
+ * 预热期间屏蔽 net.* 的所有发送, 脚本得到的返回值为 0.
+ */
+void V8SetSendMuted(VMPtr vmPtr, bool muted) {
+    vmPtr->sendMuted = muted;
+}
+
+/*
+ * 记录当前的定时器和动态导入, 之后由 V8DiscardPendingWork 取消标记之后新建的部分.
+ * 用于预热: 重放语料产生的定时器和导入不能在交付给真实会话后才触发.
+ */
+void V8MarkPendingWork(VMPtr vmPtr) {
+    Locker locker(vmPtr->isolate);
+    vmPtr->keptTimers.clear();
+    for (auto &kv : vmPtr->timers) {
+        vmPtr->keptTimers.push_back(kv.first);
+    }
+    vmPtr->keptImports.clear();
+    for (auto &kv : vmPtr->imports) {
+        vmPtr->keptImports.push_back(kv.first);
+    }
+}
+
+void V8DiscardPendingWork(VMPtr vmPtr) {
+    Locker locker(vmPtr->isolate);
+    for (auto it = vmPtr->timers.begin(); it != vmPtr->timers.end();) {
+        if (std::binary_search(vmPtr->keptTimers.begin(), vmPtr->keptTimers.end(), it->first)) {
+            ++it;
+            continue;
+        }
+        TimerService::Default().Cancel(vmPtr, it->first);
+        it = vmPtr->timers.erase(it);
+    }
+    // 加载线程上的导入无法撤回, 完成时找不到对应条目会被忽略
+    for (auto it = vmPtr->imports.begin(); it != vmPtr->imports.end();) {
+        if (std::binary_search(vmPtr->keptImports.begin(), vmPtr->keptImports.end(), it->first)) {
+            ++it;
+            continue;
+        }
+        vmPtr->importIds.erase(it->second.path);
+        it = vmPtr->imports.erase(it);
+    }
+    vmPtr->keptTimers.clear();
+    vmPtr->keptImports.clear();
+}
+
+/*
+ * JIT 代码事件回调, 只统计 TurboFan 生成的代码; V8 在代码名中以 '*' 标记优化后的函数.
+ */
+void V8TierUpEventHandler(const JitCodeEvent *event) {
+    if (event->type != JitCodeEvent::CODE_ADDED || event->code_type != JitCodeEvent::JIT_CODE || event->isolate == nullptr)
+        return;
+    auto vmPtr = static_cast<VMPtr>(event->isolate->GetData(0));
+    if (vmPtr == nullptr)
+        return;
+
+    const char *name = event->name.str;
+    size_t len = event->name.len;
+    const char *colon = static_cast<const char *>(memchr(name, ':', len));
+    if (colon == nullptr || colon + 1 >= name + len || colon[1] != '*')
+        return;
+
+    vmPtr->optimizedCount++;
+    if (vmPtr->optimizedFunctions.size() < 1024) {
+        vmPtr->optimizedFunctions.emplace_back(colon + 2, name + len - colon - 2);
+    }
+}
+
+/*
+ * 开始/停止记录函数的优化(tier-up), 开始时清空之前的记录.
+ */
+void V8TraceTierUp(VMPtr vmPtr, bool enabled) {
+    Locker locker(vmPtr->isolate);
+    Isolate::Scope isolate_scope(vmPtr->isolate);
+    if (enabled == vmPtr->tracingTierUp)
+        return;
+    if (enabled) {
+        vmPtr->optimizedCount = 0;
+        vmPtr->optimizedFunctions.clear();
+    }
+    vmPtr->tracingTierUp = enabled;
+    vmPtr->isolate->SetJitCodeEventHandler(kJitCodeEventDefault, enabled ? V8TierUpEventHandler : nullptr);
+}
+
+void V8GetTierUpStats(VMPtr vmPtr, V8TierUpStats *stats) {
+    Locker locker(vmPtr->isolate);
+    HeapCodeStatistics hcs;
+    vmPtr->isolate->GetHeapCodeAndMetadataStatistics(&hcs);
+    stats->optimized = vmPtr->optimizedCount;
+    stats->codeBytes = hcs.code_and_metadata_size();
+    stats->bytecodeBytes = hcs.bytecode_and_metadata_size();
+}
+
+/*
+ * 记录期间被优化的函数名(含脚本位置), 最多 1024 条.
+ */
+V8StringArraysPtr V8GetOptimizedFunctions(VMPtr vmPtr) {
+    Locker locker(vmPtr->isolate);
+    auto arrays = new V8StringArrays;
+    arrays->strs = vmPtr->optimizedFunctions;
+    return arrays;
+}
+
+int V8DispatchMessageEvent(VMPtr vmPtr, uint64_t sessionId, VMValuePtr vmValuePtr) {
+    Locker locker(vmPtr->isolate);
+    TraceSpan span(kTraceDispatch, "DispatchMessage", vmPtr, sessionId);
+    HandlerTimer timer(&vmPtr->stats, kHandlerMessage);
+    HandleScope handle_scope(vmPtr->isolate);
+    TryCatch try_catch(vmPtr->isolate);
+    Local<Context> context = Local<Context>::New(vmPtr->isolate, vmPtr->context);
+    Context::Scope context_scope(context);
+    OutboundScope outbound(vmPtr);
+    auto global = context->Global();
+
+    MaybeLocal<Value> maybeEnterVal = global->Get(context, String::NewFromUtf8(vmPtr->isolate, "message").ToLocalChecked());
+    if (maybeEnterVal.IsEmpty()) {
+        std::string out = "'message' not found\n";
+        vmPtr->last_exception = out;
+        timer.Fail();
+        return 2;
+    }
+    Local<Value> enterVal = maybeEnterVal.ToLocalChecked();
+    if(!enterVal->IsFunction()) {
+        std::string out = "'message' found, but it's not a function\n";
+        vmPtr->last_exception = out;
+        timer.Fail();
+        return 2;
+    }
+
+    Local<Function> enter = Local<Function>::Cast(enterVal);
+    if (!enter->IsCallable()) {
+        std::string out = "'message' found, but it's not a callable\n";
+        vmPtr->last_exception = out;
+        timer.Fail();
+        return 2;
+    }
+
+    Local<Value> args[2];
+    args[0] = BigInt::NewFromUnsigned(vmPtr->isolate, sessionId);
+    args[1] = vmValuePtr->value.Get(vmPtr->isolate);
+    MaybeLocal<Value> result = enter->CallAsFunction(context, Undefined(vmPtr->isolate), 2, args);
+    if(result.IsEmpty()) {
+        assert(try_catch.HasCaught());
+        V8CaptureException(vmPtr, &try_catch);
+        timer.Fail();
+        return 2;
+    }
+    return result.ToLocalChecked()->Uint32Value(context).FromMaybe(-1);
+}
+
+VMValuePtr V8CreateVMObject(VMPtr vmPtr) {
+    Locker locker(vmPtr->isolate);
+    HandleScope handle_scope(vmPtr->isolate);
+    TryCatch try_catch(vmPtr->isolate);
+    Local<Context> context = Local<Context>::New(vmPtr->isolate, vmPtr->context);
+    Context::Scope context_scope(context);
+
+    Local<Object> o = ObjectTemplate::New(vmPtr->isolate)->NewInstance(context).ToLocalChecked();
+    VMValuePtr vmValuePtr = new VMValue;
+    vmValuePtr->value.Reset(vmPtr->isolate, o);
+    vmValuePtr->kind = v8KindObject;
+    return vmValuePtr;
+}
+
+VMValuePtr V8CreateVMArray(VMPtr vmPtr, int length) {
+    Locker locker(vmPtr->isolate);
+    HandleScope handle_scope(vmPtr->isolate);
+    TryCatch try_catch(vmPtr->isolate);
+    Local<Context> context = Local<Context>::New(vmPtr->isolate, vmPtr->context);
+    Context::Scope context_scope(context);
+
+    Local<Array> o = Array::New(vmPtr->isolate, length);
+    auto vmValuePtr = new VMValue;
+    vmValuePtr->value.Reset(vmPtr->isolate, o);
+    vmValuePtr->kind = v8KindArray;
+    return vmValuePtr;
+}
+
+void V8DisposeVMValue(VMValuePtr vmValuePtr) {
+    vmValuePtr->value.Reset();
+    delete vmValuePtr;
+}
+
+unsigned int V8GetVMValueKind(VMValuePtr vmValuePtr) {
+    return vmValuePtr->kind;
+}
+
+void V8ObjectSetString(VMPtr vmPtr, VMValuePtr o, const char *name, const char *val) {
+    Locker locker(vmPtr->isolate);
+    HandleScope handle_scope(vmPtr->isolate);
+    TryCatch try_catch(vmPtr->isolate);
+    Local<Context> context = Local<Context>::New(vmPtr->isolate, vmPtr->context);
+    Context::Scope context_scope(context);
+
+    Local<Object> oo = Local<Value>::New(vmPtr->isolate, o->value)->ToObject(context).ToLocalChecked();
+    auto success = oo->Set(context, String::NewFromUtf8(vmPtr->isolate, name).ToLocalChecked(), String::NewFromUtf8(vmPtr->isolate, val).ToLocalChecked());
+}
+
+void V8ObjectSetStringForIndex(VMPtr vmPtr, VMValuePtr o, int index, const char *val) {
+    Locker locker(vmPtr->isolate);
+    HandleScope handle_scope(vmPtr->isolate);
+    TryCatch try_catch(vmPtr->isolate);
+    Local<Context> context = Local<Context>::New(vmPtr->isolate, vmPtr->context);
+    Context::Scope context_scope(context);
+
+    Local<Object> oo = Local<Value>::New(vmPtr->isolate, o->value)->ToObject(context).ToLocalChecked();
+    auto success = oo->Set(context, (uint32_t)index, String::NewFromUtf8(vmPtr->isolate, val).ToLocalChecked());
+}
+
+void V8ObjectSetInteger(VMPtr vmPtr, VMValuePtr o, const char *name, int64_t val) {
+    Locker locker(vmPtr->isolate);
+    HandleScope handle_scope(vmPtr->isolate);
+    TryCatch try_catch(vmPtr->isolate);
+    Local<Context> context = Local<Context>::New(vmPtr->isolate, vmPtr->context);
+    Context::Scope context_scope(context);
+
+    Local<Object> oo = Local<Value>::New(vmPtr->isolate, o->value)->ToObject(context).ToLocalChecked();
+    auto success = oo->Set(context, String::NewFromUtf8(vmPtr->isolate, name).ToLocalChecked(), Number::New(vmPtr->isolate, val));
+}
+
+void V8ObjectSetIntegerForIndex(VMPtr vmPtr, VMValuePtr o, int index, int64_t val) {
+    Locker locker(vmPtr->isolate);
+    HandleScope handle_scope(vmPtr->isolate);
+    TryCatch try_catch(vmPtr->isolate);
+    Local<Context> context = Local<Context>::New(vmPtr->isolate, vmPtr->context);
+    Context::Scope context_scope(context);
+
+    Local<Object> oo = Local<Value>::New(vmPtr->isolate, o->value)->ToObject(context).ToLocalChecked();
+    auto success = oo->Set(context, (uint32_t)index, Number::New(vmPtr->isolate, val));
+}
+
+void V8ObjectSetValue(VMPtr vmPtr, VMValuePtr o, const char *name, VMValuePtr val) {
+    Locker locker(vmPtr->isolate);
+    HandleScope handle_scope(vmPtr->isolate);
+    TryCatch try_catch(vmPtr->isolate);
+    Local<Context> context = Local<Context>::New(vmPtr->isolate, vmPtr->context);
+    Context::Scope context_scope(context);
+
+    Local<Object> oo = Local<Value>::New(vmPtr->isolate, o->value)->ToObject(context).ToLocalChecked();
+    Local<Value> vv = Local<Value>::New(vmPtr->isolate, val->value);
+    auto success = oo->Set(context, String::NewFromUtf8(vmPtr->isolate, name).ToLocalChecked(), vv);
+}
+
+void V8ObjectSetValueForIndex(VMPtr vmPtr, VMValuePtr o, int index, VMValuePtr val) {
+    Locker locker(vmPtr->isolate);
+    HandleScope handle_scope(vmPtr->isolate);
+    TryCatch try_catch(vmPtr->isolate);
+    Local<Context> context = Local<Context>::New(vmPtr->isolate, vmPtr->context);
+    Context::Scope context_scope(context);
+
+    Local<Object> oo = Local<Value>::New(vmPtr->isolate, o->value)->ToObject(context).ToLocalChecked();
+    Local<Value> vv = val->value.Get(vmPtr->isolate);
+    auto success = oo->Set(context, (uint32_t)index, vv);
+}
+
+void V8ObjectSetFloat(VMPtr vmPtr, VMValuePtr o, const char *name, double val) {
+    Locker locker(vmPtr->isolate);
+    HandleScope handle_scope(vmPtr->isolate);
+    TryCatch try_catch(vmPtr->isolate);
+    Local<Context> context = Local<Context>::New(vmPtr->isolate, vmPtr->context);
+    Context::Scope context_scope(context);
+
+    Local<Object> oo = Local<Value>::New(vmPtr->isolate, o->value)->ToObject(context).ToLocalChecked();
+    auto success = oo->Set(context, String::NewFromUtf8(vmPtr->isolate, name).ToLocalChecked(), Number::New(vmPtr->isolate, val));
+}
+
+void V8ObjectSetFloatForIndex(VMPtr vmPtr, VMValuePtr o, int index, double val) {
+    Locker locker(vmPtr->isolate);
+    HandleScope handle_scope(vmPtr->isolate);
+    TryCatch try_catch(vmPtr->isolate);
+    Local<Context> context = Local<Context>::New(vmPtr->isolate, vmPtr->context);
+    Context::Scope context_scope(context);
+
+    Local<Object> oo = Local<Value>::New(vmPtr->isolate, o->value)->ToObject(context).ToLocalChecked();
+    auto success = oo->Set(context, (uint32_t)index, Number::New(vmPtr->isolate, val));
+}
+
+void V8ObjectSetBoolean(VMPtr vmPtr, VMValuePtr o, const char *name, bool val) {
+    Locker locker(vmPtr->isolate);
+    HandleScope handle_scope(vmPtr->isolate);
+    TryCatch try_catch(vmPtr->isolate);
+    Local<Context> context = Local<Context>::New(vmPtr->isolate, vmPtr->context);
+    Context::Scope context_scope(context);
+
+    Local<Object> oo = Local<Value>::New(vmPtr->isolate, o->value)->ToObject(context).ToLocalChecked();
+    auto success = oo->Set(context, String::NewFromUtf8(vmPtr->isolate, name).ToLocalChecked(), val ? True(vmPtr->isolate) : False(vmPtr->isolate));
+}
+
+void V8ObjectSetBooleanForIndex(VMPtr vmPtr, VMValuePtr o, int index, bool val) {
+    Locker locker(vmPtr->isolate);
+    HandleScope handle_scope(vmPtr->isolate);
+    TryCatch try_catch(vmPtr->isolate);
+    Local<Context> context = Local<Context>::New(vmPtr->isolate, vmPtr->context);
+    Context::Scope context_scope(context);
+
+    Local<Object> oo = Local<Value>::New(vmPtr->isolate, o->value)->ToObject(context).ToLocalChecked();
+    auto success = oo->Set(context, (uint32_t)index, val ? True(vmPtr->isolate) : False(vmPtr->isolate));
+}
+
+V8StringArraysPtr V8ObjectGetKeys(VMPtr vmPtr, VMValuePtr o) {
+    Locker locker(vmPtr->isolate);
+    HandleScope handle_scope(vmPtr->isolate);
+    TryCatch try_catch(vmPtr->isolate);
+    Local<Context> context = Local<Context>::New(vmPtr->isolate, vmPtr->context);
+    Context::Scope context_scope(context);
+
+    Local<Object> oo = Local<Value>::New(vmPtr->isolate, o->value)->ToObject(context).ToLocalChecked();
+    Local<Array> v8keys = oo->GetPropertyNames(context).ToLocalChecked();
+    auto strings = new V8StringArrays;
+    strings->strs.resize(v8keys->Length());
+    for (int i = 0; i < v8keys->Length(); i ++) {
+        String::Utf8Value str(vmPtr->isolate, v8keys->Get(context, i).ToLocalChecked());
+        strings->strs[i] = V8ToCString(str);
+    }
+    return strings;
+}
+
+size_t V8ObjectGetLength(VMPtr vmPtr, VMValuePtr o) {
+    Locker locker(vmPtr->isolate);
+    HandleScope handle_scope(vmPtr->isolate);
+    TryCatch try_catch(vmPtr->isolate);
+    Local<Context> context = Local<Context>::New(vmPtr->isolate, vmPtr->context);
+    Context::Scope context_scope(context);
+
+    Local<Object> oo = Local<Value>::New(vmPtr->isolate, o->value)->ToObject(context).ToLocalChecked();
+    Local<Array> array = Local<Array>::Cast(oo);
+    return (size_t) array->Length();
+}
+
+VMValuePtr V8GetObjectValue(VMPtr vmPtr, VMValuePtr o, const char *key) {
+    Locker locker(vmPtr->isolate);
+    HandleScope handle_scope(vmPtr->isolate);
+    TryCatch try_catch(vmPtr->isolate);
+    Local<Context> context = Local<Context>::New(vmPtr->isolate, vmPtr->context);
+    Context::Scope context_scope(context);
+
+    Local<Value> v8Key = String::NewFromUtf8(vmPtr->isolate, key).ToLocalChecked();
+
+    Local<Object> oo = Local<Value>::New(vmPtr->isolate, o->value)->ToObject(context).ToLocalChecked();
+    Local<Value> v = oo->Get(context, v8Key).ToLocalChecked();
+
+    unsigned int kind = v8KindStart;
+
+    if (v->IsString())
+        kind |= v8KindString;
+    if (v->IsInt32())
+        kind |= v8KindInt;
+    if (v->IsBigInt())
+        kind |= v8KindBigInt;
+    if (v->IsBoolean())
+        kind |= v8KindBool;
+    if (v->IsUint32())
+        kind |= v8KindUint;
+    if (v->IsNumber()) {
+        kind |= v8KindNumber;
+        if (kind == v8KindNumber) {
+            MaybeLocal<Number> iValue = v->ToNumber(context);
+            if (!iValue.IsEmpty()) {
+                auto db = iValue.ToLocalChecked()->Value();
+                if (db == (double)(int64_t)db) {
+                    kind |= v8KindInt;
+                } else if (db == (double)(uint64_t)db) {
+                    kind |= v8KindUint;
+                }
+            }
+        }
+    }
+    if (v->IsObject())
+        kind |= v8KindObject;
+    if (v->IsArray())
+        kind |= v8KindArray;
+    if (v->IsNull())
+        kind |= v8KindNull;
+    if (v->IsUndefined())
+        kind |= v8KindUndefined;
+
+    auto vmValuePtr = new VMValue;
+    vmValuePtr->value.Reset(vmPtr->isolate, v);
+    vmValuePtr->kind = kind;
+    return vmValuePtr;
+}
+
+VMValuePtr V8GetObjectValueAtIndex(VMPtr vmPtr, VMValuePtr o, uint32_t index) {
+    Locker locker(vmPtr->isolate);
+    HandleScope handle_scope(vmPtr->isolate);
+    TryCatch try_catch(vmPtr->isolate);
+    Local<Context> context = Local<Context>::New(vmPtr->isolate, vmPtr->context);
+    Context::Scope context_scope(context);
+
+
+    Local<Object> oo = Local<Value>::New(vmPtr->isolate, o->value)->ToObject(context).ToLocalChecked();
+    Local<Value> v = oo->Get(context, index).ToLocalChecked();
+
+    unsigned int kind = v8KindStart;
+
+    if (v->IsString())
+        kind |= v8KindString;
+    if (v->IsInt32())
+        kind |= v8KindInt;
+    if (v->IsBigInt())
+        kind |= v8KindBigInt;
+    if (v->IsBoolean())
+        kind |= v8KindBool;
+    if (v->IsUint32())
+        kind |= v8KindUint;
+    if (v->IsNumber()) {
+        kind |= v8KindNumber;
+        if (kind == v8KindNumber) {
+            MaybeLocal<Number> iValue = v->ToNumber(context);
+            if (!iValue.IsEmpty()) {
+                auto db = iValue.ToLocalChecked()->Value();
+                if (db == (double)(int64_t)db) {
+                    kind |= v8KindInt;
+                } else if (db == (double)(uint64_t)db) {
+                    kind |= v8KindUint;
+                }
+            }
+        }
+    }
+    if (v->IsObject())
+        kind |= v8KindObject;
+    if (v->IsArray())
+        kind |= v8KindArray;
+    if (v->IsNull())
+        kind |= v8KindNull;
+    if (v->IsUndefined())
+        kind |= v8KindUndefined;
+
+    auto vmValuePtr = new VMValue;
+    vmValuePtr->value.Reset(vmPtr->isolate, v);
+    vmValuePtr->kind = kind;
+    return vmValuePtr;
+}
+
+
+const char *V8ValueAsString(VMPtr vmPtr, VMValuePtr o, const char *def) {
+    Locker locker(vmPtr->isolate);
+    HandleScope handle_scope(vmPtr->isolate);
+    TryCatch try_catch(vmPtr->isolate);
+    Local<Context> context = Local<Context>::New(vmPtr->isolate, vmPtr->context);
+    Context::Scope context_scope(context);
+
+    Local<Value> v = Local<Value>::New(vmPtr->isolate, o->value);
+    String::Utf8Value utf8Value(vmPtr->isolate, v);
+    return V8ToCString(utf8Value);
+}
+
+int64_t V8ValueAsInt(VMPtr vmPtr, VMValuePtr o, int64_t def) {
+    Locker locker(vmPtr->isolate);
+    HandleScope handle_scope(vmPtr->isolate);
+    TryCatch try_catch(vmPtr->isolate);
+    Local<Context> context = Local<Context>::New(vmPtr->isolate, vmPtr->context);
+    Context::Scope context_scope(context);
+
+    Local<Value> v = Local<Value>::New(vmPtr->isolate, o->value);
+    if(v->IsNumber()) {
+        MaybeLocal<Number> iValue = v->ToNumber(context);
+        if (iValue.IsEmpty())
+            return def;
+        return (int64_t)iValue.ToLocalChecked()->Value();
+    }
+    return def;
+}
+
+uint64_t V8ValueAsUint(VMPtr vmPtr, VMValuePtr o, uint64_t def) {
+    Locker locker(vmPtr->isolate);
+    HandleScope handle_scope(vmPtr->isolate);
+    TryCatch try_catch(vmPtr->isolate);
+    Local<Context> context = Local<Context>::New(vmPtr->isolate, vmPtr->context);
+    Context::Scope context_scope(context);
+
+    Local<Value> v = Local<Value>::New(vmPtr->isolate, o->value);
+    if(v->IsNumber()) {
+        MaybeLocal<Number> iValue = v->ToNumber(context);
+        if (iValue.IsEmpty())
+            return def;
+        return (uint64_t)iValue.ToLocalChecked()->Value();
+    }
+    return def;
+}
+
+double V8ValueAsFloat(VMPtr vmPtr, VMValuePtr o, double def) {
+    Locker locker(vmPtr->isolate);
+    HandleScope handle_scope(vmPtr->isolate);
+    TryCatch try_catch(vmPtr->isolate);
+    Local<Context> context = Local<Context>::New(vmPtr->isolate, vmPtr->context);
+    Context::Scope context_scope(context);
+
+    Local<Value> v = Local<Value>::New(vmPtr->isolate, o->value);
+    if(v->IsNumber()) {
+        MaybeLocal<Number> iValue = v->ToNumber(context);
+        if (iValue.IsEmpty())
+            return def;
+        return iValue.ToLocalChecked()->Value();
+    }
+
+    return def;
+}
+
+bool V8ValueAsBoolean(VMPtr vmPtr, VMValuePtr o, bool def) {
+    Locker locker(vmPtr->isolate);
+    HandleScope handle_scope(vmPtr->isolate);
+    TryCatch try_catch(vmPtr->isolate);
+    Local<Context> context = Local<Context>::New(vmPtr->isolate, vmPtr->context);
+    Context::Scope context_scope(context);
+
+    Local<Value> v = Local<Value>::New(vmPtr->isolate, o->value);
+    if(v->IsBoolean()) {
+        MaybeLocal<Boolean> iValue = v->ToBoolean(vmPtr->isolate);
+        if (iValue.IsEmpty())
+            return def;
+        return iValue.ToLocalChecked()->Value();
+    } else if (v->IsInt32() || v->IsUint32()) {
+        MaybeLocal<Integer> iValue = v->ToInteger(context);
+        if (iValue.IsEmpty())
+            return def;
+        return iValue.ToLocalChecked()->Value() != 0;
+    }
+
+    return def;
+}
+
+/*
+ * UTF-8 与 inspector StringView(Latin-1 或 UTF-16) 之间的转换.
+ */
+std::u16string UTF8ToUTF16(const char *s, size_t len) {
+    std::u16string out;
+    out.reserve(len);
+    for (size_t i = 0; i < len;) {
+        unsigned char c = (unsigned char)s[i];
+        uint32_t cp;
+        int n;
+        if (c < 0x80) {
+            cp = c;
+            n = 1;
+        } else if ((c & 0xe0) == 0xc0) {
+            cp = c & 0x1f;
+            n = 2;
+        } else if ((c & 0xf0) == 0xe0) {
+            cp = c & 0x0f;
+            n = 3;
+        } else {
+            cp = c & 0x07;
+            n = 4;
+        }
+        if (i + n > len) {
+            break;
+        }
+        for (int k = 1; k < n; k++) {
+            cp = (cp << 6) | ((unsigned char)s[i + k] & 0x3f);
+        }
+        i += n;
+
+        if (cp >= 0x10000) {
+            cp -= 0x10000;
+            out += (char16_t)(0xd800 + (cp >> 10));
+            out += (char16_t)(0xdc00 + (cp & 0x3ff));
+        } else {
+            out += (char16_t)cp;
+        }
+    }
+    return out;
+}
+
+void AppendUTF8(std::string &out, uint32_t cp) {
+    if (cp < 0x80) {
+        out += (char)cp;
+    } else if (cp < 0x800) {
+        out += (char)(0xc0 | (cp >> 6));
+        out += (char)(0x80 | (cp & 0x3f));
+    } else if (cp < 0x10000) {
+        out += (char)(0xe0 | (cp >> 12));
+        out += (char)(0x80 | ((cp >> 6) & 0x3f));
+        out += (char)(0x80 | (cp & 0x3f));
+    } else {
+        out += (char)(0xf0 | (cp >> 18));
+        out += (char)(0x80 | ((cp >> 12) & 0x3f));
+        out += (char)(0x80 | ((cp >> 6) & 0x3f));
+        out += (char)(0x80 | (cp & 0x3f));
+    }
+}
+
+std::string StringViewToUTF8(const v8_inspector::StringView &view) {
+    std::string out;
+    out.reserve(view.length());
+    if (view.is8Bit()) {
+        for (size_t i = 0; i < view.length(); i++) {
+            AppendUTF8(out, view.characters8()[i]);
+        }
+        return out;
+    }
+
+    const uint16_t *c = view.characters16();
+    for (size_t i = 0; i < view.length(); i++) {
+        uint32_t cp = c[i];
+        if (cp >= 0xd800 && cp < 0xdc00 && i + 1 < view.length() && c[i + 1] >= 0xdc00 && c[i + 1] < 0xe000) {
+            cp = 0x10000 + ((cp - 0xd800) << 10) + (c[i + 1] - 0xdc00);
+            i++;
+        }
+        AppendUTF8(out, cp);
+    }
+    return out;
+}
+
+/*
+ * DevTools 调试会话, 每个虚拟机最多一个. 只在有客户端连接时创建, 断开即销毁,
+ * 因此没有连接时不会给虚拟机带来任何开销.
+ * 协议消息由 Go 侧投递到队列, 只在持有 Locker 的线程上处理: 脚本执行中由 RequestInterrupt 回调处理,
+ * 空闲时由 V8RunTimers 处理; 断点暂停时执行线程停在 runMessageLoopOnPause 中, 直接从队列取消息处理.
+ */
+class V8GoInspector : public v8_inspector::V8InspectorClient, public v8_inspector::V8Inspector::Channel {
+public:
+    static const int kContextGroupId = 1;
+
+    explicit V8GoInspector(VMPtr vmPtr) : vmPtr(vmPtr), quit(false), closing(false), busy(false) {
+        HandleScope handle_scope(vmPtr->isolate);
+        Local<Context> context = Local<Context>::New(vmPtr->isolate, vmPtr->context);
+
+        inspector = v8_inspector::V8Inspector::create(vmPtr->isolate, this);
+        const char name[] = "v8go";
+        inspector->contextCreated(v8_inspector::V8ContextInfo(context, kContextGroupId,
+                v8_inspector::StringView((const uint8_t *)name, sizeof(name) - 1)));
+        session = inspector->connect(kContextGroupId, this, v8_inspector::StringView());
+    }
+
+    ~V8GoInspector() override {
+        session.reset();
+        inspector.reset();
+    }
+
+    void Post(const char *msg, size_t len) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            incoming.emplace_back(msg, len);
+        }
+        cv.notify_one();
+    }
+
+    /*
+     * 通知暂停中的消息循环客户端即将断开, 之后不再处理新消息.
+     */
+    void Close() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            closing = true;
+            incoming.clear();
+        }
+        cv.notify_one();
+    }
+
+    bool Closed() {
+        std::lock_guard<std::mutex> lock(mutex);
+        return closing;
+    }
+
+    /*
+     * 必须持有 Locker. 协议消息执行的脚本可能再次触发中断回调, 此时交给外层循环处理.
+     */
+    void DispatchPending() {
+        if (busy) {
+            return;
+        }
+        busy = true;
+        for (;;) {
+            std::deque<std::string> messages;
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                messages.swap(incoming);
+            }
+            if (messages.empty()) {
+                break;
+            }
+            for (auto &msg : messages) {
+                Dispatch(msg);
+            }
+        }
+        busy = false;
+    }
+
+    void runMessageLoopOnPause(int contextGroupId) override {
+        std::unique_lock<std::mutex> lock(mutex);
+        bool wasBusy = busy;
+        busy = true;
+        quit = false;
+
+        while (!quit) {
+            cv.wait(lock, [this] { return !incoming.empty() || closing; });
+            if (closing) {
+                lock.unlock();
+                session->resume();
+                lock.lock();
+                break;
+            }
+
+            std::deque<std::string> messages;
+            messages.swap(incoming);
+            lock.unlock();
+            for (auto &msg : messages) {
+                Dispatch(msg);
+            }
+            lock.lock();
+        }
+        busy = wasBusy;
+    }
+
+    void quitMessageLoopOnPause() override {
+        quit = true;
+    }
+
+    Local<Context> ensureDefaultContextInGroup(int contextGroupId) override {
+        return Local<Context>::New(vmPtr->isolate, vmPtr->context);
+    }
+
+    double currentTimeMS() override {
+        return std::chrono::duration_cast<std::chrono::milliseconds>(
+                std::chrono::system_clock::now().time_since_epoch()).count();
+    }
+
+    void sendResponse(int callId, std::unique_ptr<v8_inspector::StringBuffer> message) override {
+        Send(message->string());
+    }
+
+    void sendNotification(std::unique_ptr<v8_inspector::StringBuffer> message) override {
+        Send(message->string());
+    }
+
+    void flushProtocolNotifications() override {}
+
+private:
+    void Dispatch(const std::string &msg) {
+        HandleScope handle_scope(vmPtr->isolate);
+        Local<Context> context = Local<Context>::New(vmPtr->isolate, vmPtr->context);
+        Context::Scope context_scope(context);
+
+        bool ascii = true;
+        for (auto c : msg) {
+            if ((unsigned char)c >= 0x80) {
+                ascii = false;
+                break;
+            }
+        }
+
+        if (ascii) {
+            session->dispatchProtocolMessage(v8_inspector::StringView((const uint8_t *)msg.data(), msg.length()));
+        } else {
+            std::u16string wide = UTF8ToUTF16(msg.data(), msg.length());
+            session->dispatchProtocolMessage(v8_inspector::StringView((const uint16_t *)wide.data(), wide.length()));
+        }
+    }
+
+    void Send(const v8_inspector::StringView &view) {
+        std::string out = StringViewToUTF8(view);
+#ifdef GOOUTPUT
+        GoInspectorSend(vmPtr, (char *)out.data(), (int)out.length());
+#endif
+    }
+
+    VMPtr vmPtr;
+    std::unique_ptr<v8_inspector::V8Inspector> inspector;
+    std::unique_ptr<v8_inspector::V8InspectorSession> session;
+    std::mutex mutex;
+    std::condition_variable cv;
+    std::deque<std::string> incoming;
+    bool quit;
+    bool closing;
+    bool busy;
+};
+
+/*
+ * 从虚拟机上摘下调试会话并销毁, 必须持有 Locker.
+ */
+static void V8InspectorRelease(VMPtr vmPtr) {
+    V8GoInspector *inspector;
+    {
+        std::lock_guard<std::mutex> lock(vmPtr->inspectorMutex);
+        inspector = vmPtr->inspector;
+        vmPtr->inspector = nullptr;
+    }
+    if (inspector != nullptr) {
+        HandleScope handle_scope(vmPtr->isolate);
+        delete inspector;
+    }
+}
+
+/*
+ * 处理已投递的协议消息, 客户端已断开时销毁会话. 必须持有 Locker, 且不能在脚本执行中调用.
+ */
+void V8InspectorService(VMPtr vmPtr) {
+    V8GoInspector *inspector = vmPtr->inspector;
+    if (inspector == nullptr) {
+        return;
+    }
+    if (inspector->Closed()) {
+        V8InspectorRelease(vmPtr);
+        return;
+    }
+    inspector->DispatchPending();
+}
+
+/*
+ * 脚本执行中到达的协议消息由中断回调处理, 这里只分发消息, 销毁留给 V8InspectorService.
+ */
+static void V8InspectorInterrupt(Isolate *isolate, void *data) {
+    VMPtr vmPtr = static_cast<VMPtr>(data);
+    V8GoInspector *inspector = vmPtr->inspector;
+    if (inspector != nullptr && !inspector->Closed()) {
+        inspector->DispatchPending();
+    }
+}
+
+/*
+ * 为虚拟机建立 DevTools 会话. 返回 0 成功, 1 已有客户端连接.
+ */
+int V8InspectorConnect(VMPtr vmPtr) {
+    Locker locker(vmPtr->isolate);
+    Isolate::Scope isolate_scope(vmPtr->isolate);
+
+    if (vmPtr->inspector != nullptr) {
+        if (!vmPtr->inspector->Closed()) {
+            return 1;
+        }
+        V8InspectorRelease(vmPtr);
+    }
+    V8GoInspector *inspector = new V8GoInspector(vmPtr);
+    std::lock_guard<std::mutex> lock(vmPtr->inspectorMutex);
+    vmPtr->inspector = inspector;
+    return 0;
+}
+
+/*
+ * 投递一条协议消息, 不需要持有 isolate, 可以在任意线程调用.
+ * 暂停中的消息循环会被直接唤醒; 正在执行脚本时通过中断回调处理;
+ * 虚拟机空闲时由调用方安排一次 V8RunTimers.
+ */
+void V8InspectorPost(VMPtr vmPtr, const char *msg, size_t len) {
+    std::lock_guard<std::mutex> lock(vmPtr->inspectorMutex);
+    V8GoInspector *inspector = vmPtr->inspector;
+    if (inspector != nullptr && !inspector->Closed()) {
+        inspector->Post(msg, len);
+        vmPtr->inspectorPending = true;
+        vmPtr->isolate->RequestInterrupt(V8InspectorInterrupt, vmPtr);
+    }
+}
+
+/*
+ * 客户端断开, 不需要持有 isolate, 不会阻塞. 停在断点上的虚拟机会恢复执行,
+ * 会话在下一次 V8RunTimers 或 V8InspectorConnect 时销毁.
+ */
+void V8InspectorClose(VMPtr vmPtr) {
+    std::lock_guard<std::mutex> lock(vmPtr->inspectorMutex);
+    if (vmPtr->inspector != nullptr) {
+        vmPtr->inspector->Close();
+        vmPtr->inspectorPending = true;
+    }
+}
+
+/*
+ * 断开并销毁 DevTools 会话, 若虚拟机停在断点上会先恢复执行.
+ */
+void V8InspectorDisconnect(VMPtr vmPtr) {
+    V8InspectorClose(vmPtr);
+    if (vmPtr->inspector == nullptr) {
+        return;
+    }
+
+    Locker locker(vmPtr->isolate);
+    Isolate::Scope isolate_scope(vmPtr->isolate);
+    V8InspectorRelease(vmPtr);
+}
+
+bool ReadModuleSource(const std::string &path, std::string &out);
+
+/*
+ * 初始化V8运行环境, 请注意，此处是初始化V8环境，并没有创建任何虚拟机上下文.
+ */
+std::unique_ptr<Platform> _priv_platform;
+std::string globalCWD;
+
+/*
+ * 进程级执行配置, 必须在 V8Init 之前设置.
+ */
+int executionProfile = v8ProfileDefault;
+std::string executionFlags;
+
+void V8SetExecutionProfile(int profile, const char *extraFlags) {
+    executionProfile = profile;
+    executionFlags = extraFlags != nullptr ? extraFlags : "";
+}
+
+int V8GetExecutionProfile() {
+    return executionProfile;
+}
+
+/*
+ * 后台任务线程数与外部调度器, 必须在 V8Init 之前设置.
+ */
+int platformWorkers = 0;
+bool platformScheduler = false;
+
+void V8SetPlatformOptions(int workers, bool scheduler) {
+    platformWorkers = workers;
+    platformScheduler = scheduler;
+}
+
+static void V8PlatformTaskReady(Task *task, int priority) {
+#ifdef GOOUTPUT
+    GoPlatformTask(reinterpret_cast<V8PlatformTaskPtr>(task), priority);
+#endif
+}
+
+void V8RunPlatformTask(V8PlatformTaskPtr task, int priority) {
+    static_cast<BoundedPlatform *>(_priv_platform.get())->RunTask(reinterpret_cast<Task *>(task), priority);
+}
+
+/*
+ * V8Init 之前返回全零.
+ */
+void V8GetPlatformStats(V8PlatformStats *stats) {
+    PlatformCounters counters;
+    memset(&counters, 0, sizeof(counters));
+    if (_priv_platform)
+        static_cast<BoundedPlatform *>(_priv_platform.get())->Counters(&counters);
+    stats->workers = counters.workers;
+    for (int i = 0; i < kPlatformPriorityCount; i++) {
+        stats->pending[i] = counters.pending[i];
+        stats->executed[i] = counters.executed[i];
+    }
+    stats->delayed = counters.delayed;
+}
+
+/*
+ * Chrome trace 输出, 见 v8trace.h.
+ */
+int V8StartTracing(const char *path, const char *categories, size_t maxEvents) {
+    return TraceService::Default().Start(path, categories, maxEvents);
+}
+
+int V8StopTracing(V8TraceStats *stats) {
+    TraceCounters counters = {0, 0};
+    int r = TraceService::Default().Stop(&counters);
+    stats->events = counters.events;
+    stats->dropped = counters.dropped;
+    return r;
+}
+
+static const char *goTraceSpanNames[] = {
+    "MarshalMessage",
+};
+
+void V8TraceBegin(VMPtr vmPtr, int span, uint64_t sessionId) {
+    if (TraceService::Default().Enabled(kTraceMarshal))
+        TraceService::Default().Begin(kTraceMarshal, goTraceSpanNames[span], vmPtr, sessionId);
+}
+
+void V8TraceEnd(VMPtr vmPtr, int span) {
+    if (TraceService::Default().Enabled(kTraceMarshal))
+        TraceService::Default().End(kTraceMarshal, goTraceSpanNames[span], vmPtr);
+}
+
+void V8Init() {
+    globalCWD = getcwd(nullptr, 0);
+    V8::InitializeICU();
+    // 默认实现只保留前台任务与 PostJob, 后台任务由 BoundedPlatform 的工作线程执行
+    auto inner = platform::NewDefaultPlatform(1, platform::IdleTaskSupport::kDisabled,
+            platform::InProcessStackDumping::kDisabled,
+            std::unique_ptr<v8::TracingController>(TraceService::Default().CreateController()));
+    _priv_platform.reset(new BoundedPlatform(platformWorkers,
+            platformScheduler ? V8PlatformTaskReady : nullptr, std::move(inner)));
+    V8::InitializePlatform(_priv_platform.get());
+
+    std::string flags = "--es_staging --harmony";
+    switch (executionProfile) {
+        case v8ProfileLite:
+            // 不分配反馈向量也不做优化, 保留解释器与 RegExp/IC 的原生代码
+            flags += " --lite-mode";
+            break;
+        case v8ProfileJitless:
+            // 不生成任何可执行内存, 内存最省, WebAssembly 不可用
+            flags += " --jitless";
+            break;
+        case v8ProfileTuned:
+            // 推迟 tier-up 并让优化编译偏向代码体积, 只有持续热点的函数才会进入 TurboFan
+            flags += " --optimize-for-size --interrupt-budget=589824";
+            break;
+    }
+    if (!executionFlags.empty())
+        flags += " " + executionFlags;
+    V8::SetFlagsFromString(flags.c_str());
+    V8::Initialize();
+    TimerService::Default().SetReadyCallback(V8TimersReady);
+    ModuleLoader::Default().SetReadyCallback(V8TimersReady);
+    ModuleLoader::Default().SetReader(ReadModuleSource);
+}
+
+/*
+ * 销毁V8运行环境.
+ */
+void V8Dispose() {
+    TimerService::Default().Stop();
+    ModuleLoader::Default().Stop();
+    LogService::Default().Stop();
+    SharedRegionRegistry::Default().Clear();
+    V8::Dispose();
+    V8::ShutdownPlatform();
+}
+
+/*
+ * 获取当前工作目录.
+ */
+const char *V8WorkDir() {
+    return globalCWD.c_str();
+}
+
+/*
+ * 获取最后一条异常信息.
+ */
+const char *V8LastException(VMPtr vmPtr) {
+    if (vmPtr->last_exception.length() != 0) {
+        vmPtr->lastExceptionText = "Uncaught exception: \n" + vmPtr->last_exception;
+        return vmPtr->lastExceptionText.c_str();
+    }
+
+    if (!vmPtr->lastExceptionPending)
+        return "";
+
+    if (vmPtr->lastExceptionText.length() == 0) {
+        Locker locker(vmPtr->isolate);
+        Isolate::Scope isolate_scope(vmPtr->isolate);
+        HandleScope handle_scope(vmPtr->isolate);
+        vmPtr->lastExceptionText = "Uncaught exception: \n" + V8FormatException(vmPtr,
+                vmPtr->lastExceptionValue.Get(vmPtr->isolate), vmPtr->lastExceptionMessage.Get(vmPtr->isolate));
+    }
+    return vmPtr->lastExceptionText.c_str();
+}
+
+/*
+ * 最近一次异常所在位置已发生的次数, 非脚本异常返回 1.
+ */
+uint64_t V8LastExceptionCount(VMPtr vmPtr) {
+    if (vmPtr->last_exception.length() != 0 || !vmPtr->lastExceptionPending)
+        return 1;
+    return vmPtr->lastExceptionCount;
+}
+
+/*
+ * 获取结构化的最近一次异常, 字符串在下一次异常之前有效.
+ * 返回 0 为脚本异常, 1 为只有文本的桥接层错误, -1 为没有异常.
+ */
+int V8GetLastError(VMPtr vmPtr, V8ErrorInfo *info) {
+    memset(info, 0, sizeof(*info));
+    if (vmPtr->last_exception.length() != 0) {
+        info->message = vmPtr->last_exception.c_str();
+        info->count = 1;
+        return 1;
+    }
+    if (!vmPtr->lastExceptionPending) {
+        return -1;
+    }
+
+    V8BuildLastError(vmPtr);
+    VMErrorRecord &record = vmPtr->lastError;
+    info->file = record.file.c_str();
+    info->line = record.line;
+    info->column = record.column;
+    info->message = record.message.c_str();
+    info->count = vmPtr->lastExceptionCount;
+    info->frameCount = record.frames.size();
+    return 0;
+}
+
+const char *V8GetLastErrorFrame(VMPtr vmPtr, int index) {
+    if (index < 0 || index >= vmPtr->lastError.frames.size())
+        return nullptr;
+    return vmPtr->lastError.frames[index].c_str();
+}
+
+/*
+ * 按位置统计的异常次数快照, 需用 V8ReleaseErrorLocations 释放.
+ */
+V8ErrorLocationsPtr V8GetErrorLocations(VMPtr vmPtr) {
+    auto locations = new V8ErrorLocations;
+    locations->items.reserve(vmPtr->errorLocations.size());
+    for (auto &kv : vmPtr->errorLocations) {
+        locations->files.push_back(kv.second.file);
+    }
+    size_t i = 0;
+    for (auto &kv : vmPtr->errorLocations) {
+        V8ErrorLocation item;
+        item.file = locations->files[i++].c_str();
+        item.line = kv.second.line;
+        item.count = kv.second.count;
+        locations->items.push_back(item);
+    }
+    return locations;
+}
+
+size_t V8GetErrorLocationsLength(V8ErrorLocationsPtr locations) {
+    return locations->items.size();
+}
+
+const V8ErrorLocation *V8GetErrorLocationsItem(V8ErrorLocationsPtr locations, int index) {
+    if (index < 0 || index >= locations->items.size())
+        return nullptr;
+    return &locations->items[index];
+}
+
+void V8ReleaseErrorLocations(V8ErrorLocationsPtr locations) {
+    delete locations;
+}
+
+/*
+ * 设置输出回调.
+ */
+void V8SetOutputCallback(OutputCallback cb) {
+    assert(cb == nullptr && "V8SetOutputCallback's arg[OutputCallback] is NULL");
+    outputCallback = cb;
+}
+
+/*
+ * 记录每次 GC 的停顿时间, 全进程汇总包含已销毁的虚拟机.
+ */
+LatencyHistogram gcPauseTotals;
+
+uint64_t V8SteadyNs() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void V8GCPrologue(Isolate *isolate, GCType type, GCCallbackFlags flags, void *data) {
+    static_cast<VMPtr>(data)->gcStart = V8SteadyNs();
+}
+
+void V8GCEpilogue(Isolate *isolate, GCType type, GCCallbackFlags flags, void *data) {
+    auto vmPtr = static_cast<VMPtr>(data);
+    if (vmPtr->gcStart == 0)
+        return;
+    uint64_t pause = V8SteadyNs() - vmPtr->gcStart;
+    vmPtr->gcStart = 0;
+    vmPtr->gcPauses.Record(pause);
+    gcPauseTotals.Record(pause);
+}
+
+/*
+ * 所有虚拟机共用一个 ArrayBuffer 分配器. 信封转移的 ArrayBuffer 与 SharedArrayBuffer 的 BackingStore
+ * 会在虚拟机之间移动, 并可能比创建它的虚拟机活得更久, 因此分配器不能随虚拟机销毁.
+ */
+std::shared_ptr<ArrayBuffer::Allocator> V8SharedAllocator() {
+    static std::shared_ptr<ArrayBuffer::Allocator> allocator(ArrayBuffer::Allocator::NewDefaultAllocator());
+    return allocator;
+}
+
+/*
+ * 创建一个新的V8虚拟机上下文, 调用前必须确保已经初始化了V8运行环境.
+ */
+VMPtr V8NewVM() {
+    VM *vmPtr = new VM;
+    Isolate::CreateParams create_params;
+    create_params.array_buffer_allocator_shared = V8SharedAllocator();
+    Isolate *isolate = Isolate::New(create_params);
+
+    Locker locker(isolate);
+    HandleScope scope(isolate);
+    Local<Context> context = Context::New(isolate);
+    Context::Scope context_scope(context);
+
+    auto global = context->Global();
+
+    Local<Value> consoleV = global->Get(context, String::NewFromUtf8(isolate, "console").ToLocalChecked()).ToLocalChecked();
+    Local<Object> console = Local<Object>::Cast(consoleV);
+
+    bool success = console->Set(context, String::NewFromUtf8(isolate, "log").ToLocalChecked(),
+                   FunctionTemplate::New(isolate, consoleLog)->GetFunction(context).ToLocalChecked()).FromMaybe(false);
+
+    success = console->Set(context, String::NewFromUtf8(isolate, "info").ToLocalChecked(),
+                   FunctionTemplate::New(isolate, consoleInfo)->GetFunction(context).ToLocalChecked()).FromMaybe(false);
+
+    success = console->Set(context, String::NewFromUtf8(isolate, "assert").ToLocalChecked(),
+                   FunctionTemplate::New(isolate, consoleAssert)->GetFunction(context).ToLocalChecked()).FromMaybe(false);
+
+    success = console->Set(context, String::NewFromUtf8(isolate, "warn").ToLocalChecked(),
+                           FunctionTemplate::New(isolate, consoleWarn)->GetFunction(context).ToLocalChecked()).FromMaybe(false);
+
+    Local<ObjectTemplate> v8goTmpl = ObjectTemplate::New(isolate);
+    v8goTmpl->Set(isolate, "version", FunctionTemplate::New(isolate, v8goVersion));
+    Local<Object> v8go = v8goTmpl->NewInstance(context).ToLocalChecked();
+
+    success = global->Set(context, String::NewFromUtf8(isolate, "v8go").ToLocalChecked(), v8go).FromMaybe(false);
+
+    Local<ObjectTemplate> v8goNetTmpl = ObjectTemplate::New(isolate);
+    v8goNetTmpl->Set(isolate, "sendCurrentPlayer", FunctionTemplate::New(isolate, v8goSend));
+    v8goNetTmpl->Set(isolate, "sendToOtherPlayer", FunctionTemplate::New(isolate, v8goSendTo));
+    v8goNetTmpl->Set(isolate, "postMessage", FunctionTemplate::New(isolate, v8goPostMessage));
+    v8goNetTmpl->Set(isolate, "broadcast", FunctionTemplate::New(isolate, v8goBroadcast));
+    Local<Object> v8goNet = v8goNetTmpl->NewInstance(context).ToLocalChecked();
+
+    success = global->Set(context, String::NewFromUtf8(isolate, "net").ToLocalChecked(), v8goNet).FromMaybe(false);
+
+    success = global->Set(context, String::NewFromUtf8(isolate, "setTimeout").ToLocalChecked(),
+                          FunctionTemplate::New(isolate, v8goSetTimeout)->GetFunction(context).ToLocalChecked()).FromMaybe(false);
+    success = global->Set(context, String::NewFromUtf8(isolate, "setInterval").ToLocalChecked(),
+                          FunctionTemplate::New(isolate, v8goSetInterval)->GetFunction(context).ToLocalChecked()).FromMaybe(false);
+    success = global->Set(context, String::NewFromUtf8(isolate, "clearTimeout").ToLocalChecked(),
+                          FunctionTemplate::New(isolate, v8goClearTimer)->GetFunction(context).ToLocalChecked()).FromMaybe(false);
+    success = global->Set(context, String::NewFromUtf8(isolate, "clearInterval").ToLocalChecked(),
+                          FunctionTemplate::New(isolate, v8goClearTimer)->GetFunction(context).ToLocalChecked()).FromMaybe(false);
+    success = global->Set(context, String::NewFromUtf8(isolate, "openSharedRegion").ToLocalChecked(),
+                          FunctionTemplate::New(isolate, v8goOpenSharedRegion)->GetFunction(context).ToLocalChecked()).FromMaybe(false);
+    success = global->Set(context, String::NewFromUtf8(isolate, "getConfig").ToLocalChecked(),
+                          FunctionTemplate::New(isolate, v8goGetConfig)->GetFunction(context).ToLocalChecked()).FromMaybe(false);
+
+    vmPtr->isolate = isolate;
+    vmPtr->context.Reset(isolate, context);
+    vmPtr->cpuProfiler = nullptr;
+    vmPtr->cpuProfiling = false;
+    vmPtr->inspector = nullptr;
+    vmPtr->inspectorPending = false;
+    vmPtr->messageData = nullptr;
+    vmPtr->messageLength = 0;
+    vmPtr->messageGeneration = 0;
+    memset(&vmPtr->broadcastStats, 0, sizeof(vmPtr->broadcastStats));
+    vmPtr->coalesceSends = false;
+    vmPtr->dispatchDepth = 0;
+    vmPtr->outboundPending = false;
+    memset(&vmPtr->outboundStats, 0, sizeof(vmPtr->outboundStats));
+    vmPtr->sendMuted = false;
+    vmPtr->tracingTierUp = false;
+    vmPtr->optimizedCount = 0;
+    vmPtr->gcStart = 0;
+    vmPtr->logRing = nullptr;
+    vmPtr->lastExceptionPending = false;
+    vmPtr->lastExceptionCount = 0;
+    vmPtr->lastError.built = false;
+
+    isolate->SetData(0, vmPtr);
+    isolate->SetHostImportModuleDynamicallyCallback(V8ImportModuleDynamically);
+    // 只统计真正停顿执行的回收, 增量标记步骤和弱回调处理不计入
+    GCType pauseTypes = static_cast<GCType>(kGCTypeScavenge | kGCTypeMarkSweepCompact);
+    isolate->AddGCPrologueCallback(V8GCPrologue, vmPtr, pauseTypes);
+    isolate->AddGCEpilogueCallback(V8GCEpilogue, vmPtr, pauseTypes);
+    isolate->SetAllowAtomicsWait(allowAtomicsWait);
+
+    return vmPtr;
+}
+
+/*
+ * 销毁一个V8虚拟机上下文.
+ */
+void V8DisposeVM(VMPtr vmPtr) {
+    TimerService::Default().RemoveOwner(vmPtr);
+    ModuleLoader::Default().RemoveOwner(vmPtr);
+    V8InspectorDisconnect(vmPtr);
+    if (vmPtr->logRing != nullptr) {
+        LogService::Default().Detach(vmPtr->logRing);
+        vmPtr->logRing = nullptr;
+    }
+    vmPtr->timers.clear();
+    vmPtr->imports.clear();
+    vmPtr->importIds.clear();
+    vmPtr->configTemplate.Reset();
+    vmPtr->configArrayTemplate.Reset();
+    for (auto &kv : vmPtr->configAnchors) {
+        kv.second->handle.Reset();
+        delete kv.second;
+    }
+    vmPtr->configAnchors.clear();
+    vmPtr->messageTemplate.Reset();
+    vmPtr->messageArrayPrototype.Reset();
+    vmPtr->lastExceptionValue.Reset();
+    vmPtr->lastExceptionMessage.Reset();
+    if (vmPtr->cpuProfiler != nullptr) {
+        Locker locker(vmPtr->isolate);
+        Isolate::Scope isolate_scope(vmPtr->isolate);
+        vmPtr->cpuProfiler->Dispose();
+        vmPtr->cpuProfiler = nullptr;
+    }
+    vmPtr->context.Reset();
+    vmPtr->isolate->Dispose();
+    delete vmPtr;
+}
+
+void V8PrintVMMemStat(VMPtr vmPtr) {
+    HeapStatistics hs;
+    vmPtr->isolate->GetHeapStatistics(&hs);
+    printf(">>>>>>>>>>>>>>>>>> HeapStatistics table >>>>>>>>>>>>>>>>>>\n");
+    printf("heap_size_limit: %ld\n", hs.heap_size_limit());
+    printf("total_heap_size: %ld\n", hs.total_heap_size());
+    printf("used_heap_size: %ld\n", hs.used_heap_size());
+    printf("total_physical_size: %ld\n", hs.total_physical_size());
+    printf("total_available_size: %ld\n", hs.total_available_size());
+    printf("total_available_size: %ld\n", hs.malloced_memory());
+    printf(">>>>>>>>>>>>>>>>>> HeapStatistics table >>>>>>>>>>>>>>>>>>\n");
+}
+
+void V8SetVMAssociatedSourceAddr(VMPtr vmPtr, const char *addr) {
+    vmPtr->associatedSourceAddr = addr;
+}
+
+void V8SetVMAssociatedSourceId(VMPtr vmPtr, uint64_t id) {
+    vmPtr->associatedSourceId = id;
+}
+
+const char * V8GetVMAssociatedSourceAddr(VMPtr vmPtr) {
+    return vmPtr->associatedSourceAddr.c_str();
+}
+
+uint64_t V8GetVMAssociatedSourceId(VMPtr vmPtr) {
+    return vmPtr->associatedSourceId;
+}
+
+/*
+ * 开始 CPU 采样, samplingIntervalUs <= 0 时使用 V8 默认的 1000us.
+ * 返回 0 成功, 1 已经在采样中.
+ */
+int V8StartCpuProfiling(VMPtr vmPtr, int samplingIntervalUs) {
+    Locker locker(vmPtr->isolate);
+    Isolate::Scope isolate_scope(vmPtr->isolate);
+    HandleScope handle_scope(vmPtr->isolate);
+
+    if (vmPtr->cpuProfiling) {
+        return 1;
+    }
+
+    if (vmPtr->cpuProfiler == nullptr) {
+        vmPtr->cpuProfiler = CpuProfiler::New(vmPtr->isolate);
+    }
+    vmPtr->cpuProfiler->SetSamplingInterval(samplingIntervalUs > 0 ? samplingIntervalUs : 1000);
+    vmPtr->cpuProfiler->StartProfiling(String::NewFromUtf8(vmPtr->isolate, "v8go").ToLocalChecked(), true);
+    vmPtr->cpuProfiling = true;
+    return 0;
+}
+
+/*
+ * 按 Chrome DevTools .cpuprofile 格式序列化.
+ */
+void CpuProfileNodeToJSON(const CpuProfileNode *node, std::string &out) {
+    if (out.back() != '[')
+        out += ',';
+
+    out += "{\"id\":" + std::to_string(node->GetNodeId()) + ",\"callFrame\":{\"functionName\":";
+    AppendJSONString(out, node->GetFunctionNameStr());
+    out += ",\"scriptId\":\"" + std::to_string(node->GetScriptId()) + "\",\"url\":";
+    AppendJSONString(out, node->GetScriptResourceNameStr());
+    out += ",\"lineNumber\":" + std::to_string(node->GetLineNumber() - 1);
+    out += ",\"columnNumber\":" + std::to_string(node->GetColumnNumber() - 1);
+    out += "},\"hitCount\":" + std::to_string(node->GetHitCount()) + ",\"children\":[";
+
+    int count = node->GetChildrenCount();
+    for (int i = 0; i < count; i++) {
+        if (i > 0)
+            out += ',';
+        out += std::to_string(node->GetChild(i)->GetNodeId());
+    }
+    out += "]}";
 
-    Local<Object> oo = Local<Value>::New(vmPtr->isolate, o->value)->ToObject(context).ToLocalChecked();
-    auto success = oo->Set(context, String::NewFromUtf8(vmPtr->isolate, name).ToLocalChecked(), val ? True(vmPtr->isolate) : False(vmPtr->isolate));
+    for (int i = 0; i < count; i++) {
+        CpuProfileNodeToJSON(node->GetChild(i), out);
+    }
 }
 
-void V8ObjectSetBooleanForIndex(VMPtr vmPtr, VMValuePtr o, int index, bool val) {
-    Locker locker(vmPtr->isolate);
-    HandleScope handle_scope(vmPtr->isolate);
-    TryCatch try_catch(vmPtr->isolate);
-    Local<Context> context = Local<Context>::New(vmPtr->isolate, vmPtr->context);
-    Context::Scope context_scope(context);
+std::string CpuProfileToJSON(const CpuProfile *profile) {
+    std::string out = "{\"nodes\":[";
+    CpuProfileNodeToJSON(profile->GetTopDownRoot(), out);
 
-    Local<Object> oo = Local<Value>::New(vmPtr->isolate, o->value)->ToObject(context).ToLocalChecked();
-    auto success = oo->Set(context, (uint32_t)index, val ? True(vmPtr->isolate) : False(vmPtr->isolate));
+    out += "],\"startTime\":" + std::to_string(profile->GetStartTime());
+    out += ",\"endTime\":" + std::to_string(profile->GetEndTime()) + ",\"samples\":[";
+
+    int count = profile->GetSamplesCount();
+    for (int i = 0; i < count; i++) {
+        if (i > 0)
+            out += ',';
+        out += std::to_string(profile->GetSample(i)->GetNodeId());
+    }
+
+    out += "],\"timeDeltas\":[";
+    int64_t last = profile->GetStartTime();
+    for (int i = 0; i < count; i++) {
+        int64_t ts = profile->GetSampleTimestamp(i);
+        if (i > 0)
+            out += ',';
+        out += std::to_string(ts - last);
+        last = ts;
+    }
+    out += "]}";
+    return out;
 }
 
-V8StringArraysPtr V8ObjectGetKeys(VMPtr vmPtr, VMValuePtr o) {
+bool V8StopCpuProfilingJSON(VMPtr vmPtr, std::string &out) {
     Locker locker(vmPtr->isolate);
+    Isolate::Scope isolate_scope(vmPtr->isolate);
     HandleScope handle_scope(vmPtr->isolate);
-    TryCatch try_catch(vmPtr->isolate);
-    Local<Context> context = Local<Context>::New(vmPtr->isolate, vmPtr->context);
-    Context::Scope context_scope(context);
 
-    Local<Object> oo = Local<Value>::New(vmPtr->isolate, o->value)->ToObject(context).ToLocalChecked();
-    Local<Array> v8keys = oo->GetPropertyNames(context).ToLocalChecked();
-    auto strings = new V8StringArrays;
-    strings->strs.resize(v8keys->Length());
-    for (int i = 0; i < v8keys->Length(); i ++) {
-        String::Utf8Value str(vmPtr->isolate, v8keys->Get(context, i).ToLocalChecked());
-        strings->strs[i] = V8ToCString(str);
+    if (!vmPtr->cpuProfiling) {
+        return false;
     }
-    return strings;
+    vmPtr->cpuProfiling = false;
+
+    CpuProfile *profile = vmPtr->cpuProfiler->StopProfiling(String::NewFromUtf8(vmPtr->isolate, "v8go").ToLocalChecked());
+    if (profile == nullptr) {
+        return false;
+    }
+    out = CpuProfileToJSON(profile);
+    profile->Delete();
+    return true;
 }
 
-size_t V8ObjectGetLength(VMPtr vmPtr, VMValuePtr o) {
-    Locker locker(vmPtr->isolate);
-    HandleScope handle_scope(vmPtr->isolate);
-    TryCatch try_catch(vmPtr->isolate);
-    Local<Context> context = Local<Context>::New(vmPtr->isolate, vmPtr->context);
-    Context::Scope context_scope(context);
+/*
+ * 结束 CPU 采样并返回 .cpuprofile 内容, 返回的内存由调用者 free. 未在采样中返回 NULL.
+ */
+char *V8StopCpuProfiling(VMPtr vmPtr, size_t *len) {
+    std::string out;
+    *len = 0;
+    if (!V8StopCpuProfilingJSON(vmPtr, out)) {
+        return nullptr;
+    }
 
-    Local<Object> oo = Local<Value>::New(vmPtr->isolate, o->value)->ToObject(context).ToLocalChecked();
-    Local<Array> array = Local<Array>::Cast(oo);
-    return (size_t) array->Length();
+    char *buf = (char *)malloc(out.length());
+    if (buf == nullptr) {
+        return nullptr;
+    }
+    memcpy(buf, out.data(), out.length());
+    *len = out.length();
+    return buf;
 }
 
-VMValuePtr V8GetObjectValue(VMPtr vmPtr, VMValuePtr o, const char *key) {
-    Locker locker(vmPtr->isolate);
-    HandleScope handle_scope(vmPtr->isolate);
-    TryCatch try_catch(vmPtr->isolate);
-    Local<Context> context = Local<Context>::New(vmPtr->isolate, vmPtr->context);
-    Context::Scope context_scope(context);
+/*
+ * 结束 CPU 采样并写入 .cpuprofile 文件. 返回 0 成功, 1 未在采样中, -1 写文件失败.
+ */
+int V8StopCpuProfilingToFile(VMPtr vmPtr, const char *path) {
+    std::string out;
+    if (!V8StopCpuProfilingJSON(vmPtr, out)) {
+        return 1;
+    }
+    return WriteFile(path, out.data(), out.length()) ? 0 : -1;
+}
 
-    Local<Value> v8Key = String::NewFromUtf8(vmPtr->isolate, key).ToLocalChecked();
+/*
+ * 以流方式写入 .heapsnapshot 文件.
+ */
+class FileOutputStream : public OutputStream {
+public:
+    explicit FileOutputStream(FILE *f) : file(f), failed(false) {}
 
-    Local<Object> oo = Local<Value>::New(vmPtr->isolate, o->value)->ToObject(context).ToLocalChecked();
-    Local<Value> v = oo->Get(context, v8Key).ToLocalChecked();
+    void EndOfStream() override {}
 
-    unsigned int kind = v8KindStart;
+    int GetChunkSize() override {
+        return 64 * 1024;
+    }
 
-    if (v->IsString())
-        kind |= v8KindString;
-    if (v->IsInt32())
-        kind |= v8KindInt;
-    if (v->IsBigInt())
-        kind |= v8KindBigInt;
-    if (v->IsBoolean())
-        kind |= v8KindBool;
-    if (v->IsUint32())
-        kind |= v8KindUint;
-    if (v->IsNumber()) {
-        kind |= v8KindNumber;
-        if (kind == v8KindNumber) {
-            MaybeLocal<Number> iValue = v->ToNumber(context);
-            if (!iValue.IsEmpty()) {
-                auto db = iValue.ToLocalChecked()->Value();
-                if (db == (double)(int64_t)db) {
-                    kind |= v8KindInt;
-                } else if (db == (double)(uint64_t)db) {
-                    kind |= v8KindUint;
-                }
-            }
+    WriteResult WriteAsciiChunk(char *data, int size) override {
+        if (fwrite(data, 1, size, file) != (size_t)size) {
+            failed = true;
+            return kAbort;
         }
+        return kContinue;
     }
-    if (v->IsObject())
-        kind |= v8KindObject;
-    if (v->IsArray())
-        kind |= v8KindArray;
-    if (v->IsNull())
-        kind |= v8KindNull;
-    if (v->IsUndefined())
-        kind |= v8KindUndefined;
 
-    auto vmValuePtr = new VMValue;
-    vmValuePtr->value.Reset(vmPtr->isolate, v);
-    vmValuePtr->kind = kind;
-    return vmValuePtr;
-}
+    bool Failed() const {
+        return failed;
+    }
+
+private:
+    FILE *file;
+    bool failed;
+};
+
+/*
+ * 生成完整堆快照并写入 path. 返回 0 成功, -1 写文件失败.
+ */
+int V8WriteHeapSnapshot(VMPtr vmPtr, const char *path) {
+    FILE *f = fopen(path, "w");
+    if (f == nullptr) {
+        return -1;
+    }
 
-VMValuePtr V8GetObjectValueAtIndex(VMPtr vmPtr, VMValuePtr o, uint32_t index) {
     Locker locker(vmPtr->isolate);
+    Isolate::Scope isolate_scope(vmPtr->isolate);
     HandleScope handle_scope(vmPtr->isolate);
-    TryCatch try_catch(vmPtr->isolate);
-    Local<Context> context = Local<Context>::New(vmPtr->isolate, vmPtr->context);
-    Context::Scope context_scope(context);
 
+    const HeapSnapshot *snapshot = vmPtr->isolate->GetHeapProfiler()->TakeHeapSnapshot();
+    FileOutputStream stream(f);
+    snapshot->Serialize(&stream, HeapSnapshot::kJSON);
+    const_cast<HeapSnapshot *>(snapshot)->Delete();
 
-    Local<Object> oo = Local<Value>::New(vmPtr->isolate, o->value)->ToObject(context).ToLocalChecked();
-    Local<Value> v = oo->Get(context, index).ToLocalChecked();
+    bool ok = fclose(f) == 0 && !stream.Failed();
+    return ok ? 0 : -1;
+}
 
-    unsigned int kind = v8KindStart;
+/*
+ * 开始堆分配采样, 平均每 sampleInterval 字节采样一次. 返回 0 成功, 1 已在采样中.
+ */
+int V8StartHeapSampling(VMPtr vmPtr, uint64_t sampleInterval, int stackDepth) {
+    Locker locker(vmPtr->isolate);
+    Isolate::Scope isolate_scope(vmPtr->isolate);
 
-    if (v->IsString())
-        kind |= v8KindString;
-    if (v->IsInt32())
-        kind |= v8KindInt;
-    if (v->IsBigInt())
-        kind |= v8KindBigInt;
-    if (v->IsBoolean())
-        kind |= v8KindBool;
-    if (v->IsUint32())
-        kind |= v8KindUint;
-    if (v->IsNumber()) {
-        kind |= v8KindNumber;
-        if (kind == v8KindNumber) {
-            MaybeLocal<Number> iValue = v->ToNumber(context);
-            if (!iValue.IsEmpty()) {
-                auto db = iValue.ToLocalChecked()->Value();
-                if (db == (double)(int64_t)db) {
-                    kind |= v8KindInt;
-                } else if (db == (double)(uint64_t)db) {
-                    kind |= v8KindUint;
-                }
-            }
-        }
-    }
-    if (v->IsObject())
-        kind |= v8KindObject;
-    if (v->IsArray())
-        kind |= v8KindArray;
-    if (v->IsNull())
-        kind |= v8KindNull;
-    if (v->IsUndefined())
-        kind |= v8KindUndefined;
+    if (sampleInterval == 0)
+        sampleInterval = 512 * 1024;
+    if (stackDepth <= 0)
+        stackDepth = 16;
+    return vmPtr->isolate->GetHeapProfiler()->StartSamplingHeapProfiler(sampleInterval, stackDepth) ? 0 : 1;
+}
 
-    auto vmValuePtr = new VMValue;
-    vmValuePtr->value.Reset(vmPtr->isolate, v);
-    vmValuePtr->kind = kind;
-    return vmValuePtr;
+void V8StopHeapSampling(VMPtr vmPtr) {
+    Locker locker(vmPtr->isolate);
+    Isolate::Scope isolate_scope(vmPtr->isolate);
+    vmPtr->isolate->GetHeapProfiler()->StopSamplingHeapProfiler();
 }
 
+void CollectHeapSummary(Isolate *isolate, const AllocationProfile::Node *node,
+                        std::map<std::string, size_t> &index, V8HeapSummary *summary) {
+    if (!node->allocations.empty()) {
+        String::Utf8Value name(isolate, node->name);
+        String::Utf8Value scriptName(isolate, node->script_name);
+
+        std::string key = *name != nullptr && name.length() > 0 ? *name : "(anonymous)";
+        key += " (";
+        key += *scriptName != nullptr ? *scriptName : "";
+        key += ":";
+        key += std::to_string(node->line_number);
+        key += ")";
+
+        auto it = index.find(key);
+        if (it == index.end()) {
+            it = index.insert(std::make_pair(key, summary->items.size())).first;
+            V8HeapSummaryItem item;
+            memset(&item, 0, sizeof(item));
+            summary->names.push_back(key);
+            summary->items.push_back(item);
+        }
 
-const char *V8ValueAsString(VMPtr vmPtr, VMValuePtr o, const char *def) {
-    Locker locker(vmPtr->isolate);
-    HandleScope handle_scope(vmPtr->isolate);
-    TryCatch try_catch(vmPtr->isolate);
-    Local<Context> context = Local<Context>::New(vmPtr->isolate, vmPtr->context);
-    Context::Scope context_scope(context);
+        V8HeapSummaryItem &item = summary->items[it->second];
+        for (auto &a : node->allocations) {
+            item.count += a.count;
+            item.size += (uint64_t)a.size * a.count;
+        }
+    }
 
-    Local<Value> v = Local<Value>::New(vmPtr->isolate, o->value);
-    String::Utf8Value utf8Value(vmPtr->isolate, v);
-    return V8ToCString(utf8Value);
+    for (auto child : node->children) {
+        CollectHeapSummary(isolate, child, index, summary);
+    }
 }
 
-int64_t V8ValueAsInt(VMPtr vmPtr, VMValuePtr o, int64_t def) {
+/*
+ * 按分配位置(函数名 + 脚本:行)汇总当前仍存活的采样对象, 无需生成完整快照.
+ * 未开启采样时返回 NULL, 返回值需用 V8ReleaseHeapSummary 释放.
+ */
+V8HeapSummaryPtr V8GetHeapSamplingSummary(VMPtr vmPtr) {
     Locker locker(vmPtr->isolate);
+    Isolate::Scope isolate_scope(vmPtr->isolate);
     HandleScope handle_scope(vmPtr->isolate);
-    TryCatch try_catch(vmPtr->isolate);
-    Local<Context> context = Local<Context>::New(vmPtr->isolate, vmPtr->context);
-    Context::Scope context_scope(context);
 
-    Local<Value> v = Local<Value>::New(vmPtr->isolate, o->value);
-    if(v->IsNumber()) {
-        MaybeLocal<Number> iValue = v->ToNumber(context);
-        if (iValue.IsEmpty())
-            return def;
-        return (int64_t)iValue.ToLocalChecked()->Value();
+    std::unique_ptr<AllocationProfile> profile(vmPtr->isolate->GetHeapProfiler()->GetAllocationProfile());
+    if (!profile) {
+        return nullptr;
     }
-    return def;
+
+    auto summary = new V8HeapSummary;
+    std::map<std::string, size_t> index;
+    CollectHeapSummary(vmPtr->isolate, profile->GetRootNode(), index, summary);
+    for (size_t i = 0; i < summary->items.size(); i++) {
+        summary->items[i].name = summary->names[i].c_str();
+    }
+    return summary;
 }
 
-uint64_t V8ValueAsUint(VMPtr vmPtr, VMValuePtr o, uint64_t def) {
-    Locker locker(vmPtr->isolate);
-    HandleScope handle_scope(vmPtr->isolate);
-    TryCatch try_catch(vmPtr->isolate);
-    Local<Context> context = Local<Context>::New(vmPtr->isolate, vmPtr->context);
-    Context::Scope context_scope(context);
+size_t V8GetHeapSummaryLength(V8HeapSummaryPtr summary) {
+    return summary->items.size();
+}
 
-    Local<Value> v = Local<Value>::New(vmPtr->isolate, o->value);
-    if(v->IsNumber()) {
-        MaybeLocal<Number> iValue = v->ToNumber(context);
-        if (iValue.IsEmpty())
-            return def;
-        return (uint64_t)iValue.ToLocalChecked()->Value();
-    }
-    return def;
+const V8HeapSummaryItem *V8GetHeapSummaryItem(V8HeapSummaryPtr summary, int index) {
+    if (index < 0 || index >= summary->items.size())
+        return nullptr;
+    return &summary->items[index];
 }
 
-double V8ValueAsFloat(VMPtr vmPtr, VMValuePtr o, double def) {
-    Locker locker(vmPtr->isolate);
-    HandleScope handle_scope(vmPtr->isolate);
-    TryCatch try_catch(vmPtr->isolate);
-    Local<Context> context = Local<Context>::New(vmPtr->isolate, vmPtr->context);
-    Context::Scope context_scope(context);
+void V8ReleaseHeapSummary(V8HeapSummaryPtr summary) {
+    delete summary;
+}
 
-    Local<Value> v = Local<Value>::New(vmPtr->isolate, o->value);
-    if(v->IsNumber()) {
-        MaybeLocal<Number> iValue = v->ToNumber(context);
-        if (iValue.IsEmpty())
-            return def;
-        return iValue.ToLocalChecked()->Value();
+void V8FillLatencySummary(const LatencyHistogram::Snapshot &hs, V8LatencySummary *ls) {
+    ls->meanNs = hs.total == 0 ? 0 : hs.sum / hs.total;
+    ls->p50Ns = hs.Percentile(0.5);
+    ls->p90Ns = hs.Percentile(0.9);
+    ls->p99Ns = hs.Percentile(0.99);
+    ls->p999Ns = hs.Percentile(0.999);
+    ls->maxNs = hs.max;
+}
+
+/*
+ * 获取处理函数耗时统计, vmPtr 为空时返回全进程汇总.
+ */
+void V8GetHandlerStats(VMPtr vmPtr, int handler, V8HandlerStats *out) {
+    memset(out, 0, sizeof(*out));
+    if (handler < 0 || handler >= kHandlerCount) {
+        return;
     }
 
-    return def;
+    HandlerStats::Snapshot snapshot;
+    if (vmPtr == nullptr) {
+        HandlerStats::ReadAll(handler, snapshot);
+    } else {
+        vmPtr->stats.Read(handler, snapshot);
+    }
+
+    out->calls = snapshot.wall.total;
+    out->errors = snapshot.errors;
+
+    V8FillLatencySummary(snapshot.wall, &out->wall);
+    V8FillLatencySummary(snapshot.cpu, &out->cpu);
 }
 
-bool V8ValueAsBoolean(VMPtr vmPtr, VMValuePtr o, bool def) {
-    Locker locker(vmPtr->isolate);
-    HandleScope handle_scope(vmPtr->isolate);
-    TryCatch try_catch(vmPtr->isolate);
-    Local<Context> context = Local<Context>::New(vmPtr->isolate, vmPtr->context);
-    Context::Scope context_scope(context);
+/*
+ * 获取 GC 停顿统计, vmPtr 为空时返回全进程汇总.
+ */
+void V8GetGCStats(VMPtr vmPtr, V8GCStats *out) {
+    LatencyHistogram::Snapshot snapshot;
+    if (vmPtr == nullptr) {
+        gcPauseTotals.Read(snapshot);
+    } else {
+        vmPtr->gcPauses.Read(snapshot);
+    }
+    out->count = snapshot.total;
+    out->totalNs = snapshot.sum;
+    V8FillLatencySummary(snapshot, &out->pause);
+}
 
-    Local<Value> v = Local<Value>::New(vmPtr->isolate, o->value);
-    if(v->IsBoolean()) {
-        MaybeLocal<Boolean> iValue = v->ToBoolean(vmPtr->isolate);
-        if (iValue.IsEmpty())
-            return def;
-        return iValue.ToLocalChecked()->Value();
-    } else if (v->IsInt32() || v->IsUint32()) {
-        MaybeLocal<Integer> iValue = v->ToInteger(context);
-        if (iValue.IsEmpty())
-            return def;
-        return iValue.ToLocalChecked()->Value() != 0;
+int ResolveModule(VMPtr vmPtr, const std::string &specifierPath, const char *referrer) {
+    if (vmPtr->resolvings.count(specifierPath) != 0) {
+        return 3;
     }
-
-    return def;
+    return V8LoadModule(vmPtr, specifierPath.c_str(), nullptr, referrer);
 }
 
 /*
- * 初始化V8运行环境, 请注意，此处是初始化V8环境，并没有创建任何虚拟机上下文.
+ * 按 Module 的 identity hash 找到 referrer 的路径, 不依赖加载过程中的可变状态,
+ * 嵌套目录下的依赖也能按各自的 referrer 正确解析.
  */
-std::unique_ptr<Platform> _priv_platform = platform::NewDefaultPlatform();
-std::string globalCWD;
+MaybeLocal<Module> V8ResolveCallback(Local<Context> context, Local<String> specifier, Local<Module> referrer) {
+    auto isolate = Isolate::GetCurrent();
+    auto vmPtr = static_cast<VMPtr>(isolate->GetData(0));
 
-void V8Init() {
-    globalCWD = getcwd(nullptr, 0);
-    V8::InitializeICU();
-    V8::InitializePlatform(_priv_platform.get());
-    V8::SetFlagsFromString("--es_staging --harmony");
-    V8::Initialize();
-}
+    String::Utf8Value str(isolate, specifier);
+    std::string moduleName(*str, str.length());
+
+    const std::string *referrerPath = nullptr;
+    auto range = vmPtr->modulePaths.equal_range(referrer->GetIdentityHash());
+    for (auto it = range.first; it != range.second; ++it) {
+        auto mit = vmPtr->modules.find(it->second);
+        if (mit != vmPtr->modules.end() && mit->second.Get(isolate) == referrer) {
+            referrerPath = &it->second;
+            break;
+        }
+    }
 
-/*
- * 销毁V8运行环境.
- */
-void V8Dispose() {
-    V8::Dispose();
-    V8::ShutdownPlatform();
+    auto found = vmPtr->modules.end();
+    if (referrerPath != nullptr) {
+        std::string specifierPath;
+        ModuleResolutionCache::Default().Resolve(moduleName, *referrerPath, specifierPath);
+        found = vmPtr->modules.find(specifierPath);
+    }
+
+    if (found == vmPtr->modules.end()) {
+        std::string out;
+        out.append("Module (");
+        out.append(moduleName);
+        out.append(") has not been loaded");
+        out.append("\n");
+        vmPtr->last_exception = out;
+        MaybeLocal<Module> r;
+        return r;
+    }
+
+    return found->second.Get(isolate);
 }
 
 /*
- * 获取当前工作目录.
+ * 当前挂载的脚本包. 加载过程持有 shared_ptr, 替换或卸载不会影响正在使用的映射.
  */
-const char *V8WorkDir() {
-    return globalCWD.c_str();
+std::mutex bundleMutex;
+std::shared_ptr<ScriptBundle> mountedBundle;
+std::atomic<uint64_t> bundleHits(0);
+std::atomic<uint64_t> codeCacheAccepted(0);
+std::atomic<uint64_t> codeCacheRejected(0);
+
+std::shared_ptr<ScriptBundle> CurrentBundle() {
+    std::lock_guard<std::mutex> lock(bundleMutex);
+    return mountedBundle;
 }
 
 /*
- * 获取最后一条异常信息.
+ * 一份待编译的脚本源码. 来自脚本包时直接指向映射内存, 并可能带有 code cache.
  */
-const char *V8LastException(VMPtr vmPtr) {
-    if (vmPtr->last_exception.length() == 0)
-        return "";
+struct ScriptSource {
+    ScriptSource() : data(nullptr), length(0), cache(nullptr), cacheLength(0), module(false) {}
 
-    std::string s = "Uncaught exception: \n" + vmPtr->last_exception;
-    const char *cs = s.c_str();
-    return cs;
-}
+    ScriptCompiler::CachedData *CachedData(bool isModule) const {
+        if (cache == nullptr || module != isModule)
+            return nullptr;
+        return new ScriptCompiler::CachedData(cache, (int)cacheLength, ScriptCompiler::CachedData::BufferNotOwned);
+    }
 
-/*
- * 设置输出回调.
- */
-void V8SetOutputCallback(OutputCallback cb) {
-    assert(cb == nullptr && "V8SetOutputCallback's arg[OutputCallback] is NULL");
-    outputCallback = cb;
-}
+    std::shared_ptr<ScriptBundle> bundle;
+    VirtualFileSystem::File file;
+    std::string text;
+    const char *data;
+    size_t length;
+    const uint8_t *cache;
+    size_t cacheLength;
+    bool module;
+};
 
 /*
- * 创建一个新的V8虚拟机上下文, 调用前必须确保已经初始化了V8运行环境.
+ * 按 挂载的虚拟文件系统 -> 脚本包 -> 磁盘 的顺序取源码, 并记录按路径的访问计数.
  */
-VMPtr V8NewVM() {
-    VM *vmPtr = new VM;
-    Isolate::CreateParams create_params;
-    create_params.array_buffer_allocator = ArrayBuffer::Allocator::NewDefaultAllocator();
-    Isolate *isolate = Isolate::New(create_params);
+bool ReadScriptSource(const char *path, ScriptSource &out) {
+    VirtualFileSystem &vfs = VirtualFileSystem::Default();
+
+    int r = vfs.Open(path, out.file);
+    if (r >= 0) {
+        out.data = out.file.data;
+        out.length = out.file.length;
+        vfs.Record(path, out.length, r == 1);
+        return r == 1;
+    }
 
-    Locker locker(isolate);
-    HandleScope scope(isolate);
-    Local<Context> context = Context::New(isolate);
-    Context::Scope context_scope(context);
+    ScriptBundle::Item item;
+    out.bundle = CurrentBundle();
+    if (out.bundle != nullptr && out.bundle->Find(path, &item)) {
+        out.data = item.source;
+        out.length = item.sourceLength;
+        out.cache = item.cache;
+        out.cacheLength = item.cacheLength;
+        out.module = item.module;
+        bundleHits.fetch_add(1, std::memory_order_relaxed);
+        vfs.Record(path, out.length, true);
+        return true;
+    }
+    out.bundle.reset();
 
-    auto global = context->Global();
+    bool ok = ReadSourceFile(path, out.text);
+    out.data = out.text.data();
+    out.length = out.text.length();
+    vfs.Record(path, out.length, ok);
+    return ok;
+}
 
-    Local<Value> consoleV = global->Get(context, String::NewFromUtf8(isolate, "console").ToLocalChecked()).ToLocalChecked();
-    Local<Object> console = Local<Object>::Cast(consoleV);
+/*
+ * 动态 import 的后台读取, 脚本包中的模块不会走到这里.
+ */
+bool ReadModuleSource(const std::string &path, std::string &out) {
+    ScriptSource source;
+    if (!ReadScriptSource(path.c_str(), source)) {
+        return false;
+    }
+    if (source.data == source.text.data()) {
+        out.swap(source.text);
+    } else {
+        out.assign(source.data, source.length);
+    }
+    return true;
+}
 
-    bool success = console->Set(context, String::NewFromUtf8(isolate, "log").ToLocalChecked(),
-                   FunctionTemplate::New(isolate, consoleLog)->GetFunction(context).ToLocalChecked()).FromMaybe(false);
+bool BundleContains(const std::string &path) {
+    ScriptBundle::Item item;
+    auto bundle = CurrentBundle();
+    return bundle != nullptr && bundle->Find(path.c_str(), &item);
+}
 
-    success = console->Set(context, String::NewFromUtf8(isolate, "info").ToLocalChecked(),
-                   FunctionTemplate::New(isolate, consoleInfo)->GetFunction(context).ToLocalChecked()).FromMaybe(false);
+ScriptCompiler::CompileOptions CodeCacheOptions(ScriptCompiler::Source &source) {
+    return source.GetCachedData() != nullptr ? ScriptCompiler::kConsumeCodeCache : ScriptCompiler::kNoCompileOptions;
+}
 
-    success = console->Set(context, String::NewFromUtf8(isolate, "assert").ToLocalChecked(),
-                   FunctionTemplate::New(isolate, consoleAssert)->GetFunction(context).ToLocalChecked()).FromMaybe(false);
+void CountCodeCache(ScriptCompiler::Source &source) {
+    const ScriptCompiler::CachedData *cached = source.GetCachedData();
+    if (cached == nullptr)
+        return;
+    if (cached->rejected) {
+        codeCacheRejected.fetch_add(1, std::memory_order_relaxed);
+    } else {
+        codeCacheAccepted.fetch_add(1, std::memory_order_relaxed);
+    }
+}
 
-    success = console->Set(context, String::NewFromUtf8(isolate, "warn").ToLocalChecked(),
-                           FunctionTemplate::New(isolate, consoleWarn)->GetFunction(context).ToLocalChecked()).FromMaybe(false);
+std::string bundleError;
 
-    Local<ObjectTemplate> v8goTmpl = ObjectTemplate::New(isolate);
-    v8goTmpl->Set(isolate, "version", FunctionTemplate::New(isolate, v8goVersion));
-    Local<Object> v8go = v8goTmpl->NewInstance(context).ToLocalChecked();
+/*
+ * 挂载脚本包, 替换之前挂载的包. root 为包内路径对应的绝对目录, 为空时使用工作目录.
+ * 返回 0 成功, -1 失败(原因见 V8LastBundleError).
+ */
+int V8MountBundle(const char *path, const char *root) {
+    std::string error;
+    ScriptBundle *bundle = ScriptBundle::Open(path, root == nullptr || root[0] == '\0' ? globalCWD : root, error);
+
+    std::lock_guard<std::mutex> lock(bundleMutex);
+    if (bundle == nullptr) {
+        bundleError = error;
+        return -1;
+    }
+    bundleError.clear();
+    mountedBundle.reset(bundle);
+    return 0;
+}
 
-    success = global->Set(context, String::NewFromUtf8(isolate, "v8go").ToLocalChecked(), v8go).FromMaybe(false);
+void V8UnmountBundle() {
+    std::lock_guard<std::mutex> lock(bundleMutex);
+    mountedBundle.reset();
+}
 
-    Local<ObjectTemplate> v8goNetTmpl = ObjectTemplate::New(isolate);
-    v8goNetTmpl->Set(isolate, "sendCurrentPlayer", FunctionTemplate::New(isolate, v8goSend));
-    v8goNetTmpl->Set(isolate, "sendToOtherPlayer", FunctionTemplate::New(isolate, v8goSendTo));
-    Local<Object> v8goNet = v8goNetTmpl->NewInstance(context).ToLocalChecked();
+const char *V8LastBundleError() {
+    return bundleError.c_str();
+}
 
-    success = global->Set(context, String::NewFromUtf8(isolate, "net").ToLocalChecked(), v8goNet).FromMaybe(false);
+void V8GetBundleStats(V8BundleStats *stats) {
+    auto bundle = CurrentBundle();
+    stats->modules = bundle == nullptr ? 0 : bundle->Count();
+    stats->hits = bundleHits.load(std::memory_order_relaxed);
+    stats->codeCacheAccepted = codeCacheAccepted.load(std::memory_order_relaxed);
+    stats->codeCacheRejected = codeCacheRejected.load(std::memory_order_relaxed);
+}
 
-    vmPtr->isolate = isolate;
-    vmPtr->context.Reset(isolate, context);
-    vmPtr->allocator = create_params.array_buffer_allocator;
-    vmPtr->lastReferrerPath = V8WorkDir();
+/*
+ * 挂载虚拟文件系统, root 为空时为工作目录. 返回挂载 id, 失败返回 -1.
+ */
+int V8MountVfs(const char *root, const V8VfsProvider *provider) {
+    return VirtualFileSystem::Default().Mount(root == nullptr || root[0] == '\0' ? globalCWD : root, *provider);
+}
 
-    isolate->SetData(0, vmPtr);
+#ifdef GOOUTPUT
+int GoVfsStatCallback(void *ctx, const char *path, uint64_t *size) {
+    return GoVfsStat((uintptr_t)ctx, (char *)path, size);
+}
 
-    return vmPtr;
+int64_t GoVfsReadCallback(void *ctx, const char *path, char *buf, size_t len) {
+    return GoVfsRead((uintptr_t)ctx, (char *)path, buf, len);
 }
+#endif
 
 /*
- * 销毁一个V8虚拟机上下文.
+ * 挂载由 Go 实现的虚拟文件系统, handle 为 Go 侧的注册号.
  */
-void V8DisposeVM(VMPtr vmPtr) {
-    vmPtr->context.Reset();
-    vmPtr->isolate->Dispose();
-    delete vmPtr->allocator;
-    delete vmPtr;
+int V8MountGoVfs(const char *root, uintptr_t handle) {
+#ifdef GOOUTPUT
+    V8VfsProvider provider;
+    memset(&provider, 0, sizeof(provider));
+    provider.ctx = (void *)handle;
+    provider.stat = GoVfsStatCallback;
+    provider.read = GoVfsReadCallback;
+    return V8MountVfs(root, &provider);
+#else
+    return -1;
+#endif
 }
 
-void V8PrintVMMemStat(VMPtr vmPtr) {
-    HeapStatistics hs;
-    vmPtr->isolate->GetHeapStatistics(&hs);
-    printf(">>>>>>>>>>>>>>>>>> HeapStatistics table >>>>>>>>>>>>>>>>>>\n");
-    printf("heap_size_limit: %ld\n", hs.heap_size_limit());
-    printf("total_heap_size: %ld\n", hs.total_heap_size());
-    printf("used_heap_size: %ld\n", hs.used_heap_size());
-    printf("total_physical_size: %ld\n", hs.total_physical_size());
-    printf("total_available_size: %ld\n", hs.total_available_size());
-    printf("total_available_size: %ld\n", hs.malloced_memory());
-    printf(">>>>>>>>>>>>>>>>>> HeapStatistics table >>>>>>>>>>>>>>>>>>\n");
+int V8UnmountVfs(int id) {
+    return VirtualFileSystem::Default().Unmount(id) ? 0 : -1;
 }
 
-void V8SetVMAssociatedSourceAddr(VMPtr vmPtr, const char *addr) {
-    vmPtr->associatedSourceAddr = addr;
+typedef struct _V8PathAccessList {
+    std::vector<std::pair<std::string, VirtualFileSystem::PathCounters>> counters;
+    std::vector<V8PathAccess> items;
+} V8PathAccessList;
+
+V8PathAccessListPtr V8GetPathAccess() {
+    auto list = new V8PathAccessList;
+    VirtualFileSystem::Default().Counters(list->counters);
+    list->items.resize(list->counters.size());
+    for (size_t i = 0; i < list->counters.size(); i++) {
+        list->items[i].path = list->counters[i].first.c_str();
+        list->items[i].reads = list->counters[i].second.reads;
+        list->items[i].misses = list->counters[i].second.misses;
+        list->items[i].bytes = list->counters[i].second.bytes;
+    }
+    return list;
 }
 
-void V8SetVMAssociatedSourceId(VMPtr vmPtr, uint64_t id) {
-    vmPtr->associatedSourceId = id;
+size_t V8GetPathAccessLength(V8PathAccessListPtr list) {
+    return list->items.size();
 }
 
-const char * V8GetVMAssociatedSourceAddr(VMPtr vmPtr) {
-    return vmPtr->associatedSourceAddr.c_str();
+const V8PathAccess *V8GetPathAccessItem(V8PathAccessListPtr list, int index) {
+    if (index < 0 || index >= list->items.size())
+        return nullptr;
+    return &list->items[index];
 }
 
-uint64_t V8GetVMAssociatedSourceId(VMPtr vmPtr) {
-    return vmPtr->associatedSourceId;
+void V8ReleasePathAccess(V8PathAccessListPtr list) {
+    delete list;
 }
 
-int ResolveModule(VMPtr vmPtr, const char *specifier, const char *referrer) {
-    vmPtr->lastReferrerPath = referrer;
-    std::string specifierPath = JoinAbsPath(specifier, referrer);
-    if (vmPtr->resolvings.count(specifierPath) != 0) {
-        return 3;
+thread_local std::string configError;
+
+/*
+ * 从内存解析并注册配置表, 替换同名表. 返回 0 成功, 1 解析失败(原因见 V8LastConfigError).
+ */
+int V8LoadConfigTableData(const char *name, const char *data, size_t len) {
+    std::shared_ptr<ConfigTable> table = ConfigTable::Parse(data, len, configError);
+    if (table == nullptr) {
+        return 1;
     }
-    return V8LoadModule(vmPtr, specifierPath.c_str(), nullptr, referrer);
+    configError.clear();
+    ConfigRegistry::Default().Set(name, table);
+    return 0;
 }
 
-MaybeLocal<Module> V8ResolveCallback(Local<Context> context, Local<String> specifier, Local<Module> referrer) {
-    auto isolate = Isolate::GetCurrent();
-    auto vmPtr = static_cast<VMPtr>(isolate->GetData(0));
+/*
+ * 经由虚拟文件系统/脚本包/磁盘读取 JSON 文件并注册. 返回 0 成功, -1 文件不存在, 1 解析失败.
+ */
+int V8LoadConfigTable(const char *name, const char *path) {
+    ScriptSource source;
+    if (!ReadScriptSource(path, source)) {
+        configError = std::string("config (") + path + ") not found";
+        return -1;
+    }
+    return V8LoadConfigTableData(name, source.data, source.length);
+}
 
-    HandleScope handle_scope(isolate);
+int V8RemoveConfigTable(const char *name) {
+    return ConfigRegistry::Default().Remove(name) ? 0 : -1;
+}
 
-    String::Utf8Value str(isolate, specifier);
-    const char *moduleName = *str;
+const char *V8LastConfigError() {
+    return configError.c_str();
+}
 
-    std::string specifierPath = JoinAbsPath(moduleName, vmPtr->lastReferrerPath);
+/*
+ * 编译(不执行)一段源码并生成 code cache, 供打包工具使用. 返回 malloc 分配的缓冲区, 失败返回 NULL.
+ */
+uint8_t *V8CreateCodeCache(VMPtr vmPtr, const char *fileName, const char *sourceCode, size_t sourceLen, bool isModule, size_t *len) {
+    *len = 0;
 
-    if (vmPtr->modules.count(specifierPath.c_str()) == 0) {
-        std::string out;
-        out.append("Module (");
-        out.append(moduleName);
-        out.append(") has not been loaded");
-        out.append("\n");
-        vmPtr->last_exception = out;
-        MaybeLocal<Module> r;
-        return r;
+    Locker locker(vmPtr->isolate);
+    Isolate::Scope isolate_scope(vmPtr->isolate);
+    HandleScope handle_scope(vmPtr->isolate);
+    Local<Context> context = Local<Context>::New(vmPtr->isolate, vmPtr->context);
+    Context::Scope context_scope(context);
+    TryCatch try_catch(vmPtr->isolate);
+
+    Local<String> name = String::NewFromUtf8(vmPtr->isolate, fileName).ToLocalChecked();
+    Local<String> source_text;
+    if (!String::NewFromUtf8(vmPtr->isolate, sourceCode, NewStringType::kNormal, (int)sourceLen).ToLocal(&source_text)) {
+        return nullptr;
+    }
+
+    ScriptOrigin origin(name, Integer::New(vmPtr->isolate, 0), Integer::New(vmPtr->isolate, 0), True(vmPtr->isolate),
+                        Local<Integer>(), Local<Value>(), False(vmPtr->isolate), False(vmPtr->isolate),
+                        isModule ? True(vmPtr->isolate) : False(vmPtr->isolate));
+    ScriptCompiler::Source source(source_text, origin);
+
+    std::unique_ptr<ScriptCompiler::CachedData> cached;
+    if (isModule) {
+        Local<Module> module;
+        if (!ScriptCompiler::CompileModule(vmPtr->isolate, &source).ToLocal(&module)) {
+            V8CaptureException(vmPtr, &try_catch);
+            return nullptr;
+        }
+        cached.reset(ScriptCompiler::CreateCodeCache(module->GetUnboundModuleScript()));
+    } else {
+        Local<UnboundScript> script;
+        if (!ScriptCompiler::CompileUnboundScript(vmPtr->isolate, &source).ToLocal(&script)) {
+            V8CaptureException(vmPtr, &try_catch);
+            return nullptr;
+        }
+        cached.reset(ScriptCompiler::CreateCodeCache(script));
     }
 
-    return vmPtr->modules[specifierPath.c_str()].Get(isolate);
+    if (cached == nullptr || cached->length <= 0) {
+        return nullptr;
+    }
+    uint8_t *buf = (uint8_t *)malloc(cached->length);
+    if (buf == nullptr) {
+        return nullptr;
+    }
+    memcpy(buf, cached->data, cached->length);
+    *len = cached->length;
+    return buf;
 }
 
 /*
  * 加载一个脚本文件. 指定文件名和代码.
  */
 int V8Load(VMPtr vmPtr, const char *fileName, const char *inSourceCode) {
+    TraceSpan span(kTraceLoad, "Load", vmPtr);
 
-    std::string sourceStr = "";
-    const char * sourceCode = inSourceCode;
-    if(sourceCode == nullptr) {
-        size_t sourceLen = 0;
-        sourceStr = ReadFile(fileName, sourceLen);
-        if (sourceLen == 0) {
-            std::string out;
-            out.append("Failure to exec script (");
-            out.append(fileName);
-            out.append("), maybe the file is not exists?");
-            out.append("\n");
-            vmPtr->last_exception = out;
-            return -1;
-        }
-
-        sourceCode = sourceStr.c_str();
+    ScriptSource code;
+    if (inSourceCode != nullptr) {
+        code.data = inSourceCode;
+        code.length = strlen(inSourceCode);
+    } else if (!ReadScriptSource(fileName, code)) {
+        std::string out;
+        out.append("Failure to exec script (");
+        out.append(fileName);
+        out.append("), maybe the file is not exists?");
+        out.append("\n");
+        vmPtr->last_exception = out;
+        return -1;
     }
 
     Locker locker(vmPtr->isolate);
@@ -1066,7 +4276,7 @@ int V8Load(VMPtr vmPtr, const char *fileName, const char *inSourceCode) {
     TryCatch try_catch(vmPtr->isolate);
 
     Local<String> name = String::NewFromUtf8(vmPtr->isolate, fileName).ToLocalChecked();
-    Local<String> source_text = String::NewFromUtf8(vmPtr->isolate, sourceCode).ToLocalChecked();
+    Local<String> source_text = String::NewFromUtf8(vmPtr->isolate, code.data, NewStringType::kNormal, (int)code.length).ToLocalChecked();
 
     Local<Integer> line_offset = Integer::New(vmPtr->isolate, 0);
     Local<Integer> column_offset = Integer::New(vmPtr->isolate, 0);
@@ -1080,10 +4290,12 @@ int V8Load(VMPtr vmPtr, const char *fileName, const char *inSourceCode) {
     ScriptOrigin origin(name, line_offset, column_offset, is_cross_origin,
                         script_id, source_map_url, is_opaque, is_wasm, is_module);
 
-    MaybeLocal<Script> mScript = Script::Compile(context, source_text, &origin);
+    ScriptCompiler::Source source(source_text, origin, code.CachedData(false));
+    MaybeLocal<Script> mScript = ScriptCompiler::Compile(context, &source, CodeCacheOptions(source));
+    CountCodeCache(source);
     if (mScript.IsEmpty()) {
         assert(try_catch.HasCaught());
-        vmPtr->last_exception = V8ExceptionString(vmPtr, &try_catch);
+        V8CaptureException(vmPtr, &try_catch);
         return 1;
     }
 
@@ -1092,7 +4304,7 @@ int V8Load(VMPtr vmPtr, const char *fileName, const char *inSourceCode) {
     MaybeLocal<Value> result = script->Run(context);
     if (result.IsEmpty()) {
         assert(try_catch.HasCaught());
-        vmPtr->last_exception = V8ExceptionString(vmPtr, &try_catch);
+        V8CaptureException(vmPtr, &try_catch);
         return 2;
     }
 
@@ -1117,7 +4329,11 @@ int V8Load(VMPtr vmPtr, const char *fileName, const char *inSourceCode) {
         vmPtr->last_exception = out;
         return 2;
     }
+    HandlerTimer timer(&vmPtr->stats, kHandlerMain);
     auto s = main->CallAsFunction(context, Undefined(vmPtr->isolate), 0, nullptr);
+    if (s.IsEmpty()) {
+        timer.Fail();
+    }
 
     return 0;
 }
@@ -1126,6 +4342,7 @@ int V8Load(VMPtr vmPtr, const char *fileName, const char *inSourceCode) {
  * 加载一个模块. 指定文件名和代码.
  */
 int V8LoadModule(VMPtr vmPtr, const char *fileName, const char *inSourceCode, const char *referrer) {
+    TraceSpan span(kTraceLoad, "LoadModule", vmPtr);
 
     std::string stlFileName = fileName;
 
@@ -1140,22 +4357,18 @@ int V8LoadModule(VMPtr vmPtr, const char *fileName, const char *inSourceCode, co
     }
     vmPtr->resolvings[stlFileName] = true;
 
-    std::string sourceStr = "";
-    const char * sourceCode = inSourceCode;
-    if(sourceCode == nullptr) {
-        size_t sourceLen = 0;
-        sourceStr = ReadFile(stlFileName.c_str(), sourceLen);
-        if (sourceLen == 0) {
-            std::string out;
-            out.append("Module (");
-            out.append(stlFileName);
-            out.append(") not found, maybe the file is not exists?");
-            out.append("\n");
-            vmPtr->last_exception = out;
-            return -1;
-        }
-
-        sourceCode = sourceStr.c_str();
+    ScriptSource code;
+    if (inSourceCode != nullptr) {
+        code.data = inSourceCode;
+        code.length = strlen(inSourceCode);
+    } else if (!ReadScriptSource(stlFileName.c_str(), code)) {
+        std::string out;
+        out.append("Module (");
+        out.append(stlFileName);
+        out.append(") not found, maybe the file is not exists?");
+        out.append("\n");
+        vmPtr->last_exception = out;
+        return -1;
     }
 
     //printf("\n============= Code =============\n");
@@ -1173,7 +4386,7 @@ int V8LoadModule(VMPtr vmPtr, const char *fileName, const char *inSourceCode, co
     TryCatch try_catch(vmPtr->isolate);
 
     Local<String> name = String::NewFromUtf8(vmPtr->isolate, stlFileName.c_str()).ToLocalChecked();
-    Local<String> source_text = String::NewFromUtf8(vmPtr->isolate, sourceCode).ToLocalChecked();
+    Local<String> source_text = String::NewFromUtf8(vmPtr->isolate, code.data, NewStringType::kNormal, (int)code.length).ToLocalChecked();
 
     Local<Integer> line_offset = Integer::New(vmPtr->isolate, 0);
     Local<Integer> column_offset = Integer::New(vmPtr->isolate, 0);
@@ -1187,12 +4400,14 @@ int V8LoadModule(VMPtr vmPtr, const char *fileName, const char *inSourceCode, co
     ScriptOrigin origin(name, line_offset, column_offset, is_cross_origin,
                         script_id, source_map_url, is_opaque, is_wasm, is_module);
 
-    ScriptCompiler::Source source(source_text, origin);
+    ScriptCompiler::Source source(source_text, origin, code.CachedData(true));
     Local<Module> module;
 
-    if (!ScriptCompiler::CompileModule(vmPtr->isolate, &source).ToLocal(&module)) {
+    bool compiled = ScriptCompiler::CompileModule(vmPtr->isolate, &source, CodeCacheOptions(source)).ToLocal(&module);
+    CountCodeCache(source);
+    if (!compiled) {
         assert(try_catch.HasCaught());
-        vmPtr->last_exception = V8ExceptionString(vmPtr, &try_catch);
+        V8CaptureException(vmPtr, &try_catch);
         return 1;
     }
 
@@ -1201,7 +4416,8 @@ int V8LoadModule(VMPtr vmPtr, const char *fileName, const char *inSourceCode, co
         String::Utf8Value str(vmPtr->isolate, dependency);
         char *dependencySpecifier = *str;
 
-        std::string dependencySpecifierPath = JoinAbsPath(dependencySpecifier, stlFileName);
+        std::string dependencySpecifierPath;
+        ModuleResolutionCache::Default().Resolve(dependencySpecifier, stlFileName, dependencySpecifierPath);
 
         // If we've already loaded the module, skip resolving it.
         // TODO: Is there ever a time when the specifier would be the same
@@ -1210,7 +4426,7 @@ int V8LoadModule(VMPtr vmPtr, const char *fileName, const char *inSourceCode, co
             continue;
         }
 
-        int ret = ResolveModule(vmPtr, dependencySpecifierPath.c_str(), stlFileName.c_str());
+        int ret = ResolveModule(vmPtr, dependencySpecifierPath, stlFileName.c_str());
         if (ret != 0) {
             // TODO: Use module->GetModuleRequestLocation() to get source locations
             std::string out;
@@ -1235,15 +4451,15 @@ int V8LoadModule(VMPtr vmPtr, const char *fileName, const char *inSourceCode, co
 
     Eternal<Module> persModule(vmPtr->isolate, module);
     vmPtr->modules[stlFileName] = persModule;
+    vmPtr->modulePaths.insert(std::make_pair(module->GetIdentityHash(), stlFileName));
 
-    vmPtr->lastReferrerPath = stlFileName;
     Maybe<bool> ok = module->InstantiateModule(context, V8ResolveCallback);
 
     if (!ok.FromMaybe(false)) {
         // TODO: I'm not sure if this is needed
         if (try_catch.HasCaught()) {
             assert(try_catch.HasCaught());
-            vmPtr->last_exception = V8ExceptionString(vmPtr, &try_catch);
+            V8CaptureException(vmPtr, &try_catch);
         }
         return 2;
     }
@@ -1252,9 +4468,126 @@ int V8LoadModule(VMPtr vmPtr, const char *fileName, const char *inSourceCode, co
 
     if (result.IsEmpty()) {
         assert(try_catch.HasCaught());
-        vmPtr->last_exception = V8ExceptionString(vmPtr, &try_catch);
+        V8CaptureException(vmPtr, &try_catch);
         return 2;
     }
 
     return 0;
 }
+
+/*
+ * 按模块当前状态兑现或拒绝 import() 返回的 Promise.
+ */
+void V8SettleImport(VMPtr vmPtr, Local<Context> context, Local<Promise::Resolver> resolver,
+                    const std::string &path, const std::string &error) {
+    Isolate *isolate = vmPtr->isolate;
+
+    auto it = vmPtr->modules.find(path);
+    if (it != vmPtr->modules.end()) {
+        Local<Module> module = it->second.Get(isolate);
+        if (module->GetStatus() == Module::kErrored) {
+            resolver->Reject(context, module->GetException()).FromMaybe(false);
+            return;
+        }
+        if (module->GetStatus() >= Module::kInstantiated) {
+            resolver->Resolve(context, module->GetModuleNamespace()).FromMaybe(false);
+            return;
+        }
+    }
+
+    if (error.empty() && vmPtr->lastExceptionPending) {
+        resolver->Reject(context, vmPtr->lastExceptionValue.Get(isolate)).FromMaybe(false);
+        return;
+    }
+
+    std::string message = error.empty() ? "Module (" + path + ") has not been loaded" : error;
+    Local<String> text = String::NewFromUtf8(isolate, message.c_str()).ToLocalChecked();
+    resolver->Reject(context, Exception::Error(text)).FromMaybe(false);
+}
+
+/*
+ * import() 回调. 已在模块表中的模块直接兑现, 否则提交给后台线程读取源码,
+ * 读取完成后由 V8RunTimers 在虚拟机线程上编译执行并兑现.
+ */
+MaybeLocal<Promise> V8ImportModuleDynamically(Local<Context> context, Local<ScriptOrModule> referrer, Local<String> specifier) {
+    Isolate *isolate = context->GetIsolate();
+    auto vmPtr = static_cast<VMPtr>(isolate->GetData(0));
+    EscapableHandleScope handle_scope(isolate);
+
+    Local<Promise::Resolver> resolver;
+    if (!Promise::Resolver::New(context).ToLocal(&resolver)) {
+        return MaybeLocal<Promise>();
+    }
+
+    std::string referrerPath;
+    Local<Value> resourceName = referrer->GetResourceName();
+    if (resourceName->IsString()) {
+        String::Utf8Value name(isolate, resourceName);
+        referrerPath.assign(*name, name.length());
+    }
+    if (referrerPath.empty() || referrerPath[0] != '/') {
+        referrerPath = globalCWD + "/" + referrerPath;
+    }
+
+    String::Utf8Value str(isolate, specifier);
+    std::string path;
+    ModuleResolutionCache::Default().Resolve(std::string(*str, str.length()), referrerPath, path);
+
+    if (vmPtr->modules.count(path) != 0) {
+        V8SettleImport(vmPtr, context, resolver, path, "");
+        return handle_scope.Escape(resolver->GetPromise());
+    }
+
+    uint32_t id;
+    auto it = vmPtr->importIds.find(path);
+    if (it == vmPtr->importIds.end()) {
+        id = ModuleLoader::Default().Load(vmPtr, path, !BundleContains(path));
+        vmPtr->importIds[path] = id;
+        vmPtr->imports[id].path = path;
+    } else {
+        id = it->second;
+    }
+    vmPtr->imports[id].resolvers.emplace_back(isolate, resolver);
+
+    return handle_scope.Escape(resolver->GetPromise());
+}
+
+/*
+ * 编译执行后台读取完成的模块, 兑现等待中的 import(), 最后执行一次微任务检查点.
+ */
+void V8CompleteImports(VMPtr vmPtr, Local<Context> context, std::vector<ModuleLoader::Result> &loaded) {
+    Isolate *isolate = vmPtr->isolate;
+
+    for (auto &result : loaded) {
+        auto it = vmPtr->imports.find(result.id);
+        if (it == vmPtr->imports.end()) {
+            continue;
+        }
+        VMImport pending = std::move(it->second);
+        vmPtr->imports.erase(it);
+        vmPtr->importIds.erase(pending.path);
+
+        HandleScope handle_scope(isolate);
+
+        std::string error;
+        if (vmPtr->modules.count(pending.path) == 0) {
+            if (!result.ok) {
+                error = "Module (" + pending.path + ") not found, maybe the file is not exists?";
+            } else {
+                vmPtr->last_exception.clear();
+                vmPtr->lastExceptionPending = false;
+                vmPtr->resolvings.clear();
+                const char *source = result.source.empty() ? nullptr : result.source.c_str();
+                if (V8LoadModule(vmPtr, pending.path.c_str(), source, pending.path.c_str()) != 0) {
+                    error = vmPtr->last_exception;
+                }
+            }
+        }
+
+        for (auto &resolver : pending.resolvers) {
+            V8SettleImport(vmPtr, context, resolver.Get(isolate), pending.path, error);
+        }
+    }
+
+    isolate->PerformMicrotaskCheckpoint();
+}
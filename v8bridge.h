@@ -41,6 +41,13 @@ extern "C" {
 #define v8KindObject      (1 << 8)
 #define v8KindArray       (1 << 9)
 
+#define v8ProfileDefault  0
+#define v8ProfileLite     1
+#define v8ProfileJitless  2
+#define v8ProfileTuned    3
+
+#define v8TraceMarshalMessage 0
+
 
 typedef struct _VM VM;
 typedef VM *VMPtr;
@@ -51,22 +58,185 @@ typedef V8StringArrays *V8StringArraysPtr;
 //typedef struct _VMObject VMObject;
 //typedef VMObject *VMObjectPtr;
 
+typedef struct _V8ErrorLocations V8ErrorLocations;
+typedef V8ErrorLocations *V8ErrorLocationsPtr;
+
+typedef struct _V8HeapSummary V8HeapSummary;
+typedef V8HeapSummary *V8HeapSummaryPtr;
+
+typedef struct _V8PathAccessList V8PathAccessList;
+typedef V8PathAccessList *V8PathAccessListPtr;
+
+typedef struct _V8SharedRegions V8SharedRegions;
+typedef V8SharedRegions *V8SharedRegionsPtr;
+
+typedef struct _V8Envelope V8Envelope;
+typedef V8Envelope *V8EnvelopePtr;
+
 typedef struct _VMValue VMValue;
 typedef VMValue *VMValuePtr;
 
 typedef const void *FunctionCallbackInfoPtr;
 
+typedef struct _V8TimerStats {
+    uint64_t active;
+    uint64_t scheduled;
+    uint64_t fired;
+    uint64_t cancelled;
+    uint64_t driftTotalMs;
+    uint64_t driftMaxMs;
+} V8TimerStats;
+
+typedef struct _V8BroadcastStats {
+    uint64_t broadcasts;
+    uint64_t targets;
+    uint64_t maxFanout;
+    uint64_t bytes;
+    uint64_t serializeNs;
+    uint64_t serializeMaxNs;
+} V8BroadcastStats;
+
+typedef struct _V8OutboundStats {
+    uint64_t queued;
+    uint64_t merged;
+    uint64_t batches;
+} V8OutboundStats;
+
+typedef struct _V8TierUpStats {
+    uint64_t optimized;
+    uint64_t codeBytes;
+    uint64_t bytecodeBytes;
+} V8TierUpStats;
+
+typedef struct _V8ErrorInfo {
+    const char *file;
+    int line;
+    int column;
+    const char *message;
+    uint64_t count;
+    size_t frameCount;
+} V8ErrorInfo;
+
+typedef struct _V8ErrorLocation {
+    const char *file;
+    int line;
+    uint64_t count;
+} V8ErrorLocation;
+
+typedef struct _V8OutputStats {
+    uint64_t written;
+    uint64_t dropped;
+    uint64_t rateLimited;
+} V8OutputStats;
+
+typedef struct _V8LatencySummary {
+    uint64_t meanNs;
+    uint64_t p50Ns;
+    uint64_t p90Ns;
+    uint64_t p99Ns;
+    uint64_t p999Ns;
+    uint64_t maxNs;
+} V8LatencySummary;
+
+typedef struct _V8HandlerStats {
+    uint64_t calls;
+    uint64_t errors;
+    V8LatencySummary wall;
+    V8LatencySummary cpu;
+} V8HandlerStats;
+
+typedef struct _V8GCStats {
+    uint64_t count;
+    uint64_t totalNs;
+    V8LatencySummary pause;
+} V8GCStats;
+
+typedef struct _V8PlatformTask *V8PlatformTaskPtr;
+
+typedef struct _V8PlatformStats {
+    int workers;
+    uint64_t pending[3];
+    uint64_t executed[3];
+    uint64_t delayed;
+} V8PlatformStats;
+
+typedef struct _V8TraceStats {
+    uint64_t events;
+    uint64_t dropped;
+} V8TraceStats;
+
+typedef struct _V8HeapSummaryItem {
+    const char *name;
+    uint64_t size;
+    uint64_t count;
+} V8HeapSummaryItem;
+
+typedef struct _V8BundleStats {
+    uint64_t modules;
+    uint64_t hits;
+    uint64_t codeCacheAccepted;
+    uint64_t codeCacheRejected;
+} V8BundleStats;
+
+/*
+ * 虚拟文件系统提供者, path 为相对挂载目录的路径.
+ * stat: 存在返回 0 并写入大小, 否则返回 -1.
+ * read: 读入 buf, 返回字节数, 失败返回 -1.
+ * map/unmap: 可选, 返回在 unmap 之前一直有效的只读内存, 不支持时返回 NULL.
+ */
+typedef struct _V8VfsProvider {
+    void *ctx;
+    int (*stat)(void *ctx, const char *path, uint64_t *size);
+    int64_t (*read)(void *ctx, const char *path, char *buf, size_t len);
+    const char *(*map)(void *ctx, const char *path, size_t *len);
+    void (*unmap)(void *ctx, const char *path, const char *data, size_t len);
+} V8VfsProvider;
+
+typedef struct _V8PathAccess {
+    const char *path;
+    uint64_t reads;
+    uint64_t misses;
+    uint64_t bytes;
+} V8PathAccess;
+
+typedef struct _V8SharedRegionInfo {
+    const char *name;
+    size_t size;
+    long references;
+} V8SharedRegionInfo;
+
 typedef const char *KEY;
 
 typedef int (*OutputCallback) (const char *, FunctionCallbackInfoPtr);
 extern OutputCallback outputCallback;
 
 const char * V8Version();
+void V8SetExecutionProfile(int profile, const char *extraFlags);
+int V8GetExecutionProfile();
+
+void V8SetPlatformOptions(int workers, bool scheduler);
+void V8RunPlatformTask(V8PlatformTaskPtr task, int priority);
+void V8GetPlatformStats(V8PlatformStats *stats);
+
+int V8StartTracing(const char *path, const char *categories, size_t maxEvents);
+int V8StopTracing(V8TraceStats *stats);
+void V8TraceBegin(VMPtr vmPtr, int span, uint64_t sessionId);
+void V8TraceEnd(VMPtr vmPtr, int span);
 void V8Init();
 void V8Dispose();
 const char *V8WorkDir();
 const char *V8LastException(VMPtr);
+uint64_t V8LastExceptionCount(VMPtr vmPtr);
+int V8GetLastError(VMPtr vmPtr, V8ErrorInfo *info);
+const char *V8GetLastErrorFrame(VMPtr vmPtr, int index);
+V8ErrorLocationsPtr V8GetErrorLocations(VMPtr vmPtr);
+size_t V8GetErrorLocationsLength(V8ErrorLocationsPtr locations);
+const V8ErrorLocation *V8GetErrorLocationsItem(V8ErrorLocationsPtr locations, int index);
+void V8ReleaseErrorLocations(V8ErrorLocationsPtr locations);
 void V8SetOutputCallback(OutputCallback);
+void V8EnableAsyncOutput(size_t capacity, uint32_t maxPerSecond, uint32_t flushIntervalMs);
+void V8FlushOutput();
+void V8GetOutputStats(VMPtr vmPtr, V8OutputStats *stats);
 
 VMPtr V8NewVM();
 void V8DisposeVM(VMPtr);
@@ -81,9 +251,78 @@ uint64_t V8GetVMAssociatedSourceId(VMPtr vmPtr);
 int V8Load(VMPtr, const char *, const char *);
 int V8LoadModule(VMPtr, const char *, const char *, const char *);
 
+int V8MountBundle(const char *path, const char *root);
+void V8UnmountBundle();
+const char *V8LastBundleError();
+void V8GetBundleStats(V8BundleStats *stats);
+int V8MountVfs(const char *root, const V8VfsProvider *provider);
+int V8MountGoVfs(const char *root, uintptr_t handle);
+int V8UnmountVfs(int id);
+V8PathAccessListPtr V8GetPathAccess();
+size_t V8GetPathAccessLength(V8PathAccessListPtr list);
+const V8PathAccess *V8GetPathAccessItem(V8PathAccessListPtr list, int index);
+void V8ReleasePathAccess(V8PathAccessListPtr list);
+int V8LoadConfigTable(const char *name, const char *path);
+int V8LoadConfigTableData(const char *name, const char *data, size_t len);
+int V8RemoveConfigTable(const char *name);
+const char *V8LastConfigError();
+uint8_t *V8CreateCodeCache(VMPtr vmPtr, const char *fileName, const char *sourceCode, size_t sourceLen, bool isModule, size_t *len);
+
 int V8DispatchEnterEvent(VMPtr vmPtr, uint64_t sessionId, const char *addr);
 int V8DispatchLeaveEvent(VMPtr vmPtr, uint64_t sessionId, const char *addr);
 int V8DispatchMessageEvent(VMPtr vmPtr, uint64_t sessionId, VMValuePtr vmValuePtr);
+int V8DispatchMessageBuffer(VMPtr vmPtr, uint64_t sessionId, const char *data, size_t len);
+int V8DispatchEnvelope(VMPtr vmPtr, uint64_t sessionId, V8EnvelopePtr envelope);
+V8EnvelopePtr V8RetainEnvelope(V8EnvelopePtr envelope);
+void V8ReleaseEnvelope(V8EnvelopePtr envelope);
+size_t V8EnvelopeLength(V8EnvelopePtr envelope);
+void V8GetBroadcastStats(VMPtr vmPtr, V8BroadcastStats *stats);
+void V8SetSendCoalescing(VMPtr vmPtr, bool enabled);
+void V8GetOutboundStats(VMPtr vmPtr, V8OutboundStats *stats);
+
+int V8Hibernate(VMPtr vmPtr, uint64_t sessionId, uint8_t **data, size_t *len);
+int V8Resume(VMPtr vmPtr, uint64_t sessionId, const uint8_t *data, size_t len);
+size_t V8HeapSize(VMPtr vmPtr);
+
+void V8SetSendMuted(VMPtr vmPtr, bool muted);
+void V8MarkPendingWork(VMPtr vmPtr);
+void V8DiscardPendingWork(VMPtr vmPtr);
+void V8TraceTierUp(VMPtr vmPtr, bool enabled);
+void V8GetTierUpStats(VMPtr vmPtr, V8TierUpStats *stats);
+V8StringArraysPtr V8GetOptimizedFunctions(VMPtr vmPtr);
+
+int V8CreateSharedRegion(const char *name, size_t size);
+int V8ReleaseSharedRegion(const char *name);
+void V8SetSharedRegionScriptPolicy(const char *prefix, size_t maxSize);
+void V8SetAllowAtomicsWait(bool allow);
+V8SharedRegionsPtr V8GetSharedRegions();
+size_t V8GetSharedRegionsLength(V8SharedRegionsPtr regions);
+const V8SharedRegionInfo *V8GetSharedRegionsItem(V8SharedRegionsPtr regions, int index);
+void V8ReleaseSharedRegions(V8SharedRegionsPtr regions);
+
+void V8SetTimerResolution(uint32_t ms);
+int V8RunTimers(VMPtr vmPtr);
+void V8GetTimerStats(VMPtr vmPtr, V8TimerStats *stats);
+
+void V8GetHandlerStats(VMPtr vmPtr, int handler, V8HandlerStats *out);
+void V8GetGCStats(VMPtr vmPtr, V8GCStats *out);
+
+int V8StartCpuProfiling(VMPtr vmPtr, int samplingIntervalUs);
+char *V8StopCpuProfiling(VMPtr vmPtr, size_t *len);
+int V8StopCpuProfilingToFile(VMPtr vmPtr, const char *path);
+
+int V8WriteHeapSnapshot(VMPtr vmPtr, const char *path);
+int V8StartHeapSampling(VMPtr vmPtr, uint64_t sampleInterval, int stackDepth);
+void V8StopHeapSampling(VMPtr vmPtr);
+V8HeapSummaryPtr V8GetHeapSamplingSummary(VMPtr vmPtr);
+size_t V8GetHeapSummaryLength(V8HeapSummaryPtr summary);
+const V8HeapSummaryItem *V8GetHeapSummaryItem(V8HeapSummaryPtr summary, int index);
+void V8ReleaseHeapSummary(V8HeapSummaryPtr summary);
+
+int V8InspectorConnect(VMPtr vmPtr);
+void V8InspectorPost(VMPtr vmPtr, const char *msg, size_t len);
+void V8InspectorClose(VMPtr vmPtr);
+void V8InspectorDisconnect(VMPtr vmPtr);
 
 size_t V8GetStringArraysLength(V8StringArraysPtr v8StringArraysPtr);
 const char *V8GetStringArraysItem(V8StringArraysPtr v8StringArraysPtr, int index);
@@ -0,0 +1,125 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * The ASF licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "v8bundle.h"
+
+#include <fcntl.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/*
+ * FNV-1a 64 位.
+ */
+uint64_t BundleHash(const char *data, size_t len) {
+    uint64_t h = 14695981039346656037ULL;
+    for (size_t i = 0; i < len; i++) {
+        h ^= (uint8_t)data[i];
+        h *= 1099511628211ULL;
+    }
+    return h;
+}
+
+static bool InRange(uint64_t offset, uint64_t length, size_t size) {
+    return offset <= size && length <= size - offset;
+}
+
+ScriptBundle *ScriptBundle::Open(const char *path, const std::string &root, std::string &error) {
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        error = std::string("bundle (") + path + ") can not be opened";
+        return nullptr;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size < (off_t)sizeof(BundleHeader)) {
+        close(fd);
+        error = std::string("bundle (") + path + ") is truncated";
+        return nullptr;
+    }
+
+    void *p = mmap(nullptr, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (p == MAP_FAILED) {
+        error = std::string("bundle (") + path + ") can not be mapped";
+        return nullptr;
+    }
+
+    ScriptBundle *bundle = new ScriptBundle;
+    bundle->base = (const uint8_t *)p;
+    bundle->size = (size_t)st.st_size;
+    bundle->root = root;
+    while (!bundle->root.empty() && bundle->root[bundle->root.length() - 1] == '/')
+        bundle->root.pop_back();
+
+    const BundleHeader *header = (const BundleHeader *)bundle->base;
+    if (memcmp(header->magic, V8_BUNDLE_MAGIC, 4) != 0 || header->version != V8_BUNDLE_VERSION ||
+        header->size != bundle->size ||
+        !InRange(sizeof(BundleHeader), (uint64_t)header->count * sizeof(BundleEntry), bundle->size)) {
+        error = std::string("bundle (") + path + ") has a bad header";
+        delete bundle;
+        return nullptr;
+    }
+
+    const BundleEntry *entries = (const BundleEntry *)(bundle->base + sizeof(BundleHeader));
+    bundle->index.reserve(header->count);
+    for (uint32_t i = 0; i < header->count; i++) {
+        const BundleEntry *e = &entries[i];
+        if (!InRange(e->pathOffset, e->pathLength, bundle->size) ||
+            !InRange(e->sourceOffset, e->sourceLength, bundle->size) ||
+            !InRange(e->cacheOffset, e->cacheLength, bundle->size) ||
+            BundleHash((const char *)bundle->base + e->sourceOffset, e->sourceLength) != e->hash) {
+            error = std::string("bundle (") + path + ") is corrupted at entry " + std::to_string(i);
+            delete bundle;
+            return nullptr;
+        }
+        bundle->index[std::string((const char *)bundle->base + e->pathOffset, e->pathLength)] = e;
+    }
+
+    return bundle;
+}
+
+ScriptBundle::~ScriptBundle() {
+    if (base != nullptr)
+        munmap((void *)base, size);
+}
+
+bool ScriptBundle::Find(const char *path, Item *out) const {
+    const char *rel = path;
+    size_t rootLen = root.length();
+    if (path[0] == '/') {
+        if (strncmp(path, root.c_str(), rootLen) != 0 || path[rootLen] != '/')
+            return false;
+        rel = path + rootLen + 1;
+    }
+    while (rel[0] == '.' && rel[1] == '/')
+        rel += 2;
+
+    auto it = index.find(rel);
+    if (it == index.end())
+        return false;
+
+    const BundleEntry *e = it->second;
+    out->source = (const char *)base + e->sourceOffset;
+    out->sourceLength = e->sourceLength;
+    out->cache = e->cacheLength == 0 ? nullptr : base + e->cacheOffset;
+    out->cacheLength = e->cacheLength;
+    out->hash = e->hash;
+    out->module = (e->flags & V8_BUNDLE_MODULE) != 0;
+    return true;
+}
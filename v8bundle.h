@@ -0,0 +1,98 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * The ASF licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef V8_BUNDLE_H
+#define V8_BUNDLE_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include <string>
+#include <unordered_map>
+
+/*
+ * 脚本包格式, 全部为小端:
+ *   BundleHeader
+ *   BundleEntry[count]
+ *   路径字符串表
+ *   各模块的源码与可选的 code cache
+ * 所有偏移均相对文件起始. 整个文件以只读方式 mmap, 加载模块时不再有文件系统调用.
+ */
+#define V8_BUNDLE_MAGIC     "V8GB"
+#define V8_BUNDLE_VERSION   1
+
+#define V8_BUNDLE_MODULE    1
+
+struct BundleHeader {
+    char magic[4];
+    uint32_t version;
+    uint32_t count;
+    uint32_t flags;
+    uint64_t size;
+};
+
+struct BundleEntry {
+    uint64_t hash;
+    uint64_t sourceOffset;
+    uint64_t cacheOffset;
+    uint32_t pathOffset;
+    uint32_t pathLength;
+    uint32_t sourceLength;
+    uint32_t cacheLength;
+    uint32_t flags;
+    uint32_t reserved;
+};
+
+uint64_t BundleHash(const char *data, size_t len);
+
+class ScriptBundle {
+public:
+    struct Item {
+        const char *source;
+        size_t sourceLength;
+        const uint8_t *cache;
+        size_t cacheLength;
+        uint64_t hash;
+        bool module;
+    };
+
+    /*
+     * 映射并校验脚本包, 失败时返回 nullptr 并写入 error.
+     * root 为包内相对路径对应的绝对目录.
+     */
+    static ScriptBundle *Open(const char *path, const std::string &root, std::string &error);
+
+    ~ScriptBundle();
+
+    /*
+     * 按绝对路径或相对路径查找.
+     */
+    bool Find(const char *path, Item *out) const;
+
+    size_t Count() const { return index.size(); }
+    const std::string &Root() const { return root; }
+
+private:
+    ScriptBundle() : base(nullptr), size(0) {}
+
+    const uint8_t *base;
+    size_t size;
+    std::string root;
+    std::unordered_map<std::string, const BundleEntry *> index;
+};
+
+#endif  // !defined(V8_BUNDLE_H)
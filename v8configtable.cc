@@ -0,0 +1,395 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * The ASF licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "v8configtable.h"
+
+#include <algorithm>
+#include <ctype.h>
+#include <stdlib.h>
+#include <string.h>
+
+class ConfigTable::Parser {
+public:
+    Parser(ConfigTable *table, const char *data, size_t len)
+        : table(table), p(data), begin(data), end(data + len), depth(0) {}
+
+    bool Parse(std::string &error) {
+        SkipSpace();
+        if (!Value()) {
+            error = this->error.empty() ? "unexpected token" : this->error;
+            error += " at offset " + std::to_string(p - begin);
+            return false;
+        }
+        SkipSpace();
+        if (p != end) {
+            error = "trailing characters at offset " + std::to_string(p - begin);
+            return false;
+        }
+        return true;
+    }
+
+private:
+    static const int kMaxDepth = 256;
+
+    void SkipSpace() {
+        while (p < end && (*p == ' ' || *p == '\t' || *p == '\n' || *p == '\r'))
+            p++;
+    }
+
+    bool Fail(const char *message) {
+        error = message;
+        return false;
+    }
+
+    uint32_t NewNode(uint8_t type) {
+        Node node;
+        node.type = type;
+        node.first = 0;
+        node.count = 0;
+        node.number = 0;
+        table->nodes.push_back(node);
+        return (uint32_t)(table->nodes.size() - 1);
+    }
+
+    bool Literal(const char *word, uint8_t type) {
+        size_t n = strlen(word);
+        if ((size_t)(end - p) < n || memcmp(p, word, n) != 0)
+            return Fail("invalid literal");
+        p += n;
+        NewNode(type);
+        return true;
+    }
+
+    static void AppendUTF8(std::string &out, uint32_t c) {
+        if (c < 0x80) {
+            out.push_back((char)c);
+        } else if (c < 0x800) {
+            out.push_back((char)(0xC0 | (c >> 6)));
+            out.push_back((char)(0x80 | (c & 0x3F)));
+        } else if (c < 0x10000) {
+            out.push_back((char)(0xE0 | (c >> 12)));
+            out.push_back((char)(0x80 | ((c >> 6) & 0x3F)));
+            out.push_back((char)(0x80 | (c & 0x3F)));
+        } else {
+            out.push_back((char)(0xF0 | (c >> 18)));
+            out.push_back((char)(0x80 | ((c >> 12) & 0x3F)));
+            out.push_back((char)(0x80 | ((c >> 6) & 0x3F)));
+            out.push_back((char)(0x80 | (c & 0x3F)));
+        }
+    }
+
+    bool Hex4(uint32_t &out) {
+        if (end - p < 4)
+            return false;
+        out = 0;
+        for (int i = 0; i < 4; i++) {
+            char c = *p++;
+            out <<= 4;
+            if (c >= '0' && c <= '9') out |= c - '0';
+            else if (c >= 'a' && c <= 'f') out |= c - 'a' + 10;
+            else if (c >= 'A' && c <= 'F') out |= c - 'A' + 10;
+            else return false;
+        }
+        return true;
+    }
+
+    /*
+     * 解析字符串并追加到池中, 返回偏移和长度.
+     */
+    bool String(uint32_t &offset, uint32_t &length) {
+        std::string &pool = table->pool;
+        p++;
+        offset = (uint32_t)pool.size();
+        for (;;) {
+            const char *start = p;
+            while (p < end && *p != '"' && *p != '\\' && (uint8_t)*p >= 0x20)
+                p++;
+            pool.append(start, p - start);
+            if (p >= end)
+                return Fail("unterminated string");
+            if (*p == '"') {
+                p++;
+                break;
+            }
+            if (*p != '\\')
+                return Fail("control character in string");
+
+            p++;
+            if (p >= end)
+                return Fail("unterminated string");
+            char c = *p++;
+            switch (c) {
+                case '"': pool.push_back('"'); break;
+                case '\\': pool.push_back('\\'); break;
+                case '/': pool.push_back('/'); break;
+                case 'b': pool.push_back('\b'); break;
+                case 'f': pool.push_back('\f'); break;
+                case 'n': pool.push_back('\n'); break;
+                case 'r': pool.push_back('\r'); break;
+                case 't': pool.push_back('\t'); break;
+                case 'u': {
+                    uint32_t cp;
+                    if (!Hex4(cp))
+                        return Fail("invalid unicode escape");
+                    if (cp >= 0xD800 && cp < 0xDC00 && end - p >= 6 && p[0] == '\\' && p[1] == 'u') {
+                        const char *save = p;
+                        p += 2;
+                        uint32_t low;
+                        if (Hex4(low) && low >= 0xDC00 && low < 0xE000) {
+                            cp = 0x10000 + ((cp - 0xD800) << 10) + (low - 0xDC00);
+                        } else {
+                            p = save;
+                        }
+                    }
+                    AppendUTF8(pool, cp);
+                    break;
+                }
+                default:
+                    return Fail("invalid escape");
+            }
+        }
+        length = (uint32_t)(pool.size() - offset);
+        return true;
+    }
+
+    /*
+     * 先按 JSON 文法确定数字的范围, strtod 还接受十六进制, inf/nan 和前导 '+'.
+     */
+    bool Number() {
+        const char *start = p;
+        if (p < end && *p == '-')
+            p++;
+        if (p < end && *p == '0') {
+            p++;
+        } else if (p < end && *p >= '1' && *p <= '9') {
+            while (p < end && isdigit((uint8_t)*p))
+                p++;
+        } else {
+            return Fail("invalid number");
+        }
+        if (p < end && *p == '.') {
+            p++;
+            if (p >= end || !isdigit((uint8_t)*p))
+                return Fail("invalid number");
+            while (p < end && isdigit((uint8_t)*p))
+                p++;
+        }
+        if (p < end && (*p == 'e' || *p == 'E')) {
+            p++;
+            if (p < end && (*p == '+' || *p == '-'))
+                p++;
+            if (p >= end || !isdigit((uint8_t)*p))
+                return Fail("invalid number");
+            while (p < end && isdigit((uint8_t)*p))
+                p++;
+        }
+        if (p < end && (isalnum((uint8_t)*p) || *p == '.'))
+            return Fail("invalid number");
+
+        std::string text(start, p - start);
+        uint32_t node = NewNode(kNumber);
+        table->nodes[node].number = strtod(text.c_str(), nullptr);
+        return true;
+    }
+
+    bool Array() {
+        p++;
+        uint32_t node = NewNode(kArray);
+        std::vector<uint32_t> values;
+
+        SkipSpace();
+        if (p < end && *p == ']') {
+            p++;
+        } else {
+            for (;;) {
+                SkipSpace();
+                values.push_back((uint32_t)table->nodes.size());
+                if (!Value())
+                    return false;
+                SkipSpace();
+                if (p < end && *p == ',') {
+                    p++;
+                    continue;
+                }
+                if (p < end && *p == ']') {
+                    p++;
+                    break;
+                }
+                return Fail("expected ',' or ']'");
+            }
+        }
+
+        table->nodes[node].first = (uint32_t)table->items.size();
+        table->nodes[node].count = (uint32_t)values.size();
+        table->items.insert(table->items.end(), values.begin(), values.end());
+        return true;
+    }
+
+    bool Object() {
+        p++;
+        uint32_t node = NewNode(kObject);
+        std::vector<Member> fields;
+
+        SkipSpace();
+        if (p < end && *p == '}') {
+            p++;
+        } else {
+            for (;;) {
+                SkipSpace();
+                if (p >= end || *p != '"')
+                    return Fail("expected string key");
+                Member m;
+                if (!String(m.key, m.keyLength))
+                    return false;
+                SkipSpace();
+                if (p >= end || *p != ':')
+                    return Fail("expected ':'");
+                p++;
+                SkipSpace();
+                m.value = (uint32_t)table->nodes.size();
+                if (!Value())
+                    return false;
+                fields.push_back(m);
+                SkipSpace();
+                if (p < end && *p == ',') {
+                    p++;
+                    continue;
+                }
+                if (p < end && *p == '}') {
+                    p++;
+                    break;
+                }
+                return Fail("expected ',' or '}'");
+            }
+        }
+
+        // 按键排序, 重复的键保留最后一个
+        const std::string &pool = table->pool;
+        auto less = [&pool](const Member &a, const Member &b) {
+            int c = memcmp(pool.data() + a.key, pool.data() + b.key, std::min(a.keyLength, b.keyLength));
+            return c < 0 || (c == 0 && a.keyLength < b.keyLength);
+        };
+        std::stable_sort(fields.begin(), fields.end(), less);
+        std::vector<Member> unique;
+        unique.reserve(fields.size());
+        for (auto &m : fields) {
+            if (!unique.empty() && !less(unique.back(), m))
+                unique.back() = m;
+            else
+                unique.push_back(m);
+        }
+
+        table->nodes[node].first = (uint32_t)table->members.size();
+        table->nodes[node].count = (uint32_t)unique.size();
+        table->members.insert(table->members.end(), unique.begin(), unique.end());
+        return true;
+    }
+
+    bool Value() {
+        if (p >= end)
+            return Fail("unexpected end of input");
+        if (++depth > kMaxDepth)
+            return Fail("nesting too deep");
+
+        bool ok;
+        switch (*p) {
+            case '{': ok = Object(); break;
+            case '[': ok = Array(); break;
+            case '"': {
+                uint32_t node = NewNode(kString);
+                uint32_t offset, length;
+                ok = String(offset, length);
+                table->nodes[node].first = offset;
+                table->nodes[node].count = length;
+                break;
+            }
+            case 't': ok = Literal("true", kTrue); break;
+            case 'f': ok = Literal("false", kFalse); break;
+            case 'n': ok = Literal("null", kNull); break;
+            default: ok = Number(); break;
+        }
+
+        depth--;
+        return ok;
+    }
+
+    ConfigTable *table;
+    const char *p;
+    const char *begin;
+    const char *end;
+    int depth;
+    std::string error;
+};
+
+std::shared_ptr<ConfigTable> ConfigTable::Parse(const char *data, size_t len, std::string &error) {
+    std::shared_ptr<ConfigTable> table(new ConfigTable);
+    Parser parser(table.get(), data, len);
+    if (!parser.Parse(error))
+        return nullptr;
+
+    table->nodes.shrink_to_fit();
+    table->members.shrink_to_fit();
+    table->items.shrink_to_fit();
+    table->pool.shrink_to_fit();
+    return table;
+}
+
+int64_t ConfigTable::Find(const Node &object, const char *key, size_t len) const {
+    const Member *lo = Members(object);
+    const Member *hi = lo + object.count;
+    while (lo < hi) {
+        const Member *mid = lo + (hi - lo) / 2;
+        int c = memcmp(pool.data() + mid->key, key, std::min<size_t>(mid->keyLength, len));
+        if (c == 0)
+            c = mid->keyLength < len ? -1 : (mid->keyLength > len ? 1 : 0);
+        if (c == 0)
+            return mid->value;
+        if (c < 0)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    return -1;
+}
+
+size_t ConfigTable::MemoryUsage() const {
+    return nodes.capacity() * sizeof(Node) + members.capacity() * sizeof(Member) +
+           items.capacity() * sizeof(uint32_t) + pool.capacity();
+}
+
+ConfigRegistry &ConfigRegistry::Default() {
+    static ConfigRegistry registry;
+    return registry;
+}
+
+void ConfigRegistry::Set(const std::string &name, const std::shared_ptr<ConfigTable> &table) {
+    std::lock_guard<std::mutex> lock(mutex);
+    tables[name] = table;
+}
+
+std::shared_ptr<ConfigTable> ConfigRegistry::Get(const std::string &name) {
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = tables.find(name);
+    if (it == tables.end())
+        return nullptr;
+    return it->second;
+}
+
+bool ConfigRegistry::Remove(const std::string &name) {
+    std::lock_guard<std::mutex> lock(mutex);
+    return tables.erase(name) != 0;
+}
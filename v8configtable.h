@@ -0,0 +1,103 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * The ASF licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef V8_CONFIG_TABLE_H
+#define V8_CONFIG_TABLE_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+/*
+ * 只读配置表. 由 JSON 解析为扁平的节点数组, 对象成员按键排序以便二分查找,
+ * 字符串集中存放在一个池中. 解析后不再修改, 可被任意线程/虚拟机同时读取.
+ */
+class ConfigTable {
+public:
+    enum Type {
+        kNull,
+        kFalse,
+        kTrue,
+        kNumber,
+        kString,
+        kArray,
+        kObject,
+    };
+
+    /*
+     * kString: first 为字符串池偏移, count 为长度;
+     * kArray: items[first, first + count); kObject: members[first, first + count).
+     */
+    struct Node {
+        uint8_t type;
+        uint32_t first;
+        uint32_t count;
+        double number;
+    };
+
+    struct Member {
+        uint32_t key;
+        uint32_t keyLength;
+        uint32_t value;
+    };
+
+    static std::shared_ptr<ConfigTable> Parse(const char *data, size_t len, std::string &error);
+
+    uint32_t Root() const { return 0; }
+    const Node &At(uint32_t index) const { return nodes[index]; }
+    const char *Chars(uint32_t offset) const { return pool.data() + offset; }
+    const Member *Members(const Node &object) const { return members.data() + object.first; }
+    uint32_t Item(const Node &array, uint32_t index) const { return items[array.first + index]; }
+
+    /*
+     * 在对象中查找键, 不存在返回 -1.
+     */
+    int64_t Find(const Node &object, const char *key, size_t len) const;
+
+    size_t MemoryUsage() const;
+
+private:
+    class Parser;
+
+    std::vector<Node> nodes;
+    std::vector<Member> members;
+    std::vector<uint32_t> items;
+    std::string pool;
+};
+
+/*
+ * 全进程的命名配置表. 替换同名表不影响仍在使用旧表的虚拟机.
+ */
+class ConfigRegistry {
+public:
+    static ConfigRegistry &Default();
+
+    void Set(const std::string &name, const std::shared_ptr<ConfigTable> &table);
+    std::shared_ptr<ConfigTable> Get(const std::string &name);
+    bool Remove(const std::string &name);
+
+private:
+    std::mutex mutex;
+    std::unordered_map<std::string, std::shared_ptr<ConfigTable>> tables;
+};
+
+#endif  // !defined(V8_CONFIG_TABLE_H)
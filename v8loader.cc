@@ -0,0 +1,159 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * The ASF licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "v8loader.h"
+
+#include <stdio.h>
+
+bool ReadSourceFile(const std::string &path, std::string &out) {
+    out.clear();
+    FILE *f = fopen(path.c_str(), "rb");
+    if (f == nullptr) {
+        return false;
+    }
+
+    char buf[16 * 1024];
+    size_t n;
+    while ((n = fread(buf, 1, sizeof(buf), f)) > 0) {
+        out.append(buf, n);
+    }
+    bool ok = ferror(f) == 0;
+    fclose(f);
+    return ok;
+}
+
+ModuleLoader &ModuleLoader::Default() {
+    static ModuleLoader loader;
+    return loader;
+}
+
+ModuleLoader::ModuleLoader() : started(false), stopping(false), readyCallback(nullptr), reader(ReadSourceFile) {
+}
+
+ModuleLoader::~ModuleLoader() {
+    Stop();
+}
+
+void ModuleLoader::SetReadyCallback(ReadyCallback cb) {
+    std::lock_guard<std::mutex> lock(mutex);
+    readyCallback = cb;
+}
+
+void ModuleLoader::SetReader(SourceReader r) {
+    std::lock_guard<std::mutex> lock(mutex);
+    reader = r == nullptr ? ReadSourceFile : r;
+}
+
+uint32_t ModuleLoader::Load(void *owner, const std::string &path, bool read) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (!started) {
+        started = true;
+        stopping = false;
+        worker = std::thread(&ModuleLoader::Run, this);
+    }
+
+    OwnerState &state = owners[owner];
+    uint32_t id = state.nextId++;
+    if (state.nextId == 0)
+        state.nextId = 1;
+
+    Job job;
+    job.owner = owner;
+    job.id = id;
+    job.read = read;
+    job.path = path;
+    jobs.push_back(job);
+    wakeup.notify_one();
+    return id;
+}
+
+size_t ModuleLoader::TakeReady(void *owner, std::vector<Result> &out) {
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = owners.find(owner);
+    if (it == owners.end())
+        return 0;
+    out.swap(it->second.ready);
+    it->second.ready.clear();
+    return out.size();
+}
+
+void ModuleLoader::RemoveOwner(void *owner) {
+    std::lock_guard<std::mutex> notifyLock(notifyMutex);
+    std::lock_guard<std::mutex> lock(mutex);
+    owners.erase(owner);
+
+    auto last = jobs.begin();
+    for (auto it = jobs.begin(); it != jobs.end(); ++it) {
+        if (it->owner != owner)
+            *last++ = *it;
+    }
+    jobs.erase(last, jobs.end());
+}
+
+void ModuleLoader::Stop() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (!started)
+            return;
+        stopping = true;
+    }
+    wakeup.notify_one();
+    worker.join();
+
+    std::lock_guard<std::mutex> lock(mutex);
+    jobs.clear();
+    owners.clear();
+    started = false;
+}
+
+void ModuleLoader::Run() {
+    for (;;) {
+        Job job;
+        SourceReader read;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            wakeup.wait(lock, [this] { return stopping || !jobs.empty(); });
+            if (stopping)
+                return;
+            job = jobs.front();
+            jobs.pop_front();
+            read = reader;
+        }
+
+        // 文件读取不持锁
+        Result result;
+        result.id = job.id;
+        result.path = job.path;
+        result.ok = !job.read || read(job.path, result.source);
+
+        // 与 RemoveOwner 互斥, 确认 owner 仍然存在后再投递和通知
+        std::lock_guard<std::mutex> notifyLock(notifyMutex);
+        ReadyCallback cb;
+        bool notify;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            auto it = owners.find(job.owner);
+            if (it == owners.end())
+                continue;
+            notify = it->second.ready.empty();
+            it->second.ready.push_back(std::move(result));
+            cb = readyCallback;
+        }
+        if (notify && cb != nullptr)
+            cb(job.owner);
+    }
+}
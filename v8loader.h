@@ -0,0 +1,110 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * The ASF licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef V8_LOADER_H
+#define V8_LOADER_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+/*
+ * 读取整个文件, 只有打开或读取出错时返回 false, 空文件返回 true.
+ */
+bool ReadSourceFile(const std::string &path, std::string &out);
+
+/*
+ * 全进程共享的模块源码加载器, 一个后台线程负责读取文件.
+ * 读取结果按 owner(虚拟机) 归集, owner 的完成队列由空变为非空时调用一次 ReadyCallback,
+ * 由 owner 自己的执行线程通过 TakeReady 取走后再编译执行.
+ */
+class ModuleLoader {
+public:
+    typedef void (*ReadyCallback)(void *owner);
+    typedef bool (*SourceReader)(const std::string &path, std::string &out);
+
+    struct Result {
+        uint32_t id;
+        bool ok;
+        std::string path;
+        std::string source;
+    };
+
+    static ModuleLoader &Default();
+
+    ModuleLoader();
+    ~ModuleLoader();
+
+    void SetReadyCallback(ReadyCallback cb);
+
+    /*
+     * 替换默认的磁盘读取, 在后台线程上调用.
+     */
+    void SetReader(SourceReader reader);
+
+    /*
+     * 提交一个读取请求, 返回请求 id. read 为 false 时不读取文件, 仅按顺序投递空的完成结果,
+     * 用于源码已在内存中(如脚本包)的模块.
+     */
+    uint32_t Load(void *owner, const std::string &path, bool read = true);
+    size_t TakeReady(void *owner, std::vector<Result> &out);
+
+    /*
+     * 丢弃 owner 未完成和已完成的请求, 返回时保证不再有该 owner 的 ReadyCallback 正在执行.
+     * 不能在 ReadyCallback 内调用.
+     */
+    void RemoveOwner(void *owner);
+
+    void Stop();
+
+private:
+    struct Job {
+        void *owner;
+        uint32_t id;
+        bool read;
+        std::string path;
+    };
+
+    struct OwnerState {
+        OwnerState() : nextId(1) {}
+
+        std::vector<Result> ready;
+        uint32_t nextId;
+    };
+
+    void Run();
+
+    std::mutex mutex;
+    std::mutex notifyMutex;
+    std::condition_variable wakeup;
+    std::thread worker;
+    bool started;
+    bool stopping;
+    ReadyCallback readyCallback;
+    SourceReader reader;
+    std::deque<Job> jobs;
+    std::unordered_map<void *, OwnerState> owners;
+};
+
+#endif  // !defined(V8_LOADER_H)
@@ -0,0 +1,248 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * The ASF licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "v8log.h"
+
+#include <chrono>
+#include <string.h>
+
+LogRing::LogRing(size_t capacity, uint32_t maxPerSecond)
+    : head(0), tail(0), maxPerSecond(maxPerSecond), window(0), windowCount(0),
+      written(0), dropped(0), rateLimited(0) {
+    size_t size = 1;
+    while (size < capacity) {
+        size <<= 1;
+    }
+    slots.resize(size);
+    mask = size - 1;
+}
+
+bool LogRing::Admit(time_t now) {
+    if (maxPerSecond != 0) {
+        if (now != window) {
+            window = now;
+            windowCount = 0;
+        }
+        if (windowCount >= maxPerSecond) {
+            rateLimited.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+        windowCount++;
+    }
+
+    uint64_t t = tail.load(std::memory_order_relaxed);
+    if (t - head.load(std::memory_order_acquire) > mask) {
+        dropped.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+    return true;
+}
+
+void LogRing::Push(char tag, time_t now, std::string &&text) {
+    uint64_t t = tail.load(std::memory_order_relaxed);
+    Record &r = slots[t & mask];
+    r.tag = tag;
+    r.sec = now;
+    r.text = std::move(text);
+    tail.store(t + 1, std::memory_order_release);
+    written.fetch_add(1, std::memory_order_relaxed);
+
+    if (t - head.load(std::memory_order_relaxed) == (mask + 1) * 3 / 4) {
+        LogService::Default().Wakeup();
+    }
+}
+
+size_t LogRing::Drain(std::vector<Record> &out) {
+    uint64_t h = head.load(std::memory_order_relaxed);
+    uint64_t t = tail.load(std::memory_order_acquire);
+    size_t n = 0;
+    for (; h < t; h++, n++) {
+        Record &r = slots[h & mask];
+        out.push_back(std::move(r));
+        r.text.clear();
+    }
+    head.store(h, std::memory_order_release);
+    return n;
+}
+
+void LogRing::Counters(LogCounters *out) const {
+    out->written = written.load(std::memory_order_relaxed);
+    out->dropped = dropped.load(std::memory_order_relaxed);
+    out->rateLimited = rateLimited.load(std::memory_order_relaxed);
+}
+
+LogService &LogService::Default() {
+    static LogService service;
+    return service;
+}
+
+LogService::LogService()
+    : enabled(false), stopping(false), capacity(1024), maxPerSecond(0), flushIntervalMs(50),
+      callback(nullptr), cachedSec(0) {
+    memset(&retired, 0, sizeof(retired));
+    cachedTime[0] = '\0';
+}
+
+LogService::~LogService() {
+    // 进程退出时不再回调
+    callback = nullptr;
+    Stop();
+}
+
+/*
+ * 只能配置一次, 之后创建的虚拟机日志走异步通道.
+ */
+void LogService::Configure(size_t capacity, uint32_t maxPerSecond, uint32_t flushIntervalMs, BatchCallback cb) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (enabled)
+        return;
+
+    this->capacity = capacity != 0 ? capacity : 1024;
+    this->maxPerSecond = maxPerSecond;
+    this->flushIntervalMs = flushIntervalMs != 0 ? flushIntervalMs : 50;
+    callback = cb;
+    stopping = false;
+    enabled = true;
+    worker = std::thread(&LogService::Run, this);
+}
+
+LogRing *LogService::Attach() {
+    auto ring = new LogRing(capacity, maxPerSecond);
+    std::lock_guard<std::mutex> lock(mutex);
+    rings.insert(ring);
+    return ring;
+}
+
+/*
+ * 虚拟机销毁时调用, 先把剩余日志刷出.
+ */
+void LogService::Detach(LogRing *ring) {
+    std::lock_guard<std::recursive_mutex> deliverLock(deliverMutex);
+    std::string batch;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        DrainLocked(ring, batch);
+
+        LogCounters c;
+        ring->Counters(&c);
+        retired.written += c.written;
+        retired.dropped += c.dropped;
+        retired.rateLimited += c.rateLimited;
+        rings.erase(ring);
+        delete ring;
+    }
+    Deliver(batch);
+}
+
+void LogService::Counters(LogRing *ring, LogCounters *out) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (ring != nullptr) {
+        ring->Counters(out);
+        return;
+    }
+
+    *out = retired;
+    for (auto r : rings) {
+        LogCounters c;
+        r->Counters(&c);
+        out->written += c.written;
+        out->dropped += c.dropped;
+        out->rateLimited += c.rateLimited;
+    }
+}
+
+void LogService::Wakeup() {
+    wakeup.notify_one();
+}
+
+void LogService::DrainLocked(LogRing *ring, std::string &batch) {
+    scratch.clear();
+    if (ring->Drain(scratch) == 0)
+        return;
+
+    for (auto &r : scratch) {
+        // 时间戳每秒只格式化一次
+        if (r.sec != cachedSec) {
+            cachedSec = r.sec;
+            struct tm tmv;
+            localtime_r(&r.sec, &tmv);
+            size_t l = strftime(cachedTime, sizeof(cachedTime), "%H:%M:%S", &tmv);
+            cachedTime[l] = 0;
+        }
+
+        // 每条记录前为 4 字节小端长度, 文本中可以包含换行
+        size_t start = batch.size();
+        batch.append(4, '\0');
+        batch += "[J][";
+        batch += r.tag;
+        batch += "]";
+        batch += cachedTime;
+        batch += " >>> ";
+        batch += r.text;
+        uint32_t len = (uint32_t)(batch.size() - start - 4);
+        for (int i = 0; i < 4; i++) {
+            batch[start + i] = (char)((len >> (8 * i)) & 0xFF);
+        }
+    }
+}
+
+/*
+ * 回调在释放 mutex 之后执行, 回调中可以查询统计或继续输出日志;
+ * deliverMutex 保证各批次按取出的顺序交付.
+ */
+void LogService::Deliver(const std::string &batch) {
+    if (!batch.empty() && callback != nullptr)
+        callback(batch.data(), batch.length());
+}
+
+void LogService::Flush() {
+    std::lock_guard<std::recursive_mutex> deliverLock(deliverMutex);
+    std::string batch;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        for (auto ring : rings) {
+            DrainLocked(ring, batch);
+        }
+    }
+    Deliver(batch);
+}
+
+void LogService::Stop() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (!enabled || stopping)
+            return;
+        stopping = true;
+    }
+    wakeup.notify_one();
+    worker.join();
+    Flush();
+}
+
+void LogService::Run() {
+    for (;;) {
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            if (stopping)
+                return;
+            wakeup.wait_for(lock, std::chrono::milliseconds(flushIntervalMs));
+            if (stopping)
+                return;
+        }
+        Flush();
+    }
+}
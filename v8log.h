@@ -0,0 +1,133 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * The ASF licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef V8_LOG_H
+#define V8_LOG_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <time.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+
+struct LogCounters {
+    uint64_t written;
+    uint64_t dropped;
+    uint64_t rateLimited;
+};
+
+/*
+ * 单个虚拟机的日志环形缓冲区. 生产者是持有该虚拟机 Locker 的线程(同一时刻只有一个),
+ * 消费者是 LogService 的刷新线程, 因此按单生产者单消费者无锁实现.
+ */
+class LogRing {
+public:
+    struct Record {
+        char tag;
+        time_t sec;
+        std::string text;
+    };
+
+    LogRing(size_t capacity, uint32_t maxPerSecond);
+
+    /*
+     * 限流与容量检查, 在格式化参数之前调用, 被拒绝时只计数.
+     */
+    bool Admit(time_t now);
+    void Push(char tag, time_t now, std::string &&text);
+    size_t Drain(std::vector<Record> &out);
+
+    void Counters(LogCounters *out) const;
+
+private:
+    std::vector<Record> slots;
+    size_t mask;
+    std::atomic<uint64_t> head;
+    std::atomic<uint64_t> tail;
+
+    uint32_t maxPerSecond;
+    time_t window;
+    uint32_t windowCount;
+
+    std::atomic<uint64_t> written;
+    std::atomic<uint64_t> dropped;
+    std::atomic<uint64_t> rateLimited;
+};
+
+/*
+ * 后台刷新线程, 周期性地收集所有虚拟机的日志, 格式化后整批交给 BatchCallback.
+ */
+class LogService {
+public:
+    /*
+     * data 为若干条记录, 每条为 4 字节小端长度加文本.
+     */
+    typedef void (*BatchCallback)(const char *data, size_t len);
+
+    static LogService &Default();
+
+    LogService();
+    ~LogService();
+
+    void Configure(size_t capacity, uint32_t maxPerSecond, uint32_t flushIntervalMs, BatchCallback cb);
+    bool Enabled() const { return enabled; }
+
+    LogRing *Attach();
+    void Detach(LogRing *ring);
+
+    /*
+     * 同步刷新所有缓冲区.
+     */
+    void Flush();
+    void Counters(LogRing *ring, LogCounters *out);
+    void Stop();
+
+    /*
+     * 生产者发现缓冲区接近满时唤醒刷新线程.
+     */
+    void Wakeup();
+
+private:
+    void Run();
+    void DrainLocked(LogRing *ring, std::string &batch);
+    void Deliver(const std::string &batch);
+
+    std::mutex mutex;
+    std::recursive_mutex deliverMutex;
+    std::condition_variable wakeup;
+    std::thread worker;
+    bool enabled;
+    bool stopping;
+    size_t capacity;
+    uint32_t maxPerSecond;
+    uint32_t flushIntervalMs;
+    BatchCallback callback;
+    std::set<LogRing *> rings;
+    LogCounters retired;
+
+    std::vector<LogRing::Record> scratch;
+    time_t cachedSec;
+    char cachedTime[16];
+};
+
+#endif  // !defined(V8_LOG_H)
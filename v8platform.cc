@@ -0,0 +1,228 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * The ASF licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "v8platform.h"
+
+#include <string.h>
+
+static const int kMaxPlatformWorkers = 16;
+
+static int PriorityIndex(v8::TaskPriority priority) {
+    return static_cast<int>(priority);
+}
+
+BoundedPlatform::BoundedPlatform(int workers, TaskCallback callback, std::unique_ptr<v8::Platform> inner)
+    : inner(std::move(inner)), callback(callback), workers(workers), stopping(false) {
+    memset(pending, 0, sizeof(pending));
+    memset(executed, 0, sizeof(executed));
+
+    if (this->workers <= 0) {
+        this->workers = (int)std::thread::hardware_concurrency() - 1;
+        if (this->workers < 1)
+            this->workers = 1;
+        if (this->workers > kMaxPlatformWorkers)
+            this->workers = kMaxPlatformWorkers;
+    }
+
+    // 使用外部调度器时只需要一个线程处理延迟任务
+    int count = callback != nullptr ? 1 : this->workers;
+    for (int i = 0; i < count; i++) {
+        threads.push_back(std::thread(&BoundedPlatform::Run, this));
+    }
+}
+
+BoundedPlatform::~BoundedPlatform() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    wakeup.notify_all();
+    for (auto &t : threads) {
+        t.join();
+    }
+}
+
+/*
+ * 任务交给外部调度器时在释放锁之后回调, 否则按优先级入队.
+ */
+void BoundedPlatform::Submit(std::unique_ptr<v8::Task> task, int priority) {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        pending[priority]++;
+        if (callback == nullptr)
+            queues[priority].push_back(std::move(task));
+    }
+    if (callback != nullptr) {
+        callback(task.release(), priority);
+    } else {
+        wakeup.notify_one();
+    }
+}
+
+/*
+ * 与工作线程一致, 任务开始执行时即不再计入 pending, 完成后计入 executed.
+ */
+void BoundedPlatform::RunTask(v8::Task *task, int priority) {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        pending[priority]--;
+    }
+    task->Run();
+    delete task;
+
+    std::lock_guard<std::mutex> lock(mutex);
+    executed[priority]++;
+}
+
+/*
+ * 工作线程总是先取高优先级队列; 到期的延迟任务按 kUserVisible 处理.
+ */
+void BoundedPlatform::Run() {
+    const int visible = PriorityIndex(v8::TaskPriority::kUserVisible);
+    std::vector<std::unique_ptr<v8::Task>> due;
+
+    std::unique_lock<std::mutex> lock(mutex);
+    for (;;) {
+        if (stopping)
+            return;
+
+        auto now = Clock::now();
+        while (!delayed.empty() && delayed.begin()->first <= now) {
+            pending[visible]++;
+            if (callback != nullptr) {
+                due.push_back(std::move(delayed.begin()->second));
+            } else {
+                queues[visible].push_back(std::move(delayed.begin()->second));
+            }
+            delayed.erase(delayed.begin());
+        }
+
+        if (!due.empty()) {
+            lock.unlock();
+            for (auto &task : due) {
+                callback(task.release(), visible);
+            }
+            due.clear();
+            lock.lock();
+            continue;
+        }
+
+        int priority = kPlatformPriorityCount - 1;
+        while (priority >= 0 && queues[priority].empty()) {
+            priority--;
+        }
+        if (priority >= 0) {
+            std::unique_ptr<v8::Task> task = std::move(queues[priority].front());
+            queues[priority].pop_front();
+            pending[priority]--;
+            lock.unlock();
+            task->Run();
+            task.reset();
+            lock.lock();
+            executed[priority]++;
+            continue;
+        }
+
+        if (delayed.empty()) {
+            wakeup.wait(lock);
+        } else {
+            wakeup.wait_until(lock, delayed.begin()->first);
+        }
+    }
+}
+
+void BoundedPlatform::Counters(PlatformCounters *out) {
+    std::lock_guard<std::mutex> lock(mutex);
+    out->workers = workers;
+    for (int i = 0; i < kPlatformPriorityCount; i++) {
+        out->pending[i] = pending[i];
+        out->executed[i] = executed[i];
+    }
+    out->delayed = delayed.size();
+}
+
+v8::PageAllocator *BoundedPlatform::GetPageAllocator() {
+    return inner->GetPageAllocator();
+}
+
+void BoundedPlatform::OnCriticalMemoryPressure() {
+    inner->OnCriticalMemoryPressure();
+}
+
+bool BoundedPlatform::OnCriticalMemoryPressure(size_t length) {
+    return inner->OnCriticalMemoryPressure(length);
+}
+
+int BoundedPlatform::NumberOfWorkerThreads() {
+    return workers;
+}
+
+std::shared_ptr<v8::TaskRunner> BoundedPlatform::GetForegroundTaskRunner(v8::Isolate *isolate) {
+    return inner->GetForegroundTaskRunner(isolate);
+}
+
+void BoundedPlatform::CallOnWorkerThread(std::unique_ptr<v8::Task> task) {
+    Submit(std::move(task), PriorityIndex(v8::TaskPriority::kUserVisible));
+}
+
+void BoundedPlatform::CallBlockingTaskOnWorkerThread(std::unique_ptr<v8::Task> task) {
+    Submit(std::move(task), PriorityIndex(v8::TaskPriority::kUserBlocking));
+}
+
+void BoundedPlatform::CallLowPriorityTaskOnWorkerThread(std::unique_ptr<v8::Task> task) {
+    Submit(std::move(task), PriorityIndex(v8::TaskPriority::kBestEffort));
+}
+
+void BoundedPlatform::CallDelayedOnWorkerThread(std::unique_ptr<v8::Task> task, double delay_in_seconds) {
+    auto due = Clock::now() + std::chrono::duration_cast<Clock::duration>(
+            std::chrono::duration<double>(delay_in_seconds));
+    bool earliest;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        earliest = delayed.empty() || due < delayed.begin()->first;
+        delayed.insert(std::make_pair(due, std::move(task)));
+    }
+    if (earliest)
+        wakeup.notify_one();
+}
+
+bool BoundedPlatform::IdleTasksEnabled(v8::Isolate *isolate) {
+    return inner->IdleTasksEnabled(isolate);
+}
+
+/*
+ * 8.4 的 Job 实现不在公开头文件中, 交给默认实现, 运行在其单个工作线程上.
+ */
+std::unique_ptr<v8::JobHandle> BoundedPlatform::PostJob(v8::TaskPriority priority, std::unique_ptr<v8::JobTask> job_task) {
+    return inner->PostJob(priority, std::move(job_task));
+}
+
+double BoundedPlatform::MonotonicallyIncreasingTime() {
+    return inner->MonotonicallyIncreasingTime();
+}
+
+double BoundedPlatform::CurrentClockTimeMillis() {
+    return inner->CurrentClockTimeMillis();
+}
+
+v8::Platform::StackTracePrinter BoundedPlatform::GetStackTracePrinter() {
+    return inner->GetStackTracePrinter();
+}
+
+v8::TracingController *BoundedPlatform::GetTracingController() {
+    return inner->GetTracingController();
+}
@@ -0,0 +1,104 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * The ASF licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef V8_PLATFORM_H
+#define V8_PLATFORM_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "v8-platform.h"
+
+/*
+ * 与 v8::TaskPriority 的取值一致.
+ */
+static const int kPlatformPriorityCount = 3;
+
+struct PlatformCounters {
+    int workers;
+    uint64_t pending[kPlatformPriorityCount];
+    uint64_t executed[kPlatformPriorityCount];
+    uint64_t delayed;
+};
+
+/*
+ * 后台线程数受限的 v8::Platform. 后台任务(并发标记、并行编译等)进入按优先级排序的队列,
+ * 由固定数量的工作线程执行; 设置了 TaskCallback 时任务改为交给调用方自己的调度器,
+ * 调用方在任意线程上调用 RunTask 执行. 前台任务、时钟与 tracing 仍由 libplatform 的默认实现提供.
+ */
+class BoundedPlatform : public v8::Platform {
+public:
+    typedef void (*TaskCallback)(v8::Task *task, int priority);
+
+    /*
+     * workers 为 0 时按 CPU 数选择; inner 只用于前台任务与 PostJob, 应以最小线程数创建.
+     */
+    BoundedPlatform(int workers, TaskCallback callback, std::unique_ptr<v8::Platform> inner);
+    ~BoundedPlatform() override;
+
+    /*
+     * 执行并释放一个交给 TaskCallback 的任务, 每个任务只能调用一次.
+     */
+    void RunTask(v8::Task *task, int priority);
+    void Counters(PlatformCounters *out);
+
+    v8::PageAllocator *GetPageAllocator() override;
+    void OnCriticalMemoryPressure() override;
+    bool OnCriticalMemoryPressure(size_t length) override;
+    int NumberOfWorkerThreads() override;
+    std::shared_ptr<v8::TaskRunner> GetForegroundTaskRunner(v8::Isolate *isolate) override;
+    void CallOnWorkerThread(std::unique_ptr<v8::Task> task) override;
+    void CallBlockingTaskOnWorkerThread(std::unique_ptr<v8::Task> task) override;
+    void CallLowPriorityTaskOnWorkerThread(std::unique_ptr<v8::Task> task) override;
+    void CallDelayedOnWorkerThread(std::unique_ptr<v8::Task> task, double delay_in_seconds) override;
+    bool IdleTasksEnabled(v8::Isolate *isolate) override;
+    std::unique_ptr<v8::JobHandle> PostJob(v8::TaskPriority priority, std::unique_ptr<v8::JobTask> job_task) override;
+    double MonotonicallyIncreasingTime() override;
+    double CurrentClockTimeMillis() override;
+    StackTracePrinter GetStackTracePrinter() override;
+    v8::TracingController *GetTracingController() override;
+
+private:
+    typedef std::chrono::steady_clock Clock;
+
+    void Submit(std::unique_ptr<v8::Task> task, int priority);
+    void Run();
+
+    std::unique_ptr<v8::Platform> inner;
+    TaskCallback callback;
+    int workers;
+
+    std::mutex mutex;
+    std::condition_variable wakeup;
+    std::vector<std::thread> threads;
+    bool stopping;
+    std::deque<std::unique_ptr<v8::Task>> queues[kPlatformPriorityCount];
+    std::multimap<Clock::time_point, std::unique_ptr<v8::Task>> delayed;
+    uint64_t pending[kPlatformPriorityCount];
+    uint64_t executed[kPlatformPriorityCount];
+};
+
+#endif  // !defined(V8_PLATFORM_H)
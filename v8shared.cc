@@ -0,0 +1,93 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * The ASF licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "v8shared.h"
+
+#include <stdlib.h>
+
+static void FreeRegion(void *data, size_t /* length */, void * /* info */) {
+    free(data);
+}
+
+SharedRegionRegistry &SharedRegionRegistry::Default() {
+    static SharedRegionRegistry registry;
+    return registry;
+}
+
+int SharedRegionRegistry::Create(const std::string &name, size_t size, std::shared_ptr<v8::BackingStore> *out) {
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = regions.find(name);
+    if (it != regions.end()) {
+        if (it->second->ByteLength() != size)
+            return 1;
+        if (out != nullptr)
+            *out = it->second;
+        return 0;
+    }
+
+    void *data = calloc(1, size == 0 ? 1 : size);
+    if (data == nullptr)
+        return -1;
+
+    std::shared_ptr<v8::BackingStore> store = v8::SharedArrayBuffer::NewBackingStore(data, size, FreeRegion, nullptr);
+    regions[name] = store;
+    if (out != nullptr)
+        *out = store;
+    return 0;
+}
+
+std::shared_ptr<v8::BackingStore> SharedRegionRegistry::Find(const std::string &name) {
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = regions.find(name);
+    if (it == regions.end())
+        return nullptr;
+    return it->second;
+}
+
+bool SharedRegionRegistry::Release(const std::string &name) {
+    std::lock_guard<std::mutex> lock(mutex);
+    return regions.erase(name) != 0;
+}
+
+void SharedRegionRegistry::List(std::vector<Info> &out) {
+    std::lock_guard<std::mutex> lock(mutex);
+    out.clear();
+    out.reserve(regions.size());
+    for (auto &kv : regions) {
+        Info info;
+        info.name = kv.first;
+        info.size = kv.second->ByteLength();
+        info.references = kv.second.use_count();
+        out.push_back(info);
+    }
+}
+
+void SharedRegionRegistry::Clear() {
+    std::lock_guard<std::mutex> lock(mutex);
+    regions.clear();
+}
+
+void SharedRegionRegistry::SetScriptPolicy(const std::string &prefix, size_t maxSize) {
+    std::lock_guard<std::mutex> lock(mutex);
+    scriptPrefix = prefix;
+    scriptMaxSize = maxSize;
+}
+
+bool SharedRegionRegistry::ScriptMayCreate(const std::string &name, size_t size) {
+    std::lock_guard<std::mutex> lock(mutex);
+    return size <= scriptMaxSize && name.compare(0, scriptPrefix.size(), scriptPrefix) == 0;
+}
@@ -0,0 +1,73 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * The ASF licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef V8_SHARED_H
+#define V8_SHARED_H
+
+#include <stddef.h>
+
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "v8bridge.h"
+#include "v8.h"
+
+/*
+ * 全进程的命名共享内存区域. 每个区域是一块 BackingStore, 可以在任意虚拟机中以
+ * SharedArrayBuffer 的形式打开, 多个虚拟机看到的是同一块内存, 同步使用 Atomics.
+ * 生命周期由引用计数决定: 注册表和每个打开它的 SharedArrayBuffer 各持有一份引用,
+ * Release 只是从注册表移除名字, 最后一个引用释放时内存才被回收.
+ */
+class SharedRegionRegistry {
+public:
+    struct Info {
+        std::string name;
+        size_t size;
+        long references;
+    };
+
+    static SharedRegionRegistry &Default();
+
+    SharedRegionRegistry() : scriptPrefix("script."), scriptMaxSize(1 << 20) {}
+
+    /*
+     * 创建区域, 已存在且大小相同时返回已有区域. 返回 0 成功, 1 已存在但大小不同, -1 分配失败.
+     */
+    int Create(const std::string &name, size_t size, std::shared_ptr<v8::BackingStore> *out);
+    std::shared_ptr<v8::BackingStore> Find(const std::string &name);
+    bool Release(const std::string &name);
+    void List(std::vector<Info> &out);
+    void Clear();
+
+    /*
+     * 脚本通过 openSharedRegion(name, byteLength) 创建区域的限制: 名字必须以 prefix 开头,
+     * 大小不超过 maxSize. Go 侧创建的区域不受限制, 脚本可以按名字打开.
+     */
+    void SetScriptPolicy(const std::string &prefix, size_t maxSize);
+    bool ScriptMayCreate(const std::string &name, size_t size);
+
+private:
+    std::mutex mutex;
+    std::unordered_map<std::string, std::shared_ptr<v8::BackingStore>> regions;
+    std::string scriptPrefix;
+    size_t scriptMaxSize;
+};
+
+#endif  // !defined(V8_SHARED_H)
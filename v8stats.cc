@@ -0,0 +1,174 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * The ASF licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "v8stats.h"
+
+#include <string.h>
+#include <time.h>
+
+LatencyHistogram::Snapshot::Snapshot() : total(0), sum(0), max(0) {
+    memset(counts, 0, sizeof(counts));
+}
+
+void LatencyHistogram::Snapshot::Merge(const Snapshot &other) {
+    for (int i = 0; i < kBuckets; i++) {
+        counts[i] += other.counts[i];
+    }
+    total += other.total;
+    sum += other.sum;
+    if (other.max > max)
+        max = other.max;
+}
+
+/*
+ * p 取值 0 ~ 1, 返回所在桶的中值.
+ */
+uint64_t LatencyHistogram::Snapshot::Percentile(double p) const {
+    if (total == 0)
+        return 0;
+
+    uint64_t rank = (uint64_t)(p * total);
+    if (rank >= total)
+        rank = total - 1;
+
+    uint64_t seen = 0;
+    for (int i = 0; i < kBuckets; i++) {
+        seen += counts[i];
+        if (seen > rank) {
+            uint64_t v = BucketValue(i);
+            return v > max ? max : v;
+        }
+    }
+    return max;
+}
+
+LatencyHistogram::LatencyHistogram() : total(0), sum(0), max(0) {
+    for (int i = 0; i < kBuckets; i++) {
+        counts[i].store(0, std::memory_order_relaxed);
+    }
+}
+
+int LatencyHistogram::BucketIndex(uint64_t value) {
+    if (value < (uint64_t)kSubCount)
+        return (int)value;
+
+    int e = 63 - __builtin_clzll(value);
+    if (e > kMaxExponent)
+        return kBuckets - 1;
+
+    int sub = (int)(value >> (e - kSubBits)) - kSubCount;
+    return (e - kSubBits + 1) * kSubCount + sub;
+}
+
+uint64_t LatencyHistogram::BucketValue(int index) {
+    if (index < kSubCount)
+        return (uint64_t)index;
+
+    int e = index / kSubCount + kSubBits - 1;
+    int sub = index % kSubCount;
+    uint64_t width = 1ULL << (e - kSubBits);
+    return ((uint64_t)(kSubCount + sub) << (e - kSubBits)) + width / 2;
+}
+
+void LatencyHistogram::Record(uint64_t value) {
+    counts[BucketIndex(value)].fetch_add(1, std::memory_order_relaxed);
+    total.fetch_add(1, std::memory_order_relaxed);
+    sum.fetch_add(value, std::memory_order_relaxed);
+
+    uint64_t m = max.load(std::memory_order_relaxed);
+    while (value > m && !max.compare_exchange_weak(m, value, std::memory_order_relaxed)) {
+    }
+}
+
+void LatencyHistogram::Read(Snapshot &out) const {
+    for (int i = 0; i < kBuckets; i++) {
+        out.counts[i] = counts[i].load(std::memory_order_relaxed);
+    }
+    out.total = total.load(std::memory_order_relaxed);
+    out.sum = sum.load(std::memory_order_relaxed);
+    out.max = max.load(std::memory_order_relaxed);
+}
+
+void HandlerStats::Snapshot::Merge(const Snapshot &other) {
+    wall.Merge(other.wall);
+    cpu.Merge(other.cpu);
+    errors += other.errors;
+}
+
+std::mutex HandlerStats::registryMutex;
+std::set<HandlerStats *> HandlerStats::registry;
+HandlerStats::Snapshot HandlerStats::retired[kHandlerCount];
+
+HandlerStats::HandlerStats() {
+    for (int i = 0; i < kHandlerCount; i++) {
+        handlers[i].errors.store(0, std::memory_order_relaxed);
+    }
+    std::lock_guard<std::mutex> lock(registryMutex);
+    registry.insert(this);
+}
+
+HandlerStats::~HandlerStats() {
+    std::lock_guard<std::mutex> lock(registryMutex);
+    registry.erase(this);
+    for (int i = 0; i < kHandlerCount; i++) {
+        Snapshot s;
+        Read(i, s);
+        retired[i].Merge(s);
+    }
+}
+
+void HandlerStats::Record(int kind, uint64_t wallNs, uint64_t cpuNs, bool failed) {
+    Handler &h = handlers[kind];
+    h.wall.Record(wallNs);
+    h.cpu.Record(cpuNs);
+    if (failed)
+        h.errors.fetch_add(1, std::memory_order_relaxed);
+}
+
+void HandlerStats::Read(int kind, Snapshot &out) const {
+    const Handler &h = handlers[kind];
+    h.wall.Read(out.wall);
+    h.cpu.Read(out.cpu);
+    out.errors = h.errors.load(std::memory_order_relaxed);
+}
+
+void HandlerStats::ReadAll(int kind, Snapshot &out) {
+    std::lock_guard<std::mutex> lock(registryMutex);
+    out = retired[kind];
+    for (auto stats : registry) {
+        Snapshot s;
+        stats->Read(kind, s);
+        out.Merge(s);
+    }
+}
+
+static uint64_t ClockNanos(clockid_t clock) {
+    struct timespec ts;
+    clock_gettime(clock, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+HandlerTimer::HandlerTimer(HandlerStats *stats, int kind)
+    : stats(stats), kind(kind), failed(false),
+      wallStart(ClockNanos(CLOCK_MONOTONIC)), cpuStart(ClockNanos(CLOCK_THREAD_CPUTIME_ID)) {
+}
+
+HandlerTimer::~HandlerTimer() {
+    uint64_t wall = ClockNanos(CLOCK_MONOTONIC) - wallStart;
+    uint64_t cpu = ClockNanos(CLOCK_THREAD_CPUTIME_ID) - cpuStart;
+    stats->Record(kind, wall, cpu, failed);
+}
@@ -0,0 +1,133 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * The ASF licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef V8_STATS_H
+#define V8_STATS_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include <atomic>
+#include <mutex>
+#include <set>
+
+/*
+ * HDR 风格的对数-线性直方图(每个 2 的幂区间 8 个子桶, 精度约 12%), 记录纳秒值.
+ * Record 只使用 relaxed 原子操作, 可与 Snapshot 并发.
+ */
+class LatencyHistogram {
+public:
+    static const int kSubBits = 3;
+    static const int kSubCount = 1 << kSubBits;
+    static const int kMaxExponent = 40;
+    static const int kBuckets = (kMaxExponent - kSubBits + 2) * kSubCount;
+
+    /*
+     * 非原子的副本, 用于合并与计算分位数.
+     */
+    struct Snapshot {
+        uint64_t counts[kBuckets];
+        uint64_t total;
+        uint64_t sum;
+        uint64_t max;
+
+        Snapshot();
+        void Merge(const Snapshot &other);
+        uint64_t Percentile(double p) const;
+    };
+
+    LatencyHistogram();
+
+    void Record(uint64_t value);
+    void Read(Snapshot &out) const;
+
+    static int BucketIndex(uint64_t value);
+    static uint64_t BucketValue(int index);
+
+private:
+    std::atomic<uint64_t> counts[kBuckets];
+    std::atomic<uint64_t> total;
+    std::atomic<uint64_t> sum;
+    std::atomic<uint64_t> max;
+};
+
+enum V8HandlerKind {
+    kHandlerMain = 0,
+    kHandlerEnter,
+    kHandlerLeave,
+    kHandlerMessage,
+    kHandlerCount
+};
+
+/*
+ * 单个虚拟机各处理函数的耗时统计.
+ */
+class HandlerStats {
+public:
+    struct Snapshot {
+        LatencyHistogram::Snapshot wall;
+        LatencyHistogram::Snapshot cpu;
+        uint64_t errors;
+
+        Snapshot() : errors(0) {}
+        void Merge(const Snapshot &other);
+    };
+
+    HandlerStats();
+    ~HandlerStats();
+
+    void Record(int kind, uint64_t wallNs, uint64_t cpuNs, bool failed);
+    void Read(int kind, Snapshot &out) const;
+
+    /*
+     * 全进程汇总: 所有存活虚拟机加上已销毁虚拟机的累计值.
+     */
+    static void ReadAll(int kind, Snapshot &out);
+
+private:
+    struct Handler {
+        LatencyHistogram wall;
+        LatencyHistogram cpu;
+        std::atomic<uint64_t> errors;
+    };
+
+    Handler handlers[kHandlerCount];
+
+    static std::mutex registryMutex;
+    static std::set<HandlerStats *> registry;
+    static Snapshot retired[kHandlerCount];
+};
+
+/*
+ * 计时辅助, 析构时记录墙钟时间与线程 CPU 时间.
+ */
+class HandlerTimer {
+public:
+    HandlerTimer(HandlerStats *stats, int kind);
+    ~HandlerTimer();
+
+    void Fail() { failed = true; }
+
+private:
+    HandlerStats *stats;
+    int kind;
+    bool failed;
+    uint64_t wallStart;
+    uint64_t cpuStart;
+};
+
+#endif  // !defined(V8_STATS_H)
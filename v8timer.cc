@@ -0,0 +1,338 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * The ASF licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "v8timer.h"
+
+#include <chrono>
+#include <string.h>
+
+TimerWheel::TimerWheel(uint64_t now) : current(now), count(0) {
+    for (int i = 0; i < kRootSize; i++) {
+        root[i].prev = root[i].next = &root[i];
+    }
+    for (int l = 0; l < kLevels; l++) {
+        for (int i = 0; i < kLevelSize; i++) {
+            levels[l][i].prev = levels[l][i].next = &levels[l][i];
+        }
+    }
+}
+
+void TimerWheel::Link(Timer *head, Timer *t) {
+    t->prev = head->prev;
+    t->next = head;
+    head->prev->next = t;
+    head->prev = t;
+}
+
+void TimerWheel::Add(Timer *t) {
+    uint64_t expires = t->expires < current ? current : t->expires;
+    uint64_t delta = expires - current;
+
+    Timer *head;
+    if (delta < (uint64_t)kRootSize) {
+        head = &root[expires & (kRootSize - 1)];
+    } else {
+        // 超出最大跨度的定时器先挂在最高层, 级联时会按真实到期时间重新放置
+        uint64_t span = 1ULL << (kRootBits + kLevels * kLevelBits);
+        if (delta >= span) {
+            expires = current + span - 1;
+            delta = span - 1;
+        }
+        int level = 0;
+        while (delta >= (1ULL << (kRootBits + (level + 1) * kLevelBits))) {
+            level++;
+        }
+        head = &levels[level][(expires >> (kRootBits + level * kLevelBits)) & (kLevelSize - 1)];
+    }
+
+    Link(head, t);
+    count++;
+}
+
+void TimerWheel::Remove(Timer *t) {
+    t->prev->next = t->next;
+    t->next->prev = t->prev;
+    t->prev = t->next = nullptr;
+    count--;
+}
+
+int TimerWheel::Cascade(int level, int index) {
+    Timer *head = &levels[level][index];
+    Timer *t = head->next;
+    head->prev = head->next = head;
+
+    while (t != head) {
+        Timer *next = t->next;
+        count--;
+        Add(t);
+        t = next;
+    }
+    return index;
+}
+
+TimerService &TimerService::Default() {
+    static TimerService service;
+    return service;
+}
+
+TimerService::TimerService()
+    : started(false), stopping(false), tickMillis(1), readyCallback(nullptr), wheel(0) {
+    memset(&totals, 0, sizeof(totals));
+}
+
+TimerService::~TimerService() {
+    Stop();
+}
+
+uint64_t TimerService::NowTicks() const {
+    auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+    return (uint64_t)ms / tickMillis;
+}
+
+void TimerService::SetReadyCallback(ReadyCallback cb) {
+    std::lock_guard<std::mutex> lock(mutex);
+    readyCallback = cb;
+}
+
+/*
+ * 只能在第一个定时器创建之前修改精度.
+ */
+void TimerService::SetTickMillis(uint32_t ms) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (started || ms == 0)
+        return;
+    tickMillis = ms;
+}
+
+void TimerService::EnsureStarted() {
+    if (started)
+        return;
+    started = true;
+    stopping = false;
+    wheel.Reset(NowTicks());
+    worker = std::thread(&TimerService::Run, this);
+}
+
+uint32_t TimerService::Schedule(void *owner, uint64_t delayMs, bool repeat) {
+    std::lock_guard<std::mutex> lock(mutex);
+    EnsureStarted();
+
+    uint64_t ticks = (delayMs + tickMillis - 1) / tickMillis;
+    if (ticks == 0)
+        ticks = 1;
+
+    OwnerState &state = owners[owner];
+
+    // 时间轮空闲时工作线程不会推进 current, 先对齐到当前时间, 避免之后逐个补走空闲期间的刻度
+    bool wasIdle = wheel.Count() == 0;
+    if (wasIdle)
+        wheel.Reset(NowTicks());
+
+    // 编号回绕后跳过仍在使用的 id
+    uint32_t id = state.nextId;
+    while (id == 0 || state.timers.count(id) != 0)
+        id++;
+    state.nextId = id + 1;
+    if (state.nextId == 0)
+        state.nextId = 1;
+
+    auto t = new TimerWheel::Timer;
+    t->owner = owner;
+    t->id = id;
+    t->interval = repeat ? ticks : 0;
+    t->expires = NowTicks() + ticks;
+
+    state.timers[t->id] = t;
+    state.counters.active++;
+    state.counters.scheduled++;
+    totals.active++;
+    totals.scheduled++;
+
+    wheel.Add(t);
+    if (wasIdle)
+        wakeup.notify_one();
+
+    return t->id;
+}
+
+bool TimerService::Cancel(void *owner, uint32_t id) {
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = owners.find(owner);
+    if (it == owners.end())
+        return false;
+
+    auto tit = it->second.timers.find(id);
+    if (tit == it->second.timers.end())
+        return false;
+
+    wheel.Remove(tit->second);
+    delete tit->second;
+    it->second.timers.erase(tit);
+    it->second.counters.active--;
+    it->second.counters.cancelled++;
+    totals.active--;
+    totals.cancelled++;
+    return true;
+}
+
+bool TimerService::IsActive(void *owner, uint32_t id) {
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = owners.find(owner);
+    return it != owners.end() && it->second.timers.count(id) != 0;
+}
+
+size_t TimerService::TakeReady(void *owner, std::vector<uint32_t> &out) {
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = owners.find(owner);
+    if (it == owners.end())
+        return 0;
+    out.swap(it->second.ready);
+    it->second.ready.clear();
+    return out.size();
+}
+
+void TimerService::RemoveOwner(void *owner) {
+    std::lock_guard<std::mutex> notifyLock(notifyMutex);
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = owners.find(owner);
+    if (it == owners.end())
+        return;
+
+    for (auto &kv : it->second.timers) {
+        wheel.Remove(kv.second);
+        delete kv.second;
+    }
+    totals.active -= it->second.counters.active;
+    totals.cancelled += it->second.counters.active;
+    owners.erase(it);
+}
+
+void TimerService::Counters(void *owner, TimerCounters *out) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (owner == nullptr) {
+        *out = totals;
+        return;
+    }
+    auto it = owners.find(owner);
+    if (it == owners.end()) {
+        memset(out, 0, sizeof(*out));
+        return;
+    }
+    *out = it->second.counters;
+}
+
+void TimerService::Stop() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (!started)
+            return;
+        stopping = true;
+    }
+    wakeup.notify_one();
+    worker.join();
+
+    std::lock_guard<std::mutex> lock(mutex);
+    for (auto &o : owners) {
+        for (auto &kv : o.second.timers) {
+            wheel.Remove(kv.second);
+            delete kv.second;
+        }
+    }
+    owners.clear();
+    memset(&totals, 0, sizeof(totals));
+    started = false;
+}
+
+/*
+ * 在持有 mutex 时由时间轮回调, 周期定时器按原到期时间重新入轮, 避免误差累积;
+ * 若已落后多个周期则合并为一次触发.
+ */
+void TimerService::Expire(TimerWheel::Timer *t, uint64_t now, std::vector<void *> &notify) {
+    OwnerState &state = owners[t->owner];
+
+    uint64_t drift = (now > t->expires ? now - t->expires : 0) * tickMillis;
+    state.counters.fired++;
+    state.counters.driftTotal += drift;
+    if (drift > state.counters.driftMax)
+        state.counters.driftMax = drift;
+    totals.fired++;
+    totals.driftTotal += drift;
+    if (drift > totals.driftMax)
+        totals.driftMax = drift;
+
+    if (state.ready.empty())
+        notify.push_back(t->owner);
+    state.ready.push_back(t->id);
+
+    if (t->interval != 0) {
+        t->expires += t->interval;
+        if (t->expires <= now)
+            t->expires = now + t->interval - (now - t->expires) % t->interval;
+        wheel.Add(t);
+        return;
+    }
+
+    state.timers.erase(t->id);
+    state.counters.active--;
+    totals.active--;
+    delete t;
+}
+
+void TimerService::Run() {
+    std::vector<void *> notify;
+
+    for (;;) {
+        ReadyCallback cb;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            if (wheel.Count() == 0) {
+                wakeup.wait(lock, [this] { return stopping || wheel.Count() != 0; });
+            } else {
+                wakeup.wait_for(lock, std::chrono::milliseconds(tickMillis), [this] { return stopping; });
+            }
+            if (stopping)
+                return;
+
+            uint64_t now = NowTicks();
+            wheel.Advance(now, [this, now, &notify](TimerWheel::Timer *t) {
+                Expire(t, now, notify);
+            });
+            cb = readyCallback;
+        }
+
+        if (notify.empty())
+            continue;
+
+        // 释放 mutex 后 owner 可能已被 RemoveOwner 删除, 持有 notifyMutex 后再确认一次
+        std::lock_guard<std::mutex> notifyLock(notifyMutex);
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            auto last = notify.begin();
+            for (auto owner : notify) {
+                if (owners.count(owner) != 0)
+                    *last++ = owner;
+            }
+            notify.erase(last, notify.end());
+        }
+        for (auto owner : notify) {
+            if (cb != nullptr)
+                cb(owner);
+        }
+        notify.clear();
+    }
+}
@@ -0,0 +1,179 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * The ASF licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef V8_TIMER_H
+#define V8_TIMER_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+/*
+ * 分层时间轮(5 层, 256 + 4 * 64 槽), 单位为 tick, 添加/删除/每 tick 推进均为 O(1).
+ * 本身不加锁, 由 TimerService 负责同步.
+ */
+class TimerWheel {
+public:
+    struct Timer {
+        Timer *prev;
+        Timer *next;
+        uint64_t expires;
+        uint64_t interval;
+        void *owner;
+        uint32_t id;
+    };
+
+    explicit TimerWheel(uint64_t now);
+
+    /*
+     * 仅在轮为空时调用, 重新设定当前 tick.
+     */
+    void Reset(uint64_t now) { current = now; }
+
+    void Add(Timer *t);
+    void Remove(Timer *t);
+
+    /*
+     * 推进到 now, 对所有到期定时器调用 onExpire(Timer *), 回调内可以重新 Add.
+     */
+    template <typename F>
+    void Advance(uint64_t now, F onExpire);
+
+    size_t Count() const { return count; }
+    uint64_t Current() const { return current; }
+
+private:
+    static const int kRootBits = 8;
+    static const int kLevelBits = 6;
+    static const int kRootSize = 1 << kRootBits;
+    static const int kLevelSize = 1 << kLevelBits;
+    static const int kLevels = 4;
+
+    void Link(Timer *head, Timer *t);
+    int Cascade(int level, int index);
+
+    Timer root[kRootSize];
+    Timer levels[kLevels][kLevelSize];
+    uint64_t current;
+    size_t count;
+};
+
+template <typename F>
+void TimerWheel::Advance(uint64_t now, F onExpire) {
+    if (count == 0) {
+        if (now >= current)
+            current = now + 1;
+        return;
+    }
+
+    while (current <= now) {
+        int index = (int)(current & (kRootSize - 1));
+        if (index == 0) {
+            for (int level = 0; level < kLevels; level++) {
+                if (Cascade(level, (int)((current >> (kRootBits + level * kLevelBits)) & (kLevelSize - 1))) != 0)
+                    break;
+            }
+        }
+        current++;
+
+        Timer *head = &root[index];
+        while (head->next != head) {
+            Timer *t = head->next;
+            Remove(t);
+            onExpire(t);
+        }
+    }
+}
+
+/*
+ * 定时器统计, owner 为空时为全局汇总.
+ */
+struct TimerCounters {
+    uint64_t active;
+    uint64_t scheduled;
+    uint64_t fired;
+    uint64_t cancelled;
+    uint64_t driftTotal;
+    uint64_t driftMax;
+};
+
+/*
+ * 全进程共享的定时服务, 一个后台线程驱动时间轮.
+ * 到期的定时器按 owner(虚拟机) 归集为批次, owner 的就绪队列由空变为非空时调用一次 ReadyCallback,
+ * 由 owner 自己的执行线程通过 TakeReady 取走并执行.
+ */
+class TimerService {
+public:
+    typedef void (*ReadyCallback)(void *owner);
+
+    static TimerService &Default();
+
+    TimerService();
+    ~TimerService();
+
+    void SetReadyCallback(ReadyCallback cb);
+    void SetTickMillis(uint32_t ms);
+
+    uint32_t Schedule(void *owner, uint64_t delayMs, bool repeat);
+    bool Cancel(void *owner, uint32_t id);
+    bool IsActive(void *owner, uint32_t id);
+    size_t TakeReady(void *owner, std::vector<uint32_t> &out);
+
+    /*
+     * 删除 owner 的全部定时器, 返回时保证不再有该 owner 的 ReadyCallback 正在执行.
+     * 不能在 ReadyCallback 内调用.
+     */
+    void RemoveOwner(void *owner);
+
+    void Counters(void *owner, TimerCounters *out);
+
+    void Stop();
+
+private:
+    struct OwnerState {
+        OwnerState() : nextId(1), counters() {}
+
+        std::unordered_map<uint32_t, TimerWheel::Timer *> timers;
+        std::vector<uint32_t> ready;
+        uint32_t nextId;
+        TimerCounters counters;
+    };
+
+    uint64_t NowTicks() const;
+    void EnsureStarted();
+    void Run();
+    void Expire(TimerWheel::Timer *t, uint64_t now, std::vector<void *> &notify);
+
+    std::mutex mutex;
+    std::mutex notifyMutex;
+    std::condition_variable wakeup;
+    std::thread worker;
+    bool started;
+    bool stopping;
+    uint32_t tickMillis;
+    ReadyCallback readyCallback;
+    TimerWheel wheel;
+    std::unordered_map<void *, OwnerState> owners;
+    TimerCounters totals;
+};
+
+#endif  // !defined(V8_TIMER_H)
@@ -0,0 +1,235 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * The ASF licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "v8trace.h"
+
+#include <memory>
+#include <vector>
+
+using v8::platform::tracing::TraceBuffer;
+using v8::platform::tracing::TraceBufferChunk;
+using v8::platform::tracing::TraceConfig;
+using v8::platform::tracing::TraceObject;
+using v8::platform::tracing::TraceWriter;
+using v8::platform::tracing::TracingController;
+
+// 与 V8 trace_event_common.h 中的取值一致, 该头文件不随 libv8 发布
+static const unsigned int kTraceFlagHasId = 1 << 1;
+static const uint8_t kTraceValueUint = 2;
+
+static const char *traceCategoryNames[kTraceCategoryCount] = {
+    "v8go.load",
+    "v8go.dispatch",
+    "v8go.marshal",
+};
+
+static const uint8_t traceDisabled = 0;
+
+/*
+ * 可重复使用的环形缓冲区. V8 自带的 ring buffer 在 Flush 后不清理旧块, 且写入器在创建时固定,
+ * 无法在多次记录之间复用. 块只增不减, 记录结束后仍持有旧事件指针的线程不会访问已释放的内存.
+ */
+class TraceRing : public TraceBuffer {
+public:
+    TraceRing() : limit(0), current(0), used(0), seq(0), events(0), dropped(0) {}
+
+    void Reset(size_t maxChunks, TraceWriter *w) {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (chunks.size() < maxChunks)
+            chunks.resize(maxChunks);
+        limit = maxChunks;
+        current = 0;
+        used = 0;
+        events = 0;
+        dropped = 0;
+        writer.reset(w);
+    }
+
+    /*
+     * 释放写入器(写出 JSON 结尾)并拒绝之后的事件.
+     */
+    void Close(TraceCounters *out) {
+        std::lock_guard<std::mutex> lock(mutex);
+        writer.reset();
+        limit = 0;
+        used = 0;
+        if (out != nullptr) {
+            out->events = events;
+            out->dropped = dropped;
+        }
+    }
+
+    TraceObject *AddTraceEvent(uint64_t *handle) override {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (limit == 0)
+            return nullptr;
+
+        if (used == 0 || chunks[current]->IsFull()) {
+            if (used != 0)
+                current = (current + 1) % limit;
+            if (used == limit) {
+                dropped += chunks[current]->size();
+            } else {
+                used++;
+            }
+            auto &chunk = chunks[current];
+            if (++seq == 0)
+                seq = 1;
+            if (chunk) {
+                chunk->Reset(seq);
+            } else {
+                chunk.reset(new TraceBufferChunk(seq));
+            }
+        }
+
+        size_t index;
+        TraceObject *event = chunks[current]->AddTraceEvent(&index);
+        *handle = ((uint64_t)chunks[current]->seq() << 32) | ((uint64_t)current << 8) | index;
+        events++;
+        return event;
+    }
+
+    TraceObject *GetEventByHandle(uint64_t handle) override {
+        std::lock_guard<std::mutex> lock(mutex);
+        size_t chunkIndex = (size_t)((handle >> 8) & 0xFFFFFF);
+        size_t index = (size_t)(handle & 0xFF);
+        if (chunkIndex >= limit || !chunks[chunkIndex])
+            return nullptr;
+        auto &chunk = chunks[chunkIndex];
+        if (chunk->seq() != (uint32_t)(handle >> 32) || index >= chunk->size())
+            return nullptr;
+        return chunk->GetEventAt(index);
+    }
+
+    /*
+     * 由 TracingController::StopTracing 调用, 从最旧的块开始写出.
+     */
+    bool Flush() override {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (!writer || limit == 0)
+            return true;
+
+        size_t first = used == limit ? (current + 1) % limit : 0;
+        for (size_t i = 0; i < used; i++) {
+            auto &chunk = chunks[(first + i) % limit];
+            for (size_t j = 0; j < chunk->size(); j++) {
+                writer->AppendTraceEvent(chunk->GetEventAt(j));
+            }
+        }
+        writer->Flush();
+        return true;
+    }
+
+private:
+    std::mutex mutex;
+    std::vector<std::unique_ptr<TraceBufferChunk>> chunks;
+    std::unique_ptr<TraceWriter> writer;
+    size_t limit;
+    size_t current;
+    size_t used;
+    uint32_t seq;
+    uint64_t events;
+    uint64_t dropped;
+};
+
+TraceService &TraceService::Default() {
+    static TraceService service;
+    return service;
+}
+
+TraceService::TraceService() : controller(nullptr), ring(nullptr), recording(false) {
+    for (int i = 0; i < kTraceCategoryCount; i++) {
+        flags[i] = &traceDisabled;
+    }
+}
+
+TracingController *TraceService::CreateController() {
+    std::lock_guard<std::mutex> lock(mutex);
+    controller = new TracingController();
+    ring = new TraceRing();
+    controller->Initialize(ring);
+    for (int i = 0; i < kTraceCategoryCount; i++) {
+        flags[i] = controller->GetCategoryGroupEnabled(traceCategoryNames[i]);
+    }
+    return controller;
+}
+
+/*
+ * 返回 0 成功, 1 已在记录, 2 无法创建文件, -1 V8 尚未初始化.
+ */
+int TraceService::Start(const char *path, const char *categories, size_t maxEvents) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (controller == nullptr)
+        return -1;
+    if (recording)
+        return 1;
+
+    out.clear();
+    out.open(path, std::ios::out | std::ios::trunc);
+    if (!out.is_open())
+        return 2;
+
+    size_t maxChunks = (maxEvents + TraceBufferChunk::kChunkSize - 1) / TraceBufferChunk::kChunkSize;
+    if (maxChunks == 0)
+        maxChunks = TraceBuffer::kRingBufferChunks;
+    ring->Reset(maxChunks, TraceWriter::CreateJSONTraceWriter(out));
+
+    auto config = new TraceConfig();
+    config->SetTraceRecordMode(v8::platform::tracing::RECORD_CONTINUOUSLY);
+    std::string list = categories != nullptr ? categories : "";
+    size_t pos = 0;
+    while (pos <= list.size()) {
+        size_t end = list.find(',', pos);
+        if (end == std::string::npos)
+            end = list.size();
+        std::string name = list.substr(pos, end - pos);
+        if (!name.empty())
+            config->AddIncludedCategory(name.c_str());
+        pos = end + 1;
+    }
+    controller->StartTracing(config);
+    recording = true;
+    return 0;
+}
+
+/*
+ * 返回 0 成功, 1 未在记录, 2 写文件失败.
+ */
+int TraceService::Stop(TraceCounters *counters) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (!recording)
+        return 1;
+    recording = false;
+
+    controller->StopTracing();
+    ring->Close(counters);
+    out.close();
+    return out.fail() ? 2 : 0;
+}
+
+void TraceService::Begin(TraceCategory category, const char *name, const void *vm, uint64_t sessionId) {
+    static const char *argNames[] = {"session"};
+    static const uint8_t argTypes[] = {kTraceValueUint};
+    uint64_t argValues[] = {sessionId};
+    controller->AddTraceEvent('b', flags[category], name, "vm", (uint64_t)(uintptr_t)vm, 0,
+                              sessionId != 0 ? 1 : 0, argNames, argTypes, argValues, nullptr, kTraceFlagHasId);
+}
+
+void TraceService::End(TraceCategory category, const char *name, const void *vm) {
+    controller->AddTraceEvent('e', flags[category], name, "vm", (uint64_t)(uintptr_t)vm, 0,
+                              0, nullptr, nullptr, nullptr, nullptr, kTraceFlagHasId);
+}
@@ -0,0 +1,108 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * The ASF licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef V8_TRACE_H
+#define V8_TRACE_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include <fstream>
+#include <mutex>
+#include <string>
+
+#include "libplatform/v8-tracing.h"
+
+enum TraceCategory {
+    kTraceLoad = 0,
+    kTraceDispatch,
+    kTraceMarshal,
+    kTraceCategoryCount
+};
+
+struct TraceCounters {
+    uint64_t events;
+    uint64_t dropped;
+};
+
+class TraceRing;
+
+/*
+ * 进程级的 Chrome trace 输出. 持有交给 platform 的 TracingController, 记录期间 V8 自身
+ * (编译、GC 等)与桥接层的事件都进入固定容量的环形缓冲区, 停止时按时间顺序写成 JSON 文件.
+ */
+class TraceService {
+public:
+    static TraceService &Default();
+
+    TraceService();
+
+    /*
+     * 创建 TracingController, 所有权交给 platform, 只能在 V8Init 中调用一次.
+     */
+    v8::platform::tracing::TracingController *CreateController();
+
+    /*
+     * categories 为逗号分隔的类别列表; maxEvents 为环形缓冲区容量, 超出后覆盖最旧的事件.
+     */
+    int Start(const char *path, const char *categories, size_t maxEvents);
+    int Stop(TraceCounters *out);
+
+    bool Enabled(TraceCategory category) const { return *flags[category] != 0; }
+
+    /*
+     * 以虚拟机为 id 的嵌套异步事件, 在 trace 查看器中每个虚拟机一条时间线.
+     */
+    void Begin(TraceCategory category, const char *name, const void *vm, uint64_t sessionId);
+    void End(TraceCategory category, const char *name, const void *vm);
+
+private:
+    std::mutex mutex;
+    v8::platform::tracing::TracingController *controller;
+    TraceRing *ring;
+    std::ofstream out;
+    bool recording;
+    const uint8_t *flags[kTraceCategoryCount];
+};
+
+/*
+ * 作用域内的追踪区间, 类别未开启时只有一次读取开销. name 必须是字符串常量.
+ */
+class TraceSpan {
+public:
+    TraceSpan(TraceCategory category, const char *name, const void *vm, uint64_t sessionId = 0)
+        : category(category), name(name), vm(vm), active(TraceService::Default().Enabled(category)) {
+        if (active)
+            TraceService::Default().Begin(category, name, vm, sessionId);
+    }
+
+    ~TraceSpan() {
+        if (active)
+            TraceService::Default().End(category, name, vm);
+    }
+
+private:
+    TraceCategory category;
+    const char *name;
+    const void *vm;
+    bool active;
+
+    TraceSpan(const TraceSpan &) = delete;
+    void operator=(const TraceSpan &) = delete;
+};
+
+#endif  // !defined(V8_TRACE_H)
@@ -0,0 +1,137 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * The ASF licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "v8vfs.h"
+
+#include <string.h>
+
+VirtualFileSystem::File::~File() {
+    if (mapped && mount != nullptr && mount->provider.unmap != nullptr)
+        mount->provider.unmap(mount->provider.ctx, relative.c_str(), data, length);
+}
+
+VirtualFileSystem &VirtualFileSystem::Default() {
+    static VirtualFileSystem vfs;
+    return vfs;
+}
+
+int VirtualFileSystem::Mount(const std::string &root, const V8VfsProvider &provider) {
+    if (provider.stat == nullptr || (provider.read == nullptr && provider.map == nullptr))
+        return -1;
+
+    std::shared_ptr<MountPoint> mount(new MountPoint);
+    mount->root = root;
+    while (!mount->root.empty() && mount->root[mount->root.length() - 1] == '/')
+        mount->root.pop_back();
+    mount->provider = provider;
+
+    std::lock_guard<std::mutex> lock(mutex);
+    mount->id = nextId++;
+    mounts.push_back(mount);
+    return mount->id;
+}
+
+bool VirtualFileSystem::Unmount(int id) {
+    std::lock_guard<std::mutex> lock(mutex);
+    for (auto it = mounts.begin(); it != mounts.end(); ++it) {
+        if ((*it)->id == id) {
+            mounts.erase(it);
+            return true;
+        }
+    }
+    return false;
+}
+
+bool VirtualFileSystem::Empty() {
+    std::lock_guard<std::mutex> lock(mutex);
+    return mounts.empty();
+}
+
+int VirtualFileSystem::Open(const char *path, File &out) {
+    std::vector<std::shared_ptr<MountPoint>> snapshot;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (mounts.empty())
+            return -1;
+        snapshot = mounts;
+    }
+
+    for (auto it = snapshot.rbegin(); it != snapshot.rend(); ++it) {
+        const MountPoint &mount = **it;
+        const char *rel = path;
+        if (path[0] == '/') {
+            size_t rootLen = mount.root.length();
+            if (strncmp(path, mount.root.c_str(), rootLen) != 0 || path[rootLen] != '/')
+                continue;
+            rel = path + rootLen + 1;
+        }
+        while (rel[0] == '.' && rel[1] == '/')
+            rel += 2;
+
+        uint64_t size = 0;
+        if (mount.provider.stat(mount.provider.ctx, rel, &size) != 0)
+            continue;
+
+        out.mount = *it;
+        out.relative = rel;
+
+        if (mount.provider.map != nullptr) {
+            size_t len = 0;
+            const char *data = mount.provider.map(mount.provider.ctx, rel, &len);
+            if (data != nullptr) {
+                out.data = data;
+                out.length = len;
+                out.mapped = true;
+                return 1;
+            }
+        }
+        if (mount.provider.read == nullptr)
+            return 0;
+
+        out.text.resize(size);
+        int64_t n = size == 0 ? 0 : mount.provider.read(mount.provider.ctx, rel, &out.text[0], size);
+        if (n < 0)
+            return 0;
+        out.text.resize((size_t)n < size ? (size_t)n : size);
+        out.data = out.text.data();
+        out.length = out.text.length();
+        return out.length != 0 ? 1 : 0;
+    }
+    return -1;
+}
+
+void VirtualFileSystem::Record(const char *path, size_t bytes, bool hit) {
+    std::lock_guard<std::mutex> lock(countersMutex);
+    auto it = counters.find(path);
+    if (it == counters.end()) {
+        if (counters.size() >= kMaxPaths)
+            return;
+        PathCounters zero = {0, 0, 0};
+        it = counters.insert(std::make_pair(std::string(path), zero)).first;
+    }
+    if (hit) {
+        it->second.reads++;
+        it->second.bytes += bytes;
+    } else {
+        it->second.misses++;
+    }
+}
+
+void VirtualFileSystem::Counters(std::vector<std::pair<std::string, PathCounters>> &out) {
+    std::lock_guard<std::mutex> lock(countersMutex);
+    out.assign(counters.begin(), counters.end());
+}
@@ -0,0 +1,96 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * The ASF licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef V8_VFS_H
+#define V8_VFS_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "v8bridge.h"
+
+/*
+ * 脚本源码的虚拟文件系统. 每个挂载点把一个绝对目录交给一个 V8VfsProvider,
+ * 后挂载的优先; 提供者收到的是相对挂载目录的路径. 相对路径的脚本名在每个挂载点下按相对路径查找.
+ */
+class VirtualFileSystem {
+public:
+    struct MountPoint {
+        int id;
+        std::string root;
+        V8VfsProvider provider;
+    };
+
+    /*
+     * 一次打开的源码. 提供者支持 map 时直接引用其内存, 析构时 unmap.
+     */
+    struct File {
+        File() : data(nullptr), length(0), mapped(false) {}
+        File(const File &) = delete;
+        File &operator=(const File &) = delete;
+        ~File();
+
+        std::shared_ptr<MountPoint> mount;
+        std::string relative;
+        std::string text;
+        const char *data;
+        size_t length;
+        bool mapped;
+    };
+
+    struct PathCounters {
+        uint64_t reads;
+        uint64_t misses;
+        uint64_t bytes;
+    };
+
+    static VirtualFileSystem &Default();
+
+    int Mount(const std::string &root, const V8VfsProvider &provider);
+    bool Unmount(int id);
+    bool Empty();
+
+    /*
+     * 在挂载点中查找并读取. 没有挂载点包含该路径返回 -1, 读取失败返回 0, 成功返回 1.
+     */
+    int Open(const char *path, File &out);
+
+    /*
+     * 记录一次按路径的源码访问, 所有来源(挂载点/脚本包/磁盘)共用.
+     */
+    void Record(const char *path, size_t bytes, bool hit);
+    void Counters(std::vector<std::pair<std::string, PathCounters>> &out);
+
+private:
+    static const size_t kMaxPaths = 65536;
+
+    VirtualFileSystem() : nextId(1) {}
+
+    std::mutex mutex;
+    int nextId;
+    std::vector<std::shared_ptr<MountPoint>> mounts;
+    std::mutex countersMutex;
+    std::unordered_map<std::string, PathCounters> counters;
+};
+
+#endif  // !defined(V8_VFS_H)
@@ -0,0 +1,146 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * The ASF licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+package v8go
+
+/*
+#include <stdlib.h>
+#include <string.h>
+#include "v8bridge.h"
+*/
+import "C"
+
+import (
+    "sort"
+    "sync"
+    "sync/atomic"
+    "unsafe"
+)
+
+// 脚本源码的虚拟文件系统, path 为相对挂载目录的路径, 以 / 分隔
+type FileSystem interface {
+    Stat(path string) (size int64, ok bool)
+    ReadFile(path string) ([]byte, error)
+}
+
+// 内存中的文件表, 也可以用来包装 go:embed 读出的内容
+type MapFS map[string][]byte
+
+func (m MapFS) Stat(path string) (int64, bool) {
+    data, ok := m[path]
+    return int64(len(data)), ok
+}
+
+func (m MapFS) ReadFile(path string) ([]byte, error) {
+    return m[path], nil
+}
+
+// 按路径的源码访问计数, 包括虚拟文件系统/脚本包/磁盘
+type PathAccess struct {
+    Path   string
+    Reads  uint64
+    Misses uint64
+    Bytes  uint64
+}
+
+var (
+    vfsHandles    sync.Map
+    vfsMounts     sync.Map
+    vfsNextHandle uintptr
+)
+
+//export GoVfsStat
+func GoVfsStat(handle C.uintptr_t, path *C.char, size *C.uint64_t) C.int {
+    fs, ok := vfsHandles.Load(uintptr(handle))
+    if !ok {
+        return -1
+    }
+    n, ok := fs.(FileSystem).Stat(C.GoString(path))
+    if !ok {
+        return -1
+    }
+    *size = C.uint64_t(n)
+    return 0
+}
+
+//export GoVfsRead
+func GoVfsRead(handle C.uintptr_t, path *C.char, buf *C.char, size C.size_t) C.int64_t {
+    fs, ok := vfsHandles.Load(uintptr(handle))
+    if !ok {
+        return -1
+    }
+    data, err := fs.(FileSystem).ReadFile(C.GoString(path))
+    if err != nil {
+        return -1
+    }
+    n := len(data)
+    if n > int(size) {
+        n = int(size)
+    }
+    if n > 0 {
+        C.memcpy(unsafe.Pointer(buf), unsafe.Pointer(&data[0]), C.size_t(n))
+    }
+    return C.int64_t(n)
+}
+
+// 把 fs 挂载到 root(为空时为工作目录), Load 和模块加载会优先从中取源码, 后挂载的优先.
+// 返回挂载 id, 失败返回 -1
+func MountFS(root string, fs FileSystem) int {
+    handle := atomic.AddUintptr(&vfsNextHandle, 1)
+    vfsHandles.Store(handle, fs)
+
+    cRoot := C.CString(root)
+    defer C.free(unsafe.Pointer(cRoot))
+    id := int(C.V8MountGoVfs(cRoot, C.uintptr_t(handle)))
+    if id < 0 {
+        vfsHandles.Delete(handle)
+        return -1
+    }
+    vfsMounts.Store(id, handle)
+    return id
+}
+
+func UnmountFS(id int) {
+    C.V8UnmountVfs(C.int(id))
+    if handle, ok := vfsMounts.Load(id); ok {
+        vfsMounts.Delete(id)
+        vfsHandles.Delete(handle)
+    }
+}
+
+// 按读取次数降序
+func GetPathAccess() []PathAccess {
+    cList := C.V8GetPathAccess()
+    defer C.V8ReleasePathAccess(cList)
+
+    length := int(C.V8GetPathAccessLength(cList))
+    access := make([]PathAccess, length)
+    for i := 0; i < length; i++ {
+        item := C.V8GetPathAccessItem(cList, C.int(i))
+        access[i] = PathAccess{
+            Path:   C.GoString(item.path),
+            Reads:  uint64(item.reads),
+            Misses: uint64(item.misses),
+            Bytes:  uint64(item.bytes),
+        }
+    }
+
+    sort.Slice(access, func(i, j int) bool {
+        return access[i].Reads > access[j].Reads
+    })
+    return access
+}
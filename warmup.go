@@ -0,0 +1,342 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * The ASF licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+package v8go
+
+/*
+#include "v8bridge.h"
+*/
+import "C"
+
+import (
+    "bufio"
+    "encoding/json"
+    "io/ioutil"
+    "os"
+    "sync"
+    "time"
+)
+
+const (
+    WarmupEnter   = "enter"
+    WarmupMessage = "message"
+    WarmupLeave   = "leave"
+)
+
+// 预热语料中的一条事件, 文件格式为每行一个 JSON 对象
+type WarmupEvent struct {
+    Kind    string                 `json:"kind"`
+    Session uint64                 `json:"session"`
+    Addr    string                 `json:"addr,omitempty"`
+    Message map[string]interface{} `json:"message,omitempty"`
+}
+
+// 预热语料. 可由 LoadWarmupCorpus 读取文件, 也可在生产环境中调用 Record* 采集
+type WarmupCorpus struct {
+    mu     sync.Mutex
+    events []WarmupEvent
+    // 采集的事件数上限, 0 表示不限
+    Limit  int
+}
+
+type TierUpStats struct {
+    // 记录期间 TurboFan 生成优化代码的次数
+    Optimized     uint64
+    CodeBytes     uint64
+    BytecodeBytes uint64
+}
+
+type WarmupReport struct {
+    Rounds     int
+    Events     int
+    Errors     int
+    // 第一轮与最后一轮的平均单事件耗时
+    FirstRound time.Duration
+    LastRound  time.Duration
+    Before     TierUpStats
+    After      TierUpStats
+    // 预热期间被优化的函数
+    Optimized  []string
+}
+
+func LoadWarmupCorpus(path string) (*WarmupCorpus, error) {
+    f, err := os.Open(path)
+    if err != nil {
+        return nil, err
+    }
+    defer f.Close()
+
+    c := &WarmupCorpus{}
+    scanner := bufio.NewScanner(f)
+    scanner.Buffer(make([]byte, 64*1024), 16*1024*1024)
+    for scanner.Scan() {
+        line := scanner.Bytes()
+        if len(line) == 0 {
+            continue
+        }
+        var ev WarmupEvent
+        if err := json.Unmarshal(line, &ev); err != nil {
+            return nil, err
+        }
+        c.events = append(c.events, ev)
+    }
+    if err := scanner.Err(); err != nil {
+        return nil, err
+    }
+    return c, nil
+}
+
+func (c *WarmupCorpus) WriteFile(path string) error {
+    c.mu.Lock()
+    var data []byte
+    for _, ev := range c.events {
+        line, err := json.Marshal(ev)
+        if err != nil {
+            c.mu.Unlock()
+            return err
+        }
+        data = append(data, line...)
+        data = append(data, '\n')
+    }
+    c.mu.Unlock()
+
+    if err := ioutil.WriteFile(path+".tmp", data, 0644); err != nil {
+        return err
+    }
+    return os.Rename(path+".tmp", path)
+}
+
+func (c *WarmupCorpus) Len() int {
+    c.mu.Lock()
+    defer c.mu.Unlock()
+    return len(c.events)
+}
+
+// 当前事件的快照
+func (c *WarmupCorpus) Events() []WarmupEvent {
+    c.mu.Lock()
+    defer c.mu.Unlock()
+    return append([]WarmupEvent(nil), c.events...)
+}
+
+// 把消息事件的负载还原为 DispatchMessage 接受的形式
+func (ev *WarmupEvent) DispatchMessage() map[interface{}] interface{} {
+    return warmupDecodeMap(ev.Message)
+}
+
+func (c *WarmupCorpus) record(ev WarmupEvent) {
+    c.mu.Lock()
+    if c.Limit == 0 || len(c.events) < c.Limit {
+        c.events = append(c.events, ev)
+    }
+    c.mu.Unlock()
+}
+
+func (c *WarmupCorpus) RecordEnter(sessionId uint64, addr string) {
+    c.record(WarmupEvent{Kind: WarmupEnter, Session: sessionId, Addr: addr})
+}
+
+func (c *WarmupCorpus) RecordLeave(sessionId uint64, addr string) {
+    c.record(WarmupEvent{Kind: WarmupLeave, Session: sessionId, Addr: addr})
+}
+
+// 记录一条消息, 键按 DispatchMessage 的规则转为字符串
+func (c *WarmupCorpus) RecordMessage(sessionId uint64, msg map[interface{}] interface{}) {
+    c.record(WarmupEvent{Kind: WarmupMessage, Session: sessionId, Message: warmupEncodeMap(msg)})
+}
+
+func warmupEncodeMap(m map[interface{}] interface{}) map[string]interface{} {
+    out := make(map[string]interface{}, len(m))
+    for k, v := range m {
+        if sk, ok := messageKey(k); ok {
+            out[sk] = warmupEncodeValue(v)
+        }
+    }
+    return out
+}
+
+func warmupEncodeValue(v interface{}) interface{} {
+    switch val := v.(type) {
+    case map[interface{}] interface{}: return warmupEncodeMap(val)
+    case []interface{}:
+        arr := make([]interface{}, len(val))
+        for i, item := range val {
+            arr[i] = warmupEncodeValue(item)
+        }
+        return arr
+    }
+    return v
+}
+
+func warmupDecodeValue(v interface{}) interface{} {
+    switch val := v.(type) {
+    case map[string]interface{}: return warmupDecodeMap(val)
+    case []interface{}:
+        arr := make([]interface{}, len(val))
+        for i, item := range val {
+            arr[i] = warmupDecodeValue(item)
+        }
+        return arr
+    }
+    return v
+}
+
+func warmupDecodeMap(m map[string]interface{}) map[interface{}] interface{} {
+    out := make(map[interface{}] interface{}, len(m))
+    for k, v := range m {
+        out[k] = warmupDecodeValue(v)
+    }
+    return out
+}
+
+// 开始/停止记录函数优化, 开始时清空之前的记录
+func (vm *V8VM) TraceTierUp(enabled bool) {
+    if vm.disposed {
+        return
+    }
+    C.V8TraceTierUp(vm.vmCPtr, C._Bool(enabled))
+}
+
+func (vm *V8VM) TierUpStats() TierUpStats {
+    if vm.disposed {
+        return TierUpStats{}
+    }
+    var cs C.V8TierUpStats
+    C.V8GetTierUpStats(vm.vmCPtr, &cs)
+    return TierUpStats{
+        Optimized:     uint64(cs.optimized),
+        CodeBytes:     uint64(cs.codeBytes),
+        BytecodeBytes: uint64(cs.bytecodeBytes),
+    }
+}
+
+// 记录期间被优化的函数名
+func (vm *V8VM) OptimizedFunctions() []string {
+    if vm.disposed {
+        return nil
+    }
+    cs := C.V8GetOptimizedFunctions(vm.vmCPtr)
+    defer C.V8ReleaseStringArrays(cs)
+
+    n := int(C.V8GetStringArraysLength(cs))
+    names := make([]string, n)
+    for i := 0; i < n; i++ {
+        names[i] = C.GoString(C.V8GetStringArraysItem(cs, C.int(i)))
+    }
+    return names
+}
+
+// 屏蔽 net.* 的所有发送
+func (vm *V8VM) SetSendMuted(muted bool) {
+    if vm.disposed {
+        return
+    }
+    C.V8SetSendMuted(vm.vmCPtr, C._Bool(muted))
+}
+
+// 标记/丢弃预热期间新建的定时器和动态导入
+func (vm *V8VM) markPendingWork() {
+    if vm.disposed {
+        return
+    }
+    C.V8MarkPendingWork(vm.vmCPtr)
+}
+
+func (vm *V8VM) discardPendingWork() {
+    if vm.disposed {
+        return
+    }
+    C.V8DiscardPendingWork(vm.vmCPtr)
+}
+
+// 把语料重放 rounds 轮, 让热点函数在交付前完成 JIT 优化. 期间屏蔽所有发送,
+// 结束时离开语料中未离开的会话, 并取消重放期间新建的定时器和动态导入.
+func Warmup(vm VM, corpus *WarmupCorpus, rounds int) WarmupReport {
+    corpus.mu.Lock()
+    events := corpus.events
+    corpus.mu.Unlock()
+
+    messages := make([]map[interface{}] interface{}, len(events))
+    for i, ev := range events {
+        if ev.Kind == WarmupMessage {
+            messages[i] = warmupDecodeMap(ev.Message)
+        }
+    }
+
+    report := WarmupReport{Rounds: rounds}
+    report.Before = vm.TierUpStats()
+    v8vm, _ := vm.(*V8VM)
+    if v8vm != nil {
+        v8vm.markPendingWork()
+    }
+    vm.SetSendMuted(true)
+    vm.TraceTierUp(true)
+
+    // 语料进入而未离开的会话, 结束时补发 leave, 不把会话状态留给真实会话
+    entered := make(map[uint64]string)
+    defer func() {
+        for id, addr := range entered {
+            vm.DispatchLeave(id, addr)
+        }
+        if v8vm != nil {
+            v8vm.discardPendingWork()
+        }
+        vm.TraceTierUp(false)
+        vm.SetSendMuted(false)
+    }()
+
+    for round := 0; round < rounds; round++ {
+        start := time.Now()
+        for i, ev := range events {
+            r := 0
+            switch ev.Kind {
+            case WarmupEnter:
+                r = vm.DispatchEnter(ev.Session, ev.Addr)
+                entered[ev.Session] = ev.Addr
+            case WarmupLeave:
+                r = vm.DispatchLeave(ev.Session, ev.Addr)
+                delete(entered, ev.Session)
+            case WarmupMessage: r = vm.DispatchMessage(ev.Session, messages[i])
+            default:
+                continue
+            }
+            report.Events++
+            if r == 2 || r == -1 {
+                report.Errors++
+            }
+        }
+        if len(events) > 0 {
+            avg := time.Since(start) / time.Duration(len(events))
+            if round == 0 {
+                report.FirstRound = avg
+            }
+            report.LastRound = avg
+        }
+    }
+
+    report.After = vm.TierUpStats()
+    report.Optimized = vm.OptimizedFunctions()
+    return report
+}
+
+// 返回可赋给 VMPool.Prepare 的函数, 池中的虚拟机加载脚本后先用语料预热
+func WarmupPrepare(corpus *WarmupCorpus, rounds int) func(VM) bool {
+    return func(vm VM) bool {
+        Warmup(vm, corpus, rounds)
+        return true
+    }
+}